@@ -0,0 +1,324 @@
+#include "ccore/c_target.h"
+#include "ccore/c_debug.h"
+#include "cbase/c_allocator.h"
+#include "cbase/c_memory.h"
+
+#include "cfilesystem/c_appendlog.h"
+#include "cfilesystem/c_async.h"
+#include "cfilesystem/c_filepath.h"
+#include "cfilesystem/c_filesystem.h"
+
+#include "cfilesystem/private/c_atomic.h"
+#include "cfilesystem/private/c_enumerations.h"
+#include "cfilesystem/private/c_filedevice.h"
+#include "cfilesystem/private/c_filesystem.h"
+#include "cfilesystem/private/c_segment.h"
+
+namespace ncore
+{
+    namespace nfs
+    {
+        extern filesys_t* mImpl;
+
+        appendlog_t::appendlog_t() : m_allocator(nullptr), m_device(nullptr), m_path(nullptr), m_segment_size(0), m_slab_size(0), m_slab_count(0), m_slabs(nullptr), m_tail(0), m_written(0), m_flush_to(0), m_pending(0), m_busy(0), m_queued(0), m_failed(0), m_segment(-1), m_handle(nullptr), m_open(false) { m_flusher.m_log = this; }
+
+        appendlog_t::~appendlog_t() { close(); }
+
+        bool appendlog_t::open(appendlogoptions_t const& options)
+        {
+            if (m_open || options.m_path == nullptr || options.m_slab_count < 2 || options.m_slab_size == 0)
+                return false;
+
+            char name[ESettings::MAX_PATH];
+            if (!segment_name(options.m_path, 0, "log", name, ESettings::MAX_PATH))
+                return false;
+
+            m_allocator    = mImpl->m_allocator;
+            m_device       = filepath(name).m_dirpath.m_device->m_fileDevice;
+            m_slab_size    = options.m_slab_size;
+            m_slab_count   = options.m_slab_count;
+            m_segment_size = ((options.m_segment_size + m_slab_size - 1) / m_slab_size) * m_slab_size;
+            if (m_segment_size == 0)
+                m_segment_size = m_slab_size;
+            if (!m_device->canWrite())
+                return false;
+
+            s32 pathlen = 0;
+            while (options.m_path[pathlen] != '\0')
+                pathlen += 1;
+            m_path = (char*)m_allocator->allocate(pathlen + 1);
+            nmem::memcpy(m_path, options.m_path, pathlen + 1);
+
+            // Continue after the end of the last segment
+            s64 last = -1;
+            while (segment_name(m_path, last + 1, "log", name, ESettings::MAX_PATH) && m_device->hasFile(filepath(name)))
+                last += 1;
+            s64 tail = 0;
+            if (last >= 0)
+            {
+                u64 length = 0;
+                segment_name(m_path, last, "log", name, ESettings::MAX_PATH);
+                if (!m_device->statFile(filepath(name), length, nullptr, nullptr) || !open_segment(last, false))
+                {
+                    m_allocator->deallocate(m_path);
+                    m_path = nullptr;
+                    return false;
+                }
+                tail = last * (s64)m_segment_size + (s64)length;
+            }
+
+            m_slabs       = (slab_t*)m_allocator->allocate(sizeof(slab_t) * m_slab_count);
+            s64 const top = tail - (tail % m_slab_size);
+            for (s32 i = 0; i < m_slab_count; ++i)
+            {
+                s64 const base                                  = top + i * m_slab_size;
+                slab_t&   slab                                  = m_slabs[(base / m_slab_size) % m_slab_count];
+                slab.m_data                                     = (u8*)m_allocator->allocate((u32)m_slab_size, ESettings::MEM_ALIGNMENT);
+                slab.m_base                                     = base;
+                slab.m_committed                                = 0;
+            }
+            // The part of the first slab before the tail is already in the segment
+            m_slabs[(top / m_slab_size) % m_slab_count].m_committed = tail - top;
+
+            m_tail     = tail;
+            m_written  = tail;
+            m_flush_to = tail;
+            m_pending  = 0;
+            m_busy     = 0;
+            m_queued   = 0;
+            m_failed   = 0;
+            m_open     = true;
+            return true;
+        }
+
+        void appendlog_t::close()
+        {
+            if (!m_open)
+                return;
+
+            sync();
+            m_open = false;
+
+            acquire_flusher();
+            while (natomic::load(&m_queued) != 0)
+                io_yield();
+            close_segment();
+            natomic::store(&m_busy, 0);
+
+            for (s32 i = 0; i < m_slab_count; ++i)
+                m_allocator->deallocate(m_slabs[i].m_data);
+            m_allocator->deallocate(m_slabs);
+            m_allocator->deallocate(m_path);
+            m_slabs = nullptr;
+            m_path  = nullptr;
+        }
+
+        s64 appendlog_t::append(void const* data, u32 size)
+        {
+            if (!m_open)
+                return -1;
+
+            s64 const at   = natomic::add(&m_tail, (s64)size);
+            u8 const* src  = (u8 const*)data;
+            s64       pos  = at;
+            s64       left = size;
+            while (left > 0)
+            {
+                s64 const base = pos - (pos % m_slab_size);
+                slab_t&   slab = m_slabs[(base / m_slab_size) % m_slab_count];
+
+                // The slab still holds an older range that has not been written yet
+                while (natomic::load(&slab.m_base) != base)
+                {
+                    kick();
+                    io_yield();
+                }
+
+                s64 const n = left < (base + m_slab_size - pos) ? left : (base + m_slab_size - pos);
+                nmem::memcpy(slab.m_data + (pos - base), src, (u32)n);
+                s64 const committed = natomic::add(&slab.m_committed, n) + n;
+                if (committed == m_slab_size)
+                    kick();
+                pos += n;
+                src += n;
+                left -= n;
+            }
+            return at;
+        }
+
+        void appendlog_t::request_flush(s64 to)
+        {
+            s64 cur = natomic::load(&m_flush_to);
+            while (to > cur && !natomic::cas(&m_flush_to, cur, to))
+                cur = natomic::load(&m_flush_to);
+        }
+
+        void appendlog_t::flush()
+        {
+            if (!m_open)
+                return;
+            request_flush(natomic::load(&m_tail));
+            kick();
+        }
+
+        bool appendlog_t::sync()
+        {
+            if (!m_open)
+                return false;
+
+            s64 const to = natomic::load(&m_tail);
+            request_flush(to);
+            while (natomic::load(&m_written) < to && natomic::load(&m_failed) == 0)
+            {
+                kick();
+                io_yield();
+            }
+
+            // The flusher owns the segment handle, it can be closed by a rotation
+            acquire_flusher();
+            bool const result = natomic::load(&m_failed) == 0 && (m_handle == nullptr || m_device->flushFile(m_handle));
+            natomic::store(&m_busy, 0);
+            if (natomic::load(&m_pending) != 0)
+                kick();
+            return result;
+        }
+
+        s64 appendlog_t::size() const { return natomic::load(&m_tail); }
+        s64 appendlog_t::written() const { return natomic::load(&m_written); }
+
+        void appendlog_t::acquire_flusher()
+        {
+            while (!natomic::cas(&m_busy, 0, 1))
+                io_yield();
+        }
+
+        // Only one flusher runs at a time, a kick while it runs makes it check again
+        void appendlog_t::kick()
+        {
+            natomic::store(&m_pending, 1);
+            if (!natomic::cas(&m_busy, 0, 1))
+                return;
+
+            if (natomic::load(&mImpl->m_ioworkers_count) > 0)
+            {
+                natomic::add(&m_queued, 1);
+                async_t const token = mImpl->submit_call(m_device, nullptr, &m_flusher, &m_flusher, EIoPriority::LOW);
+                if (token.error().value == EFileError::ERROR_ASYNC_BUSY)
+                    return;
+                natomic::add(&m_queued, -1);
+            }
+            run();
+        }
+
+        void appendlog_t::run()
+        {
+            while (true)
+            {
+                while (natomic::exchange(&m_pending, 0) != 0)
+                    drain();
+                natomic::store(&m_busy, 0);
+                if (natomic::load(&m_pending) == 0 || !natomic::cas(&m_busy, 0, 1))
+                    return;
+            }
+        }
+
+        EFileError::Enum appendlog_t::flusher_t::operator()(s64& result)
+        {
+            m_log->run();
+            result = 0;
+            return EFileError::Error_Ok();
+        }
+
+        void appendlog_t::flusher_t::operator()(async_t const& token, EFileError::Enum error, s64 bytes) { natomic::add(&m_log->m_queued, -1); }
+
+        // Write the slabs in log order. A full slab is written and handed back, of the
+        // slab at the tail only the part that is complete is written when a flush asks
+        // for it. That part is known to be complete when all the bytes reserved in the
+        // slab have been copied in, the committed count is read before the tail so
+        // equal counts mean nothing was in progress.
+        void appendlog_t::drain()
+        {
+            while (natomic::load(&m_failed) == 0)
+            {
+                s64 const at   = m_written;
+                s64 const base = at - (at % m_slab_size);
+                slab_t&   slab = m_slabs[(base / m_slab_size) % m_slab_count];
+                if (natomic::load(&slab.m_base) != base)
+                    return;
+
+                s64 const committed = natomic::load(&slab.m_committed);
+                s64       end       = base + m_slab_size;
+                if (committed != m_slab_size)
+                {
+                    if (natomic::load(&m_flush_to) <= at)
+                        return;
+                    s64 const tail = natomic::load(&m_tail);
+                    end            = tail < end ? tail : end;
+                    if (committed != (end - base) || end <= at)
+                        return;
+                }
+
+                if (!write(at, end, slab.m_data + (at - base)))
+                {
+                    natomic::store(&m_failed, 1);
+                    return;
+                }
+                natomic::store(&m_written, end);
+
+                if (end != (base + m_slab_size))
+                    return;
+                slab.m_committed = 0;
+                natomic::store(&slab.m_base, base + (s64)m_slab_count * m_slab_size);
+            }
+        }
+
+        bool appendlog_t::write(s64 from, s64 to, u8 const* data)
+        {
+            s64 const index = from / (s64)m_segment_size;
+            if (index != m_segment)
+            {
+                close_segment();
+                if (!open_segment(index, true))
+                    return false;
+            }
+
+            u64       n     = 0;
+            u64 const pos   = (u64)(from - index * (s64)m_segment_size);
+            u64 const count = (u64)(to - from);
+            return m_device->writeFile(m_handle, pos, data, count, n) && n == count;
+        }
+
+        // A new segment gets its storage reserved up front, it is given back when the
+        // segment is closed (the length is what has been written).
+        bool appendlog_t::open_segment(s64 index, bool create)
+        {
+            char name[ESettings::MAX_PATH];
+            if (!segment_name(m_path, index, "log", name, ESettings::MAX_PATH))
+                return false;
+
+            void*      handle   = nullptr;
+            bool const result   = create ? m_device->createFile(filepath(name), true, true, handle) : m_device->openFile(filepath(name), EFileMode::Value_Open, EFileAccess::Value_ReadWrite, EFileOp::Value_Sync, handle);
+            if (!result)
+                return false;
+            if (create)
+                m_device->reserveFile(handle, m_segment_size);
+            m_segment = index;
+            m_handle  = handle;
+            return true;
+        }
+
+        void appendlog_t::close_segment()
+        {
+            if (m_handle == nullptr)
+                return;
+            u64 length = 0;
+            if (m_device->getLengthOfFile(m_handle, length))
+                m_device->setLengthOfFile(m_handle, length);
+            m_device->flushFile(m_handle);
+            m_device->closeFile(m_handle);
+            m_handle  = nullptr;
+            m_segment = -1;
+        }
+
+    } // namespace nfs
+}; // namespace ncore
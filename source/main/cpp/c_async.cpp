@@ -0,0 +1,711 @@
+#include "ccore/c_target.h"
+#include "ccore/c_debug.h"
+#include "cbase/c_allocator.h"
+#include "cbase/c_memory.h"
+
+#include "cfilesystem/c_async.h"
+#include "cfilesystem/c_filesystem.h"
+#include "cfilesystem/c_stream.h"
+#include "cfilesystem/c_threading.h"
+
+#include "cfilesystem/private/c_atomic.h"
+#include "cfilesystem/private/c_enumerations.h"
+#include "cfilesystem/private/c_filedevice.h"
+#include "cfilesystem/private/c_filesystem.h"
+#include "cfilesystem/private/c_iorequest.h"
+#include "cfilesystem/private/c_ioscheduler.h"
+#include "cfilesystem/private/c_ioqueue.h"
+
+namespace ncore
+{
+    namespace nfs
+    {
+        extern filesys_t* mImpl;
+
+        // -----------------------------------------------------------
+        // async_t
+        // -----------------------------------------------------------
+
+        async_t::async_t() : m_owner(nullptr), m_id(0), m_error(EFileError::ERROR_NOASYNC), m_result(0) {}
+        async_t::async_t(const async_t& t) : m_owner(t.m_owner), m_id(t.m_id), m_error(t.m_error), m_result(t.m_result) {}
+        async_t::async_t(filesys_t* owner, async_id_t id, EFileError::Enum error) : m_owner(owner), m_id(id), m_error(error), m_result(0) {}
+
+        bool async_t::isValid() const { return m_owner != nullptr || m_error.value != EFileError::ERROR_NOASYNC; }
+
+        EFileError::Enum async_t::poll()
+        {
+            if (m_owner == nullptr)
+                return m_error;
+
+            iorequest_t* req = m_owner->lookup_iorequest(m_id);
+            if (req == nullptr)
+            {
+                // Retired by somebody else (e.g. after calling the delegate)
+                m_owner = nullptr;
+                m_error = EFileError::ERROR_NOASYNC;
+                return m_error;
+            }
+
+            // A request with a delegate is retired by the one delivering it, also when
+            // the token is waited on from inside the delegate
+            s32 const state = natomic::load(&req->m_state);
+            if (state == EIoState::DELIVERING)
+            {
+                m_owner = nullptr;
+                m_error = EFileError::ERROR_NOASYNC;
+                return m_error;
+            }
+            if (state != EIoState::DONE)
+                return EFileError::ERROR_ASYNC_BUSY;
+
+            // Copies of the token may poll at the same time, only the one that moves
+            // the request out of DONE retires it
+            EFileError::EEnumValue const error  = (EFileError::EEnumValue)req->m_error;
+            s64 const                    result = req->m_result;
+            filesys_t* const             owner  = m_owner;
+            m_owner                             = nullptr;
+            if (!natomic::cas(&req->m_state, EIoState::DONE, EIoState::FREE))
+            {
+                m_error = EFileError::ERROR_NOASYNC;
+                return m_error;
+            }
+            m_error  = error;
+            m_result = result;
+            owner->release_iorequest(req);
+            return m_error;
+        }
+
+        EFileError::Enum async_t::wait()
+        {
+            filesys_t* owner = m_owner;
+            while (true)
+            {
+                EFileError::Enum const e = poll();
+                if (e.value != EFileError::ERROR_ASYNC_BUSY)
+                    return e;
+                if (!owner->process_iorequest())
+                    io_yield();
+            }
+        }
+
+        s32 async_t::wait_any(async_t* tokens, s32 count)
+        {
+            filesys_t* owner = nullptr;
+            for (s32 i = 0; i < count; ++i)
+            {
+                if (tokens[i].m_owner != nullptr)
+                    owner = tokens[i].m_owner;
+                else if (tokens[i].m_error.value != EFileError::ERROR_NOASYNC)
+                    return i;
+            }
+            if (owner == nullptr)
+                return -1;
+
+            while (true)
+            {
+                for (s32 i = 0; i < count; ++i)
+                {
+                    if (tokens[i].m_owner == nullptr)
+                        continue;
+                    EFileError::Enum const e = tokens[i].poll();
+                    if (e.value != EFileError::ERROR_ASYNC_BUSY)
+                        return i;
+                }
+                if (!owner->process_iorequest())
+                    io_yield();
+            }
+        }
+
+        bool async_t::cancel()
+        {
+            if (m_owner == nullptr)
+                return false;
+            return m_owner->cancel_iorequest(m_id);
+        }
+
+        async_t& async_t::operator=(const async_t& t)
+        {
+            m_owner  = t.m_owner;
+            m_id     = t.m_id;
+            m_error  = t.m_error;
+            m_result = t.m_result;
+            return *this;
+        }
+
+        // -----------------------------------------------------------
+        // stream_t
+        // -----------------------------------------------------------
+
+        async_t stream_t::read_async(s64 offset, u8* buffer, s64 size, async_delegate_t* delegate, s32 priority, u32 deadline_us, u32 timeout_us)
+        {
+            if (m_filehandle == nullptr || m_filehandle == INVALID_FILE_HANDLE)
+                return async_t(nullptr, 0, EFileError::ERROR_BAD_FD);
+            if (priority < 0 || priority >= EIoPriority::COUNT)
+                return async_t(nullptr, 0, EFileError::ERROR_PRIORITY);
+            return m_filehandle->m_owner->submit(EIoOp::READ, m_filehandle->m_filedevice, m_filehandle, (u64)offset, buffer, (u64)size, 0, delegate, priority, deadline_us, timeout_us, isAsync());
+        }
+
+        async_t stream_t::write_async(s64 offset, u8 const* buffer, s64 size, async_delegate_t* delegate, s32 priority, u32 deadline_us, u32 timeout_us)
+        {
+            if (m_filehandle == nullptr || m_filehandle == INVALID_FILE_HANDLE)
+                return async_t(nullptr, 0, EFileError::ERROR_BAD_FD);
+            if (!canWrite())
+                return async_t(nullptr, 0, EFileError::ERROR_DEVICE_READONLY);
+            if (priority < 0 || priority >= EIoPriority::COUNT)
+                return async_t(nullptr, 0, EFileError::ERROR_PRIORITY);
+            return m_filehandle->m_owner->submit(EIoOp::WRITE, m_filehandle->m_filedevice, m_filehandle, (u64)offset, (void*)buffer, (u64)size, 0, delegate, priority, deadline_us, timeout_us, isAsync());
+        }
+
+        static inline u64 sSpansSize(ciospan_t const* spans, s32 count)
+        {
+            u64 size = 0;
+            for (s32 i = 0; i < count; ++i)
+                size += spans[i].m_size;
+            return size;
+        }
+
+        async_t stream_t::read_async(s64 offset, iospan_t const* spans, s32 count, async_delegate_t* delegate, s32 priority, u32 deadline_us, u32 timeout_us)
+        {
+            if (m_filehandle == nullptr || m_filehandle == INVALID_FILE_HANDLE)
+                return async_t(nullptr, 0, EFileError::ERROR_BAD_FD);
+            if (priority < 0 || priority >= EIoPriority::COUNT)
+                return async_t(nullptr, 0, EFileError::ERROR_PRIORITY);
+            u64 const size = sSpansSize((ciospan_t const*)spans, count);
+            return m_filehandle->m_owner->submit(EIoOp::READ, m_filehandle->m_filedevice, m_filehandle, (u64)offset, (void*)spans, size, count, delegate, priority, deadline_us, timeout_us, isAsync());
+        }
+
+        async_t stream_t::write_async(s64 offset, ciospan_t const* spans, s32 count, async_delegate_t* delegate, s32 priority, u32 deadline_us, u32 timeout_us)
+        {
+            if (m_filehandle == nullptr || m_filehandle == INVALID_FILE_HANDLE)
+                return async_t(nullptr, 0, EFileError::ERROR_BAD_FD);
+            if (!canWrite())
+                return async_t(nullptr, 0, EFileError::ERROR_DEVICE_READONLY);
+            if (priority < 0 || priority >= EIoPriority::COUNT)
+                return async_t(nullptr, 0, EFileError::ERROR_PRIORITY);
+            u64 const size = sSpansSize(spans, count);
+            return m_filehandle->m_owner->submit(EIoOp::WRITE, m_filehandle->m_filedevice, m_filehandle, (u64)offset, (void*)spans, size, count, delegate, priority, deadline_us, timeout_us, isAsync());
+        }
+
+        s32 stream_t::cancel_all()
+        {
+            if (m_filehandle == nullptr || m_filehandle == INVALID_FILE_HANDLE)
+                return 0;
+            return m_filehandle->m_owner->cancel_filehandle(m_filehandle);
+        }
+
+        void get_iostats(iostats_t& stats)
+        {
+            stats.m_cancelled = natomic::load(&mImpl->m_stats_cancelled);
+            stats.m_timedout  = natomic::load(&mImpl->m_stats_timedout);
+        }
+
+        // -----------------------------------------------------------
+        // filesys_t, asynchronous request pool and queue
+        // -----------------------------------------------------------
+
+        async_t filesys_t::submit(EIoOp::EEnum op, filedevice_t* fd, filehandle_t* fh, u64 offset, void* buffer, u64 size, s32 span_count, async_delegate_t* delegate, s32 priority, u32 deadline_us, u32 timeout_us, bool async)
+        {
+            iorequest_t* req = obtain_iorequest();
+            if (req == nullptr)
+                return async_t(nullptr, 0, EFileError::ERROR_MAX_ASYNC);
+
+            req->m_op         = op;
+            req->m_priority   = priority;
+            req->m_deadline   = deadline_us > 0 ? io_clock_us() + deadline_us : 0;
+            req->m_timeout    = timeout_us > 0 ? io_clock_us() + timeout_us : 0;
+            req->m_queue      = -1;
+            req->m_filehandle = fh;
+            req->m_offset     = offset;
+            req->m_buffer     = buffer;
+            req->m_size       = size;
+            req->m_span_count = span_count;
+            req->m_result     = 0;
+            req->m_error      = EFileError::ERROR_OK;
+            req->m_delegate   = delegate;
+
+            async_t token(this, iorequest_id(req), EFileError::ERROR_ASYNC_BUSY);
+
+            // Streams that are not asynchronous, or when there is no thread running
+            // doIO, execute the request right away.
+            ioqueue_t* queue = nullptr;
+            if (async && natomic::load(&m_ioworkers_count) > 0)
+            {
+                if (fd != nullptr)
+                    queue = get_ioqueue(fd);
+                else if (op == EIoOp::CALL)
+                    queue = &m_ioqueues[WORK_IOQUEUE];
+            }
+
+            if (queue != nullptr)
+            {
+                req->m_queue = (s32)(queue - m_ioqueues);
+                natomic::store(&req->m_state, EIoState::QUEUED);
+                if (queue->m_submitted.push(req))
+                {
+                    wake_ioworker();
+
+                    // The last IO thread may have drained the queues and left between
+                    // the check above and the push, nobody would pick it up then.
+                    if (natomic::load(&m_ioworkers_count) == 0)
+                    {
+                        while (queue->has_work())
+                        {
+                            if (!process_ioqueue(queue))
+                                io_yield();
+                        }
+                    }
+                    return token;
+                }
+
+                // The queue is full, execute it here unless it was cancelled already
+                if (!natomic::cas(&req->m_state, EIoState::QUEUED, EIoState::RUNNING))
+                {
+                    complete_iorequest(req);
+                    return token;
+                }
+            }
+
+            execute_iorequest(req);
+            return token;
+        }
+
+        // Calls are always handed to an IO thread when there is one, they are ordered
+        // with respect to the other requests on the same file. A call without a device
+        // goes to the work queue, which is not limited by m_max_io_per_device, it is
+        // meant for calls that do the IO of several files or of a part of a file.
+        async_t filesys_t::submit_call(filedevice_t* fd, filehandle_t* fh, async_call_t* call, async_delegate_t* delegate, s32 priority)
+        {
+            if (priority < 0 || priority >= EIoPriority::COUNT)
+                return async_t(nullptr, 0, EFileError::ERROR_PRIORITY);
+            return submit(EIoOp::CALL, fd, fh, 0, call, (u64)-1, 0, delegate, priority, 0, 0, true);
+        }
+
+        filehandle_t* filesys_t::get_filehandle(stream_t const& stream) { return stream.m_filehandle; }
+
+        iorequest_t* filesys_t::lookup_iorequest(async_id_t id)
+        {
+            s32 const index = iorequest_index(id);
+            if (index >= (s32)m_max_async)
+                return nullptr;
+            iorequest_t* req = &m_iorequests_array[index];
+            if (req->m_salt != iorequest_salt(id) || natomic::load(&req->m_state) == EIoState::FREE)
+                return nullptr;
+            return req;
+        }
+
+        // The free requests form a lock-free stack, the top is (tag << 32) | (index + 1)
+        // where the tag protects against ABA.
+        static inline s64 sMakeFreeTop(s64 top, s32 index_plus_one) { return (s64)(((((u64)top >> 32) + 1) << 32) | (u64)(u32)index_plus_one); }
+
+        iorequest_t* filesys_t::obtain_iorequest()
+        {
+            while (true)
+            {
+                s64 const top   = natomic::load(&m_iorequests_free);
+                s32 const index = (s32)(top & 0xFFFFFFFF) - 1;
+                if (index < 0)
+                    return nullptr;
+
+                iorequest_t* req = &m_iorequests_array[index];
+                if (natomic::cas(&m_iorequests_free, top, sMakeFreeTop(top, req->m_next_free)))
+                {
+                    req->m_next = nullptr;
+                    req->m_salt = (req->m_salt + 1) & 0xFFFF;
+                    natomic::store(&req->m_state, EIoState::RUNNING); // Until it is queued
+                    return req;
+                }
+            }
+        }
+
+        void filesys_t::release_iorequest(iorequest_t* req)
+        {
+            natomic::store(&req->m_state, EIoState::FREE);
+            req->m_delegate   = nullptr;
+            req->m_filehandle = nullptr;
+            req->m_next       = nullptr;
+            while (true)
+            {
+                s64 const top     = natomic::load(&m_iorequests_free);
+                req->m_next_free = (s32)(top & 0xFFFFFFFF);
+                if (natomic::cas(&m_iorequests_free, top, sMakeFreeTop(top, req->m_index + 1)))
+                    return;
+            }
+        }
+
+        // A request can only be cancelled while it is queued, once an IO thread has
+        // started it the buffer is in use until it completes. A cancelled request is
+        // completed with ERROR_CANCELLED by the next IO thread that visits its queue.
+        bool filesys_t::cancel_queued(iorequest_t* req)
+        {
+            if (!natomic::cas(&req->m_state, EIoState::QUEUED, EIoState::CANCELLED))
+                return false;
+            natomic::add(&m_ioqueues[req->m_queue].m_cancelled, 1);
+            return true;
+        }
+
+        bool filesys_t::cancel_iorequest(async_id_t id)
+        {
+            iorequest_t* req = lookup_iorequest(id);
+            if (req == nullptr || !cancel_queued(req))
+                return false;
+            wake_ioworker();
+            return true;
+        }
+
+        s32 filesys_t::cancel_filehandle(filehandle_t* fh)
+        {
+            s32 count = 0;
+            for (s32 i = 0; i < (s32)m_max_async; ++i)
+            {
+                iorequest_t* req = &m_iorequests_array[i];
+                if (req->m_filehandle == fh && natomic::load(&req->m_state) == EIoState::QUEUED && cancel_queued(req))
+                    count += 1;
+            }
+            if (count > 0)
+                wake_ioworker();
+            return count;
+        }
+
+        // -----------------------------------------------------------
+        // filesys_t, per device queues and IO threads
+        // -----------------------------------------------------------
+
+        ioqueue_t* filesys_t::get_ioqueue(filedevice_t* fd)
+        {
+            for (s32 i = 0; i < MAX_IOQUEUES; ++i)
+            {
+                ioqueue_t*    q = &m_ioqueues[i];
+                filedevice_t* d = (filedevice_t*)natomic::load_ptr((void* volatile*)&q->m_device);
+                if (d == fd)
+                    return q;
+                if (d == nullptr)
+                {
+                    if (natomic::cas_ptr((void* volatile*)&q->m_device, nullptr, fd))
+                        return q;
+                    if (natomic::load_ptr((void* volatile*)&q->m_device) == fd)
+                        return q;
+                }
+            }
+            return nullptr;
+        }
+
+        // Called when a device is destroyed, the queue is drained and can then be
+        // bound to another device.
+        void filesys_t::release_ioqueue(filedevice_t* fd)
+        {
+            for (s32 i = 0; i < MAX_IOQUEUES; ++i)
+            {
+                ioqueue_t* q = &m_ioqueues[i];
+                if (natomic::load_ptr((void* volatile*)&q->m_device) != fd)
+                    continue;
+                while (q->has_work() || natomic::load(&q->m_active) > 0)
+                {
+                    if (!process_ioqueue(q))
+                        io_yield();
+                }
+                natomic::cas_ptr((void* volatile*)&q->m_device, fd, nullptr);
+                return;
+            }
+        }
+
+        bool filesys_t::process_iorequest(s32 worker)
+        {
+            s32 const first = worker < 0 ? 0 : worker;
+            for (s32 i = 0; i <= WORK_IOQUEUE; ++i)
+            {
+                ioqueue_t* q = &m_ioqueues[(first + i) % (WORK_IOQUEUE + 1)];
+                if (!q->has_work())
+                    continue;
+                if (process_ioqueue(q))
+                    return true;
+            }
+            return false;
+        }
+
+        bool filesys_t::process_ioqueue(ioqueue_t* q)
+        {
+            if (!q->try_enter())
+                return false;
+
+            u64 const now = io_clock_us();
+
+            q->m_scheduler_lock.lock();
+            {
+                // Move the submitted requests into the scheduler
+                iorequest_t* req = q->m_submitted.pop();
+                while (req != nullptr)
+                {
+                    q->m_scheduler.push(req, now);
+                    req = q->m_submitted.pop();
+                }
+            }
+            iorequest_t* expired = nullptr;
+            if (natomic::exchange(&q->m_cancelled, 0) != 0 || q->m_scheduler.has_expired(now))
+                expired = q->m_scheduler.expire(now);
+            u8* const    merge_buffer = q->m_scheduler.acquire_merge_buffer();
+            iorequest_t* req          = q->m_scheduler.pop(now, merge_buffer != nullptr ? q->m_scheduler.m_merge_max : 0);
+            q->m_scheduler_lock.unlock();
+
+            bool const progress = expired != nullptr || req != nullptr;
+            while (expired != nullptr)
+            {
+                iorequest_t* next = expired->m_next;
+                expired->m_next   = nullptr;
+                complete_iorequest(expired);
+                expired = next;
+            }
+
+            s32 const active = (req != nullptr) ? req->m_active : -1;
+            if (req != nullptr && req->m_next != nullptr)
+            {
+                execute_merged_iorequest(req, merge_buffer);
+                q->m_scheduler.release_merge_buffer();
+            }
+            else
+            {
+                if (merge_buffer != nullptr)
+                    q->m_scheduler.release_merge_buffer();
+                if (req != nullptr && natomic::load(&req->m_state) != EIoState::RUNNING)
+                    complete_iorequest(req); // Cancelled or timed out
+                else if (req != nullptr)
+                    execute_iorequest(req);
+            }
+
+            // Requests that were waiting on this one can now be scheduled
+            if (active >= 0)
+            {
+                q->m_scheduler_lock.lock();
+                q->m_scheduler.retire(active);
+                q->m_scheduler_lock.unlock();
+            }
+
+            q->leave();
+            return progress;
+        }
+
+        bool filesys_t::has_pending_io() const
+        {
+            for (s32 i = 0; i <= WORK_IOQUEUE; ++i)
+            {
+                if (m_ioqueues[i].has_work())
+                    return true;
+            }
+            return false;
+        }
+
+        s32 filesys_t::register_ioworker(io_thread_t* io_thread)
+        {
+            for (s32 i = 0; i < MAX_IOWORKERS; ++i)
+            {
+                ioworker_t* w = &m_ioworkers[i];
+                if (natomic::cas_ptr(&w->m_thread, nullptr, io_thread))
+                {
+                    natomic::store(&w->m_idle, 0);
+                    natomic::add(&m_ioworkers_count, 1);
+                    return i;
+                }
+            }
+            return -1;
+        }
+
+        void filesys_t::unregister_ioworker(s32 worker)
+        {
+            if (worker < 0)
+                return;
+            ioworker_t* w = &m_ioworkers[worker];
+            natomic::store(&w->m_idle, 0);
+            natomic::store_ptr(&w->m_thread, nullptr);
+            natomic::add(&m_ioworkers_count, -1);
+        }
+
+        // Marks the worker as idle and waits for a signal. The pending work is checked
+        // after publishing the idle state, so a producer either sees the idle worker
+        // and signals it, or the worker sees the request that was just pushed.
+        void filesys_t::idle_ioworker(s32 worker, io_thread_t* io_thread)
+        {
+            if (worker < 0)
+            {
+                io_thread->sleep(1);
+                return;
+            }
+
+            ioworker_t* w = &m_ioworkers[worker];
+            natomic::store(&w->m_idle, 1);
+            if (has_pending_io() && natomic::cas(&w->m_idle, 1, 0))
+                return;
+            io_thread->wait();
+            natomic::store(&w->m_idle, 0);
+        }
+
+        void filesys_t::wake_ioworker()
+        {
+            for (s32 i = 0; i < MAX_IOWORKERS; ++i)
+            {
+                ioworker_t* w = &m_ioworkers[i];
+                if (natomic::cas(&w->m_idle, 1, 0))
+                {
+                    io_thread_t* io_thread = (io_thread_t*)natomic::load_ptr(&w->m_thread);
+                    if (io_thread != nullptr)
+                        io_thread->signal();
+                    return;
+                }
+            }
+        }
+
+        void filesys_t::execute_iorequest(iorequest_t* req)
+        {
+            filehandle_t* fh = req->m_filehandle;
+            if (req->m_op == EIoOp::CALL)
+            {
+                async_call_t*          call   = (async_call_t*)req->m_buffer;
+                s64                    result = 0;
+                EFileError::Enum const error  = (*call)(result);
+                req->m_result                 = result;
+                req->m_error                  = error.value;
+            }
+            else if (fh == nullptr || fh->m_handle == nullptr || fh->m_handle == INVALID_FILE_HANDLE)
+            {
+                req->m_result = -1;
+                req->m_error  = EFileError::ERROR_BAD_FD;
+            }
+            else
+            {
+                u64  n  = 0;
+                bool ok = false;
+                if (req->m_span_count > 0 && req->m_op == EIoOp::READ)
+                    ok = fh->m_filedevice->readFileV(fh->m_handle, req->m_offset, (iospan_t const*)req->m_buffer, req->m_span_count, n);
+                else if (req->m_span_count > 0)
+                    ok = fh->m_filedevice->writeFileV(fh->m_handle, req->m_offset, (ciospan_t const*)req->m_buffer, req->m_span_count, n);
+                else if (req->m_op == EIoOp::READ)
+                    ok = fh->m_filedevice->readFile(fh->m_handle, req->m_offset, req->m_buffer, req->m_size, n);
+                else
+                    ok = fh->m_filedevice->writeFile(fh->m_handle, req->m_offset, req->m_buffer, req->m_size, n);
+                req->m_result = ok ? (s64)n : -1;
+                req->m_error  = ok ? EFileError::ERROR_OK : EFileError::ERROR_IO;
+                if (ok && req->m_op == EIoOp::WRITE)
+                    note_write_end(fh, req->m_offset + n);
+            }
+            complete_iorequest(req);
+        }
+
+        // A chain of reads that the scheduler merged, they are read with one device
+        // call. When the reads are back-to-back they are scattered directly into the
+        // buffers of the requests, otherwise (overlapping reads) they are read into
+        // the merge buffer and copied out to every request.
+        void filesys_t::execute_merged_iorequest(iorequest_t* chain, u8* merge_buffer)
+        {
+            enum
+            {
+                MAX_SPANS = 16
+            };
+            iospan_t spans[MAX_SPANS];
+            s32      num_spans = 0;
+
+            filehandle_t* fh    = chain->m_filehandle;
+            u64 const     start = chain->m_offset;
+            u64           end   = start;
+            for (iorequest_t* r = chain; r != nullptr; r = r->m_next)
+            {
+                if (num_spans >= 0 && num_spans < MAX_SPANS && r->m_offset == end)
+                {
+                    spans[num_spans].m_data = (u8*)r->m_buffer;
+                    spans[num_spans].m_size = r->m_size;
+                    num_spans += 1;
+                }
+                else
+                {
+                    num_spans = -1;
+                }
+                if ((r->m_offset + r->m_size) > end)
+                    end = r->m_offset + r->m_size;
+            }
+
+            u64  n  = 0;
+            bool ok = false;
+            if (fh->m_handle != nullptr && fh->m_handle != INVALID_FILE_HANDLE)
+            {
+                if (num_spans > 0)
+                    ok = fh->m_filedevice->readFileV(fh->m_handle, start, spans, num_spans, n);
+                else
+                    ok = fh->m_filedevice->readFile(fh->m_handle, start, merge_buffer, end - start, n);
+            }
+
+            iorequest_t* r = chain;
+            while (r != nullptr)
+            {
+                iorequest_t* next = r->m_next;
+                r->m_next         = nullptr;
+                if (ok)
+                {
+                    u64 const avail = (start + n) > r->m_offset ? (start + n) - r->m_offset : 0;
+                    u64 const count = avail < r->m_size ? avail : r->m_size;
+                    if (num_spans <= 0)
+                        nmem::memcpy(r->m_buffer, merge_buffer + (r->m_offset - start), count);
+                    r->m_result = (s64)count;
+                    r->m_error  = EFileError::ERROR_OK;
+                }
+                else
+                {
+                    r->m_result = -1;
+                    r->m_error  = EFileError::ERROR_IO;
+                }
+                complete_iorequest(r);
+                r = next;
+            }
+        }
+
+        void filesys_t::complete_iorequest(iorequest_t* req)
+        {
+            s32 const state = natomic::load(&req->m_state);
+            if (state == EIoState::CANCELLED)
+            {
+                req->m_result = -1;
+                req->m_error  = EFileError::ERROR_CANCELLED;
+                natomic::add(&m_stats_cancelled, 1);
+            }
+            else if (state == EIoState::TIMEDOUT)
+            {
+                req->m_result = -1;
+                req->m_error  = EFileError::ERROR_TIMEDOUT;
+                natomic::add(&m_stats_timedout, 1);
+            }
+
+            if (req->m_delegate != nullptr)
+            {
+                natomic::store(&req->m_state, EIoState::DELIVERING);
+                async_t token(this, iorequest_id(req), (EFileError::EEnumValue)req->m_error);
+                token.m_result = req->m_result;
+                (*req->m_delegate)(token, token.m_error, token.m_result);
+                release_iorequest(req);
+            }
+            else
+            {
+                natomic::store(&req->m_state, EIoState::DONE);
+            }
+        }
+
+        // -----------------------------------------------------------
+        // doIO
+        // -----------------------------------------------------------
+
+        void doIO(io_thread_t* io_thread)
+        {
+            filesys_t* fs     = mImpl;
+            s32 const  worker = fs->register_ioworker(io_thread);
+            while (!io_thread->quit())
+            {
+                if (!fs->process_iorequest(worker))
+                {
+                    fs->idle_ioworker(worker, io_thread);
+                }
+            }
+            fs->unregister_ioworker(worker);
+
+            // Drain what is left so that no token is left waiting forever
+            while (fs->process_iorequest(worker))
+            {
+            }
+        }
+
+    } // namespace nfs
+}; // namespace ncore
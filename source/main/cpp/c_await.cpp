@@ -0,0 +1,202 @@
+#include "ccore/c_target.h"
+#include "ccore/c_debug.h"
+
+#include "cfilesystem/c_await.h"
+#include "cfilesystem/c_enumerator.h"
+#include "cfilesystem/c_filesystem.h"
+#include "cfilesystem/c_stream.h"
+
+#include "cfilesystem/private/c_atomic.h"
+#include "cfilesystem/private/c_enumerations.h"
+#include "cfilesystem/private/c_filedevice.h"
+#include "cfilesystem/private/c_filesystem.h"
+
+namespace ncore
+{
+    namespace nfs
+    {
+        extern filesys_t* mImpl;
+
+        enum
+        {
+            AWAIT_STARTED   = 0,
+            AWAIT_SUSPENDED = 1,
+            AWAIT_COMPLETED = 2,
+        };
+
+        // -----------------------------------------------------------
+        // awaitable_t
+        // -----------------------------------------------------------
+
+        awaitable_t::awaitable_t(s32 priority) : m_state(AWAIT_STARTED), m_priority(priority), m_coroutine(nullptr), m_resume(nullptr) {}
+
+        // Returns false when the request has already completed (or could not be issued)
+        // and the coroutine should not suspend. The completion can happen on another
+        // thread before start() returns, whoever comes second of suspend/complete
+        // decides whether to resume.
+        bool awaitable_t::suspend(void* coroutine, void (*resume)(void*))
+        {
+            m_coroutine = coroutine;
+            m_resume    = resume;
+            natomic::store(&m_state, AWAIT_STARTED);
+
+            async_t const token = start();
+            if (token.error().value != EFileError::ERROR_ASYNC_BUSY)
+            {
+                m_outcome.m_error  = token.error();
+                m_outcome.m_result = -1;
+                return false;
+            }
+            return natomic::exchange(&m_state, AWAIT_SUSPENDED) != AWAIT_COMPLETED;
+        }
+
+        void awaitable_t::operator()(async_t const& token, EFileError::Enum error, s64 bytes)
+        {
+            m_outcome.m_error  = error;
+            m_outcome.m_result = bytes;
+
+            // After the exchange the awaitable can be gone (wait() returned), so read
+            // what is needed to resume before it.
+            void* const coroutine = m_coroutine;
+            void (*resume)(void*) = m_resume;
+            if (natomic::exchange(&m_state, AWAIT_COMPLETED) == AWAIT_SUSPENDED && resume != nullptr)
+                resume(coroutine);
+        }
+
+        ioresult_t awaitable_t::wait()
+        {
+            if (suspend(nullptr, nullptr))
+            {
+                while (natomic::load(&m_state) != AWAIT_COMPLETED)
+                {
+                    if (!mImpl->process_iorequest())
+                        io_yield();
+                }
+            }
+            return m_outcome;
+        }
+
+        // -----------------------------------------------------------
+        // read / write
+        // -----------------------------------------------------------
+
+        read_awaitable_t::read_awaitable_t(stream_t& stream, s64 offset, u8* buffer, s64 size, s32 priority) : awaitable_t(priority), m_stream(&stream), m_offset(offset), m_buffer(buffer), m_size(size) {}
+
+        async_t read_awaitable_t::start() { return m_stream->read_async(m_offset, m_buffer, m_size, this, m_priority); }
+
+        write_awaitable_t::write_awaitable_t(stream_t& stream, s64 offset, u8 const* buffer, s64 size, s32 priority) : awaitable_t(priority), m_stream(&stream), m_offset(offset), m_buffer(buffer), m_size(size) {}
+
+        async_t write_awaitable_t::start() { return m_stream->write_async(m_offset, m_buffer, m_size, this, m_priority); }
+
+        // -----------------------------------------------------------
+        // open / close / flush
+        // -----------------------------------------------------------
+
+        static inline filedevice_t* sStreamDevice(stream_t const& stream)
+        {
+            filehandle_t* fh = filesys_t::get_filehandle(stream);
+            return fh != nullptr ? fh->m_filedevice : nullptr;
+        }
+
+        open_awaitable_t::open_awaitable_t(filepath_t const& filepath, EFileMode::Enum mode, EFileAccess::Enum access, EFileOp::Enum op, stream_t& out_stream, s32 priority)
+            : call_awaitable_t(priority)
+            , m_filepath(&filepath)
+            , m_mode(mode)
+            , m_access(access)
+            , m_op(op)
+            , m_stream(&out_stream)
+        {
+        }
+
+        async_t open_awaitable_t::start() { return mImpl->submit_call(m_filepath->m_dirpath.m_device->m_fileDevice, nullptr, this, this, m_priority); }
+
+        EFileError::Enum open_awaitable_t::operator()(s64& result)
+        {
+            result = 0;
+            return mImpl->open(*m_filepath, m_mode, m_access, m_op, *m_stream);
+        }
+
+        close_awaitable_t::close_awaitable_t(stream_t& stream, s32 priority) : call_awaitable_t(priority), m_stream(&stream) {}
+
+        async_t close_awaitable_t::start() { return mImpl->submit_call(sStreamDevice(*m_stream), filesys_t::get_filehandle(*m_stream), this, this, m_priority); }
+
+        EFileError::Enum close_awaitable_t::operator()(s64& result)
+        {
+            result = 0;
+            if (!m_stream->isOpen())
+                return EFileError::Error_BadFileDescriptor();
+            m_stream->close();
+            return EFileError::Error_Ok();
+        }
+
+        flush_awaitable_t::flush_awaitable_t(stream_t& stream, s32 priority) : call_awaitable_t(priority), m_stream(&stream) {}
+
+        async_t flush_awaitable_t::start() { return mImpl->submit_call(sStreamDevice(*m_stream), filesys_t::get_filehandle(*m_stream), this, this, m_priority); }
+
+        EFileError::Enum flush_awaitable_t::operator()(s64& result)
+        {
+            result = 0;
+            if (!m_stream->isOpen())
+                return EFileError::Error_BadFileDescriptor();
+            m_stream->flush();
+            return EFileError::Error_Ok();
+        }
+
+        // -----------------------------------------------------------
+        // stat / enumerate
+        // -----------------------------------------------------------
+
+        stat_awaitable_t::stat_awaitable_t(filepath_t const& filepath, fileattrs_t& out_attrs, filetimes_t& out_times, s32 priority)
+            : call_awaitable_t(priority)
+            , m_filepath(&filepath)
+            , m_attrs(&out_attrs)
+            , m_times(&out_times)
+        {
+        }
+
+        async_t stat_awaitable_t::start() { return mImpl->submit_call(m_filepath->m_dirpath.m_device->m_fileDevice, nullptr, this, this, m_priority); }
+
+        EFileError::Enum stat_awaitable_t::operator()(s64& result)
+        {
+            filedevice_t* fd = m_filepath->m_dirpath.m_device->m_fileDevice;
+            result           = 0;
+            if (!fd->getFileAttr(*m_filepath, *m_attrs) || !fd->getFileTime(*m_filepath, *m_times))
+                return EFileError::Error_NoFile();
+            return EFileError::Error_Ok();
+        }
+
+        class enumerate_counter_t : public enumerate_delegate_t
+        {
+        public:
+            enumerate_counter_t(enumerate_delegate_t* delegate) : m_delegate(delegate), m_count(0) {}
+
+            virtual bool operator()(s32 depth, filepath_t const& fi, fileattrs_t const& fa, filetimes_t const& ft)
+            {
+                m_count += 1;
+                return (*m_delegate)(depth, fi, fa, ft);
+            }
+            virtual bool operator()(s32 depth, dirpath_t const& di)
+            {
+                m_count += 1;
+                return (*m_delegate)(depth, di);
+            }
+
+            enumerate_delegate_t* m_delegate;
+            s64                   m_count;
+        };
+
+        enumerate_awaitable_t::enumerate_awaitable_t(dirpath_t const& dirpath, enumerate_delegate_t& delegate, s32 priority) : call_awaitable_t(priority), m_dirpath(&dirpath), m_delegate(&delegate) {}
+
+        async_t enumerate_awaitable_t::start() { return mImpl->submit_call(m_dirpath->m_device->m_fileDevice, nullptr, this, this, m_priority); }
+
+        EFileError::Enum enumerate_awaitable_t::operator()(s64& result)
+        {
+            filedevice_t*       fd = m_dirpath->m_device->m_fileDevice;
+            enumerate_counter_t counter(m_delegate);
+            bool const          ok = fd->enumerate(*m_dirpath, counter);
+            result                 = counter.m_count;
+            return ok ? EFileError::Error_Ok() : EFileError::Error_NoFile();
+        }
+
+    } // namespace nfs
+}; // namespace ncore
@@ -0,0 +1,221 @@
+#include "ccore/c_target.h"
+#include "ccore/c_debug.h"
+#include "cbase/c_allocator.h"
+
+#include "cfilesystem/c_async.h"
+#include "cfilesystem/c_attributes.h"
+#include "cfilesystem/c_batch.h"
+#include "cfilesystem/c_filesystem.h"
+#include "cfilesystem/c_stream.h"
+
+#include "cfilesystem/private/c_atomic.h"
+#include "cfilesystem/private/c_enumerations.h"
+#include "cfilesystem/private/c_filedevice.h"
+#include "cfilesystem/private/c_filesystem.h"
+
+namespace ncore
+{
+    namespace nfs
+    {
+        extern filesys_t* mImpl;
+
+        s32 batch_stat(filepath_t const* filepaths, s32 count, batch_t& out) { return mImpl->batch_stat(filepaths, count, out); }
+        s32 batch_load(filepath_t const* filepaths, s32 count, batch_t& out) { return mImpl->batch_load(filepaths, count, out); }
+        s32 batch_open(filepath_t const* filepaths, s32 count, EFileMode::Enum mode, EFileAccess::Enum access, EFileOp::Enum op, batch_t& out) { return mImpl->batch_open(filepaths, count, mode, access, op, out); }
+
+        // -----------------------------------------------------------
+        // filesys_t, batched operations
+        // -----------------------------------------------------------
+
+        namespace EBatchOp
+        {
+            enum EEnum
+            {
+                STAT = 0,
+                LOAD = 1,
+                OPEN = 2,
+            };
+        }
+
+        // One group of consecutive files of a batch, executed as one request
+        class batch_call_t : public async_call_t
+        {
+        public:
+            batch_call_t() : m_mode(EFileMode::Value_Open), m_access(EFileAccess::Value_Read), m_fileop(EFileOp::Value_Sync) {}
+
+            virtual EFileError::Enum operator()(s64& result)
+            {
+                s32 succeeded = 0;
+                for (s32 i = m_begin; i < m_end; ++i)
+                {
+                    EFileError::Enum const error = execute(i);
+                    m_out->m_errors[i]           = error.value;
+                    if (error.value == EFileError::ERROR_OK)
+                        succeeded += 1;
+                }
+                result = succeeded;
+                return EFileError::Error_Ok();
+            }
+
+            EFileError::Enum execute(s32 i)
+            {
+                filepath_t const& filepath = m_filepaths[i];
+                filedevice_t*     fd       = filepath.m_dirpath.m_device->m_fileDevice;
+                switch (m_op)
+                {
+                    case EBatchOp::STAT:
+                    {
+                        fileattrs_t* attrs = m_out->m_attrs != nullptr ? &m_out->m_attrs[i] : nullptr;
+                        filetimes_t* times = m_out->m_times != nullptr ? &m_out->m_times[i] : nullptr;
+                        if (!fd->statFile(filepath, m_out->m_sizes[i], attrs, times))
+                            return EFileError::Error_NoFile();
+                        return EFileError::Error_Ok();
+                    }
+                    case EBatchOp::LOAD:
+                    {
+                        // The size decides the place in the arena, the file is then read
+                        // straight into it.
+                        m_out->m_data[i]  = nullptr;
+                        m_out->m_sizes[i] = 0;
+                        u64 size          = 0;
+                        if (!fd->statFile(filepath, size, nullptr, nullptr))
+                            return EFileError::Error_NoFile();
+                        u64 const aligned = (size + (ESettings::MEM_ALIGNMENT - 1)) & ~(u64)(ESettings::MEM_ALIGNMENT - 1);
+                        u64 const offset  = (u64)natomic::add(&m_out->m_arena_used, (s64)aligned);
+                        if (offset + size > m_out->m_arena_size)
+                            return EFileError::Error_Io();
+                        u8* data = m_out->m_arena + offset;
+                        if (!fd->loadFile(filepath, data, size, size))
+                            return EFileError::Error_Io();
+                        m_out->m_data[i]  = data;
+                        m_out->m_sizes[i] = size;
+                        return EFileError::Error_Ok();
+                    }
+                    case EBatchOp::OPEN:
+                    {
+                        return m_owner->open(filepath, m_mode, m_access, m_fileop, m_out->m_streams[i]);
+                    }
+                }
+                return EFileError::Error_Unsupported();
+            }
+
+            filesys_t*        m_owner;
+            s32               m_op;
+            filepath_t const* m_filepaths;
+            s32               m_begin;
+            s32               m_end;
+            batch_t*          m_out;
+            EFileMode::Enum   m_mode;
+            EFileAccess::Enum m_access;
+            EFileOp::Enum     m_fileop;
+        };
+
+        // Small groups keep every IO thread busy, large groups amortize the request
+        // overhead, aim for a handful of groups per IO thread.
+        static s32 sBatchGroupSize(s32 count, s32 workers)
+        {
+            enum
+            {
+                GROUP_MIN = 1,
+                GROUP_MAX = 64,
+            };
+            s32 const groups = (workers > 0 ? workers : 1) * 4;
+            s32       size   = (count + groups - 1) / groups;
+            if (size < GROUP_MIN)
+                size = GROUP_MIN;
+            if (size > GROUP_MAX)
+                size = GROUP_MAX;
+            return size;
+        }
+
+        static s32 sRunBatch(filesys_t* fs, batch_call_t const& proto, s32 count)
+        {
+            enum
+            {
+                WINDOW = 16
+            };
+            batch_call_t calls[WINDOW];
+            async_t      tokens[WINDOW];
+            bool         inflight[WINDOW];
+            for (s32 w = 0; w < WINDOW; ++w)
+                inflight[w] = false;
+
+            s32 const group     = sBatchGroupSize(count, natomic::load(&fs->m_ioworkers_count));
+            s32       succeeded = 0;
+            s32       slot      = 0;
+            for (s32 begin = 0; begin < count; begin += group)
+            {
+                if (inflight[slot])
+                {
+                    tokens[slot].wait();
+                    succeeded += (s32)tokens[slot].result();
+                    inflight[slot] = false;
+                }
+
+                batch_call_t& call = calls[slot];
+                call               = proto;
+                call.m_begin       = begin;
+                call.m_end         = (begin + group) < count ? (begin + group) : count;
+
+                filedevice_t* fd = proto.m_filepaths[begin].m_dirpath.m_device->m_fileDevice;
+                tokens[slot]     = fs->submit_call(fd, nullptr, &call, nullptr, EIoPriority::NORMAL);
+                if (tokens[slot].error().value == EFileError::ERROR_ASYNC_BUSY)
+                {
+                    inflight[slot] = true;
+                }
+                else
+                {
+                    s64 result = 0; // No request available
+                    call(result);
+                    succeeded += (s32)result;
+                }
+                slot = (slot + 1) % WINDOW;
+            }
+
+            for (s32 w = 0; w < WINDOW; ++w)
+            {
+                if (inflight[w])
+                {
+                    tokens[w].wait();
+                    succeeded += (s32)tokens[w].result();
+                }
+            }
+            return succeeded;
+        }
+
+        static void sInitBatchCall(batch_call_t& call, filesys_t* fs, s32 op, filepath_t const* filepaths, batch_t& out)
+        {
+            call.m_owner     = fs;
+            call.m_op        = op;
+            call.m_filepaths = filepaths;
+            call.m_begin     = 0;
+            call.m_end       = 0;
+            call.m_out       = &out;
+        }
+
+        s32 filesys_t::batch_stat(filepath_t const* filepaths, s32 count, batch_t& out)
+        {
+            batch_call_t call;
+            sInitBatchCall(call, this, EBatchOp::STAT, filepaths, out);
+            return sRunBatch(this, call, count);
+        }
+
+        s32 filesys_t::batch_load(filepath_t const* filepaths, s32 count, batch_t& out)
+        {
+            batch_call_t call;
+            sInitBatchCall(call, this, EBatchOp::LOAD, filepaths, out);
+            return sRunBatch(this, call, count);
+        }
+
+        s32 filesys_t::batch_open(filepath_t const* filepaths, s32 count, EFileMode::Enum mode, EFileAccess::Enum access, EFileOp::Enum op, batch_t& out)
+        {
+            batch_call_t call;
+            call.m_mode   = mode;
+            call.m_access = access;
+            call.m_fileop = op;
+            sInitBatchCall(call, this, EBatchOp::OPEN, filepaths, out);
+            return sRunBatch(this, call, count);
+        }
+
+    } // namespace nfs
+}; // namespace ncore
@@ -0,0 +1,908 @@
+#include "ccore/c_target.h"
+#include "ccore/c_debug.h"
+#include "cbase/c_allocator.h"
+#include "cbase/c_memory.h"
+
+#include "cfilesystem/c_filepath.h"
+#include "cfilesystem/c_dirpath.h"
+#include "cfilesystem/c_filesystem.h"
+#include "cfilesystem/c_hash.h"
+
+#include "cfilesystem/private/c_atomic.h"
+#include "cfilesystem/private/c_chunker.h"
+#include "cfilesystem/private/c_enumerations.h"
+#include "cfilesystem/private/c_filedevice.h"
+#include "cfilesystem/private/c_filesystem.h"
+
+namespace ncore
+{
+    namespace nfs
+    {
+        extern filesys_t* mImpl;
+
+        enum
+        {
+            CAS_MAGIC        = 0x4D534143, // "CASM"
+            CAS_VERSION      = 1,
+            CAS_MIN_ENTRIES  = 64,
+            CAS_MAX_ENTRIES  = 128 * 1024 * 1024, // The entries of a handle are allocated with a u32 size
+            CAS_MIN_BUCKETS  = 64,
+            CAS_STORE_LENGTH = 192, // Longest path of the store
+        };
+
+        // The manifest of a file, the header is followed by the entries of its chunks
+        struct casheader_t
+        {
+            u32 m_magic;
+            u32 m_version;
+            u64 m_size;
+            u64 m_count;
+        };
+
+        struct casentry_t
+        {
+            hash128_t m_hash;
+            u32       m_size;
+            u32       m_reserved;
+        };
+
+        // A handle of a file on the device. Written data is collected in m_pending until
+        // a chunk can be cut from it, a flush stores what is pending as a provisional last
+        // chunk that is cut again when more data is written.
+        struct cashandle_t
+        {
+            void*       m_manifest;
+            bool        m_write;
+            bool        m_dirty; // The manifest has to be written
+            bool        m_provisional;
+            bool        m_reopen; // Opened for writing, the last chunk is reopened by the first write
+            casentry_t* m_entries;
+            u64*        m_offsets; // Of the chunks, m_count + 1 of them
+            s64         m_count;
+            s64         m_capacity;
+            u8*         m_pending;
+            u32         m_pending_size;
+
+            DCORE_CLASS_PLACEMENT_NEW_DELETE
+        };
+
+        // A chunk in the cache, m_refs is guarded by the lock of the device
+        struct casblock_t
+        {
+            hash128_t   m_hash;
+            u8*         m_data;
+            u32         m_size;
+            s32         m_refs;
+            casblock_t* m_hash_next;
+            casblock_t* m_lru_prev; // Towards the most recently used
+            casblock_t* m_lru_next;
+
+            DCORE_CLASS_PLACEMENT_NEW_DELETE
+        };
+
+        static inline u32 sBucketOf(hash128_t const& hash, u32 mask) { return (u32)hash.m_lo & mask; }
+
+        // Files are manifests on the backing device, chunks are files of the store
+        // "<store>/<2 hex digits>/<32 hex digits>". Writing a chunk that is already in
+        // the store is skipped, a new chunk is written to a temporary file first and
+        // then moved in place so that a chunk in the store is always complete.
+        class filedevice_cas_t : public filedevice_t
+        {
+        public:
+            DCORE_CLASS_PLACEMENT_NEW_DELETE
+
+            filedevice_cas_t(filedevice_t* device, alloc_t* allocator, casoptions_t const& options) : m_device(device), m_allocator(allocator), m_options(options), m_lru_head(nullptr), m_lru_tail(nullptr), m_used(0), m_temp_seq(0)
+            {
+                m_chunker.init(options.m_min_chunk, options.m_avg_chunk, options.m_max_chunk);
+
+                s32 n = 0;
+                while (options.m_store[n] != '\0' && n < (CAS_STORE_LENGTH - 1))
+                {
+                    m_store[n] = options.m_store[n];
+                    n += 1;
+                }
+                if (n > 0 && (m_store[n - 1] == '/' || m_store[n - 1] == '\\'))
+                    n -= 1;
+                m_store[n]        = '\0';
+                m_store_length    = n;
+                m_options.m_store = m_store;
+
+                u32 buckets = CAS_MIN_BUCKETS;
+                while (((u64)buckets * m_chunker.avg_size()) < options.m_cache_size && buckets < 0x100000)
+                    buckets <<= 1;
+                m_bucket_mask = buckets - 1;
+                m_buckets     = (casblock_t**)allocator->allocate(sizeof(casblock_t*) * buckets);
+                for (u32 i = 0; i < buckets; ++i)
+                    m_buckets[i] = nullptr;
+                for (s32 i = 0; i < 256; ++i)
+                    m_fanout[i] = 0;
+            }
+
+            virtual ~filedevice_cas_t()
+            {
+                while (m_lru_head != nullptr)
+                {
+                    casblock_t* b = m_lru_head;
+                    m_lru_head    = b->m_lru_next;
+                    m_allocator->deallocate(b->m_data);
+                    m_allocator->destruct(b);
+                }
+                m_allocator->deallocate(m_buckets);
+            }
+
+            virtual void destruct(alloc_t* allocator) { allocator->destruct(this); }
+
+            virtual bool canWrite() const { return m_device->canWrite(); }
+            virtual bool canSeek() const { return true; }
+
+            virtual bool getDeviceInfo(filedevice_t* device, u64& totalSpace, u64& freeSpace) const { return m_device->getDeviceInfo(device, totalSpace, freeSpace); }
+
+            virtual bool openFile(filepath_t const& szFilename, EFileMode::Enum mode, EFileAccess::Enum access, EFileOp::Enum op, void*& outHandle);
+            virtual bool createFile(const filepath_t& szFilename, bool boRead, bool boWrite, void*& nFileHandle);
+            virtual bool readFile(void* pHandle, u64 pos, void* buffer, u64 count, u64& outNumBytesRead);
+            virtual bool writeFile(void* pHandle, u64 pos, void const* buffer, u64 count, u64& outNumBytesWritten);
+            virtual bool flushFile(void* pHandle);
+            virtual bool closeFile(void* pHandle);
+
+            virtual bool statFile(filepath_t const& szFilename, u64& outSize, fileattrs_t* outAttr, filetimes_t* outTimes);
+            virtual bool identifyFile(filepath_t const& szFilename, u64& outId, u64& outModified, u64& outSize);
+
+            virtual bool createStream(filepath_t const& szFilename, bool boRead, bool boWrite, stream_t& strm) { return false; }
+            virtual bool closeStream(stream_t& strm) { return false; }
+
+            virtual bool setLengthOfFile(void* pHandle, u64 inLength);
+            virtual bool getLengthOfFile(void* pHandle, u64& outLength);
+
+            virtual bool setFileTime(filepath_t const& szFilename, filetimes_t const& times) { return m_device->setFileTime(szFilename, times); }
+            virtual bool getFileTime(filepath_t const& szFilename, filetimes_t& outTimes) { return m_device->getFileTime(szFilename, outTimes); }
+            virtual bool setFileAttr(filepath_t const& szFilename, fileattrs_t const& attr) { return m_device->setFileAttr(szFilename, attr); }
+            virtual bool getFileAttr(filepath_t const& szFilename, fileattrs_t& attr) { return m_device->getFileAttr(szFilename, attr); }
+
+            virtual bool setFileTime(void* pHandle, filetimes_t const& times) { return m_device->setFileTime(((cashandle_t*)pHandle)->m_manifest, times); }
+            virtual bool getFileTime(void* pHandle, filetimes_t& outTimes) { return m_device->getFileTime(((cashandle_t*)pHandle)->m_manifest, outTimes); }
+
+            virtual bool hasFile(filepath_t const& szFilename) { return m_device->hasFile(szFilename); }
+            virtual bool moveFile(filepath_t const& szFilename, filepath_t const& szToFilename, bool boOverwrite) { return m_device->moveFile(szFilename, szToFilename, boOverwrite); }
+            virtual bool copyFile(filepath_t const& szFilename, filepath_t const& szToFilename, bool boOverwrite) { return m_device->copyFile(szFilename, szToFilename, boOverwrite); }
+            virtual bool deleteFile(filepath_t const& szFilename) { return m_device->deleteFile(szFilename); }
+
+            virtual bool openDir(dirpath_t const& szDirPath, void*& nDirHandle) { return m_device->openDir(szDirPath, nDirHandle); }
+            virtual bool hasDir(dirpath_t const& szDirPath) { return m_device->hasDir(szDirPath); }
+            virtual bool moveDir(dirpath_t const& szDirPath, dirpath_t const& szToDirPath, bool boOverwrite) { return m_device->moveDir(szDirPath, szToDirPath, boOverwrite); }
+            virtual bool copyDir(dirpath_t const& szDirPath, dirpath_t const& szToDirPath, bool boOverwrite) { return m_device->copyDir(szDirPath, szToDirPath, boOverwrite); }
+            virtual bool createDir(dirpath_t const& szDirPath) { return m_device->createDir(szDirPath); }
+            virtual bool deleteDir(dirpath_t const& szDirPath) { return m_device->deleteDir(szDirPath); }
+
+            virtual s32  deleteFiles(filepath_t const* szFilenames, s32 count) { return m_device->deleteFiles(szFilenames, count); }
+            virtual bool removeDir(dirpath_t const& szDirPath) { return m_device->removeDir(szDirPath); }
+            virtual bool flushDir(dirpath_t const& szDirPath) { return m_device->flushDir(szDirPath); }
+
+            virtual bool setDirTime(dirpath_t const& szDirPath, filetimes_t const& ftimes) { return m_device->setDirTime(szDirPath, ftimes); }
+            virtual bool getDirTime(dirpath_t const& szDirPath, filetimes_t& ftimes) { return m_device->getDirTime(szDirPath, ftimes); }
+            virtual bool setDirAttr(dirpath_t const& szDirPath, fileattrs_t const& attr) { return m_device->setDirAttr(szDirPath, attr); }
+            virtual bool getDirAttr(dirpath_t const& szDirPath, fileattrs_t& attr) { return m_device->getDirAttr(szDirPath, attr); }
+
+            virtual bool enumerate(dirpath_t const& szDirPath, enumerate_delegate_t& enumerator) { return m_device->enumerate(szDirPath, enumerator); }
+
+            cashandle_t* new_handle(void* manifest, bool boWrite);
+            void         free_handle(cashandle_t* h);
+            bool         read_manifest(cashandle_t* h);
+            bool         write_manifest(cashandle_t* h);
+            bool         read_header(filepath_t const& szFilename, casheader_t& outHeader);
+            bool         reserve(cashandle_t* h, s64 count);
+            bool         add_entry(cashandle_t* h, hash128_t const& hash, u32 size);
+            bool         append(cashandle_t* h, u8 const* data, u64 count);
+            bool         cut_pending(cashandle_t* h, bool boFinal);
+            bool         reopen_last(cashandle_t* h);
+            bool         truncate(cashandle_t* h, u64 length);
+            u64          pending_at(cashandle_t const* h) const { return h->m_offsets[h->m_provisional ? h->m_count - 1 : h->m_count]; }
+            s64          locate(cashandle_t const* h, u64 pos) const;
+
+            bool        store_chunk(u8 const* data, u32 size, hash128_t& outHash);
+            bool        chunk_name(hash128_t const& hash, char* out, s32 capacity, bool boDirOnly) const;
+            casblock_t* get_chunk(hash128_t const& hash, u32 size);
+            void        release_chunk(casblock_t* b);
+            casblock_t* find_locked(hash128_t const& hash) const;
+            void        evict_locked(casblock_t*& outEvicted);
+
+            filedevice_t* m_device;
+            alloc_t*      m_allocator;
+            casoptions_t  m_options;
+            chunker_t     m_chunker;
+            char          m_store[CAS_STORE_LENGTH];
+            s32           m_store_length;
+            s32 volatile  m_fanout[256]; // The directories of the store that are known to exist
+            spinlock_t    m_lock;
+            casblock_t**  m_buckets;
+            u32           m_bucket_mask;
+            casblock_t*   m_lru_head;
+            casblock_t*   m_lru_tail;
+            u64           m_used;
+            s64 volatile  m_temp_seq;
+        };
+
+        // -----------------------------------------------------------
+        // manifests
+        // -----------------------------------------------------------
+
+        cashandle_t* filedevice_cas_t::new_handle(void* manifest, bool boWrite)
+        {
+            cashandle_t* h    = m_allocator->construct<cashandle_t>();
+            h->m_manifest     = manifest;
+            h->m_write        = boWrite;
+            h->m_dirty        = false;
+            h->m_provisional  = false;
+            h->m_reopen       = false;
+            h->m_count        = 0;
+            h->m_capacity     = CAS_MIN_ENTRIES;
+            h->m_entries      = (casentry_t*)m_allocator->allocate((u32)(sizeof(casentry_t) * h->m_capacity));
+            h->m_offsets      = (u64*)m_allocator->allocate((u32)(sizeof(u64) * (h->m_capacity + 1)));
+            h->m_offsets[0]   = 0;
+            h->m_pending      = boWrite ? (u8*)m_allocator->allocate(m_chunker.max_size()) : nullptr;
+            h->m_pending_size = 0;
+            return h;
+        }
+
+        void filedevice_cas_t::free_handle(cashandle_t* h)
+        {
+            m_allocator->deallocate(h->m_entries);
+            m_allocator->deallocate(h->m_offsets);
+            if (h->m_pending != nullptr)
+                m_allocator->deallocate(h->m_pending);
+            m_allocator->destruct(h);
+        }
+
+        bool filedevice_cas_t::reserve(cashandle_t* h, s64 count)
+        {
+            if (count > CAS_MAX_ENTRIES)
+                return false;
+            if (count > h->m_capacity)
+            {
+                s64 capacity = h->m_capacity * 2;
+                while (capacity < count)
+                    capacity *= 2;
+                if (capacity > CAS_MAX_ENTRIES)
+                    capacity = CAS_MAX_ENTRIES;
+                casentry_t* entries  = (casentry_t*)m_allocator->allocate((u32)(sizeof(casentry_t) * capacity));
+                u64*        offsets  = (u64*)m_allocator->allocate((u32)(sizeof(u64) * (capacity + 1)));
+                if (entries == nullptr || offsets == nullptr)
+                {
+                    if (entries != nullptr)
+                        m_allocator->deallocate(entries);
+                    if (offsets != nullptr)
+                        m_allocator->deallocate(offsets);
+                    return false;
+                }
+                nmem::memcpy(entries, h->m_entries, (u32)(sizeof(casentry_t) * h->m_count));
+                nmem::memcpy(offsets, h->m_offsets, (u32)(sizeof(u64) * (h->m_count + 1)));
+                m_allocator->deallocate(h->m_entries);
+                m_allocator->deallocate(h->m_offsets);
+                h->m_entries  = entries;
+                h->m_offsets  = offsets;
+                h->m_capacity = capacity;
+            }
+            return true;
+        }
+
+        bool filedevice_cas_t::add_entry(cashandle_t* h, hash128_t const& hash, u32 size)
+        {
+            if (!reserve(h, h->m_count + 1))
+                return false;
+
+            casentry_t& e = h->m_entries[h->m_count];
+            e.m_hash      = hash;
+            e.m_size      = size;
+            e.m_reserved  = 0;
+            h->m_offsets[h->m_count + 1] = h->m_offsets[h->m_count] + size;
+            h->m_count += 1;
+            h->m_dirty = true;
+            return true;
+        }
+
+        // An empty manifest is a new file
+        bool filedevice_cas_t::read_manifest(cashandle_t* h)
+        {
+            u64 length = 0;
+            if (!m_device->getLengthOfFile(h->m_manifest, length))
+                return false;
+            if (length == 0)
+                return true;
+
+            casheader_t header;
+            u64         n = 0;
+            if (length < sizeof(casheader_t) || !m_device->readFile(h->m_manifest, 0, &header, sizeof(header), n) || n != sizeof(header))
+                return false;
+
+            // The count is checked against the length, the product could overflow
+            u64 const entries = length - sizeof(casheader_t);
+            if (header.m_magic != CAS_MAGIC || header.m_version != CAS_VERSION || (entries % sizeof(casentry_t)) != 0 || (entries / sizeof(casentry_t)) != header.m_count)
+                return false;
+            if (header.m_count > CAS_MAX_ENTRIES)
+                return false;
+
+            if (!reserve(h, (s64)header.m_count) || !m_device->readFile(h->m_manifest, sizeof(casheader_t), h->m_entries, entries, n) || n != entries)
+                return false;
+            h->m_count = (s64)header.m_count;
+            for (s64 i = 0; i < h->m_count; ++i)
+                h->m_offsets[i + 1] = h->m_offsets[i] + h->m_entries[i].m_size;
+            return h->m_offsets[h->m_count] == header.m_size;
+        }
+
+        bool filedevice_cas_t::write_manifest(cashandle_t* h)
+        {
+            if (!h->m_dirty)
+                return true;
+
+            casheader_t header;
+            header.m_magic   = CAS_MAGIC;
+            header.m_version = CAS_VERSION;
+            header.m_size    = h->m_offsets[h->m_count];
+            header.m_count   = (u64)h->m_count;
+
+            u64       n       = 0;
+            u64 const entries = sizeof(casentry_t) * (u64)h->m_count;
+            if (!m_device->writeFile(h->m_manifest, 0, &header, sizeof(header), n) || n != sizeof(header))
+                return false;
+            if (entries > 0 && (!m_device->writeFile(h->m_manifest, sizeof(header), h->m_entries, entries, n) || n != entries))
+                return false;
+            if (!m_device->setLengthOfFile(h->m_manifest, sizeof(header) + entries))
+                return false;
+            h->m_dirty = false;
+            return true;
+        }
+
+        bool filedevice_cas_t::read_header(filepath_t const& szFilename, casheader_t& outHeader)
+        {
+            void* manifest = nullptr;
+            if (!m_device->openFile(szFilename, EFileMode::Value_Open, EFileAccess::Value_Read, EFileOp::Value_Sync, manifest))
+                return false;
+            u64  n  = 0;
+            bool ok = m_device->readFile(manifest, 0, &outHeader, sizeof(outHeader), n);
+            m_device->closeFile(manifest);
+            if (ok && n == 0)
+            {
+                outHeader.m_magic   = CAS_MAGIC;
+                outHeader.m_version = CAS_VERSION;
+                outHeader.m_size    = 0;
+                outHeader.m_count   = 0;
+                return true;
+            }
+            return ok && n == sizeof(outHeader) && outHeader.m_magic == CAS_MAGIC;
+        }
+
+        // The chunk that contains pos, the caller knows pos is before the pending data
+        s64 filedevice_cas_t::locate(cashandle_t const* h, u64 pos) const
+        {
+            s64 lo = 0;
+            s64 hi = h->m_count - 1;
+            while (lo < hi)
+            {
+                s64 const mid = (lo + hi + 1) / 2;
+                if (h->m_offsets[mid] <= pos)
+                    lo = mid;
+                else
+                    hi = mid - 1;
+            }
+            return lo;
+        }
+
+        // -----------------------------------------------------------
+        // writing
+        // -----------------------------------------------------------
+
+        // The last chunk goes back to the pending data so that appending to it gives
+        // the chunks a file written in one go would have had. A provisional chunk is
+        // still pending, otherwise it is the last chunk of the file that was opened.
+        bool filedevice_cas_t::reopen_last(cashandle_t* h)
+        {
+            if (h->m_provisional)
+            {
+                h->m_provisional = false;
+                h->m_count -= 1;
+                h->m_dirty = true;
+                return true;
+            }
+            if (!h->m_reopen)
+                return true;
+            h->m_reopen = false;
+            if (h->m_count == 0)
+                return true;
+
+            // A store written with larger chunks cannot be appended to
+            casentry_t const& last = h->m_entries[h->m_count - 1];
+            if (last.m_size > m_chunker.max_size())
+                return false;
+            casblock_t* block = get_chunk(last.m_hash, last.m_size);
+            if (block == nullptr)
+                return false;
+            nmem::memcpy(h->m_pending, block->m_data, block->m_size);
+            h->m_pending_size = block->m_size;
+            release_chunk(block);
+            h->m_count -= 1;
+            h->m_dirty = true;
+            return true;
+        }
+
+        bool filedevice_cas_t::append(cashandle_t* h, u8 const* data, u64 count)
+        {
+            if (!reopen_last(h))
+                return false;
+            u32 const max = m_chunker.max_size();
+            while (count > 0)
+            {
+                u32 const n = (count < (u64)(max - h->m_pending_size)) ? (u32)count : (max - h->m_pending_size);
+                nmem::memcpy(h->m_pending + h->m_pending_size, data, n);
+                h->m_pending_size += n;
+                data += n;
+                count -= n;
+                if (h->m_pending_size == max && !cut_pending(h, false))
+                    return false;
+            }
+            return true;
+        }
+
+        // Chunks are only cut from a full buffer, a boundary needs the bytes up to the
+        // maximum chunk size to be found. At the end of the file everything is cut.
+        bool filedevice_cas_t::cut_pending(cashandle_t* h, bool boFinal)
+        {
+            while (h->m_pending_size > 0 && (boFinal || h->m_pending_size == m_chunker.max_size()))
+            {
+                u32 const size = m_chunker.cut(h->m_pending, h->m_pending_size);
+                hash128_t hash;
+                if (!store_chunk(h->m_pending, size, hash) || !add_entry(h, hash, size))
+                    return false;
+                h->m_pending_size -= size;
+                for (u32 i = 0; i < h->m_pending_size; ++i)
+                    h->m_pending[i] = h->m_pending[size + i];
+            }
+            return true;
+        }
+
+        // Shrinking keeps the chunks before the new end, the chunk that contains it
+        // is written again. Growing appends zeros.
+        bool filedevice_cas_t::truncate(cashandle_t* h, u64 length)
+        {
+            if (!reopen_last(h))
+                return false;
+
+            u64 const at = pending_at(h);
+            if (length >= at)
+            {
+                u64 const size = at + h->m_pending_size;
+                if (length <= size)
+                {
+                    h->m_pending_size = (u32)(length - at);
+                    return true;
+                }
+                u8  zeros[256];
+                u64 grow = length - size;
+                nmem::memset(zeros, 0, sizeof(zeros));
+                while (grow > 0)
+                {
+                    u64 const n = grow < sizeof(zeros) ? grow : sizeof(zeros);
+                    if (!append(h, zeros, n))
+                        return false;
+                    grow -= n;
+                }
+                return true;
+            }
+
+            s64 const         i = locate(h, length);
+            casentry_t const& e = h->m_entries[i];
+            if ((length - h->m_offsets[i]) > m_chunker.max_size())
+                return false;
+            casblock_t* block = get_chunk(e.m_hash, e.m_size);
+            if (block == nullptr)
+                return false;
+            h->m_pending_size = (u32)(length - h->m_offsets[i]);
+            nmem::memcpy(h->m_pending, block->m_data, h->m_pending_size);
+            release_chunk(block);
+            h->m_count = i;
+            h->m_dirty = true;
+            return true;
+        }
+
+        bool filedevice_cas_t::chunk_name(hash128_t const& hash, char* out, s32 capacity, bool boDirOnly) const
+        {
+            if ((m_store_length + 4 + 33) > capacity)
+                return false;
+            char hex[33];
+            hash_to_hex(hash, hex);
+
+            char const slash = mImpl->m_default_slash;
+            s32        n     = 0;
+            for (; n < m_store_length; ++n)
+                out[n] = m_store[n];
+            out[n++] = slash;
+            out[n++] = hex[0];
+            out[n++] = hex[1];
+            out[n++] = slash;
+            if (!boDirOnly)
+            {
+                for (s32 i = 0; i < 32; ++i)
+                    out[n++] = hex[i];
+            }
+            out[n] = '\0';
+            return true;
+        }
+
+        bool filedevice_cas_t::store_chunk(u8 const* data, u32 size, hash128_t& outHash)
+        {
+            outHash = hash128(data, size);
+
+            char name[ESettings::MAX_PATH];
+            if (!chunk_name(outHash, name, ESettings::MAX_PATH, false))
+                return false;
+
+            filepath_t const chunkpath = filepath(name);
+            if (m_device->hasFile(chunkpath))
+            {
+                if (m_options.m_stats != nullptr)
+                {
+                    natomic::add(&m_options.m_stats->m_chunks_deduped, 1);
+                    natomic::add(&m_options.m_stats->m_bytes_deduped, (s64)size);
+                }
+                return true;
+            }
+
+            s32 const fanout = (s32)((outHash.m_hi >> 56) & 0xFF);
+            if (natomic::load(&m_fanout[fanout]) == 0)
+            {
+                char dirname[ESettings::MAX_PATH];
+                chunk_name(outHash, dirname, ESettings::MAX_PATH, true);
+                dirpath_t const dir = dirpath(dirname);
+                if (m_device->hasDir(dir) || m_device->createDir(dir))
+                    natomic::store(&m_fanout[fanout], 1);
+            }
+
+            // "<chunk>.<sequence>.tmp", every writer has its own temporary file
+            char      temp[ESettings::MAX_PATH];
+            s64 const seq = natomic::add(&m_temp_seq, 1);
+            s32       n   = 0;
+            while (name[n] != '\0')
+                n += 1;
+            if ((n + 22) > ESettings::MAX_PATH)
+                return false;
+            for (n = 0; name[n] != '\0';)
+            {
+                temp[n] = name[n];
+                n += 1;
+            }
+            temp[n++] = '.';
+            for (s32 i = 60; i >= 0; i -= 4)
+                temp[n++] = "0123456789abcdef"[(seq >> i) & 0xF];
+            temp[n++] = '.';
+            temp[n++] = 't';
+            temp[n++] = 'm';
+            temp[n++] = 'p';
+            temp[n]   = '\0';
+
+            filepath_t const temppath = filepath(temp);
+            void*            handle   = nullptr;
+            if (!m_device->createFile(temppath, false, true, handle))
+                return false;
+            u64  written = 0;
+            bool ok      = m_device->writeFile(handle, 0, data, size, written) && written == size && m_device->flushFile(handle);
+            m_device->closeFile(handle);
+
+            // Another writer may have stored the same chunk in the meantime
+            ok = ok && (m_device->moveFile(temppath, chunkpath, false) || m_device->hasFile(chunkpath));
+            if (m_device->hasFile(temppath))
+                m_device->deleteFile(temppath);
+            if (ok && m_options.m_stats != nullptr)
+            {
+                natomic::add(&m_options.m_stats->m_chunks_stored, 1);
+                natomic::add(&m_options.m_stats->m_bytes_stored, (s64)size);
+            }
+            return ok;
+        }
+
+        // -----------------------------------------------------------
+        // chunk cache
+        // -----------------------------------------------------------
+
+        casblock_t* filedevice_cas_t::find_locked(hash128_t const& hash) const
+        {
+            casblock_t* b = m_buckets[sBucketOf(hash, m_bucket_mask)];
+            while (b != nullptr && b->m_hash != hash)
+                b = b->m_hash_next;
+            return b;
+        }
+
+        // The least recently used chunks that are not in use are evicted until the
+        // cache is within its budget, they are freed by the caller after the lock.
+        void filedevice_cas_t::evict_locked(casblock_t*& outEvicted)
+        {
+            casblock_t* b = m_lru_tail;
+            while (m_used > m_options.m_cache_size && b != nullptr)
+            {
+                casblock_t* prev = b->m_lru_prev;
+                if (b->m_refs == 0)
+                {
+                    casblock_t** link = &m_buckets[sBucketOf(b->m_hash, m_bucket_mask)];
+                    while (*link != b)
+                        link = &(*link)->m_hash_next;
+                    *link = b->m_hash_next;
+
+                    if (prev != nullptr)
+                        prev->m_lru_next = b->m_lru_next;
+                    else
+                        m_lru_head = b->m_lru_next;
+                    if (b->m_lru_next != nullptr)
+                        b->m_lru_next->m_lru_prev = prev;
+                    else
+                        m_lru_tail = prev;
+                    m_used -= b->m_size;
+
+                    b->m_hash_next = outEvicted;
+                    outEvicted     = b;
+                }
+                b = prev;
+            }
+        }
+
+        // Returns the chunk with a reference held. A chunk that is not in the cache is
+        // loaded from the store, when another thread loads it at the same time the
+        // first one to insert it wins.
+        casblock_t* filedevice_cas_t::get_chunk(hash128_t const& hash, u32 size)
+        {
+            m_lock.lock();
+            casblock_t* b = find_locked(hash);
+            if (b != nullptr)
+            {
+                b->m_refs += 1;
+                if (b != m_lru_head)
+                {
+                    b->m_lru_prev->m_lru_next = b->m_lru_next;
+                    if (b->m_lru_next != nullptr)
+                        b->m_lru_next->m_lru_prev = b->m_lru_prev;
+                    else
+                        m_lru_tail = b->m_lru_prev;
+                    b->m_lru_prev          = nullptr;
+                    b->m_lru_next          = m_lru_head;
+                    m_lru_head->m_lru_prev = b;
+                    m_lru_head             = b;
+                }
+                m_lock.unlock();
+                return b;
+            }
+            m_lock.unlock();
+
+            char name[ESettings::MAX_PATH];
+            if (!chunk_name(hash, name, ESettings::MAX_PATH, false))
+                return nullptr;
+            u8* data = (u8*)m_allocator->allocate(size > 0 ? size : 1, ESettings::MEM_ALIGNMENT);
+            if (data == nullptr)
+                return nullptr;
+            u64 n = 0;
+            if (!m_device->loadFile(filepath(name), data, size, n) || n != size || (m_options.m_verify && hash128(data, size) != hash))
+            {
+                m_allocator->deallocate(data);
+                return nullptr;
+            }
+
+            b              = m_allocator->construct<casblock_t>();
+            b->m_hash      = hash;
+            b->m_data      = data;
+            b->m_size      = size;
+            b->m_refs      = 1;
+            b->m_lru_prev  = nullptr;
+            b->m_lru_next  = nullptr;
+
+            casblock_t* evicted = nullptr;
+            m_lock.lock();
+            casblock_t* other = find_locked(hash);
+            if (other != nullptr)
+            {
+                other->m_refs += 1;
+            }
+            else
+            {
+                casblock_t*& bucket = m_buckets[sBucketOf(hash, m_bucket_mask)];
+                b->m_hash_next      = bucket;
+                bucket              = b;
+                b->m_lru_next       = m_lru_head;
+                if (m_lru_head != nullptr)
+                    m_lru_head->m_lru_prev = b;
+                m_lru_head = b;
+                if (m_lru_tail == nullptr)
+                    m_lru_tail = b;
+                m_used += size;
+                evict_locked(evicted);
+            }
+            m_lock.unlock();
+
+            while (evicted != nullptr)
+            {
+                casblock_t* e = evicted;
+                evicted       = e->m_hash_next;
+                m_allocator->deallocate(e->m_data);
+                m_allocator->destruct(e);
+            }
+            if (other != nullptr)
+            {
+                m_allocator->deallocate(b->m_data);
+                m_allocator->destruct(b);
+                return other;
+            }
+            return b;
+        }
+
+        void filedevice_cas_t::release_chunk(casblock_t* b)
+        {
+            m_lock.lock();
+            b->m_refs -= 1;
+            m_lock.unlock();
+        }
+
+        // -----------------------------------------------------------
+        // files
+        // -----------------------------------------------------------
+
+        // The manifest is opened with the mode of the file, it is read (and written)
+        // for any access so that appending can continue the existing chunk list.
+        bool filedevice_cas_t::openFile(filepath_t const& szFilename, EFileMode::Enum mode, EFileAccess::Enum access, EFileOp::Enum op, void*& outHandle)
+        {
+            // Appending is done by the device, the manifest itself is rewritten in place
+            bool const            write    = !access.IsRead();
+            EFileMode::Enum const mmode    = mode.IsAppend() ? EFileMode::Enum(EFileMode::Value_OpenOrCreate) : mode;
+            void*                 manifest = nullptr;
+            if (!m_device->openFile(szFilename, mmode, write ? EFileAccess::Value_ReadWrite : EFileAccess::Value_Read, EFileOp::Value_Sync, manifest))
+                return false;
+
+            cashandle_t* h = new_handle(manifest, write);
+            if (!read_manifest(h))
+            {
+                m_device->closeFile(manifest);
+                free_handle(h);
+                return false;
+            }
+            h->m_reopen = write;
+            outHandle   = h;
+            return true;
+        }
+
+        bool filedevice_cas_t::createFile(const filepath_t& szFilename, bool boRead, bool boWrite, void*& nFileHandle)
+        {
+            void* manifest = nullptr;
+            if (!m_device->createFile(szFilename, true, true, manifest))
+                return false;
+            cashandle_t* h = new_handle(manifest, true);
+            h->m_dirty     = true;
+            nFileHandle    = h;
+            return true;
+        }
+
+        bool filedevice_cas_t::readFile(void* pHandle, u64 pos, void* buffer, u64 count, u64& outNumBytesRead)
+        {
+            cashandle_t* h      = (cashandle_t*)pHandle;
+            u64 const    at     = pending_at(h);
+            u64 const    size   = at + h->m_pending_size;
+            u8*          dst    = (u8*)buffer;
+            u64          done   = 0;
+            u64 const    wanted = pos < size ? ((size - pos) < count ? (size - pos) : count) : 0;
+
+            outNumBytesRead = 0;
+            while (done < wanted)
+            {
+                u64 const p = pos + done;
+                u64       n = 0;
+                if (p >= at)
+                {
+                    n = wanted - done;
+                    nmem::memcpy(dst + done, h->m_pending + (p - at), (u32)n);
+                }
+                else
+                {
+                    s64 const         i     = locate(h, p);
+                    casentry_t const& e     = h->m_entries[i];
+                    casblock_t*       block = get_chunk(e.m_hash, e.m_size);
+                    if (block == nullptr)
+                        return done > 0;
+                    u64 const offset = p - h->m_offsets[i];
+                    n                = (e.m_size - offset) < (wanted - done) ? (e.m_size - offset) : (wanted - done);
+                    nmem::memcpy(dst + done, block->m_data + offset, (u32)n);
+                    release_chunk(block);
+                }
+                done += n;
+                outNumBytesRead = done;
+            }
+            return true;
+        }
+
+        bool filedevice_cas_t::writeFile(void* pHandle, u64 pos, void const* buffer, u64 count, u64& outNumBytesWritten)
+        {
+            cashandle_t* h = (cashandle_t*)pHandle;
+            outNumBytesWritten = 0;
+            if (!h->m_write || pos != (pending_at(h) + h->m_pending_size))
+                return false;
+            if (!append(h, (u8 const*)buffer, count))
+                return false;
+            outNumBytesWritten = count;
+            return true;
+        }
+
+        // What is pending is stored as a provisional chunk, so that the manifest on the
+        // device describes all of the data that has been written.
+        bool filedevice_cas_t::flushFile(void* pHandle)
+        {
+            cashandle_t* h = (cashandle_t*)pHandle;
+            if (!h->m_write)
+                return true;
+            if (!h->m_provisional && h->m_pending_size > 0)
+            {
+                hash128_t hash;
+                if (!store_chunk(h->m_pending, h->m_pending_size, hash) || !add_entry(h, hash, h->m_pending_size))
+                    return false;
+                h->m_provisional = true;
+            }
+            return write_manifest(h) && m_device->flushFile(h->m_manifest);
+        }
+
+        bool filedevice_cas_t::closeFile(void* pHandle)
+        {
+            cashandle_t* h  = (cashandle_t*)pHandle;
+            bool         ok = true;
+            if (h->m_write)
+            {
+                if (h->m_provisional)
+                    reopen_last(h);
+                ok = cut_pending(h, true) && write_manifest(h);
+            }
+            ok = m_device->closeFile(h->m_manifest) && ok;
+            free_handle(h);
+            return ok;
+        }
+
+        bool filedevice_cas_t::setLengthOfFile(void* pHandle, u64 inLength)
+        {
+            cashandle_t* h = (cashandle_t*)pHandle;
+            return h->m_write && truncate(h, inLength);
+        }
+
+        bool filedevice_cas_t::getLengthOfFile(void* pHandle, u64& outLength)
+        {
+            cashandle_t* h = (cashandle_t*)pHandle;
+            outLength      = pending_at(h) + h->m_pending_size;
+            return true;
+        }
+
+        bool filedevice_cas_t::statFile(filepath_t const& szFilename, u64& outSize, fileattrs_t* outAttr, filetimes_t* outTimes)
+        {
+            casheader_t header;
+            u64         manifest_size = 0;
+            if (!m_device->statFile(szFilename, manifest_size, outAttr, outTimes) || !read_header(szFilename, header))
+                return false;
+            outSize = header.m_size;
+            return true;
+        }
+
+        bool filedevice_cas_t::identifyFile(filepath_t const& szFilename, u64& outId, u64& outModified, u64& outSize)
+        {
+            casheader_t header;
+            if (!m_device->identifyFile(szFilename, outId, outModified, outSize) || !read_header(szFilename, header))
+                return false;
+            outSize = header.m_size;
+            return true;
+        }
+
+        // -----------------------------------------------------------
+        // -----------------------------------------------------------
+
+        filedevice_t* create_cas_device(filedevice_t* device, casoptions_t const& options)
+        {
+            if (device == nullptr)
+                device = gCreateFileDevice(true);
+            if (device == nullptr || options.m_store == nullptr || options.m_store[0] == '\0')
+                return nullptr;
+            return mImpl->m_allocator->construct<filedevice_cas_t>(device, mImpl->m_allocator, options);
+        }
+
+        void destroy_cas_device(filedevice_t* device)
+        {
+            mImpl->release_ioqueue(device);
+            mImpl->m_allocator->destruct((filedevice_cas_t*)device);
+        }
+
+    } // namespace nfs
+}; // namespace ncore
@@ -0,0 +1,64 @@
+#include "ccore/c_target.h"
+
+#include "cfilesystem/private/c_chunker.h"
+
+namespace ncore
+{
+    namespace nfs
+    {
+        static inline u64 sSplitMix(u64& state)
+        {
+            state += 0x9E3779B97F4A7C15ull;
+            u64 z = state;
+            z     = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            z     = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+            return z ^ (z >> 31);
+        }
+
+        static inline u64 sTopBits(u32 bits) { return bits >= 64 ? ~(u64)0 : (bits == 0 ? 0 : (~(u64)0 << (64 - bits))); }
+
+        void chunker_t::init(u32 min_size, u32 avg_size, u32 max_size)
+        {
+            // The gear table has to be the same everywhere, chunks of a store are
+            // only shared when they are cut the same way.
+            u64 state = 0x46617374434443ull; // "FastCDC"
+            for (s32 i = 0; i < 256; ++i)
+                m_gear[i] = sSplitMix(state);
+
+            u32 bits = 6;
+            while ((1u << (bits + 1)) <= avg_size && bits < 30)
+                bits += 1;
+            m_avg = 1u << bits;
+            m_min = min_size < m_avg ? min_size : m_avg;
+            m_max = max_size > m_avg ? max_size : m_avg;
+
+            m_mask_small = sTopBits(bits + 2);
+            m_mask_large = sTopBits(bits - 2);
+        }
+
+        u32 chunker_t::cut(u8 const* data, u64 size) const
+        {
+            u32 const end = size < (u64)m_max ? (u32)size : m_max;
+            if (end <= m_min)
+                return end;
+
+            u32 const normal = end < m_avg ? end : m_avg;
+            u64       h      = 0;
+            u32       i      = m_min;
+            for (; i < normal; ++i)
+            {
+                h = (h << 1) + m_gear[data[i]];
+                if ((h & m_mask_small) == 0)
+                    return i + 1;
+            }
+            for (; i < end; ++i)
+            {
+                h = (h << 1) + m_gear[data[i]];
+                if ((h & m_mask_large) == 0)
+                    return i + 1;
+            }
+            return end;
+        }
+
+    } // namespace nfs
+}; // namespace ncore
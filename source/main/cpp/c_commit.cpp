@@ -0,0 +1,299 @@
+#include "ccore/c_target.h"
+#include "ccore/c_debug.h"
+#include "cbase/c_allocator.h"
+
+#include "cfilesystem/c_async.h"
+#include "cfilesystem/c_dirpath.h"
+#include "cfilesystem/c_filesystem.h"
+#include "cfilesystem/c_stream.h"
+
+#include "cfilesystem/private/c_atomic.h"
+#include "cfilesystem/private/c_commit.h"
+#include "cfilesystem/private/c_enumerations.h"
+#include "cfilesystem/private/c_filedevice.h"
+#include "cfilesystem/private/c_filesystem.h"
+#include "cfilesystem/private/c_ioscheduler.h"
+
+namespace ncore
+{
+    namespace nfs
+    {
+        extern filesys_t* mImpl;
+
+        bool commit(stream_t& stream) { return mImpl->commit(stream); }
+        bool commit(dirpath_t const& dirpath) { return mImpl->commit(dirpath); }
+
+        // -----------------------------------------------------------
+        // filesys_t, group commit
+        // -----------------------------------------------------------
+
+        namespace ECommitState
+        {
+            enum EEnum
+            {
+                FREE     = 0,
+                OPEN     = 1, // Committers can join
+                FLUSHING = 2,
+                DONE     = 3,
+            };
+        }
+
+        namespace ECommitResult
+        {
+            enum EEnum
+            {
+                PENDING   = 0,
+                DUPLICATE = 1, // Same handle or directory as an earlier entry of the batch
+                OK        = 2,
+                FAILED    = 3,
+            };
+        }
+
+        bool filesys_t::commit(stream_t& stream)
+        {
+            filehandle_t* fh = get_filehandle(stream);
+            if (fh == nullptr)
+                return false;
+
+            commitentry_t entry;
+            entry.m_device = fh->m_filedevice;
+            entry.m_handle = fh->m_handle;
+            return m_commit.commit(this, entry);
+        }
+
+        bool filesys_t::commit(dirpath_t const& dirpath)
+        {
+            commitentry_t entry;
+            entry.m_device = dirpath.m_device->m_fileDevice;
+            entry.m_handle = nullptr;
+            entry.m_dir    = dirpath;
+            return m_commit.commit(this, entry);
+        }
+
+        void groupcommit_t::init(u32 window_us, s32 volume_threshold)
+        {
+            m_open             = nullptr;
+            m_flushing         = 0;
+            m_window_us        = window_us;
+            m_volume_threshold = volume_threshold;
+            for (s32 i = 0; i < MAX_BATCHES; ++i)
+            {
+                m_batches[i].m_count   = 0;
+                m_batches[i].m_state   = ECommitState::FREE;
+                m_batches[i].m_waiters = 0;
+            }
+        }
+
+        // Called with the lock held, a batch is free again once all of its committers
+        // have picked up their result.
+        commitbatch_t* groupcommit_t::open_batch()
+        {
+            for (s32 i = 0; i < MAX_BATCHES; ++i)
+            {
+                commitbatch_t* batch = &m_batches[i];
+                if (batch->m_state == ECommitState::OPEN || batch->m_state == ECommitState::FLUSHING)
+                    continue;
+                if (natomic::load(&batch->m_waiters) != 0)
+                    continue;
+                batch->m_count  = 0;
+                batch->m_next   = 0;
+                batch->m_opened = io_clock_us();
+                batch->m_state  = ECommitState::OPEN;
+                return batch;
+            }
+            return nullptr;
+        }
+
+        bool groupcommit_t::commit(filesys_t* fs, commitentry_t const& entry)
+        {
+            commitbatch_t* batch  = nullptr;
+            bool           leader = false;
+            s32            index  = 0;
+            while (batch == nullptr)
+            {
+                m_lock.lock();
+                batch = m_open;
+                if (batch == nullptr || batch->m_count == commitbatch_t::MAX_ENTRIES)
+                {
+                    batch  = open_batch();
+                    m_open = batch;
+                    leader = true;
+                }
+                if (batch != nullptr)
+                {
+                    index                   = batch->m_count;
+                    batch->m_entries[index] = entry;
+                    batch->m_results[index] = ECommitResult::PENDING;
+                    batch->m_count          = index + 1;
+                    natomic::add(&batch->m_waiters, 1);
+                }
+                m_lock.unlock();
+                if (batch == nullptr)
+                    io_yield(); // All batches are busy
+            }
+
+            if (leader)
+            {
+                u64 const deadline = batch->m_opened + m_window_us;
+                while (natomic::load(&batch->m_count) < commitbatch_t::MAX_ENTRIES && natomic::load(&m_flushing) > 0 && io_clock_us() < deadline)
+                    io_yield();
+
+                m_lock.lock();
+                if (m_open == batch)
+                    m_open = nullptr;
+                natomic::add(&m_flushing, 1);
+                natomic::store(&batch->m_state, (s32)ECommitState::FLUSHING);
+                m_lock.unlock();
+
+                flush(fs, batch);
+
+                natomic::add(&m_flushing, -1);
+                natomic::store(&batch->m_state, (s32)ECommitState::DONE);
+                io_wake_all(&batch->m_state);
+            }
+            else
+            {
+                s32 state = natomic::load(&batch->m_state);
+                while (state != ECommitState::DONE)
+                {
+                    io_wait(&batch->m_state, state);
+                    state = natomic::load(&batch->m_state);
+                }
+            }
+
+            // The batch holds a copy of the directory path until it is picked up
+            bool const result = batch->m_results[index] == ECommitResult::OK;
+            if (batch->m_entries[index].m_handle == nullptr)
+            {
+                m_lock.lock();
+                batch->m_entries[index].m_dir = dirpath_t();
+                m_lock.unlock();
+            }
+            natomic::add(&batch->m_waiters, -1);
+            return result;
+        }
+
+        // Directories are always flushed, their paths are not compared
+        static inline bool sSameEntry(commitentry_t const& a, commitentry_t const& b) { return a.m_handle != nullptr && a.m_handle == b.m_handle && a.m_device == b.m_device; }
+
+        void groupcommit_t::flush_entries(commitbatch_t* batch)
+        {
+            s32 const count = batch->m_count;
+            while (true)
+            {
+                s32 const i = natomic::add(&batch->m_next, 1);
+                if (i >= count)
+                    return;
+                if (batch->m_results[i] != ECommitResult::PENDING)
+                    continue;
+
+                commitentry_t const& entry = batch->m_entries[i];
+                bool const           ok    = entry.m_handle != nullptr ? entry.m_device->flushFile(entry.m_handle) : entry.m_device->flushDir(entry.m_dir);
+                batch->m_results[i]        = ok ? ECommitResult::OK : ECommitResult::FAILED;
+            }
+        }
+
+        class commit_call_t : public async_call_t
+        {
+        public:
+            virtual EFileError::Enum operator()(s64& result)
+            {
+                groupcommit_t::flush_entries(m_batch);
+                result = 0;
+                return EFileError::Error_Ok();
+            }
+
+            commitbatch_t* m_batch;
+        };
+
+        void groupcommit_t::flush(filesys_t* fs, commitbatch_t* batch)
+        {
+            enum
+            {
+                MAX_COMMIT_CALLS = 8,
+                ENTRIES_PER_CALL = 16,
+            };
+
+            s32 const count = batch->m_count;
+
+            // Every file is flushed once per batch
+            for (s32 i = 1; i < count; ++i)
+            {
+                for (s32 j = 0; j < i; ++j)
+                {
+                    if (batch->m_results[j] != ECommitResult::DUPLICATE && sSameEntry(batch->m_entries[i], batch->m_entries[j]))
+                    {
+                        batch->m_results[i] = ECommitResult::DUPLICATE;
+                        break;
+                    }
+                }
+            }
+
+            // Many files of one device are made durable with one sync of their volume(s)
+            // instead of one flush each, when the device supports it.
+            if (m_volume_threshold > 0)
+            {
+                void* handles[commitbatch_t::MAX_ENTRIES];
+                for (s32 i = 0; i < count; ++i)
+                {
+                    filedevice_t* fd = batch->m_entries[i].m_device;
+                    if (batch->m_results[i] != ECommitResult::PENDING || batch->m_entries[i].m_handle == nullptr)
+                        continue;
+
+                    bool seen = false; // The device has already been tried
+                    for (s32 j = 0; j < i && !seen; ++j)
+                        seen = batch->m_entries[j].m_device == fd && batch->m_entries[j].m_handle != nullptr;
+                    if (seen)
+                        continue;
+
+                    s32 n = 0;
+                    for (s32 j = i; j < count; ++j)
+                    {
+                        if (batch->m_entries[j].m_device == fd && batch->m_entries[j].m_handle != nullptr && batch->m_results[j] == ECommitResult::PENDING)
+                            handles[n++] = batch->m_entries[j].m_handle;
+                    }
+                    if (n < m_volume_threshold || !fd->syncVolume(handles, n))
+                        continue;
+                    for (s32 j = i; j < count; ++j)
+                    {
+                        if (batch->m_entries[j].m_device == fd && batch->m_entries[j].m_handle != nullptr && batch->m_results[j] == ECommitResult::PENDING)
+                            batch->m_results[j] = ECommitResult::OK;
+                    }
+                }
+            }
+
+            // The remaining flushes are shared with the IO threads
+            commit_call_t calls[MAX_COMMIT_CALLS];
+            async_t       tokens[MAX_COMMIT_CALLS];
+            s32           submitted = 0;
+            s32 const     wanted    = count / ENTRIES_PER_CALL;
+            s32 const     workers   = natomic::load(&fs->m_ioworkers_count);
+            for (s32 i = 0; i < wanted && i < workers && i < MAX_COMMIT_CALLS; ++i)
+            {
+                calls[i].m_batch = batch;
+                tokens[i]        = fs->submit_call(batch->m_entries[0].m_device, nullptr, &calls[i], nullptr, EIoPriority::HIGH);
+                if (tokens[i].error().value != EFileError::ERROR_ASYNC_BUSY)
+                    break;
+                submitted += 1;
+            }
+            flush_entries(batch);
+            for (s32 i = 0; i < submitted; ++i)
+                tokens[i].wait();
+
+            for (s32 i = 1; i < count; ++i)
+            {
+                if (batch->m_results[i] != ECommitResult::DUPLICATE)
+                    continue;
+                for (s32 j = 0; j < i; ++j)
+                {
+                    if (batch->m_results[j] != ECommitResult::DUPLICATE && sSameEntry(batch->m_entries[i], batch->m_entries[j]))
+                    {
+                        batch->m_results[i] = batch->m_results[j];
+                        break;
+                    }
+                }
+            }
+        }
+
+    } // namespace nfs
+}; // namespace ncore
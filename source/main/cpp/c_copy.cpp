@@ -0,0 +1,293 @@
+#include "ccore/c_target.h"
+#include "ccore/c_debug.h"
+#include "cbase/c_allocator.h"
+
+#include "cfilesystem/c_async.h"
+#include "cfilesystem/c_filesystem.h"
+
+#include "cfilesystem/private/c_atomic.h"
+#include "cfilesystem/private/c_enumerations.h"
+#include "cfilesystem/private/c_filedevice.h"
+#include "cfilesystem/private/c_filesystem.h"
+
+namespace ncore
+{
+    namespace nfs
+    {
+        extern filesys_t* mImpl;
+
+        enum
+        {
+            COPY_MAX_CHUNK_SIZE = 1024 * 1024 * 1024, // The chunk buffers are allocated with a u32 size
+        };
+
+        void copy(filepath_t const& src, filepath_t const& dst) { mImpl->copy(src, dst); }
+        bool copy(filepath_t const& src, filepath_t const& dst, copyoptions_t const& options) { return mImpl->copy(src, dst, options); }
+        bool snapshot(dirpath_t const& src, dirpath_t const& dst, copystats_t& out_stats) { return mImpl->snapshot(src, dst, out_stats); }
+
+        // -----------------------------------------------------------
+        // filesys_t, chunked copy
+        // -----------------------------------------------------------
+
+        // Shared by all the threads copying one file, a thread claims the next chunk
+        // until there are none left or one of them has failed.
+        struct copyjob_t
+        {
+            filedevice_t* m_src_device;
+            filedevice_t* m_dst_device;
+            void*         m_src_handle;
+            void*         m_dst_handle;
+            u64           m_size;
+            u64           m_chunk_size;
+            s64           m_chunk_count;
+            s64 volatile  m_next_chunk;
+            s64 volatile  m_copied;
+            s32 volatile  m_failed;
+            bool          m_sparse;
+        };
+
+        // Copy the data extents of [pos, pos + size), the holes are left alone and stay
+        // holes in the (sparse) destination.
+        static bool sCopyExtents(copyjob_t* job, u8* buffer, u64 pos, u64 size)
+        {
+            u64 const end = pos + size;
+            u64       at  = pos;
+            while (at < end)
+            {
+                u64 data_pos = 0;
+                u64 data_end = 0;
+                if (!job->m_src_device->nextDataExtent(job->m_src_handle, at, data_pos, data_end) || data_pos >= end)
+                    return true;
+                if (data_end > end)
+                    data_end = end;
+
+                u64 const count = data_end - data_pos;
+                u64       n     = 0;
+                if (!job->m_src_device->readFile(job->m_src_handle, data_pos, buffer, count, n) || n != count)
+                    return false;
+                if (!job->m_dst_device->writeFile(job->m_dst_handle, data_pos, buffer, count, n) || n != count)
+                    return false;
+                at = data_end;
+            }
+            return true;
+        }
+
+        static void sCopyChunks(copyjob_t* job, u8* buffer)
+        {
+            while (natomic::load(&job->m_failed) == 0)
+            {
+                s64 const chunk = natomic::add(&job->m_next_chunk, 1);
+                if (chunk >= job->m_chunk_count)
+                    return;
+
+                u64 const pos  = (u64)chunk * job->m_chunk_size;
+                u64 const size = (pos + job->m_chunk_size) < job->m_size ? job->m_chunk_size : (job->m_size - pos);
+
+                if (job->m_sparse)
+                {
+                    if (!sCopyExtents(job, buffer, pos, size))
+                    {
+                        natomic::store(&job->m_failed, 1);
+                        return;
+                    }
+                    natomic::add(&job->m_copied, (s64)size);
+                    continue;
+                }
+
+                u64 n = 0;
+                if (!job->m_src_device->readFile(job->m_src_handle, pos, buffer, size, n) || n != size)
+                {
+                    natomic::store(&job->m_failed, 1);
+                    return;
+                }
+                if (!job->m_dst_device->writeFile(job->m_dst_handle, pos, buffer, size, n) || n != size)
+                {
+                    natomic::store(&job->m_failed, 1);
+                    return;
+                }
+                natomic::add(&job->m_copied, (s64)size);
+            }
+        }
+
+        static inline void sCountCopy(copystats_t* stats, u64 cloned, u64 copied)
+        {
+            if (stats == nullptr)
+                return;
+            natomic::add(&stats->m_files, 1);
+            natomic::add(&stats->m_bytes_cloned, (s64)cloned);
+            natomic::add(&stats->m_bytes_copied, (s64)copied);
+        }
+
+        class copy_call_t : public async_call_t
+        {
+        public:
+            virtual EFileError::Enum operator()(s64& result)
+            {
+                sCopyChunks(m_job, m_buffer);
+                result = 0;
+                return EFileError::Error_Ok();
+            }
+
+            copyjob_t* m_job;
+            u8*        m_buffer;
+        };
+
+        void filesys_t::copy(filepath_t const& src, filepath_t const& dst)
+        {
+            copyoptions_t const options;
+            copy(src, dst, options);
+        }
+
+        // The destination is sized up front so the chunks can be written in any order,
+        // every thread uses its own buffer and positional reads/writes on the shared
+        // handles. The copy threads run as calls on the work queue, so they are not
+        // limited by context_t::m_max_io_per_device.
+        // A file below the parallel threshold takes the same path with one thread, so
+        // that holes, the length check and the overwrite option are the same for all.
+        bool filesys_t::copy(filepath_t const& src, filepath_t const& dst, copyoptions_t const& options)
+        {
+            filedevice_t* srcfd = src.m_dirpath.m_device->m_fileDevice;
+            filedevice_t* dstfd = dst.m_dirpath.m_device->m_fileDevice;
+            if (!dstfd->canWrite())
+                return false;
+
+            u64 size = 0;
+            if (!srcfd->statFile(src, size, nullptr, nullptr))
+                return false;
+
+            if (!options.m_overwrite && dstfd->hasFile(dst))
+                return false;
+
+            u64 chunk_size = options.m_chunk_size > 0 ? options.m_chunk_size : (8 * 1024 * 1024);
+            if (chunk_size > COPY_MAX_CHUNK_SIZE)
+                chunk_size = COPY_MAX_CHUNK_SIZE;
+            s64 const chunks = (s64)((size + chunk_size - 1) / chunk_size);
+
+            s32 threads = natomic::load(&m_ioworkers_count) + 1;
+            if (options.m_parallelism > 0 && options.m_parallelism < threads)
+                threads = options.m_parallelism;
+            if (size < options.m_parallel_threshold)
+                threads = 1;
+            if ((s64)threads > chunks)
+                threads = (s32)chunks;
+
+            // A clone shares the data blocks of the source, it is tried first when the
+            // device supports it for the destination, otherwise the data is copied.
+            bool const clone = options.m_clone && srcfd == dstfd && dstfd->canClone(dst.m_dirpath);
+
+            copyjob_t job;
+            job.m_src_device  = srcfd;
+            job.m_dst_device  = dstfd;
+            job.m_src_handle  = nullptr;
+            job.m_dst_handle  = nullptr;
+            job.m_size        = size;
+            job.m_chunk_size  = chunk_size;
+            job.m_chunk_count = chunks;
+            job.m_next_chunk  = 0;
+            job.m_copied      = 0;
+            job.m_failed      = 0;
+            job.m_sparse      = false;
+
+            if (!srcfd->openFile(src, EFileMode::Value_Open, EFileAccess::Value_Read, EFileOp::Value_Sync, job.m_src_handle))
+                return false;
+            if (!dstfd->createFile(dst, true, true, job.m_dst_handle))
+            {
+                srcfd->closeFile(job.m_src_handle);
+                return false;
+            }
+
+            // An empty file only has to be created, there is nothing to reserve or copy.
+            // A sparse source makes a sparse destination with the same holes, any other
+            // destination gets all of its storage reserved up front.
+            u64 cloned = 0;
+            if (size > 0)
+            {
+                job.m_sparse = srcfd->isSparseFile(job.m_src_handle) && dstfd->setSparseFile(job.m_dst_handle);
+                if (job.m_sparse)
+                    dstfd->setLengthOfFile(job.m_dst_handle, size);
+                else if (!dstfd->preallocate(job.m_dst_handle, 0, size))
+                    dstfd->setLengthOfFile(job.m_dst_handle, size);
+
+                if (clone && dstfd->cloneFileRange(job.m_src_handle, 0, job.m_dst_handle, 0, size))
+                    cloned = size;
+                else
+                    copy_chunks(job, threads);
+            }
+
+            // Verify that all the bytes arrived and that the length is what it should be
+            u64  length = 0;
+            bool result = cloned == size || (natomic::load(&job.m_failed) == 0 && (u64)job.m_copied == size);
+            result      = result && dstfd->flushFile(job.m_dst_handle) && dstfd->getLengthOfFile(job.m_dst_handle, length) && length == size;
+
+            srcfd->closeFile(job.m_src_handle);
+            dstfd->closeFile(job.m_dst_handle);
+            if (!result)
+                dstfd->deleteFile(dst);
+            else
+                sCountCopy(options.m_stats, cloned, size - cloned);
+            return result;
+        }
+
+        void filesys_t::copy_chunks(copyjob_t& job, s32 threads)
+        {
+            enum
+            {
+                MAX_COPY_THREADS = MAX_IOWORKERS + 1
+            };
+            if (threads > MAX_COPY_THREADS)
+                threads = MAX_COPY_THREADS;
+            if (threads < 1)
+                threads = 1;
+
+            u8*         buffers[MAX_COPY_THREADS];
+            copy_call_t calls[MAX_COPY_THREADS];
+            async_t     tokens[MAX_COPY_THREADS];
+            s32         buffer_count = 0;
+            for (s32 i = 0; i < threads; ++i)
+            {
+                buffers[i] = (u8*)m_allocator->allocate((u32)job.m_chunk_size, ESettings::MEM_ALIGNMENT);
+                if (buffers[i] == nullptr)
+                    break;
+                buffer_count += 1;
+            }
+
+            // Thread 0 is the calling thread, the others are handed to the IO threads
+            // and when no request is available the calling thread does it all.
+            s32 submitted = 0;
+            for (s32 i = 1; i < buffer_count; ++i)
+            {
+                calls[i].m_job    = &job;
+                calls[i].m_buffer = buffers[i];
+                tokens[i]         = submit_call(nullptr, nullptr, &calls[i], nullptr, EIoPriority::NORMAL);
+                if (tokens[i].error().value != EFileError::ERROR_ASYNC_BUSY)
+                    break;
+                submitted += 1;
+            }
+            if (buffer_count > 0)
+                sCopyChunks(&job, buffers[0]);
+            else
+                natomic::store(&job.m_failed, 1);
+            for (s32 i = 1; i <= submitted; ++i)
+                tokens[i].wait();
+
+            for (s32 i = 0; i < buffer_count; ++i)
+                m_allocator->deallocate(buffers[i]);
+        }
+
+        // Every file is cloned when the device can, otherwise it is copied. The tree walk
+        // hands the files to the IO threads so the clone calls run in parallel.
+        bool filesys_t::snapshot(dirpath_t const& src, dirpath_t const& dst, copystats_t& out_stats)
+        {
+            out_stats.m_files        = 0;
+            out_stats.m_bytes_cloned = 0;
+            out_stats.m_bytes_copied = 0;
+
+            copyoptions_t options;
+            options.m_clone       = true;
+            options.m_parallelism = 1;
+            options.m_stats       = &out_stats;
+            return copy(src, dst, options);
+        }
+
+    } // namespace nfs
+}; // namespace ncore
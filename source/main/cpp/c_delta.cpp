@@ -0,0 +1,90 @@
+#include "ccore/c_target.h"
+#include "cbase/c_allocator.h"
+
+#include "cfilesystem/c_hash.h"
+
+#include "cfilesystem/private/c_delta.h"
+
+namespace ncore
+{
+    namespace nfs
+    {
+        static inline u32 sSlotOf(u32 weak, u32 mask) { return (weak * 0x9E3779B1u) & mask; }
+
+        deltaindex_t::deltaindex_t() : m_allocator(nullptr), m_sigs(nullptr), m_table(nullptr), m_mask(0), m_count(0), m_max(0), m_block_size(0) {}
+
+        bool deltaindex_t::init(alloc_t* allocator, u32 block_size, u32 max_blocks)
+        {
+            u32 slots = 16;
+            while (slots < (max_blocks * 2))
+                slots <<= 1;
+
+            m_allocator  = allocator;
+            m_block_size = block_size;
+            m_max        = max_blocks;
+            m_count      = 0;
+            m_mask       = slots - 1;
+            m_sigs       = (sig_t*)allocator->allocate(sizeof(sig_t) * (max_blocks > 0 ? max_blocks : 1));
+            m_table      = (u32*)allocator->allocate(sizeof(u32) * slots);
+            if (m_sigs == nullptr || m_table == nullptr)
+            {
+                exit();
+                return false;
+            }
+            for (u32 i = 0; i < slots; ++i)
+                m_table[i] = 0;
+            return true;
+        }
+
+        void deltaindex_t::exit()
+        {
+            if (m_sigs != nullptr)
+                m_allocator->deallocate(m_sigs);
+            if (m_table != nullptr)
+                m_allocator->deallocate(m_table);
+            m_sigs  = nullptr;
+            m_table = nullptr;
+            m_count = 0;
+        }
+
+        void deltaindex_t::add(u32 block, u8 const* data)
+        {
+            if (m_count == m_max)
+                return;
+
+            rollsum_t sum;
+            sum.init(data, m_block_size);
+
+            sig_t& sig   = m_sigs[m_count];
+            sig.m_weak   = sum.digest();
+            sig.m_block  = block;
+            sig.m_strong = hash64(data, m_block_size);
+
+            u32 slot = sSlotOf(sig.m_weak, m_mask);
+            while (m_table[slot] != 0)
+                slot = (slot + 1) & m_mask;
+            m_table[slot] = ++m_count;
+        }
+
+        s64 deltaindex_t::find(u32 weak, u8 const* data) const
+        {
+            u64  strong = 0;
+            bool hashed = false;
+            for (u32 slot = sSlotOf(weak, m_mask); m_table[slot] != 0; slot = (slot + 1) & m_mask)
+            {
+                sig_t const& sig = m_sigs[m_table[slot] - 1];
+                if (sig.m_weak != weak)
+                    continue;
+                if (!hashed)
+                {
+                    strong = hash64(data, m_block_size);
+                    hashed = true;
+                }
+                if (sig.m_strong == strong)
+                    return sig.m_block;
+            }
+            return -1;
+        }
+
+    } // namespace nfs
+}; // namespace ncore
@@ -0,0 +1,188 @@
+#include "ccore/c_target.h"
+#include "ccore/c_debug.h"
+#include "cbase/c_allocator.h"
+
+#include "cfilesystem/private/c_enumerations.h"
+#include "cfilesystem/private/c_filedevice.h"
+#include "cfilesystem/c_attributes.h"
+
+namespace ncore
+{
+    namespace nfs
+    {
+        // -----------------------------------------------------------
+        // filedevice_t, default implementations
+        // -----------------------------------------------------------
+
+        bool filedevice_t::readFileV(void* pHandle, u64 pos, iospan_t const* spans, s32 count, u64& outNumBytesRead)
+        {
+            outNumBytesRead = 0;
+            for (s32 i = 0; i < count; ++i)
+            {
+                u64 n = 0;
+                if (!readFile(pHandle, pos, spans[i].m_data, spans[i].m_size, n))
+                    return outNumBytesRead > 0;
+                outNumBytesRead += n;
+                pos += n;
+                if (n < spans[i].m_size)
+                    break;
+            }
+            return true;
+        }
+
+        bool filedevice_t::writeFileV(void* pHandle, u64 pos, ciospan_t const* spans, s32 count, u64& outNumBytesWritten)
+        {
+            outNumBytesWritten = 0;
+            for (s32 i = 0; i < count; ++i)
+            {
+                u64 n = 0;
+                if (!writeFile(pHandle, pos, spans[i].m_data, spans[i].m_size, n))
+                    return outNumBytesWritten > 0;
+                outNumBytesWritten += n;
+                pos += n;
+                if (n < spans[i].m_size)
+                    break;
+            }
+            return true;
+        }
+
+        bool filedevice_t::loadFile(filepath_t const& szFilename, alloc_t* allocator, u64 mapThreshold, u8 const*& outData, u64& outSize, void*& outMapping)
+        {
+            outData    = nullptr;
+            outSize    = 0;
+            outMapping = nullptr;
+
+            void* handle = nullptr;
+            if (!openFile(szFilename, EFileMode::Value_Open, EFileAccess::Value_Read, EFileOp::Value_Sync, handle))
+                return false;
+
+            // The allocator takes a u32 size, larger files can only be mapped
+            u64  length = 0;
+            bool result = getLengthOfFile(handle, length) && length <= 0xFFFFFFFF;
+            if (result && length > 0)
+            {
+                u8* data = (u8*)allocator->allocate((u32)length, ESettings::MEM_ALIGNMENT);
+                u64 n    = 0;
+                result   = data != nullptr && readFile(handle, 0, data, length, n) && n == length;
+                if (result)
+                {
+                    outData = data;
+                    outSize = length;
+                }
+                else if (data != nullptr)
+                {
+                    allocator->deallocate(data);
+                }
+            }
+            closeFile(handle);
+            return result;
+        }
+
+        bool filedevice_t::loadFile(filepath_t const& szFilename, u8* buffer, u64 capacity, u64& outSize)
+        {
+            outSize = 0;
+
+            void* handle = nullptr;
+            if (!openFile(szFilename, EFileMode::Value_Open, EFileAccess::Value_Read, EFileOp::Value_Sync, handle))
+                return false;
+
+            u64  length = 0;
+            bool result = getLengthOfFile(handle, length) && length <= capacity;
+            if (result && length > 0)
+            {
+                u64 n  = 0;
+                result = readFile(handle, 0, buffer, length, n) && n == length;
+                if (result)
+                    outSize = length;
+            }
+            closeFile(handle);
+            return result;
+        }
+
+        bool filedevice_t::unmapFile(void* mapping) { return false; }
+        bool filedevice_t::mapFile(void* pHandle, u64 pos, u64 count, u8 const*& outData, void*& outMapping) { return false; }
+        bool filedevice_t::identifyFile(filepath_t const& szFilename, u64& outId, u64& outModified, u64& outSize) { return false; }
+        bool filedevice_t::mapFileWritable(void* pHandle, u64 pos, u64 count, u8*& outData, void*& outMapping) { return false; }
+        bool filedevice_t::flushMapping(void* pHandle, void const* address, u64 count, bool boWait) { return false; }
+
+        bool filedevice_t::findFile(filepath_t const& szFilename, bool& outFound)
+        {
+            outFound = hasFile(szFilename);
+            return true;
+        }
+
+        bool filedevice_t::statFile(filepath_t const& szFilename, u64& outSize, fileattrs_t* outAttr, filetimes_t* outTimes)
+        {
+            outSize = 0;
+
+            void* handle = nullptr;
+            if (!openFile(szFilename, EFileMode::Value_Open, EFileAccess::Value_Read, EFileOp::Value_Sync, handle))
+                return false;
+            bool result = getLengthOfFile(handle, outSize);
+            if (result && outTimes != nullptr)
+                result = getFileTime(handle, *outTimes);
+            closeFile(handle);
+
+            if (result && outAttr != nullptr)
+                result = getFileAttr(szFilename, *outAttr);
+            return result;
+        }
+
+        s32 filedevice_t::deleteFiles(filepath_t const* szFilenames, s32 count)
+        {
+            s32 deleted = 0;
+            for (s32 i = 0; i < count; ++i)
+            {
+                if (deleteFile(szFilenames[i]))
+                    deleted += 1;
+            }
+            return deleted;
+        }
+
+        bool filedevice_t::removeDir(dirpath_t const& szDirPath) { return false; }
+
+        bool filedevice_t::canClone(dirpath_t const& szDirPath) { return false; }
+        bool filedevice_t::cloneFileRange(void* pSrcHandle, u64 srcPos, void* pDstHandle, u64 dstPos, u64 count) { return false; }
+
+        bool filedevice_t::isSparseFile(void* pHandle) { return false; }
+        bool filedevice_t::setSparseFile(void* pHandle) { return false; }
+
+        bool filedevice_t::nextDataExtent(void* pHandle, u64 pos, u64& outDataPos, u64& outDataEnd)
+        {
+            u64 length = 0;
+            if (!getLengthOfFile(pHandle, length) || pos >= length)
+                return false;
+            outDataPos = pos;
+            outDataEnd = length;
+            return true;
+        }
+
+        bool filedevice_t::punchHole(void* pHandle, u64 pos, u64 count) { return false; }
+        bool filedevice_t::reserveFile(void* pHandle, u64 size) { return false; }
+
+        bool filedevice_t::preallocate(void* pHandle, u64 pos, u64 count)
+        {
+            u64 length = 0;
+            if (!getLengthOfFile(pHandle, length))
+                return false;
+            if ((pos + count) <= length)
+                return true;
+            return setLengthOfFile(pHandle, pos + count);
+        }
+
+        bool filedevice_t::adviseFile(void* pHandle, u64 pos, u64 count, s32 advice) { return false; }
+
+        bool filedevice_t::syncFileRange(void* pHandle, u64 pos, u64 count, bool boWait)
+        {
+            if (!boWait)
+                return true;
+            return flushFile(pHandle);
+        }
+
+        bool filedevice_t::flushDir(dirpath_t const& szDirPath) { return false; }
+        bool filedevice_t::syncVolume(void* const* pHandles, s32 count) { return false; }
+        bool filedevice_t::createTempFile(filepath_t const& szFilename, void*& outHandle) { return false; }
+        bool filedevice_t::linkTempFile(void* pHandle, filepath_t const& szFilename) { return false; }
+
+    } // namespace nfs
+}; // namespace ncore
@@ -111,6 +111,10 @@ namespace ncore
     }
 
     void g_DestroyFileDevice(filedevice_t* fd) { g_DestroyFileDeviceMac(fd); }
+
+    // Unbuffered IO (F_NOCACHE) is not implemented by this device
+    filedevice_t* gCreateDirectFileDevice(alloc_t* allocator, iobufferpool_t* pool, bool boCanWrite) { return nullptr; }
+    void          gDestroyDirectFileDevice(alloc_t* allocator, filedevice_t* fd) {}
     }
 
 } // namespace ncore
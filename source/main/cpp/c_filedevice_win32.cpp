@@ -8,6 +8,7 @@
 #    define NOGDI
 #    define NOKANJI
 #    include <windows.h>
+#    include <winioctl.h>
 #    include <stdio.h>
 
 #    include "cbase/c_allocator.h"
@@ -20,8 +21,10 @@
 
 #    include "ctime/c_datetime.h"
 
+#    include "cfilesystem/private/c_dirstack.h"
 #    include "cfilesystem/private/c_filedevice.h"
 #    include "cfilesystem/private/c_filesystem.h"
+#    include "cfilesystem/private/c_iobuffers.h"
 #    include "cfilesystem/c_attributes.h"
 #    include "cfilesystem/c_filesystem.h"
 
@@ -34,7 +37,7 @@ namespace ncore
         public:
             DCORE_CLASS_PLACEMENT_NEW_DELETE
 
-            filedevice_pc_t() {}
+            filedevice_pc_t() : m_openFlags(FILE_ATTRIBUTE_NORMAL) {}
             virtual ~filedevice_pc_t() {}
 
             virtual void destruct(alloc_t* allocator) {}
@@ -51,6 +54,16 @@ namespace ncore
             virtual bool flushFile(void* nFileHandle);
             virtual bool closeFile(void* nFileHandle);
 
+            virtual bool loadFile(filepath_t const& szFilename, alloc_t* allocator, u64 mapThreshold, u8 const*& outData, u64& outSize, void*& outMapping);
+            virtual bool loadFile(filepath_t const& szFilename, u8* buffer, u64 capacity, u64& outSize);
+            virtual bool unmapFile(void* mapping);
+            virtual bool mapFile(void* pHandle, u64 pos, u64 count, u8 const*& outData, void*& outMapping);
+            virtual bool mapFileWritable(void* pHandle, u64 pos, u64 count, u8*& outData, void*& outMapping);
+            virtual bool flushMapping(void* pHandle, void const* address, u64 count, bool boWait);
+            virtual bool statFile(filepath_t const& szFilename, u64& outSize, fileattrs_t* outAttr, filetimes_t* outTimes);
+            virtual bool findFile(filepath_t const& szFilename, bool& outFound);
+            virtual bool identifyFile(filepath_t const& szFilename, u64& outId, u64& outModified, u64& outSize);
+
             virtual bool createStream(filepath_t const& szFilename, bool boRead, bool boWrite, stream_t& strm);
             virtual bool closeStream(stream_t& strm);
 
@@ -76,6 +89,22 @@ namespace ncore
             virtual bool moveDir(const dirpath_t& szDirPath, const dirpath_t& szToDirPath, bool boOverwrite);
             virtual bool copyDir(const dirpath_t& szDirPath, const dirpath_t& szToDirPath, bool boOverwrite);
             virtual bool deleteDir(const dirpath_t& szDirPath);
+            virtual s32  deleteFiles(filepath_t const* szFilenames, s32 count);
+            virtual bool removeDir(const dirpath_t& szDirPath);
+            virtual bool canClone(const dirpath_t& szDirPath);
+            virtual bool cloneFileRange(void* pSrcHandle, u64 srcPos, void* pDstHandle, u64 dstPos, u64 count);
+
+            virtual bool isSparseFile(void* pHandle);
+            virtual bool setSparseFile(void* pHandle);
+            virtual bool nextDataExtent(void* pHandle, u64 pos, u64& outDataPos, u64& outDataEnd);
+            virtual bool punchHole(void* pHandle, u64 pos, u64 count);
+            virtual bool preallocate(void* pHandle, u64 pos, u64 count);
+            virtual bool reserveFile(void* pHandle, u64 size);
+            virtual bool adviseFile(void* pHandle, u64 pos, u64 count, s32 advice);
+            virtual bool flushDir(const dirpath_t& szDirPath);
+            virtual bool syncVolume(void* const* pHandles, s32 count);
+            virtual bool createTempFile(const filepath_t& szFilename, void*& outHandle);
+            virtual bool linkTempFile(void* pHandle, const filepath_t& szFilename);
 
             virtual bool setDirTime(const dirpath_t& szDirPath, const filetimes_t& ftimes);
             virtual bool getDirTime(const dirpath_t& szDirPath, filetimes_t& ftimes);
@@ -94,6 +123,12 @@ namespace ncore
             bool seekOrigin(void* nFileHandle, u64 pos, u64& newPos);
             bool seekCurrent(void* nFileHandle, u64 pos, u64& newPos);
             bool seekEnd(void* nFileHandle, u64 pos, u64& newPos);
+
+            HANDLE openForLoad(filepath_t const& szFilename, u64& outSize);
+            bool   readWhole(HANDLE handle, u8* buffer, u64 size);
+            void*  mapWhole(HANDLE handle);
+
+            u32 m_openFlags; // Flags and attributes for opening/creating a file
         };
 
         class filedevice_pc_ro_t : public filedevice_pc_t
@@ -118,6 +153,49 @@ namespace ncore
 
         void x_DestroyFileDevice(filedevice_t* fd) { x_DestroyFileDevicePC(fd); }
 
+        // -----------------------------------------------------------------------
+        // Unbuffered IO, the file is opened with FILE_FLAG_NO_BUFFERING which requires
+        // that the position, the size and the memory of a transfer are aligned to the
+        // sector size. The alignment of the buffer pool is used, it must be a multiple
+        // of the sector size of the volume (4096 covers all current drives).
+        //
+        // A transfer is split into an unaligned head, an aligned body and an unaligned
+        // tail. The body goes straight to/from the memory of the caller, the head and
+        // the tail go through a bounce buffer from the pool. When the memory and the
+        // position are not aligned in the same way the whole transfer is bounced.
+        // A partial sector is written as read-modify-write, writes on the same sector
+        // from different threads must be serialized by the user.
+        class filedevice_pc_direct_t : public filedevice_pc_t
+        {
+        public:
+            filedevice_pc_direct_t(iobufferpool_t* pool, bool boCanWrite) : m_pool(pool), m_canWrite(boCanWrite) { m_openFlags = FILE_ATTRIBUTE_NORMAL | FILE_FLAG_NO_BUFFERING; }
+
+            virtual bool canWrite() const { return m_canWrite; }
+
+            virtual bool readFile(void* nFileHandle, u64 pos, void* buffer, u64 count, u64& outNumBytesRead);
+            virtual bool writeFile(void* nFileHandle, u64 pos, const void* buffer, u64 count, u64& outNumBytesWritten);
+            virtual bool adviseFile(void* pHandle, u64 pos, u64 count, s32 advice) { return false; } // The page cache is not used
+            virtual bool mapFile(void* pHandle, u64 pos, u64 count, u8 const*& outData, void*& outMapping) { return false; }
+            virtual bool mapFileWritable(void* pHandle, u64 pos, u64 count, u8*& outData, void*& outMapping) { return false; }
+
+            bool readAligned(void* nFileHandle, u64 pos, u8* buffer, u64 count, u64& outNumBytesRead);
+            bool writeAligned(void* nFileHandle, u64 pos, u8 const* buffer, u64 count);
+            bool readBounced(void* nFileHandle, u64 pos, u8* buffer, u64 count, u64& outNumBytesRead);
+            bool writeBounced(void* nFileHandle, u64 pos, u8 const* buffer, u64 count);
+
+            iobufferpool_t* m_pool;
+            bool            m_canWrite;
+        };
+
+        filedevice_t* gCreateDirectFileDevice(alloc_t* allocator, iobufferpool_t* pool, bool boCanWrite) { return allocator->construct<filedevice_pc_direct_t>(pool, boCanWrite); }
+
+        void gDestroyDirectFileDevice(alloc_t* allocator, filedevice_t* fd) { allocator->destruct((filedevice_pc_direct_t*)fd); }
+
+        // The number of UTF-16 runes to allocate for a path, including the terminator
+        // that the Win32 functions need
+        static inline s32 sPathLen16(filepath_t const& filepath) { return filepath.to_strlen() + 1; }
+        static inline s32 sPathLen16(dirpath_t const& dirpath) { return dirpath.to_strlen() + 1; }
+
         bool filedevice_pc_t::getDeviceInfo(pathdevice_t* device, u64& totalSpace, u64& freeSpace) const
         {
             ULARGE_INTEGER totalbytes, freebytes;
@@ -150,7 +228,7 @@ namespace ncore
 
             alloc_t* allocator = szFilename.m_dirpath.m_device->m_root->m_allocator;
 
-            s32 const    filenamestrlen = szFilename.to_strlen();
+            s32 const    filenamestrlen = sPathLen16(szFilename);
             utf16::prune filenamestr    = (utf16::prune)allocator->allocate(filenamestrlen * sizeof(utf16::rune));
             runes_t      filename16(filenamestr, filenamestr + filenamestrlen);
             szFilename.to_string(filename16);
@@ -167,16 +245,17 @@ namespace ncore
             return result;
         }
 
+        // A file opened for reading can still be written by others (a log that is tailed)
         bool filedevice_pc_t::openFile(const filepath_t& szFilename, EFileMode mode, EFileAccess access, EFileOp op, void*& nFileHandle)
         {
-            u32 shareType   = FILE_SHARE_READ;
+            u32 shareType   = (access == FileAccess_Read) ? (FILE_SHARE_READ | FILE_SHARE_WRITE) : FILE_SHARE_READ;
             u32 fileMode    = (access == FileAccess_Read) ? GENERIC_READ : GENERIC_WRITE | GENERIC_READ;
             u32 disposition = OPEN_EXISTING;
-            u32 attrFlags   = FILE_ATTRIBUTE_NORMAL;
+            u32 attrFlags   = m_openFlags;
 
             alloc_t* allocator = szFilename.m_dirpath.m_device->m_root->m_allocator;
 
-            s32 const    filenamestrlen = szFilename.to_strlen();
+            s32 const    filenamestrlen = sPathLen16(szFilename);
             utf16::prune filenamestr    = (utf16::prune)allocator->allocate(filenamestrlen * sizeof(utf16::rune));
             runes_t      filename16(filenamestr, filenamestr + filenamestrlen);
             szFilename.to_string(filename16);
@@ -193,11 +272,11 @@ namespace ncore
             u32 shareType   = FILE_SHARE_READ;
             u32 fileMode    = !boWrite ? GENERIC_READ : GENERIC_WRITE | GENERIC_READ;
             u32 disposition = CREATE_ALWAYS;
-            u32 attrFlags   = FILE_ATTRIBUTE_NORMAL;
+            u32 attrFlags   = m_openFlags;
 
             alloc_t* allocator = szFilename.m_dirpath.m_device->m_root->m_allocator;
 
-            s32 const    filenamestrlen = szFilename.to_strlen();
+            s32 const    filenamestrlen = sPathLen16(szFilename);
             utf16::prune filenamestr    = (utf16::prune)allocator->allocate(filenamestrlen * sizeof(utf16::rune));
             runes_t      filename16(filenamestr, filenamestr + filenamestrlen);
             szFilename.to_string(filename16);
@@ -209,67 +288,291 @@ namespace ncore
             return nFileHandle != INVALID_HANDLE_VALUE;
         }
 
+        // The position is passed in the OVERLAPPED structure instead of seeking first, on
+        // a synchronous handle this is a positional read/write and several threads can
+        // use the same handle at different positions.
+        static inline void sSetPosition(OVERLAPPED& overlapped, u64 pos)
+        {
+            ::ZeroMemory(&overlapped, sizeof(overlapped));
+            overlapped.Offset     = nmem::lou32(pos);
+            overlapped.OffsetHigh = nmem::hiu32(pos);
+        }
+
         bool filedevice_pc_t::readFile(void* nFileHandle, u64 pos, void* buffer, u64 count, u64& outNumBytesRead)
         {
-            u64 newPos;
-            if (seek(nFileHandle, __SEEK_ORIGIN, pos, newPos))
+            OVERLAPPED overlapped;
+            sSetPosition(overlapped, pos);
+
+            DWORD numBytesRead;
+            bool  boSuccess = ::ReadFile((HANDLE)nFileHandle, buffer, (DWORD)count, &numBytesRead, &overlapped);
+
+            if (boSuccess)
+            {
+                outNumBytesRead = numBytesRead;
+            }
+
+            if (!boSuccess)
             {
-                DWORD numBytesRead;
-                bool  boSuccess = ::ReadFile((HANDLE)nFileHandle, buffer, (DWORD)count, &numBytesRead, nullptr);
+                outNumBytesRead = -1;
 
-                if (boSuccess)
+                DWORD dwError = ::GetLastError();
+                switch (dwError)
                 {
-                    outNumBytesRead = numBytesRead;
+                    case ERROR_HANDLE_EOF: // Reading at or beyond the end of the file, nothing was read
+                        outNumBytesRead = 0;
+                        return true;
+                    case ERROR_IO_PENDING: return false;
+                    default: return false;
                 }
+            }
 
-                if (!boSuccess)
-                {
-                    outNumBytesRead = -1;
+            return true;
+        }
+        bool filedevice_pc_t::writeFile(void* nFileHandle, u64 pos, const void* buffer, u64 count, u64& outNumBytesWritten)
+        {
+            OVERLAPPED overlapped;
+            sSetPosition(overlapped, pos);
 
-                    DWORD dwError = ::GetLastError();
-                    switch (dwError)
-                    {
-                        case ERROR_HANDLE_EOF: // We have reached the end of the FilePC during the call to ReadFile
-                            return false;
-                        case ERROR_IO_PENDING: return false;
-                        default: return false;
-                    }
+            DWORD numBytesWritten;
+            bool  boSuccess = ::WriteFile((HANDLE)nFileHandle, buffer, (DWORD)count, &numBytesWritten, &overlapped);
+
+            if (boSuccess)
+            {
+                outNumBytesWritten = numBytesWritten;
+            }
+
+            if (!boSuccess)
+            {
+                outNumBytesWritten = -1;
+
+                DWORD dwError = ::GetLastError();
+                switch (dwError)
+                {
+                    case ERROR_HANDLE_EOF: // We have reached the end of the FilePC during the call to WriteFile
+                        return false;
+                    case ERROR_IO_PENDING: return false;
+                    default: return false;
                 }
+            }
 
-                return true;
+            return true;
+        }
+
+        // -----------------------------------------------------------------------
+        // filedevice_pc_direct_t
+
+        enum
+        {
+            DIRECT_MAX_TRANSFER = 0x40000000, // Largest aligned transfer handed to ReadFile/WriteFile
+        };
+
+        bool filedevice_pc_direct_t::readAligned(void* nFileHandle, u64 pos, u8* buffer, u64 count, u64& outNumBytesRead)
+        {
+            outNumBytesRead = 0;
+            while (count > 0)
+            {
+                u64 const size = count < DIRECT_MAX_TRANSFER ? count : DIRECT_MAX_TRANSFER;
+                u64       n    = 0;
+                if (!filedevice_pc_t::readFile(nFileHandle, pos, buffer, size, n))
+                    return false;
+                outNumBytesRead += n;
+                if (n < size)
+                    break; // End of file
+                pos += size;
+                buffer += size;
+                count -= size;
             }
-            return false;
+            return true;
         }
-        bool filedevice_pc_t::writeFile(void* nFileHandle, u64 pos, const void* buffer, u64 count, u64& outNumBytesWritten)
+
+        bool filedevice_pc_direct_t::writeAligned(void* nFileHandle, u64 pos, u8 const* buffer, u64 count)
         {
-            u64 newPos;
-            if (seek(nFileHandle, __SEEK_ORIGIN, pos, newPos))
+            while (count > 0)
+            {
+                u64 const size = count < DIRECT_MAX_TRANSFER ? count : DIRECT_MAX_TRANSFER;
+                u64       n    = 0;
+                if (!filedevice_pc_t::writeFile(nFileHandle, pos, buffer, size, n) || n != size)
+                    return false;
+                pos += size;
+                buffer += size;
+                count -= size;
+            }
+            return true;
+        }
+
+        bool filedevice_pc_direct_t::readBounced(void* nFileHandle, u64 pos, u8* buffer, u64 count, u64& outNumBytesRead)
+        {
+            outNumBytesRead = 0;
+            if (count == 0)
+                return true;
+
+            u8* bounce = m_pool->obtain();
+            if (bounce == nullptr)
+                return false;
+
+            u64 const align  = m_pool->alignment();
+            u64 const window = m_pool->buffer_size();
+            bool      result = true;
+            while (count > 0)
             {
-                DWORD numBytesWritten;
-                bool  boSuccess = ::WriteFile((HANDLE)nFileHandle, buffer, (DWORD)count, &numBytesWritten, nullptr);
+                u64 const apos = pos & ~(align - 1);
+                u64 const skip = pos - apos;
+                u64 const size = (window - skip) < count ? (window - skip) : count;
+                u64 const span = (skip + size + (align - 1)) & ~(align - 1);
 
-                if (boSuccess)
+                u64 n = 0;
+                if (!filedevice_pc_t::readFile(nFileHandle, apos, bounce, span, n))
                 {
-                    outNumBytesWritten = numBytesWritten;
+                    result = false;
+                    break;
                 }
+                if (n <= skip)
+                    break; // End of file
+                u64 const avail = (n - skip) < size ? (n - skip) : size;
+                nmem::memcpy(buffer, bounce + skip, avail);
+                outNumBytesRead += avail;
+                if (avail < size)
+                    break;
+                pos += size;
+                buffer += size;
+                count -= size;
+            }
 
-                if (!boSuccess)
-                {
-                    outNumBytesWritten = -1;
+            m_pool->release(bounce);
+            return result;
+        }
+
+        // The sectors that are only partially covered are read first so that the bytes
+        // around the written range are kept, beyond the end of the file they are zero.
+        bool filedevice_pc_direct_t::writeBounced(void* nFileHandle, u64 pos, u8 const* buffer, u64 count)
+        {
+            if (count == 0)
+                return true;
+
+            u8* bounce = m_pool->obtain();
+            if (bounce == nullptr)
+                return false;
+
+            u64 const align  = m_pool->alignment();
+            u64 const window = m_pool->buffer_size();
+            bool      result = true;
+            while (count > 0)
+            {
+                u64 const apos = pos & ~(align - 1);
+                u64 const skip = pos - apos;
+                u64 const size = (window - skip) < count ? (window - skip) : count;
+                u64 const span = (skip + size + (align - 1)) & ~(align - 1);
 
-                    DWORD dwError = ::GetLastError();
-                    switch (dwError)
+                if (skip != 0 || span != size)
+                {
+                    u64 n = 0;
+                    if (!filedevice_pc_t::readFile(nFileHandle, apos, bounce, span, n))
                     {
-                        case ERROR_HANDLE_EOF: // We have reached the end of the FilePC during the call to WriteFile
-                            return false;
-                        case ERROR_IO_PENDING: return false;
-                        default: return false;
+                        result = false;
+                        break;
                     }
+                    if (n < span)
+                        nmem::memset(bounce + n, 0, span - n);
                 }
+                nmem::memcpy(bounce + skip, buffer, size);
+
+                u64 n = 0;
+                if (!filedevice_pc_t::writeFile(nFileHandle, apos, bounce, span, n) || n != span)
+                {
+                    result = false;
+                    break;
+                }
+                pos += size;
+                buffer += size;
+                count -= size;
+            }
+
+            m_pool->release(bounce);
+            return result;
+        }
+
+        bool filedevice_pc_direct_t::readFile(void* nFileHandle, u64 pos, void* buffer, u64 count, u64& outNumBytesRead)
+        {
+            u64 const align = m_pool->alignment();
+            u8*       dst   = (u8*)buffer;
+
+            // Memory and position do not share the same alignment, nothing can go direct
+            if ((((u64)dst ^ pos) & (align - 1)) != 0)
+                return readBounced(nFileHandle, pos, dst, count, outNumBytesRead);
+
+            u64 head = (align - (pos & (align - 1))) & (align - 1);
+            if (head > count)
+                head = count;
+            u64 const body = (count - head) & ~(align - 1);
+            u64 const tail = count - head - body;
+
+            u64 n           = 0;
+            outNumBytesRead = 0;
+            if (!readBounced(nFileHandle, pos, dst, head, n))
+                return false;
+            outNumBytesRead += n;
+            if (n < head)
+                return true;
 
+            if (!readAligned(nFileHandle, pos + head, dst + head, body, n))
+                return false;
+            outNumBytesRead += n;
+            if (n < body)
                 return true;
+
+            if (!readBounced(nFileHandle, pos + head + body, dst + head + body, tail, n))
+                return false;
+            outNumBytesRead += n;
+            return true;
+        }
+
+        // Writing whole sectors can extend the file beyond the end of the written range,
+        // the length is set back to the end of the write (or the old length when that
+        // is further).
+        bool filedevice_pc_direct_t::writeFile(void* nFileHandle, u64 pos, const void* buffer, u64 count, u64& outNumBytesWritten)
+        {
+            outNumBytesWritten = 0;
+            if (!m_canWrite)
+                return false;
+
+            u64 const align = m_pool->alignment();
+            u8 const* src   = (u8 const*)buffer;
+
+            u64 length = 0;
+            getLengthOfFile(nFileHandle, length);
+
+            bool result;
+            if ((((u64)src ^ pos) & (align - 1)) != 0)
+            {
+                result = writeBounced(nFileHandle, pos, src, count);
             }
-            return false;
+            else
+            {
+                u64 head = (align - (pos & (align - 1))) & (align - 1);
+                if (head > count)
+                    head = count;
+                u64 const body = (count - head) & ~(align - 1);
+                u64 const tail = count - head - body;
+
+                result = writeBounced(nFileHandle, pos, src, head);
+                result = result && writeAligned(nFileHandle, pos + head, src + head, body);
+                result = result && writeBounced(nFileHandle, pos + head + body, src + head + body, tail);
+            }
+            if (!result)
+                return false;
+
+            u64 const end  = pos + count;
+            u64 const aend = (end + (align - 1)) & ~(align - 1);
+            if (aend != end && aend > length)
+            {
+                FILE_END_OF_FILE_INFO eof;
+                eof.EndOfFile.QuadPart = (LONGLONG)(end > length ? end : length);
+                if (!::SetFileInformationByHandle((HANDLE)nFileHandle, FileEndOfFileInfo, &eof, sizeof(eof)))
+                    return false;
+            }
+
+            outNumBytesWritten = count;
+            return true;
         }
 
         bool filedevice_pc_t::moveFile(const filepath_t& szFilename, const filepath_t& szToFilename, bool boOverwrite)
@@ -279,12 +582,12 @@ namespace ncore
 
             alloc_t* allocator = szFilename.m_dirpath.m_device->m_root->m_allocator;
 
-            s32 const    filenamestrlen = szFilename.to_strlen();
+            s32 const    filenamestrlen = sPathLen16(szFilename);
             utf16::prune filenamestr    = (utf16::prune)allocator->allocate(filenamestrlen * sizeof(utf16::rune));
             runes_t      filename16(filenamestr, filenamestr + filenamestrlen);
             szFilename.to_string(filename16);
 
-            s32 const    tofilenamestrlen = szToFilename.to_strlen();
+            s32 const    tofilenamestrlen = sPathLen16(szToFilename);
             utf16::prune tofilenamestr    = (utf16::prune)allocator->allocate(tofilenamestrlen * sizeof(utf16::rune));
             runes_t      tofilename16(tofilenamestr, tofilenamestr + tofilenamestrlen);
             szToFilename.to_string(tofilename16);
@@ -305,12 +608,12 @@ namespace ncore
 
             const bool failIfExists = boOverwrite == false;
 
-            s32 const    filenamestrlen = szFilename.to_strlen();
+            s32 const    filenamestrlen = sPathLen16(szFilename);
             utf16::prune filenamestr    = (utf16::prune)allocator->allocate(filenamestrlen * sizeof(utf16::rune));
             runes_t      filename16(filenamestr, filenamestr + filenamestrlen);
             szFilename.to_string(filename16);
 
-            s32 const    tofilenamestrlen = szToFilename.to_strlen();
+            s32 const    tofilenamestrlen = sPathLen16(szToFilename);
             utf16::prune tofilenamestr    = (utf16::prune)allocator->allocate(tofilenamestrlen * sizeof(utf16::rune));
             runes_t      tofilename16(tofilenamestr, tofilenamestr + tofilenamestrlen);
             szToFilename.to_string(tofilename16);
@@ -322,7 +625,7 @@ namespace ncore
             return result == TRUE;
         }
 
-        bool filedevice_pc_t::flushFile(void* nFileHandle) { return true; }
+        bool filedevice_pc_t::flushFile(void* nFileHandle) { return ::FlushFileBuffers((HANDLE)nFileHandle) == TRUE; }
 
         bool filedevice_pc_t::closeFile(void* nFileHandle)
         {
@@ -331,6 +634,162 @@ namespace ncore
             return true;
         }
 
+        // Open a file for reading it from start to end, no seek or hasFile probes are
+        // needed, the size comes from the same handle.
+        HANDLE filedevice_pc_t::openForLoad(filepath_t const& szFilename, u64& outSize)
+        {
+            alloc_t* allocator = szFilename.m_dirpath.m_device->m_root->m_allocator;
+
+            s32 const    filenamestrlen = sPathLen16(szFilename);
+            utf16::prune filenamestr    = (utf16::prune)allocator->allocate(filenamestrlen * sizeof(utf16::rune));
+            runes_t      filename16(filenamestr, filenamestr + filenamestrlen);
+            szFilename.to_string(filename16);
+
+            HANDLE handle = ::CreateFileW(LPCWSTR(filename16.str16()), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+            allocator->deallocate(filenamestr);
+
+            LARGE_INTEGER size;
+            if (handle != INVALID_HANDLE_VALUE && !::GetFileSizeEx(handle, &size))
+            {
+                ::CloseHandle(handle);
+                handle = INVALID_HANDLE_VALUE;
+            }
+            outSize = handle != INVALID_HANDLE_VALUE ? (u64)size.QuadPart : 0;
+            return handle;
+        }
+
+        // ReadFile transfers at most 4 GB per call
+        bool filedevice_pc_t::readWhole(HANDLE handle, u8* buffer, u64 size)
+        {
+            while (size > 0)
+            {
+                DWORD const chunk = size > 0x40000000 ? 0x40000000 : (DWORD)size;
+                DWORD       numBytesRead;
+                if (!::ReadFile(handle, buffer, chunk, &numBytesRead, nullptr) || numBytesRead != chunk)
+                    return false;
+                buffer += numBytesRead;
+                size -= numBytesRead;
+            }
+            return true;
+        }
+
+        // The view keeps the file and the mapping object alive
+        void* filedevice_pc_t::mapWhole(HANDLE handle)
+        {
+            void*        view    = nullptr;
+            HANDLE const mapping = ::CreateFileMappingW(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (mapping != nullptr)
+            {
+                view = ::MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+                ::CloseHandle(mapping);
+            }
+            return view;
+        }
+
+        bool filedevice_pc_t::loadFile(filepath_t const& szFilename, alloc_t* allocator, u64 mapThreshold, u8 const*& outData, u64& outSize, void*& outMapping)
+        {
+            outData    = nullptr;
+            outSize    = 0;
+            outMapping = nullptr;
+
+            u64          size   = 0;
+            HANDLE const handle = openForLoad(szFilename, size);
+            if (handle == INVALID_HANDLE_VALUE)
+                return false;
+
+            // The allocator takes a u32 size, larger files are always mapped
+            bool result = true;
+            if ((mapThreshold > 0 && size >= mapThreshold) || size > 0xFFFFFFFF)
+            {
+                outMapping = mapWhole(handle);
+                outData    = (u8 const*)outMapping;
+                outSize    = size;
+                result     = outMapping != nullptr;
+            }
+            else if (size > 0)
+            {
+                u8* data = (u8*)allocator->allocate((u32)size, ESettings::MEM_ALIGNMENT);
+                result   = data != nullptr && readWhole(handle, data, size);
+                if (result)
+                {
+                    outData = data;
+                    outSize = size;
+                }
+                else if (data != nullptr)
+                {
+                    allocator->deallocate(data);
+                }
+            }
+            ::CloseHandle(handle);
+            return result;
+        }
+
+        bool filedevice_pc_t::loadFile(filepath_t const& szFilename, u8* buffer, u64 capacity, u64& outSize)
+        {
+            outSize = 0;
+
+            u64          size   = 0;
+            HANDLE const handle = openForLoad(szFilename, size);
+            if (handle == INVALID_HANDLE_VALUE)
+                return false;
+
+            bool const result = size <= capacity && readWhole(handle, buffer, size);
+            if (result)
+                outSize = size;
+            ::CloseHandle(handle);
+            return result;
+        }
+
+        bool filedevice_pc_t::unmapFile(void* mapping) { return ::UnmapViewOfFile(mapping) != 0; }
+
+        // A view starts on a multiple of the allocation granularity, the mapping object
+        // is closed right away since the view keeps it alive. Views of a file share the
+        // pages of the cache so they see the writes made through the handles.
+        static u8* sMapView(HANDLE handle, u64 pos, u64 count, bool writable, void*& outMapping)
+        {
+            outMapping = nullptr;
+            if (count == 0)
+                return nullptr;
+
+            SYSTEM_INFO info;
+            ::GetSystemInfo(&info);
+            u64 const granularity = info.dwAllocationGranularity;
+            u64 const base        = pos & ~(granularity - 1);
+            u64 const size        = (pos - base) + count;
+
+            HANDLE mapping = ::CreateFileMappingW(handle, nullptr, writable ? PAGE_READWRITE : PAGE_READONLY, 0, 0, nullptr);
+            if (mapping == nullptr)
+                return nullptr;
+            void* view = ::MapViewOfFile(mapping, writable ? FILE_MAP_WRITE : FILE_MAP_READ, nmem::hiu32(base), nmem::lou32(base), (SIZE_T)size);
+            ::CloseHandle(mapping);
+            if (view == nullptr)
+                return nullptr;
+
+            outMapping = view;
+            return (u8*)view + (pos - base);
+        }
+
+        bool filedevice_pc_t::mapFile(void* pHandle, u64 pos, u64 count, u8 const*& outData, void*& outMapping)
+        {
+            outData = sMapView((HANDLE)pHandle, pos, count, false, outMapping);
+            return outData != nullptr;
+        }
+
+        bool filedevice_pc_t::mapFileWritable(void* pHandle, u64 pos, u64 count, u8*& outData, void*& outMapping)
+        {
+            outData = sMapView((HANDLE)pHandle, pos, count, true, outMapping);
+            return outData != nullptr;
+        }
+
+        // FlushViewOfFile starts the write-back of the pages without waiting for the
+        // disk, the metadata and the disk cache are flushed through the handle.
+        bool filedevice_pc_t::flushMapping(void* pHandle, void const* address, u64 count, bool boWait)
+        {
+            if (count > 0 && !::FlushViewOfFile(address, (SIZE_T)count))
+                return false;
+            return !boWait || ::FlushFileBuffers((HANDLE)pHandle) == TRUE;
+        }
+
         //@todo: implement create and close stream
         bool filedevice_pc_t::createStream(filepath_t const& szFilename, bool boRead, bool boWrite, stream_t& strm) { return false; }
         bool filedevice_pc_t::closeStream(stream_t& strm) { return false; }
@@ -339,7 +798,7 @@ namespace ncore
         {
             alloc_t* allocator = szFilename.m_dirpath.m_device->m_root->m_allocator;
 
-            s32 const    filenamestrlen = szFilename.to_strlen();
+            s32 const    filenamestrlen = sPathLen16(szFilename);
             utf16::prune filenamestr    = (utf16::prune)allocator->allocate(filenamestrlen * sizeof(utf16::rune));
             runes_t      filename16(filenamestr, filenamestr + filenamestrlen);
             szFilename.to_string(filename16);
@@ -443,7 +902,7 @@ namespace ncore
 
             alloc_t* allocator = szFilename.m_dirpath.m_device->m_root->m_allocator;
 
-            s32 const    filenamestrlen = szFilename.to_strlen();
+            s32 const    filenamestrlen = sPathLen16(szFilename);
             utf16::prune filenamestr    = (utf16::prune)allocator->allocate(filenamestrlen * sizeof(utf16::rune));
             runes_t      filename16(filenamestr, filenamestr + filenamestrlen);
             szFilename.to_string(filename16);
@@ -460,7 +919,7 @@ namespace ncore
 
             alloc_t* allocator = szFilename.m_dirpath.m_device->m_root->m_allocator;
 
-            s32 const    filenamestrlen = szFilename.to_strlen();
+            s32 const    filenamestrlen = sPathLen16(szFilename);
             utf16::prune filenamestr    = (utf16::prune)allocator->allocate(filenamestrlen * sizeof(utf16::rune));
             runes_t      filename16(filenamestr, filenamestr + filenamestrlen);
             szFilename.to_string(filename16);
@@ -480,6 +939,92 @@ namespace ncore
             return result;
         }
 
+        // A directory with the name of the file is not the file
+        bool filedevice_pc_t::findFile(filepath_t const& szFilename, bool& outFound)
+        {
+            outFound = false;
+
+            alloc_t* allocator = szFilename.m_dirpath.m_device->m_root->m_allocator;
+
+            s32 const    filenamestrlen = sPathLen16(szFilename);
+            utf16::prune filenamestr    = (utf16::prune)allocator->allocate(filenamestrlen * sizeof(utf16::rune));
+            runes_t      filename16(filenamestr, filenamestr + filenamestrlen);
+            szFilename.to_string(filename16);
+
+            DWORD const dwFileAttributes = ::GetFileAttributesW(LPCWSTR(filename16.str16()));
+            DWORD const dwError          = dwFileAttributes == INVALID_FILE_ATTRIBUTES ? ::GetLastError() : ERROR_SUCCESS;
+            allocator->deallocate(filenamestr);
+            if (dwFileAttributes != INVALID_FILE_ATTRIBUTES)
+            {
+                outFound = (dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0;
+                return true;
+            }
+            return dwError == ERROR_FILE_NOT_FOUND || dwError == ERROR_PATH_NOT_FOUND;
+        }
+
+        // Everything comes from the directory entry, the file is not opened
+        bool filedevice_pc_t::statFile(filepath_t const& szFilename, u64& outSize, fileattrs_t* outAttr, filetimes_t* outTimes)
+        {
+            outSize = 0;
+
+            alloc_t* allocator = szFilename.m_dirpath.m_device->m_root->m_allocator;
+
+            s32 const    filenamestrlen = sPathLen16(szFilename);
+            utf16::prune filenamestr    = (utf16::prune)allocator->allocate(filenamestrlen * sizeof(utf16::rune));
+            runes_t      filename16(filenamestr, filenamestr + filenamestrlen);
+            szFilename.to_string(filename16);
+
+            WIN32_FILE_ATTRIBUTE_DATA data;
+            bool const                result = ::GetFileAttributesExW(LPCWSTR(filename16.str16()), GetFileExInfoStandard, &data) == TRUE;
+            allocator->deallocate(filenamestr);
+            if (!result || (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0)
+                return false;
+
+            outSize = nmem::makeu64(data.nFileSizeLow, data.nFileSizeHigh);
+            if (outAttr != nullptr)
+            {
+                outAttr->setArchive(data.dwFileAttributes & FILE_ATTRIBUTE_ARCHIVE);
+                outAttr->setReadOnly(data.dwFileAttributes & FILE_ATTRIBUTE_READONLY);
+                outAttr->setHidden(data.dwFileAttributes & FILE_ATTRIBUTE_HIDDEN);
+                outAttr->setSystem(data.dwFileAttributes & FILE_ATTRIBUTE_SYSTEM);
+            }
+            if (outTimes != nullptr)
+            {
+                outTimes->setCreationTime(datetime_t::sFromFileTime((u64)nmem::makeu64(data.ftCreationTime.dwLowDateTime, data.ftCreationTime.dwHighDateTime)));
+                outTimes->setLastAccessTime(datetime_t::sFromFileTime((u64)nmem::makeu64(data.ftLastAccessTime.dwLowDateTime, data.ftLastAccessTime.dwHighDateTime)));
+                outTimes->setLastWriteTime(datetime_t::sFromFileTime((u64)nmem::makeu64(data.ftLastWriteTime.dwLowDateTime, data.ftLastWriteTime.dwHighDateTime)));
+            }
+            return true;
+        }
+
+        // The file index is unique on its volume, it is mixed with the serial number of
+        // the volume. Opening for attributes only does not conflict with any sharing.
+        bool filedevice_pc_t::identifyFile(filepath_t const& szFilename, u64& outId, u64& outModified, u64& outSize)
+        {
+            alloc_t* allocator = szFilename.m_dirpath.m_device->m_root->m_allocator;
+
+            s32 const    filenamestrlen = sPathLen16(szFilename);
+            utf16::prune filenamestr    = (utf16::prune)allocator->allocate(filenamestrlen * sizeof(utf16::rune));
+            runes_t      filename16(filenamestr, filenamestr + filenamestrlen);
+            szFilename.to_string(filename16);
+
+            HANDLE handle = ::CreateFileW(LPCWSTR(filename16.str16()), FILE_READ_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+            allocator->deallocate(filenamestr);
+            if (handle == INVALID_HANDLE_VALUE)
+                return false;
+
+            BY_HANDLE_FILE_INFORMATION info;
+            bool const                 result = ::GetFileInformationByHandle(handle, &info) == TRUE;
+            ::CloseHandle(handle);
+            if (!result)
+                return false;
+
+            outId       = nmem::makeu64(info.nFileIndexLow, info.nFileIndexHigh) ^ ((u64)info.dwVolumeSerialNumber * 0x9E3779B97F4A7C15ull);
+            outModified = nmem::makeu64(info.ftLastWriteTime.dwLowDateTime, info.ftLastWriteTime.dwHighDateTime);
+            outSize     = nmem::makeu64(info.nFileSizeLow, info.nFileSizeHigh);
+            return true;
+        }
+
         bool filedevice_pc_t::setFileTime(void* nFileHandle, const filetimes_t& ftimes)
         {
             datetime_t creationTime;
@@ -532,7 +1077,7 @@ namespace ncore
 
             alloc_t* allocator = szDirPath.m_device->m_root->m_allocator;
 
-            s32 const    pathstrlen = szDirPath.to_strlen();
+            s32 const    pathstrlen = sPathLen16(szDirPath);
             utf16::prune pathstr    = (utf16::prune)allocator->allocate(pathstrlen * sizeof(utf16::rune));
             runes_t      path16(pathstr, pathstr + pathstrlen);
             szDirPath.to_string(path16);
@@ -559,7 +1104,7 @@ namespace ncore
         {
             alloc_t* allocator = szDirPath.m_device->m_root->m_allocator;
 
-            s32 const    pathstrlen = szDirPath.to_strlen();
+            s32 const    pathstrlen = sPathLen16(szDirPath);
             utf16::prune pathstr    = (utf16::prune)allocator->allocate(pathstrlen * sizeof(utf16::rune));
             runes_t      path16(pathstr, pathstr + pathstrlen);
             szDirPath.to_string(path16);
@@ -576,12 +1121,12 @@ namespace ncore
 
             alloc_t* allocator = szDirPath.m_device->m_root->m_allocator;
 
-            s32 const    pathstrlen = szDirPath.to_strlen();
+            s32 const    pathstrlen = sPathLen16(szDirPath);
             utf16::prune pathstr    = (utf16::prune)allocator->allocate(pathstrlen * sizeof(utf16::rune));
             runes_t      path16(pathstr, pathstr + pathstrlen);
             szDirPath.to_string(path16);
 
-            s32 const    topathstrlen = szDirPath.to_strlen();
+            s32 const    topathstrlen = sPathLen16(szDirPath);
             utf16::prune topathstr    = (utf16::prune)allocator->allocate(topathstrlen * sizeof(utf16::rune));
             runes_t      topath16(topathstr, topathstr + topathstrlen);
             szToDirPath.to_string(topath16);
@@ -803,35 +1348,484 @@ namespace ncore
             return true;
         }
 
-        struct enumerate_delegate_delete_dir : public enumerate_delegate_t
+        // A UTF-16 path buffer that is reused for a sequence of paths, it only grows
+        struct pathbuffer16_t
         {
-            filesys_t* m_root;
-            alloc_t*   m_alloc;
+            pathbuffer16_t(alloc_t* allocator) : m_alloc(allocator), m_str(nullptr), m_cap(0) {}
+            ~pathbuffer16_t()
+            {
+                if (m_str != nullptr)
+                    m_alloc->deallocate(m_str);
+            }
 
-            virtual bool operator()(s32 depth, const filepath_t& fp, const fileattrs_t& fa, const filetimes_t& ft)
+            LPCWSTR convert(filepath_t const& fp)
             {
-                s32 const    len = fp.to_strlen() + 1;
-                utf16::prune str = (utf16::prune)m_alloc->allocate(sizeof(utf16::rune) * len);
-                runes_t      runes16(str, str + len);
+                s32 const len = sPathLen16(fp);
+                if (len > m_cap)
+                {
+                    if (m_str != nullptr)
+                        m_alloc->deallocate(m_str);
+                    m_cap = len < 260 ? 260 : len * 2;
+                    m_str = (utf16::prune)m_alloc->allocate(sizeof(utf16::rune) * m_cap);
+                }
+                runes_t runes16(m_str, m_str + m_cap);
+                fp.to_string(runes16);
+                return (LPCWSTR)runes16.str16();
+            }
 
-                DWORD dwFileAttributes = ::GetFileAttributesW((LPCWSTR)runes16.m_utf16.m_str);
-                if (dwFileAttributes & FILE_ATTRIBUTE_READONLY) // change read-only file mode
-                    ::SetFileAttributesW((LPCWSTR)runes16.m_utf16.m_str, dwFileAttributes & ~FILE_ATTRIBUTE_READONLY);
-                ::DeleteFileW((LPCWSTR)runes16.m_utf16.m_str);
+            alloc_t*     m_alloc;
+            utf16::prune m_str;
+            s32          m_cap;
+        };
 
-                m_alloc->deallocate(str);
+        static inline bool sDeleteFile(LPCWSTR path)
+        {
+            if (::DeleteFileW(path))
+                return true;
+            DWORD const dwFileAttributes = ::GetFileAttributesW(path);
+            if (dwFileAttributes == INVALID_FILE_ATTRIBUTES || (dwFileAttributes & FILE_ATTRIBUTE_READONLY) == 0)
+                return false;
+            ::SetFileAttributesW(path, dwFileAttributes & ~FILE_ATTRIBUTE_READONLY); // change read-only file mode
+            return ::DeleteFileW(path) == TRUE;
+        }
+
+        struct enumerate_delegate_delete_dir : public enumerate_delegate_t
+        {
+            enumerate_delegate_delete_dir(alloc_t* allocator) : m_path(allocator), m_dirs(allocator) {}
+
+            pathbuffer16_t m_path;
+            dirstack_t     m_dirs;
+
+            virtual bool operator()(s32 depth, const filepath_t& fp, const fileattrs_t& fa, const filetimes_t& ft)
+            {
+                sDeleteFile(m_path.convert(fp));
                 return true;
             }
 
-            virtual bool operator()(s32 depth, const dirpath_t& dp) { return true; }
+            virtual bool operator()(s32 depth, const dirpath_t& dp)
+            {
+                m_dirs.push(dp);
+                return true;
+            }
         };
 
+        // Files are deleted during the walk, the directories are removed bottom-up after it
         bool filedevice_pc_t::deleteDir(const dirpath_t& szDirPath)
         {
-            enumerate_delegate_delete_dir enumerator;
-            enumerator.m_root  = szDirPath.m_device->m_root;
-            enumerator.m_alloc = enumerator.m_root->m_allocator;
-            return enumerate(szDirPath, enumerator);
+            enumerate_delegate_delete_dir enumerator(szDirPath.m_device->m_root->m_allocator);
+            if (!enumerate(szDirPath, enumerator))
+                return false;
+
+            bool      result = true;
+            dirpath_t dir;
+            while (enumerator.m_dirs.pop(dir))
+                result = removeDir(dir) && result;
+            return result;
+        }
+
+        s32 filedevice_pc_t::deleteFiles(filepath_t const* szFilenames, s32 count)
+        {
+            if (!canWrite() || count <= 0)
+                return 0;
+
+            pathbuffer16_t path(szFilenames[0].m_dirpath.m_device->m_root->m_allocator);
+            s32            deleted = 0;
+            for (s32 i = 0; i < count; ++i)
+            {
+                if (sDeleteFile(path.convert(szFilenames[i])))
+                    deleted += 1;
+            }
+            return deleted;
+        }
+
+        bool filedevice_pc_t::removeDir(const dirpath_t& szDirPath)
+        {
+            if (!canWrite())
+                return false;
+
+            alloc_t* allocator = szDirPath.m_device->m_root->m_allocator;
+
+            s32 const    pathstrlen = sPathLen16(szDirPath);
+            utf16::prune pathstr    = (utf16::prune)allocator->allocate(pathstrlen * sizeof(utf16::rune));
+            runes_t      path16(pathstr, pathstr + pathstrlen);
+            szDirPath.to_string(path16);
+
+            BOOL result = ::RemoveDirectoryW(LPCWSTR(path16.str16()));
+            if (!result)
+            {
+                DWORD const dwFileAttributes = ::GetFileAttributesW(LPCWSTR(path16.str16()));
+                if (dwFileAttributes != INVALID_FILE_ATTRIBUTES && (dwFileAttributes & FILE_ATTRIBUTE_READONLY) != 0)
+                {
+                    ::SetFileAttributesW(LPCWSTR(path16.str16()), dwFileAttributes & ~FILE_ATTRIBUTE_READONLY);
+                    result = ::RemoveDirectoryW(LPCWSTR(path16.str16()));
+                }
+            }
+
+            allocator->deallocate(pathstr);
+            return result == TRUE;
+        }
+
+        // Block cloning is a feature of the volume (ReFS), the volume root of the path
+        // tells whether it is supported.
+        bool filedevice_pc_t::canClone(const dirpath_t& szDirPath)
+        {
+            if (!canWrite())
+                return false;
+
+            alloc_t* allocator = szDirPath.m_device->m_root->m_allocator;
+
+            s32 const    pathstrlen = sPathLen16(szDirPath);
+            utf16::prune pathstr    = (utf16::prune)allocator->allocate(pathstrlen * sizeof(utf16::rune));
+            runes_t      path16(pathstr, pathstr + pathstrlen);
+            szDirPath.to_string(path16);
+
+            WCHAR volume[MAX_PATH + 1];
+            DWORD flags  = 0;
+            bool  result = ::GetVolumePathNameW(LPCWSTR(path16.str16()), volume, MAX_PATH + 1) == TRUE;
+            result       = result && ::GetVolumeInformationW(volume, nullptr, 0, nullptr, nullptr, &flags, nullptr, 0) == TRUE;
+
+            allocator->deallocate(pathstr);
+            return result && (flags & FILE_SUPPORTS_BLOCK_REFCOUNTING) != 0;
+        }
+
+        // FSCTL_DUPLICATE_EXTENTS_TO_FILE works on whole clusters, the count is rounded
+        // up to the cluster size which is fine at the end of the file since the
+        // destination has the same length as the source.
+        bool filedevice_pc_t::cloneFileRange(void* pSrcHandle, u64 srcPos, void* pDstHandle, u64 dstPos, u64 count)
+        {
+            FSCTL_GET_INTEGRITY_INFORMATION_BUFFER integrity;
+            DWORD                                  bytes = 0;
+            if (!::DeviceIoControl((HANDLE)pSrcHandle, FSCTL_GET_INTEGRITY_INFORMATION, nullptr, 0, &integrity, sizeof(integrity), &bytes, nullptr))
+                return false;
+
+            u64 const cluster = integrity.ClusterSizeInBytes;
+            if (cluster == 0 || (srcPos % cluster) != 0 || (dstPos % cluster) != 0)
+                return false;
+
+            u64 const max_chunk = (u64)0x40000000; // 1 GB per call, a multiple of any cluster size
+            count               = (count + cluster - 1) & ~(cluster - 1);
+            while (count > 0)
+            {
+                u64 const chunk = count < max_chunk ? count : max_chunk;
+
+                DUPLICATE_EXTENTS_DATA data;
+                data.FileHandle                = (HANDLE)pSrcHandle;
+                data.SourceFileOffset.QuadPart = (LONGLONG)srcPos;
+                data.TargetFileOffset.QuadPart = (LONGLONG)dstPos;
+                data.ByteCount.QuadPart        = (LONGLONG)chunk;
+                if (!::DeviceIoControl((HANDLE)pDstHandle, FSCTL_DUPLICATE_EXTENTS_TO_FILE, &data, sizeof(data), nullptr, 0, &bytes, nullptr))
+                    return false;
+
+                srcPos += chunk;
+                dstPos += chunk;
+                count -= chunk;
+            }
+            return true;
+        }
+
+        bool filedevice_pc_t::isSparseFile(void* pHandle)
+        {
+            FILE_BASIC_INFO info;
+            if (!::GetFileInformationByHandleEx((HANDLE)pHandle, FileBasicInfo, &info, sizeof(info)))
+                return false;
+            return (info.FileAttributes & FILE_ATTRIBUTE_SPARSE_FILE) != 0;
+        }
+
+        bool filedevice_pc_t::setSparseFile(void* pHandle)
+        {
+            FILE_SET_SPARSE_BUFFER sparse;
+            sparse.SetSparse = TRUE;
+            DWORD bytes      = 0;
+            return ::DeviceIoControl((HANDLE)pHandle, FSCTL_SET_SPARSE, &sparse, sizeof(sparse), nullptr, 0, &bytes, nullptr) == TRUE;
+        }
+
+        // Only sparse files have holes, for any other file everything up to the end is data
+        bool filedevice_pc_t::nextDataExtent(void* pHandle, u64 pos, u64& outDataPos, u64& outDataEnd)
+        {
+            u64 length = 0;
+            if (!getLengthOfFile(pHandle, length) || pos >= length)
+                return false;
+            if (!isSparseFile(pHandle))
+                return filedevice_t::nextDataExtent(pHandle, pos, outDataPos, outDataEnd);
+
+            FILE_ALLOCATED_RANGE_BUFFER query;
+            query.FileOffset.QuadPart = (LONGLONG)pos;
+            query.Length.QuadPart     = (LONGLONG)(length - pos);
+
+            // Only the first range is needed, ERROR_MORE_DATA means there are more
+            FILE_ALLOCATED_RANGE_BUFFER range;
+            DWORD                       bytes = 0;
+            if (!::DeviceIoControl((HANDLE)pHandle, FSCTL_QUERY_ALLOCATED_RANGES, &query, sizeof(query), &range, sizeof(range), &bytes, nullptr) && ::GetLastError() != ERROR_MORE_DATA)
+                return false;
+            if (bytes < sizeof(range))
+                return false;
+
+            u64 const begin = (u64)range.FileOffset.QuadPart;
+            u64 const end   = begin + (u64)range.Length.QuadPart;
+            outDataPos      = begin < pos ? pos : begin;
+            outDataEnd      = end > length ? length : end;
+            return outDataPos < outDataEnd;
+        }
+
+        bool filedevice_pc_t::punchHole(void* pHandle, u64 pos, u64 count)
+        {
+            if (!isSparseFile(pHandle) && !setSparseFile(pHandle))
+                return false;
+
+            FILE_ZERO_DATA_INFORMATION zero;
+            zero.FileOffset.QuadPart      = (LONGLONG)pos;
+            zero.BeyondFinalZero.QuadPart = (LONGLONG)(pos + count);
+            DWORD bytes                   = 0;
+            return ::DeviceIoControl((HANDLE)pHandle, FSCTL_SET_ZERO_DATA, &zero, sizeof(zero), nullptr, 0, &bytes, nullptr) == TRUE;
+        }
+
+        // The allocation is reserved without writing to it, the end of the file is only
+        // moved when the range goes beyond it.
+        bool filedevice_pc_t::preallocate(void* pHandle, u64 pos, u64 count)
+        {
+            FILE_STANDARD_INFO standard;
+            if (!::GetFileInformationByHandleEx((HANDLE)pHandle, FileStandardInfo, &standard, sizeof(standard)))
+                return false;
+
+            u64 const end = pos + count;
+            if (end > (u64)standard.AllocationSize.QuadPart)
+            {
+                FILE_ALLOCATION_INFO allocation;
+                allocation.AllocationSize.QuadPart = (LONGLONG)end;
+                if (!::SetFileInformationByHandle((HANDLE)pHandle, FileAllocationInfo, &allocation, sizeof(allocation)))
+                    return false;
+            }
+            if (end > (u64)standard.EndOfFile.QuadPart)
+            {
+                FILE_END_OF_FILE_INFO eof;
+                eof.EndOfFile.QuadPart = (LONGLONG)end;
+                if (!::SetFileInformationByHandle((HANDLE)pHandle, FileEndOfFileInfo, &eof, sizeof(eof)))
+                    return false;
+            }
+            return true;
+        }
+
+        // The file system releases an allocation beyond the end of the file when the
+        // last handle is closed, setLengthOfFile releases it right away.
+        bool filedevice_pc_t::reserveFile(void* pHandle, u64 size)
+        {
+            // A smaller allocation than the end of the file would truncate it
+            FILE_STANDARD_INFO standard;
+            if (!::GetFileInformationByHandleEx((HANDLE)pHandle, FileStandardInfo, &standard, sizeof(standard)))
+                return false;
+            if (size <= (u64)standard.AllocationSize.QuadPart || size <= (u64)standard.EndOfFile.QuadPart)
+                return true;
+
+            FILE_ALLOCATION_INFO allocation;
+            allocation.AllocationSize.QuadPart = (LONGLONG)size;
+            return ::SetFileInformationByHandle((HANDLE)pHandle, FileAllocationInfo, &allocation, sizeof(allocation)) == TRUE;
+        }
+
+        // The cache manager has no per range hints, a WILLNEED range is mapped and
+        // prefetched which reads it into the cache asynchronously (the mapping and the
+        // cache share the same pages). The other hints are not supported, the lazy
+        // writer and the cache manager manage the pages of the file on their own.
+        bool filedevice_pc_t::adviseFile(void* pHandle, u64 pos, u64 count, s32 advice)
+        {
+            if (advice != EFileAdvice::WILLNEED)
+                return false;
+
+            u64 length = 0;
+            if (!getLengthOfFile(pHandle, length) || pos >= length)
+                return true;
+            if (count == 0 || (pos + count) > length)
+                count = length - pos;
+
+            SYSTEM_INFO info;
+            ::GetSystemInfo(&info);
+            u64 const granularity = info.dwAllocationGranularity;
+            u64 const base        = pos & ~(granularity - 1);
+            u64 const size        = (pos - base) + count;
+
+            HANDLE mapping = ::CreateFileMappingW((HANDLE)pHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (mapping == nullptr)
+                return false;
+
+            bool  result = false;
+            void* view   = ::MapViewOfFile(mapping, FILE_MAP_READ, nmem::hiu32(base), nmem::lou32(base), (SIZE_T)size);
+            if (view != nullptr)
+            {
+                WIN32_MEMORY_RANGE_ENTRY range;
+                range.VirtualAddress = view;
+                range.NumberOfBytes  = (SIZE_T)size;
+                result               = ::PrefetchVirtualMemory(::GetCurrentProcess(), 1, &range, 0) != 0;
+                ::UnmapViewOfFile(view);
+            }
+            ::CloseHandle(mapping);
+            return result;
+        }
+
+        // A directory opened for writing can be flushed like a file, this flushes the
+        // changes to its entries.
+        bool filedevice_pc_t::flushDir(const dirpath_t& szDirPath)
+        {
+            if (!canWrite())
+                return false;
+
+            alloc_t* allocator = szDirPath.m_device->m_root->m_allocator;
+
+            s32 const    pathstrlen = sPathLen16(szDirPath);
+            utf16::prune pathstr    = (utf16::prune)allocator->allocate(pathstrlen * sizeof(utf16::rune));
+            runes_t      path16(pathstr, pathstr + pathstrlen);
+            szDirPath.to_string(path16);
+
+            bool   result = false;
+            HANDLE handle = ::CreateFileW(LPCWSTR(path16.str16()), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, nullptr);
+            if (handle != INVALID_HANDLE_VALUE)
+            {
+                result = ::FlushFileBuffers(handle) == TRUE;
+                ::CloseHandle(handle);
+            }
+
+            allocator->deallocate(pathstr);
+            return result;
+        }
+
+        // Flushing a volume handle flushes all the files of the volume, opening it needs
+        // administrator rights. Every distinct volume of the files is flushed once.
+        bool filedevice_pc_t::syncVolume(void* const* pHandles, s32 count)
+        {
+            enum
+            {
+                MAX_VOLUMES = 8,
+            };
+            DWORD serials[MAX_VOLUMES];
+            s32   volumes = 0;
+            for (s32 i = 0; i < count; ++i)
+            {
+                BY_HANDLE_FILE_INFORMATION info;
+                if (!::GetFileInformationByHandle((HANDLE)pHandles[i], &info))
+                    return false;
+
+                bool known = false;
+                for (s32 v = 0; v < volumes && !known; ++v)
+                    known = serials[v] == info.dwVolumeSerialNumber;
+                if (known)
+                    continue;
+                if (volumes == MAX_VOLUMES)
+                    return false;
+                serials[volumes++] = info.dwVolumeSerialNumber;
+
+                // \\?\Volume{GUID}\path, the volume is the part up to the closing brace
+                WCHAR path[MAX_PATH + 64];
+                DWORD len = ::GetFinalPathNameByHandleW((HANDLE)pHandles[i], path, MAX_PATH + 64, VOLUME_NAME_GUID);
+                if (len == 0 || len >= (MAX_PATH + 64))
+                    return false;
+                DWORD end = 0;
+                while (end < len && path[end] != L'}')
+                    end += 1;
+                if (end == len)
+                    return false;
+                path[end + 1] = 0;
+
+                HANDLE volume = ::CreateFileW(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, 0, nullptr);
+                if (volume == INVALID_HANDLE_VALUE)
+                    return false;
+                BOOL const flushed = ::FlushFileBuffers(volume);
+                ::CloseHandle(volume);
+                if (!flushed)
+                    return false;
+            }
+            return true;
+        }
+
+        static inline bool sSetDeleteOnClose(HANDLE handle, bool boDelete)
+        {
+            FILE_DISPOSITION_INFO disposition;
+            disposition.DeleteFile = boDelete ? TRUE : FALSE;
+            return ::SetFileInformationByHandle(handle, FileDispositionInfo, &disposition, sizeof(disposition)) == TRUE;
+        }
+
+        // There are no anonymous files, the temporary file gets a unique name next to the
+        // target (".~<name>.<tick><counter>") and is marked for deletion so that it goes
+        // away when it is closed, also when the process dies before it was linked.
+        bool filedevice_pc_t::createTempFile(const filepath_t& szFilename, void*& outHandle)
+        {
+            static s32 volatile sTempCounter = 0;
+
+            outHandle = INVALID_HANDLE_VALUE;
+            if (!canWrite())
+                return false;
+
+            alloc_t*  allocator = szFilename.m_dirpath.m_device->m_root->m_allocator;
+            s32 const pathlen   = sPathLen16(szFilename);
+            s32 const templen   = pathlen + 32;
+
+            utf16::prune pathstr = (utf16::prune)allocator->allocate(pathlen * sizeof(utf16::rune));
+            runes_t      path16(pathstr, pathstr + pathlen);
+            szFilename.to_string(path16);
+
+            WCHAR const* path = LPCWSTR(path16.str16());
+            s32          len  = 0;
+            s32          name = 0;
+            while (path[len] != 0)
+            {
+                if (path[len] == L'\\' || path[len] == L'/')
+                    name = len + 1;
+                len += 1;
+            }
+
+            WCHAR* temp = (WCHAR*)allocator->allocate(templen * sizeof(WCHAR));
+            u32    unique = (u32)::GetTickCount() ^ ((u32)natomic::add(&sTempCounter, 1) << 20);
+            s32    n      = 0;
+            for (s32 i = 0; i < name; ++i)
+                temp[n++] = path[i];
+            temp[n++] = L'.';
+            temp[n++] = L'~';
+            for (s32 i = name; i < len; ++i)
+                temp[n++] = path[i];
+            temp[n++] = L'.';
+            for (s32 i = 7; i >= 0; --i)
+                temp[n++] = L"0123456789abcdef"[(unique >> (i * 4)) & 0xF];
+            temp[n++] = 0;
+
+            HANDLE handle = ::CreateFileW(temp, GENERIC_READ | GENERIC_WRITE | DELETE, FILE_SHARE_READ, nullptr, CREATE_NEW, m_openFlags, nullptr);
+            if (handle != INVALID_HANDLE_VALUE && !sSetDeleteOnClose(handle, true))
+            {
+                ::CloseHandle(handle);
+                ::DeleteFileW(temp);
+                handle = INVALID_HANDLE_VALUE;
+            }
+
+            allocator->deallocate(temp);
+            allocator->deallocate(pathstr);
+            outHandle = handle;
+            return handle != INVALID_HANDLE_VALUE;
+        }
+
+        // The rename goes through the handle of the temporary file, its name is not needed
+        bool filedevice_pc_t::linkTempFile(void* pHandle, const filepath_t& szFilename)
+        {
+            alloc_t*  allocator = szFilename.m_dirpath.m_device->m_root->m_allocator;
+            s32 const pathlen   = sPathLen16(szFilename);
+
+            DWORD const       infosize = (DWORD)(sizeof(FILE_RENAME_INFO) + pathlen * sizeof(WCHAR));
+            FILE_RENAME_INFO* info     = (FILE_RENAME_INFO*)allocator->allocate(infosize);
+            runes_t           path16((utf16::prune)info->FileName, (utf16::prune)info->FileName + pathlen);
+            szFilename.to_string(path16);
+
+            WCHAR const* path = LPCWSTR(path16.str16());
+            DWORD        len  = 0;
+            while (path[len] != 0)
+                len += 1;
+            info->ReplaceIfExists = TRUE;
+            info->RootDirectory   = nullptr;
+            info->FileNameLength  = len * sizeof(WCHAR);
+
+            bool result = sSetDeleteOnClose((HANDLE)pHandle, false);
+            if (result && !::SetFileInformationByHandle((HANDLE)pHandle, FileRenameInfo, info, infosize))
+            {
+                sSetDeleteOnClose((HANDLE)pHandle, true);
+                result = false;
+            }
+
+            allocator->deallocate(info);
+            return result;
         }
 
         bool filedevice_pc_t::setDirTime(const dirpath_t& szDirPath, const filetimes_t& ftimes)
@@ -909,7 +1903,7 @@ namespace ncore
 
             alloc_t* allocator = szDirPath.m_device->m_root->m_allocator;
 
-            s32 const    pathstrlen = szDirPath.to_strlen();
+            s32 const    pathstrlen = sPathLen16(szDirPath);
             utf16::prune pathstr    = (utf16::prune)allocator->allocate(pathstrlen * sizeof(utf16::rune));
             runes_t      dirpath16(pathstr, pathstr + pathstrlen);
             szDirPath.to_string(dirpath16);
@@ -923,7 +1917,7 @@ namespace ncore
         {
             alloc_t* allocator = szDirPath.m_device->m_root->m_allocator;
 
-            s32 const    pathstrlen = szDirPath.to_strlen();
+            s32 const    pathstrlen = sPathLen16(szDirPath);
             utf16::prune pathstr    = (utf16::prune)allocator->allocate(pathstrlen * sizeof(utf16::rune));
             runes_t      dirpath16(pathstr, pathstr + pathstrlen);
             szDirPath.to_string(dirpath16);
@@ -237,6 +237,7 @@ namespace ncore
                     u64 n;
                     if (fd->readFile(fh->m_handle, pos, buffer, count, n))
                     {
+                        note_read(fh, pos, pos + n);
                         pos += n;
                     }
                     return n;
@@ -255,6 +256,8 @@ namespace ncore
                     u64 n;
                     if (fd->writeFile(fh->m_handle, pos, buffer, count, n))
                     {
+                        note_write_end(fh, pos + n);
+                        note_written(fh, pos, pos + n);
                         pos += n;
                     }
                     return n;
@@ -263,15 +266,49 @@ namespace ncore
             return 0;
         }
 
+        static void sStreamCopyRange(stream_t& src, stream_t& dst, buffer_t& buffer, s64 count)
+        {
+            while (count > 0)
+            {
+                s64 const size = count < (s64)buffer.size() ? count : (s64)buffer.size();
+                s64 const r    = src.read(buffer.m_begin, size);
+                if (r <= 0)
+                    return;
+                dst.write(buffer.m_begin, r);
+                count -= r;
+            }
+        }
+
+        // When the source is a sparse file only its data extents are copied, the
+        // destination is made sparse and its length set so the holes are recreated.
         void stream_copy(stream_t& src, stream_t& dst, buffer_t& buffer)
         {
-            s64 streamLength = (s64)src.getLength();
-            while (streamLength > 0)
+            s64 const streamLength = (s64)src.getLength();
+
+            filehandle_t* sfh = filesys_t::get_filehandle(src);
+            filehandle_t* dfh = filesys_t::get_filehandle(dst);
+            if (sfh != nullptr && dfh != nullptr && sfh->m_filedevice->isSparseFile(sfh->m_handle) && dfh->m_filedevice->setSparseFile(dfh->m_handle))
             {
-                u64 const r = src.read(buffer.m_begin, buffer.size());
-                dst.write(buffer.m_begin, buffer.size());
-                streamLength -= r;
+                s64 const srcBase = src.getPos();
+                s64 const dstBase = dst.getPos();
+                u64       at      = (u64)srcBase;
+                u64       dataPos = 0;
+                u64       dataEnd = 0;
+                while (sfh->m_filedevice->nextDataExtent(sfh->m_handle, at, dataPos, dataEnd))
+                {
+                    src.setPos((s64)dataPos);
+                    dst.setPos(dstBase + ((s64)dataPos - srcBase));
+                    sStreamCopyRange(src, dst, buffer, (s64)(dataEnd - dataPos));
+                    at = dataEnd;
+                }
+                if (dst.getLength() < (u64)(dstBase + (streamLength - srcBase)))
+                    dst.setLength((u64)(dstBase + (streamLength - srcBase)));
+                src.setPos(streamLength);
+                dst.setPos(dstBase + (streamLength - srcBase));
+                return;
             }
+
+            sStreamCopyRange(src, dst, buffer, streamLength - src.getPos());
         }
     } // namespace nfs
 }; // namespace ncore
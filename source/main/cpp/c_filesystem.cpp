@@ -22,10 +22,16 @@ namespace ncore
         s64  size(filepath_t const& filepath) { return mImpl->size(filepath); }
         void rename(filepath_t const& filepath, filepath_t const& xfp) { mImpl->rename(filepath, xfp); }
         void move(filepath_t const& src, filepath_t const& dst) { mImpl->move(src, dst); }
-        void copy(filepath_t const& src, filepath_t const& dst) { mImpl->copy(src, dst); }
         void rm(filepath_t const& filepath) { mImpl->rm(filepath); }
         void rm(dirpath_t const& dirpath) { mImpl->rm(dirpath); }
 
+        filedevice_t* create_direct_device(bool can_write) { return gCreateDirectFileDevice(mImpl->m_allocator, &mImpl->m_iobuffers, can_write); }
+        void          destroy_direct_device(filedevice_t* device)
+        {
+            mImpl->release_ioqueue(device);
+            gDestroyDirectFileDevice(mImpl->m_allocator, device);
+        }
+
         // -----------------------------------------------------------
         // -----------------------------------------------------------
         // -----------------------------------------------------------
@@ -34,31 +40,119 @@ namespace ncore
         // -----------------------------------------------------------
         // -----------------------------------------------------------
 
+        void filesys_t::init(alloc_t* allocator)
+        {
+            m_filehandles_free       = nullptr;
+            m_filehandles_active     = nullptr;
+            m_filehandles_free_index = 0;
+            m_filehandles_count      = (s32)m_max_open_files;
+            m_filehandles_array      = (filehandle_t*)allocator->allocate(sizeof(filehandle_t) * m_max_open_files);
+
+            ASSERT(m_max_async <= MAX_IOREQUESTS);
+            if (m_max_async > MAX_IOREQUESTS)
+                m_max_async = MAX_IOREQUESTS;
+
+            m_iorequests_array = (iorequest_t*)allocator->allocate(sizeof(iorequest_t) * m_max_async);
+            for (s32 i = 0; i < (s32)m_max_async; ++i)
+            {
+                iorequest_t* req  = &m_iorequests_array[i];
+                req->m_state      = EIoState::FREE;
+                req->m_salt       = 0;
+                req->m_index      = i;
+                req->m_filehandle = nullptr;
+                req->m_delegate   = nullptr;
+                req->m_next       = nullptr;
+                req->m_next_free  = (i + 1) < (s32)m_max_async ? (i + 2) : 0;
+            }
+            m_iorequests_free = m_max_async > 0 ? 1 : 0;
+
+            for (s32 i = 0; i < MAX_IOQUEUES; ++i)
+                m_ioqueues[i].init(allocator, m_max_async, 128 * 1024, m_max_io_per_device);
+            m_ioqueues[WORK_IOQUEUE].init(allocator, m_max_async, 0, MAX_IOWORKERS + 1);
+            for (s32 i = 0; i < MAX_IOWORKERS; ++i)
+            {
+                m_ioworkers[i].m_thread = nullptr;
+                m_ioworkers[i].m_idle   = 0;
+            }
+            m_ioworkers_count = 0;
+            m_stats_cancelled = 0;
+            m_stats_timedout  = 0;
+
+            m_iobuffers.init(allocator, m_iobuffer_size, m_iobuffer_alignment, m_max_iobuffers);
+            m_commit.init(m_commit_window_us, m_commit_volume_threshold);
+        }
+
+        void filesys_t::exit(alloc_t* allocator)
+        {
+            m_iobuffers.exit();
+
+            for (s32 i = 0; i <= WORK_IOQUEUE; ++i)
+                m_ioqueues[i].exit(allocator);
+
+            allocator->deallocate(m_iorequests_array);
+            m_iorequests_array = nullptr;
+            m_iorequests_free  = 0;
+
+            allocator->deallocate(m_filehandles_array);
+            m_filehandles_array = nullptr;
+            m_filehandles_free  = nullptr;
+        }
+
         void filesys_t::destroy(stream_t& stream) {}
 
         extern istream_t* get_filestream();
 
-        void filesys_t::open(const filepath_t& filename, EFileMode::Enum mode, EFileAccess::Enum access, EFileOp::Enum op, stream_t& out_stream)
+        EFileError::Enum filesys_t::open(const filepath_t& filename, EFileMode::Enum mode, EFileAccess::Enum access, EFileOp::Enum op, stream_t& out_stream)
         {
             filedevice_t* fd = filename.m_dirpath.m_device->m_fileDevice;
 
             void* filehandle;
-            if (fd->openFile(filename, mode, access, op, filehandle))
+            if (!fd->openFile(filename, mode, access, op, filehandle))
             {
-                filehandle_t* fh = obtain_filehandle();
-                fh->m_owner      = this;
-                fh->m_handle     = filehandle;
-                fh->m_filedevice = fd;
-                // fh->m_filename   = m_paths->attach(filename.m_filename);
-                // fh->m_extension  = m_paths->attach(filename.m_extension);
-                // fh->m_device     = m_paths->attach(filename.m_dirpath.m_device);
-                // fh->m_path       = m_paths->attach(filename.m_dirpath.m_path);
-                out_stream       = stream_t(get_filestream(), fh);
+                out_stream = stream_t(get_nullstream(), nullptr);
+                return EFileError::Error_NoFile();
             }
-            else
+            if (!attach(fd, filehandle, access, op, out_stream))
+                return EFileError::Error_MaxFiles();
+            return EFileError::Error_Ok();
+        }
+
+        // A stream for a handle that has been opened by the device, when all file
+        // handles are in use the device handle is closed and the null stream is given.
+        bool filesys_t::attach(filedevice_t* fd, void* filehandle, EFileAccess::Enum access, EFileOp::Enum op, stream_t& out_stream)
+        {
+            filehandle_t* fh = obtain_filehandle();
+            if (fh == nullptr)
             {
+                fd->closeFile(filehandle);
                 out_stream = stream_t(get_nullstream(), nullptr);
+                return false;
             }
+            fh->m_owner      = this;
+            fh->m_refcount   = 1;
+            fh->m_handle     = filehandle;
+            fh->m_filedevice = fd;
+            fh->m_reserve    = EReserve::NONE;
+            fh->m_write_end  = 0;
+            fh->m_streaming  = EStreaming::NONE;
+            fh->m_queued_head = nullptr;
+            fh->m_queued_tail = nullptr;
+            fh->m_running     = 0;
+            // fh->m_filename   = m_paths->attach(filename.m_filename);
+            // fh->m_extension  = m_paths->attach(filename.m_extension);
+            // fh->m_device     = m_paths->attach(filename.m_dirpath.m_device);
+            // fh->m_path       = m_paths->attach(filename.m_dirpath.m_path);
+            out_stream       = stream_t(get_filestream(), fh);
+
+            u32 caps = EStreamCaps::Value_None;
+            if (op.IsAsync())
+                caps |= EStreamCaps::Value_Async;
+            if (!access.IsRead())
+                caps |= EStreamCaps::Value_Write;
+            if (fd->canSeek())
+                caps |= EStreamCaps::Value_Seek;
+            out_stream.m_caps = EStreamCaps::Enum((EStreamCaps::EEnumValue)caps);
+            return true;
         }
 
         void filesys_t::close(stream_t& stream)
@@ -68,10 +162,21 @@ namespace ncore
 
             if (fh->m_refcount == 1)
             {
+                // Give back the storage that was reserved and not written
+                if (fh->m_reserve == EReserve::EXTENDED)
+                {
+                    u64 const end = (u64)fh->m_write_end > fh->m_reserve_base ? (u64)fh->m_write_end : fh->m_reserve_base;
+                    fd->setLengthOfFile(fh->m_handle, end);
+                }
+                else if (fh->m_reserve == EReserve::KEEP_SIZE)
+                {
+                    u64 length = 0;
+                    if (fd->getLengthOfFile(fh->m_handle, length))
+                        fd->setLengthOfFile(fh->m_handle, length);
+                }
+                fh->m_reserve = EReserve::NONE;
                 fd->closeFile(fh->m_handle);
                 fh->m_handle = nullptr;
-
-                m_allocator->deallocate(fh);
             }
             fh->m_refcount -= 1;
 
@@ -86,16 +191,21 @@ namespace ncore
         s64  filesys_t::size(filepath_t const&) { return 0; }
         void filesys_t::rename(filepath_t const&, filepath_t const&) {}
         void filesys_t::move(filepath_t const& src, filepath_t const& dst) {}
-        void filesys_t::copy(filepath_t const& src, filepath_t const& dst) {}
         void filesys_t::rm(filepath_t const&) {}
-        void filesys_t::rm(dirpath_t const&) {}
 
         filehandle_t* filesys_t::obtain_filehandle()
         {
+            m_filehandles_lock.lock();
+
             // obtain from freelist or free index
             filehandle_t* fh = nullptr;
             if (m_filehandles_free == nullptr)
             {
+                if (m_filehandles_free_index == m_filehandles_count)
+                {
+                    m_filehandles_lock.unlock();
+                    return nullptr;
+                }
                 fh = &m_filehandles_array[m_filehandles_free_index++];
             }
             else
@@ -116,11 +226,15 @@ namespace ncore
                 m_filehandles_active->m_prev = fh;
             }
             m_filehandles_active = fh;
+
+            m_filehandles_lock.unlock();
             return fh;
         }
 
         void filesys_t::release_filehandle(filehandle_t* fh)
         {
+            m_filehandles_lock.lock();
+
             // remove from active list
             if (fh->m_prev != nullptr)
             {
@@ -149,6 +263,8 @@ namespace ncore
                 m_filehandles_free->m_prev = fh;
                 m_filehandles_free         = fh;
             }
+
+            m_filehandles_lock.unlock();
         }
     } // namespace nfs
 } // namespace ncore
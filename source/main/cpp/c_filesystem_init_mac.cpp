@@ -76,14 +76,26 @@ namespace ncore
 
     namespace nfs
     {
-        static filesys_t* sImpl = nullptr;
+        extern filesys_t* mImpl;
 
         void create(context_t const& ctxt)
         {
-            filesys_t* imp       = ctxt.m_allocator->construct<filesys_t>();
-            imp->m_default_slash = ctxt.m_default_slash;
-            imp->m_allocator     = ctxt.m_allocator;
-            sImpl = imp;
+            filesys_t* imp                 = ctxt.m_allocator->construct<filesys_t>();
+            imp->m_default_slash           = ctxt.m_default_slash;
+            imp->m_allocator               = ctxt.m_allocator;
+            imp->m_max_open_files          = ctxt.m_max_open_files;
+            imp->m_max_async               = ctxt.m_max_async;
+            imp->m_max_io_per_device       = ctxt.m_max_io_per_device;
+            imp->m_load_map_threshold      = ctxt.m_load_map_threshold;
+            imp->m_iobuffer_size           = ctxt.m_iobuffer_size;
+            imp->m_iobuffer_alignment      = ctxt.m_iobuffer_alignment;
+            imp->m_max_iobuffers           = ctxt.m_max_iobuffers;
+            imp->m_commit_window_us        = ctxt.m_commit_window_us;
+            imp->m_commit_volume_threshold = ctxt.m_commit_volume_threshold;
+            imp->m_max_path_objects        = ctxt.m_max_path_objects;
+            mImpl                          = imp;
+
+            imp->init(ctxt.m_allocator);
 
             //        imp->m_devman = ctxt.m_allocator->construct<devicemanager_t>(imp->m_stralloc);
 
@@ -131,8 +143,9 @@ namespace ncore
         {
             //        mImpl->m_devman->exit();
             //        mImpl->m_allocator->destruct(mImpl->m_devman);
-            sImpl->m_allocator->destruct(sImpl);
-            sImpl = nullptr;
+            mImpl->exit(mImpl->m_allocator);
+            mImpl->m_allocator->destruct(mImpl);
+            mImpl = nullptr;
         }
     } // namespace nfs
 } // namespace ncore
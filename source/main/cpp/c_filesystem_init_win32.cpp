@@ -149,16 +149,25 @@ namespace ncore
 
     namespace nfs
     {
+        extern filesys_t* mImpl;
 
         //------------------------------------------------------------------------------
-        void filesystem_t::create(filesystem_t::context_t const& ctxt)
+        void create(context_t const& ctxt)
         {
-            filesys_t* root          = ctxt.m_allocator->construct<filesys_t>();
-            root->m_allocator        = ctxt.m_allocator;
-            root->m_default_slash    = ctxt.m_default_slash;
-            root->m_max_open_files   = ctxt.m_max_open_files;
-            root->m_max_path_objects = ctxt.m_max_path_objects;
-            filesystem_t::mImpl      = root;
+            filesys_t* root                 = ctxt.m_allocator->construct<filesys_t>();
+            root->m_allocator               = ctxt.m_allocator;
+            root->m_default_slash           = ctxt.m_default_slash;
+            root->m_max_open_files          = ctxt.m_max_open_files;
+            root->m_max_async               = ctxt.m_max_async;
+            root->m_max_io_per_device       = ctxt.m_max_io_per_device;
+            root->m_load_map_threshold      = ctxt.m_load_map_threshold;
+            root->m_iobuffer_size           = ctxt.m_iobuffer_size;
+            root->m_iobuffer_alignment      = ctxt.m_iobuffer_alignment;
+            root->m_max_iobuffers           = ctxt.m_max_iobuffers;
+            root->m_commit_window_us        = ctxt.m_commit_window_us;
+            root->m_commit_volume_threshold = ctxt.m_commit_volume_threshold;
+            root->m_max_path_objects        = ctxt.m_max_path_objects;
+            mImpl                           = root;
 
             root->init(ctxt.m_allocator);
 
@@ -198,11 +207,10 @@ namespace ncore
         //     void
         // Description:
         //------------------------------------------------------------------------------
-        void filesystem_t::destroy()
+        void destroy()
         {
             gFileSystemDestroyFileDevices(mImpl);
             mImpl->exit(mImpl->m_allocator);
-            mImpl->m_allocator->destruct(mImpl->m_stralloc);
             mImpl->m_allocator->destruct(mImpl);
             mImpl = nullptr;
         }
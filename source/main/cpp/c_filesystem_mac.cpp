@@ -1,6 +1,16 @@
 #include "ccore/c_target.h"
 #ifdef TARGET_MAC
 
+#    include <errno.h>
+#    include <fcntl.h>
+#    include <pthread.h>
+#    include <sched.h>
+#    include <signal.h>
+#    include <sys/mman.h>
+#    include <sys/stat.h>
+#    include <time.h>
+#    include <unistd.h>
+
 #    include "ccore/c_debug.h"
 #    include "cbase/c_runes.h"
 #    include "cbase/c_va_list.h"
@@ -11,13 +21,91 @@
 
 #    include "cfilesystem/c_filesystem.h"
 #    include "cfilesystem/private/c_filedevice.h"
+#    include "cfilesystem/private/c_atomic.h"
+#    include "cfilesystem/private/c_ioscheduler.h"
+#    include "cfilesystem/private/c_shmcache.h"
 
 namespace ncore
 {
     namespace nfs
     {
         bool isPathUNIXStyle(void) { return true; }
-        void doIO(io_thread_t* io_thread) {}
+        void io_yield() { ::sched_yield(); }
+
+        // There is no public wait on an address, all waiters share one condition and
+        // check their own address when it is signalled.
+        static pthread_mutex_t sWaitLock = PTHREAD_MUTEX_INITIALIZER;
+        static pthread_cond_t  sWaitCond = PTHREAD_COND_INITIALIZER;
+
+        void io_wait(s32 volatile* address, s32 value)
+        {
+            ::pthread_mutex_lock(&sWaitLock);
+            while (natomic::load(address) == value)
+                ::pthread_cond_wait(&sWaitCond, &sWaitLock);
+            ::pthread_mutex_unlock(&sWaitLock);
+        }
+
+        void io_wake_all(s32 volatile* address)
+        {
+            ::pthread_mutex_lock(&sWaitLock);
+            ::pthread_cond_broadcast(&sWaitCond);
+            ::pthread_mutex_unlock(&sWaitLock);
+        }
+
+        u64 io_clock_us()
+        {
+            struct timespec ts;
+            ::clock_gettime(CLOCK_MONOTONIC, &ts);
+            return (u64)ts.tv_sec * 1000000 + (u64)ts.tv_nsec / 1000;
+        }
+
+        // POSIX shared memory object "/<name>". The creator sizes it, a process that
+        // attaches waits until it has its size. The object stays until it is unlinked.
+        void* shm_attach(const char* name, u64 size, bool& outCreated)
+        {
+            char object[ESettings::MAX_PATH];
+            s32  n    = 0;
+            object[0] = '/';
+            while (name[n] != '\0' && (n + 1) < (ESettings::MAX_PATH - 1))
+            {
+                object[n + 1] = name[n];
+                n += 1;
+            }
+            object[n + 1] = '\0';
+
+            outCreated = true;
+            int fd     = ::shm_open(object, O_RDWR | O_CREAT | O_EXCL, 0600);
+            if (fd >= 0)
+            {
+                if (::ftruncate(fd, (off_t)size) != 0)
+                {
+                    ::close(fd);
+                    ::shm_unlink(object);
+                    return nullptr;
+                }
+            }
+            else
+            {
+                if (errno != EEXIST)
+                    return nullptr;
+                outCreated = false;
+                fd         = ::shm_open(object, O_RDWR, 0600);
+                if (fd < 0)
+                    return nullptr;
+                struct stat st;
+                while (::fstat(fd, &st) == 0 && (u64)st.st_size < size)
+                    ::sched_yield();
+            }
+
+            void* base = ::mmap(nullptr, (size_t)size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            ::close(fd);
+            return base == MAP_FAILED ? nullptr : base;
+        }
+
+        void shm_detach(void* base, u64 size) { ::munmap(base, (size_t)size); }
+
+        s32  shm_process_id() { return (s32)::getpid(); }
+        bool shm_process_alive(s32 pid) { return ::kill((pid_t)pid, 0) == 0 || errno == EPERM; }
 
     } // namespace nfs
 }; // namespace ncore
@@ -7,7 +7,10 @@
 #    include <windows.h>
 #    include <stdio.h>
 
+#    pragma comment(lib, "Synchronization.lib") // WaitOnAddress
+
 #    include "ccore/c_debug.h"
+#    include "cbase/c_memory.h"
 #    include "cbase/c_runes.h"
 #    include "cbase/c_va_list.h"
 
@@ -17,13 +20,76 @@
 
 #    include "cfilesystem/c_filesystem.h"
 #    include "cfilesystem/private/c_filedevice.h"
+#    include "cfilesystem/private/c_atomic.h"
+#    include "cfilesystem/private/c_ioscheduler.h"
+#    include "cfilesystem/private/c_shmcache.h"
 
 namespace ncore
 {
     namespace nfs
     {
         bool isPathUNIXStyle(void) { return false; }
-        void doIO(io_thread_t* io_thread) {}
+        void io_yield() { ::SwitchToThread(); }
+
+        void io_wait(s32 volatile* address, s32 value)
+        {
+            while (natomic::load(address) == value)
+                ::WaitOnAddress((volatile VOID*)address, &value, sizeof(s32), INFINITE);
+        }
+        void io_wake_all(s32 volatile* address) { ::WakeByAddressAll((PVOID)address); }
+
+        u64 io_clock_us()
+        {
+            static LARGE_INTEGER sFrequency = {0};
+            if (sFrequency.QuadPart == 0)
+                ::QueryPerformanceFrequency(&sFrequency);
+            LARGE_INTEGER counter;
+            ::QueryPerformanceCounter(&counter);
+            return (u64)((counter.QuadPart / sFrequency.QuadPart) * 1000000 + ((counter.QuadPart % sFrequency.QuadPart) * 1000000) / sFrequency.QuadPart);
+        }
+
+        // A named section backed by the paging file, in the session namespace. The view
+        // keeps the section alive, it is gone when the last process has detached.
+        void* shm_attach(const char* name, u64 size, bool& outCreated)
+        {
+            const char* local = "Local\\";
+            char        section[ESettings::MAX_PATH];
+            s32         prefix = 0;
+            while (local[prefix] != '\0')
+            {
+                section[prefix] = local[prefix];
+                prefix += 1;
+            }
+            s32 n = 0;
+            while (name[n] != '\0' && (prefix + n) < (ESettings::MAX_PATH - 1))
+            {
+                section[prefix + n] = name[n];
+                n += 1;
+            }
+            section[prefix + n] = '\0';
+
+            HANDLE mapping = ::CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, nmem::hiu32(size), nmem::lou32(size), section);
+            if (mapping == nullptr)
+                return nullptr;
+            outCreated = ::GetLastError() != ERROR_ALREADY_EXISTS;
+            void* view = ::MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, (SIZE_T)size);
+            ::CloseHandle(mapping);
+            return view;
+        }
+
+        void shm_detach(void* base, u64 size) { ::UnmapViewOfFile(base); }
+
+        s32 shm_process_id() { return (s32)::GetCurrentProcessId(); }
+
+        bool shm_process_alive(s32 pid)
+        {
+            HANDLE process = ::OpenProcess(SYNCHRONIZE, FALSE, (DWORD)pid);
+            if (process == nullptr)
+                return ::GetLastError() == ERROR_ACCESS_DENIED;
+            bool const alive = ::WaitForSingleObject(process, 0) == WAIT_TIMEOUT;
+            ::CloseHandle(process);
+            return alive;
+        }
     } // namespace nfs
 }; // namespace ncore
 
@@ -0,0 +1,337 @@
+#include "ccore/c_target.h"
+#include "cbase/c_memory.h"
+
+#include "cfilesystem/c_hash.h"
+
+#if defined(_M_X64) || defined(__x86_64__)
+#    define DFS_HASH_X64 1
+#    include <immintrin.h>
+#    if defined(_MSC_VER)
+#        include <intrin.h>
+#        define DFS_HASH_AVX2_FN
+#    else
+#        define DFS_HASH_AVX2_FN __attribute__((target("avx2")))
+#    endif
+#elif defined(_M_ARM64) || defined(__aarch64__)
+#    define DFS_HASH_NEON 1
+#    include <arm_neon.h>
+#endif
+
+namespace ncore
+{
+    namespace nfs
+    {
+        enum
+        {
+            HASH_LANES  = 8,
+            HASH_STRIPE = 64,
+            HASH_BLOCK  = 16, // Stripes per block
+        };
+
+        // Stripe s of a block uses the keys [s, s + 8), followed by the keys of the
+        // scramble and of the final fold.
+        static const u64 sHashKeys[40] = {
+            0x1AC046DDA8E86E2Aull, 0xBE2C3B00B1D348C8ull, 0x9B1A66A95412FF75ull, 0xC448C2B1F05F7E4Cull,
+            0xC111CA6B8F6E73C4ull, 0xB54861920D05B01Dull, 0x8D61500F4A7BBE16ull, 0x5E0C25471F89E02Eull,
+            0x48105A3D28F0E221ull, 0x2169F8846B637746ull, 0x3D628782E0C0D863ull, 0xA5DDB2216078AA40ull,
+            0xC8119D17F0571101ull, 0x98E2E2EB8F33280Full, 0x8CD1E28860679CC4ull, 0x9DCA6189C923AEF3ull,
+            0x9D8D3071BA4F04C4ull, 0x5D395ADA34220C26ull, 0xE6DE42A441A1E28Eull, 0x308FBF68CC864F59ull,
+            0x216A3C81332862F9ull, 0xBACECA0A77F3132Eull, 0xDF2A2215339CA69Cull, 0x3E4C11A103A5D859ull,
+            0x6D0F173FFEC5F603ull, 0x0BF4BC630D193BB6ull, 0x5F76C4AD104B57FDull, 0x99CA459F4E93F651ull,
+            0x4751799D68CF88A0ull, 0xA6B1639E3B42B61Cull, 0x278B01031924EA35ull, 0x430253EB7E993605ull,
+            0x5F4E14147961F2E8ull, 0x52AEAD5EF08AC45Full, 0x583DCA09AF910274ull, 0x4A8B9D4B576480CBull,
+            0xBEE913DC4EF28B44ull, 0x7DE79C7A57AF8587ull, 0x1ECF42B9E34CD874ull, 0x38ADAC4AB1F3AAD1ull,
+        };
+
+        static u64 const* const sScrambleKeys = sHashKeys + 24;
+        static u64 const* const sFoldKeys     = sHashKeys + 32;
+
+        static const u64 sPrime32   = 0x9E3779B1ull;
+        static const u64 sPrime64_1 = 0x9E3779B185EBCA87ull;
+        static const u64 sPrime64_2 = 0xC2B2AE3D27D4EB4Full;
+
+        // All the targets are little endian, a lane is read as it is
+        static inline u64 sReadLane(u8 const* p)
+        {
+            u64 v;
+            nmem::memcpy(&v, p, sizeof(v));
+            return v;
+        }
+
+        static inline void sAccumulate(u64* acc, u8 const* stripe, u64 const* keys)
+        {
+            for (s32 i = 0; i < HASH_LANES; ++i)
+            {
+                u64 const data = sReadLane(stripe + i * 8);
+                u64 const key  = data ^ keys[i];
+                acc[i ^ 1] += data;
+                acc[i] += (key & 0xFFFFFFFF) * (key >> 32);
+            }
+        }
+
+#if !defined(DFS_HASH_X64) && !defined(DFS_HASH_NEON)
+        static inline void sScramble(u64* acc)
+        {
+            for (s32 i = 0; i < HASH_LANES; ++i)
+            {
+                u64 a = acc[i];
+                a ^= a >> 47;
+                a ^= sScrambleKeys[i];
+                acc[i] = a * sPrime32;
+            }
+        }
+
+        static void sHashBlocksScalar(u64* acc, u8 const* src, u64 blocks)
+        {
+            for (u64 b = 0; b < blocks; ++b, src += HASH_STRIPE * HASH_BLOCK)
+            {
+                for (s32 s = 0; s < HASH_BLOCK; ++s)
+                    sAccumulate(acc, src + s * HASH_STRIPE, sHashKeys + s);
+                sScramble(acc);
+            }
+        }
+#endif
+
+        // The vector kernels do the same per 64-bit lane: the data of lane i is added
+        // to lane i^1 (a swap of the halves of each 128-bit pair) and the product of the
+        // 32-bit halves of data^key to lane i. The scramble multiplies by a 32-bit
+        // constant as two 32x32 products, the high one shifted up.
+#if defined(DFS_HASH_X64)
+        static void sHashBlocksSSE2(u64* acc, u8 const* src, u64 blocks)
+        {
+            __m128i a[4];
+            for (s32 i = 0; i < 4; ++i)
+                a[i] = _mm_loadu_si128((__m128i const*)(acc + i * 2));
+            __m128i const prime = _mm_set1_epi32((int)sPrime32);
+
+            for (u64 b = 0; b < blocks; ++b, src += HASH_STRIPE * HASH_BLOCK)
+            {
+                for (s32 s = 0; s < HASH_BLOCK; ++s)
+                {
+                    u8 const*  stripe = src + s * HASH_STRIPE;
+                    u64 const* keys   = sHashKeys + s;
+                    for (s32 i = 0; i < 4; ++i)
+                    {
+                        __m128i const data    = _mm_loadu_si128((__m128i const*)(stripe + i * 16));
+                        __m128i const key     = _mm_xor_si128(data, _mm_loadu_si128((__m128i const*)(keys + i * 2)));
+                        __m128i const product = _mm_mul_epu32(key, _mm_srli_epi64(key, 32));
+                        __m128i const swapped = _mm_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2));
+                        a[i]                  = _mm_add_epi64(a[i], _mm_add_epi64(product, swapped));
+                    }
+                }
+                for (s32 i = 0; i < 4; ++i)
+                {
+                    __m128i v        = _mm_xor_si128(a[i], _mm_srli_epi64(a[i], 47));
+                    v                = _mm_xor_si128(v, _mm_loadu_si128((__m128i const*)(sScrambleKeys + i * 2)));
+                    __m128i const lo = _mm_mul_epu32(v, prime);
+                    __m128i const hi = _mm_mul_epu32(_mm_srli_epi64(v, 32), prime);
+                    a[i]             = _mm_add_epi64(lo, _mm_slli_epi64(hi, 32));
+                }
+            }
+
+            for (s32 i = 0; i < 4; ++i)
+                _mm_storeu_si128((__m128i*)(acc + i * 2), a[i]);
+        }
+
+        DFS_HASH_AVX2_FN static void sHashBlocksAVX2(u64* acc, u8 const* src, u64 blocks)
+        {
+            __m256i       a0    = _mm256_loadu_si256((__m256i const*)acc);
+            __m256i       a1    = _mm256_loadu_si256((__m256i const*)(acc + 4));
+            __m256i const prime = _mm256_set1_epi32((int)sPrime32);
+            __m256i const sk0   = _mm256_loadu_si256((__m256i const*)sScrambleKeys);
+            __m256i const sk1   = _mm256_loadu_si256((__m256i const*)(sScrambleKeys + 4));
+
+            for (u64 b = 0; b < blocks; ++b, src += HASH_STRIPE * HASH_BLOCK)
+            {
+                for (s32 s = 0; s < HASH_BLOCK; ++s)
+                {
+                    u8 const*     stripe = src + s * HASH_STRIPE;
+                    u64 const*    keys   = sHashKeys + s;
+                    __m256i const d0     = _mm256_loadu_si256((__m256i const*)stripe);
+                    __m256i const d1     = _mm256_loadu_si256((__m256i const*)(stripe + 32));
+                    __m256i const k0     = _mm256_xor_si256(d0, _mm256_loadu_si256((__m256i const*)keys));
+                    __m256i const k1     = _mm256_xor_si256(d1, _mm256_loadu_si256((__m256i const*)(keys + 4)));
+                    __m256i const p0     = _mm256_mul_epu32(k0, _mm256_srli_epi64(k0, 32));
+                    __m256i const p1     = _mm256_mul_epu32(k1, _mm256_srli_epi64(k1, 32));
+                    a0                   = _mm256_add_epi64(a0, _mm256_add_epi64(p0, _mm256_shuffle_epi32(d0, _MM_SHUFFLE(1, 0, 3, 2))));
+                    a1                   = _mm256_add_epi64(a1, _mm256_add_epi64(p1, _mm256_shuffle_epi32(d1, _MM_SHUFFLE(1, 0, 3, 2))));
+                }
+
+                __m256i v0 = _mm256_xor_si256(_mm256_xor_si256(a0, _mm256_srli_epi64(a0, 47)), sk0);
+                __m256i v1 = _mm256_xor_si256(_mm256_xor_si256(a1, _mm256_srli_epi64(a1, 47)), sk1);
+                a0         = _mm256_add_epi64(_mm256_mul_epu32(v0, prime), _mm256_slli_epi64(_mm256_mul_epu32(_mm256_srli_epi64(v0, 32), prime), 32));
+                a1         = _mm256_add_epi64(_mm256_mul_epu32(v1, prime), _mm256_slli_epi64(_mm256_mul_epu32(_mm256_srli_epi64(v1, 32), prime), 32));
+            }
+
+            _mm256_storeu_si256((__m256i*)acc, a0);
+            _mm256_storeu_si256((__m256i*)(acc + 4), a1);
+        }
+
+        // AVX2 needs the CPU and the OS (saving the ymm registers), SSE2 is always there
+        static bool sHasAVX2()
+        {
+#    if defined(_MSC_VER)
+            int info[4];
+            __cpuid(info, 0);
+            if (info[0] < 7)
+                return false;
+            __cpuid(info, 1);
+            bool const osxsave = (info[2] & (1 << 27)) != 0;
+            bool const avx     = (info[2] & (1 << 28)) != 0;
+            if (!osxsave || !avx || (_xgetbv(0) & 6) != 6)
+                return false;
+            __cpuidex(info, 7, 0);
+            return (info[1] & (1 << 5)) != 0;
+#    else
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx2") != 0;
+#    endif
+        }
+#endif
+
+#if defined(DFS_HASH_NEON)
+        static void sHashBlocksNEON(u64* acc, u8 const* src, u64 blocks)
+        {
+            uint64x2_t a[4];
+            for (s32 i = 0; i < 4; ++i)
+                a[i] = vld1q_u64(acc + i * 2);
+            u32 const prime = (u32)sPrime32;
+
+            for (u64 b = 0; b < blocks; ++b, src += HASH_STRIPE * HASH_BLOCK)
+            {
+                for (s32 s = 0; s < HASH_BLOCK; ++s)
+                {
+                    u8 const*  stripe = src + s * HASH_STRIPE;
+                    u64 const* keys   = sHashKeys + s;
+                    for (s32 i = 0; i < 4; ++i)
+                    {
+                        uint64x2_t const data    = vreinterpretq_u64_u8(vld1q_u8(stripe + i * 16));
+                        uint64x2_t const key     = veorq_u64(data, vld1q_u64(keys + i * 2));
+                        uint64x2_t const product = vmull_u32(vmovn_u64(key), vshrn_n_u64(key, 32));
+                        a[i]                     = vaddq_u64(a[i], vaddq_u64(product, vextq_u64(data, data, 1)));
+                    }
+                }
+                for (s32 i = 0; i < 4; ++i)
+                {
+                    uint64x2_t v  = veorq_u64(a[i], vshrq_n_u64(a[i], 47));
+                    v             = veorq_u64(v, vld1q_u64(sScrambleKeys + i * 2));
+                    uint64x2_t hi = vshlq_n_u64(vmull_n_u32(vshrn_n_u64(v, 32), prime), 32);
+                    a[i]          = vmlal_n_u32(hi, vmovn_u64(v), prime);
+                }
+            }
+
+            for (s32 i = 0; i < 4; ++i)
+                vst1q_u64(acc + i * 2, a[i]);
+        }
+#endif
+
+        typedef void (*hashblocks_fn)(u64* acc, u8 const* src, u64 blocks);
+
+        static hashblocks_fn sSelectKernel()
+        {
+#if defined(DFS_HASH_X64)
+            return sHasAVX2() ? sHashBlocksAVX2 : sHashBlocksSSE2;
+#elif defined(DFS_HASH_NEON)
+            return sHashBlocksNEON;
+#else
+            return sHashBlocksScalar;
+#endif
+        }
+
+        // Selected once, every thread that races to it stores the same kernel
+        static hashblocks_fn volatile sHashBlocks = nullptr;
+
+        // Both halves of the 128-bit product a*b folded into 64 bits
+        static inline u64 sMulFold(u64 a, u64 b)
+        {
+            u64 const a_lo = a & 0xFFFFFFFF;
+            u64 const a_hi = a >> 32;
+            u64 const b_lo = b & 0xFFFFFFFF;
+            u64 const b_hi = b >> 32;
+            u64 const ll   = a_lo * b_lo;
+            u64 const lh   = a_lo * b_hi;
+            u64 const hl   = a_hi * b_lo;
+            u64 const hh   = a_hi * b_hi;
+            u64 const mid  = (ll >> 32) + (lh & 0xFFFFFFFF) + (hl & 0xFFFFFFFF);
+            u64 const lo   = (mid << 32) | (ll & 0xFFFFFFFF);
+            u64 const hi   = hh + (lh >> 32) + (hl >> 32) + (mid >> 32);
+            return lo ^ hi;
+        }
+
+        static inline u64 sAvalanche(u64 h)
+        {
+            h ^= h >> 37;
+            h *= 0x165667919E3779F9ull;
+            h ^= h >> 32;
+            return h;
+        }
+
+        hash128_t hash128(void const* data, u64 size)
+        {
+            u64 acc[HASH_LANES] = {0xC2B2AE3Dull, sPrime64_1, sPrime64_2, 0x27D4EB2F165667C5ull, 0x85EBCA77C2B2AE63ull, 0x9E3779B1ull, 0x165667B1ull, 0x61C8864E7A143579ull};
+
+            hashblocks_fn kernel = sHashBlocks;
+            if (kernel == nullptr)
+            {
+                kernel      = sSelectKernel();
+                sHashBlocks = kernel;
+            }
+
+            // The full blocks go to the kernel, the stripes of the last block that is not
+            // full are not scrambled
+            u8 const* src     = (u8 const*)data;
+            u64 const stripes = size / HASH_STRIPE;
+            u64 const blocks  = stripes / HASH_BLOCK;
+            kernel(acc, src, blocks);
+            for (u64 s = blocks * HASH_BLOCK; s < stripes; ++s)
+                sAccumulate(acc, src + s * HASH_STRIPE, sHashKeys + (u32)(s % HASH_BLOCK));
+
+            // The rest is zero padded to a stripe, the length in the fold tells it apart
+            u64 const rest = size - stripes * HASH_STRIPE;
+            if (rest > 0)
+            {
+                u8 last[HASH_STRIPE];
+                nmem::memset(last, 0, HASH_STRIPE);
+                nmem::memcpy(last, src + stripes * HASH_STRIPE, (u32)rest);
+                sAccumulate(acc, last, sHashKeys + (u32)(stripes % HASH_BLOCK));
+            }
+
+            u64 lo = size * sPrime64_1;
+            u64 hi = ~size * sPrime64_2;
+            for (s32 i = 0; i < HASH_LANES; i += 2)
+            {
+                lo += sMulFold(acc[i] ^ sFoldKeys[i], acc[i + 1] ^ sFoldKeys[i + 1]);
+                hi += sMulFold(acc[i] ^ sFoldKeys[7 - i], acc[i + 1] ^ sFoldKeys[6 - i]);
+            }
+
+            hash128_t hash;
+            hash.m_lo = sAvalanche(lo);
+            hash.m_hi = sAvalanche(hi ^ hash.m_lo);
+            return hash;
+        }
+
+        hash128_t hash128_combine(hash128_t const* chunks, u64 count, u64 size)
+        {
+            hash128_t const root = hash128(chunks, count * sizeof(hash128_t));
+
+            u64 node[4];
+            node[0] = root.m_lo;
+            node[1] = root.m_hi;
+            node[2] = size;
+            node[3] = HASH_CHUNK_SIZE;
+            return hash128(node, sizeof(node));
+        }
+
+        void hash_to_hex(hash128_t const& hash, char* out)
+        {
+            static const char sDigits[] = "0123456789abcdef";
+            for (s32 i = 0; i < 16; ++i)
+            {
+                out[i]      = sDigits[(hash.m_hi >> (60 - i * 4)) & 0xF];
+                out[16 + i] = sDigits[(hash.m_lo >> (60 - i * 4)) & 0xF];
+            }
+            out[32] = '\0';
+        }
+
+    } // namespace nfs
+}; // namespace ncore
@@ -0,0 +1,205 @@
+#include "ccore/c_target.h"
+#include "ccore/c_debug.h"
+#include "cbase/c_allocator.h"
+
+#include "cfilesystem/c_async.h"
+#include "cfilesystem/c_filesystem.h"
+#include "cfilesystem/c_hash.h"
+
+#include "cfilesystem/private/c_atomic.h"
+#include "cfilesystem/private/c_enumerations.h"
+#include "cfilesystem/private/c_filedevice.h"
+#include "cfilesystem/private/c_filesystem.h"
+
+namespace ncore
+{
+    namespace nfs
+    {
+        extern filesys_t* mImpl;
+
+        bool hash(filepath_t const& filepath, hash128_t& out_hash) { return mImpl->hash(filepath, out_hash); }
+
+        // -----------------------------------------------------------
+        // filesys_t, content hashing
+        // -----------------------------------------------------------
+
+        // Shared by all the threads hashing one file, a thread claims the next chunk
+        // until there are none left or one of them has failed. With a mapping the
+        // chunks are hashed where they are, otherwise they are read into the buffer
+        // of the thread.
+        struct hashjob_t
+        {
+            filedevice_t* m_device;
+            void*         m_handle;
+            u8 const*     m_data;
+            u64           m_size;
+            s64           m_chunk_count;
+            s64 volatile  m_next_chunk;
+            s32 volatile  m_failed;
+            hash128_t*    m_hashes;
+        };
+
+        static void sHashChunks(hashjob_t* job, u8* buffer)
+        {
+            while (natomic::load(&job->m_failed) == 0)
+            {
+                s64 const chunk = natomic::add(&job->m_next_chunk, 1);
+                if (chunk >= job->m_chunk_count)
+                    return;
+
+                u64 const pos  = (u64)chunk * HASH_CHUNK_SIZE;
+                u64 const size = (pos + HASH_CHUNK_SIZE) < job->m_size ? (u64)HASH_CHUNK_SIZE : (job->m_size - pos);
+
+                u8 const* data = job->m_data != nullptr ? job->m_data + pos : buffer;
+                if (job->m_data == nullptr)
+                {
+                    u64 n = 0;
+                    if (!job->m_device->readFile(job->m_handle, pos, buffer, size, n) || n != size)
+                    {
+                        natomic::store(&job->m_failed, 1);
+                        return;
+                    }
+                }
+                job->m_hashes[chunk] = hash128(data, size);
+            }
+        }
+
+        class hash_call_t : public async_call_t
+        {
+        public:
+            virtual EFileError::Enum operator()(s64& result)
+            {
+                sHashChunks(m_job, m_buffer);
+                result = 0;
+                return EFileError::Error_Ok();
+            }
+
+            hashjob_t* m_job;
+            u8*        m_buffer;
+        };
+
+        // Thread 0 is the calling thread, the others are handed to the IO threads and
+        // when no request is available the calling thread does it all.
+        static void sRunHashJob(filesys_t* fs, hashjob_t& job, s32 parallelism)
+        {
+            enum
+            {
+                MAX_HASH_THREADS = MAX_IOWORKERS + 1
+            };
+            s32 threads = natomic::load(&fs->m_ioworkers_count) + 1;
+            if (parallelism > 0 && parallelism < threads)
+                threads = parallelism;
+            if (threads > MAX_HASH_THREADS)
+                threads = MAX_HASH_THREADS;
+            if ((s64)threads > job.m_chunk_count)
+                threads = (s32)job.m_chunk_count;
+
+            u8*         buffers[MAX_HASH_THREADS];
+            hash_call_t calls[MAX_HASH_THREADS];
+            async_t     tokens[MAX_HASH_THREADS];
+            s32         buffer_count = 0;
+            for (s32 i = 0; i < threads; ++i)
+            {
+                buffers[i] = nullptr;
+                if (job.m_data == nullptr)
+                {
+                    buffers[i] = (u8*)fs->m_allocator->allocate(HASH_CHUNK_SIZE, ESettings::MEM_ALIGNMENT);
+                    if (buffers[i] == nullptr)
+                        break;
+                }
+                buffer_count += 1;
+            }
+
+            s32 submitted = 0;
+            for (s32 i = 1; i < buffer_count; ++i)
+            {
+                calls[i].m_job    = &job;
+                calls[i].m_buffer = buffers[i];
+                tokens[i]         = fs->submit_call(nullptr, nullptr, &calls[i], nullptr, EIoPriority::NORMAL);
+                if (tokens[i].error().value != EFileError::ERROR_ASYNC_BUSY)
+                    break;
+                submitted += 1;
+            }
+            if (buffer_count > 0)
+                sHashChunks(&job, buffers[0]);
+            else
+                natomic::store(&job.m_failed, 1);
+            for (s32 i = 1; i <= submitted; ++i)
+                tokens[i].wait();
+
+            for (s32 i = 0; i < buffer_count; ++i)
+            {
+                if (buffers[i] != nullptr)
+                    fs->m_allocator->deallocate(buffers[i]);
+            }
+        }
+
+        bool filesys_t::hash(filepath_t const& filepath, hash128_t& out_hash) { return hash(filepath, out_hash, 0); }
+
+        // A file of one chunk is loaded the way load() does it (mapped when it is large
+        // enough) and hashed on the calling thread. A larger file is mapped as a whole
+        // when it is large enough, the chunks are hashed in parallel by up to
+        // parallelism threads (0 = all of them).
+        bool filesys_t::hash(filepath_t const& filepath, hash128_t& out_hash, s32 parallelism)
+        {
+            filedevice_t* fd   = filepath.m_dirpath.m_device->m_fileDevice;
+            u64           size = 0;
+            if (!fd->statFile(filepath, size, nullptr, nullptr))
+                return false;
+
+            if (size <= HASH_CHUNK_SIZE)
+            {
+                filedata_t data = load(filepath, m_allocator);
+                if (!data.isValid() && size > 0)
+                    return false;
+                out_hash = hash128(data.m_data, data.m_size);
+                unload(data);
+                return true;
+            }
+
+            hashjob_t job;
+            job.m_device      = fd;
+            job.m_handle      = nullptr;
+            job.m_data        = nullptr;
+            job.m_size        = 0;
+            job.m_chunk_count = 0;
+            job.m_next_chunk  = 0;
+            job.m_failed      = 0;
+            job.m_hashes      = nullptr;
+            if (!fd->openFile(filepath, EFileMode::Value_Open, EFileAccess::Value_Read, EFileOp::Value_Sync, job.m_handle))
+                return false;
+
+            // The size of the open file, it may have changed since the stat
+            bool result = fd->getLengthOfFile(job.m_handle, job.m_size) && job.m_size > 0;
+            if (result)
+            {
+                job.m_chunk_count = (s64)((job.m_size + HASH_CHUNK_SIZE - 1) / HASH_CHUNK_SIZE);
+                job.m_hashes      = (hash128_t*)m_allocator->allocate((u32)(sizeof(hash128_t) * job.m_chunk_count));
+                result            = job.m_hashes != nullptr;
+            }
+
+            void* mapping = nullptr;
+            if (result && m_load_map_threshold > 0 && job.m_size >= m_load_map_threshold)
+            {
+                if (!fd->mapFile(job.m_handle, 0, job.m_size, job.m_data, mapping))
+                    job.m_data = nullptr;
+            }
+
+            if (result)
+            {
+                sRunHashJob(this, job, parallelism);
+                result = natomic::load(&job.m_failed) == 0 && natomic::load(&job.m_next_chunk) >= job.m_chunk_count;
+            }
+            if (result)
+                out_hash = hash128_combine(job.m_hashes, (u64)job.m_chunk_count, job.m_size);
+
+            if (mapping != nullptr)
+                fd->unmapFile(mapping);
+            if (job.m_hashes != nullptr)
+                m_allocator->deallocate(job.m_hashes);
+            fd->closeFile(job.m_handle);
+            return result;
+        }
+
+    } // namespace nfs
+}; // namespace ncore
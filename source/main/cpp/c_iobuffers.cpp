@@ -0,0 +1,86 @@
+#include "ccore/c_target.h"
+#include "ccore/c_debug.h"
+#include "cbase/c_allocator.h"
+
+#include "cfilesystem/private/c_atomic.h"
+#include "cfilesystem/private/c_iobuffers.h"
+
+namespace ncore
+{
+    namespace nfs
+    {
+        iobufferpool_t::iobufferpool_t() : m_allocator(nullptr), m_buffer_size(0), m_alignment(0), m_max_buffers(0), m_allocated(0), m_free(nullptr), m_buffers(nullptr) {}
+
+        void iobufferpool_t::init(alloc_t* allocator, u32 buffer_size, u32 alignment, s32 max_buffers)
+        {
+            ASSERT(alignment >= sizeof(node_t) && (alignment & (alignment - 1)) == 0);
+
+            // The size is a multiple of the alignment so that a whole buffer can be
+            // used for one unbuffered transfer.
+            m_allocator   = allocator;
+            m_alignment   = alignment;
+            m_buffer_size = (buffer_size + (alignment - 1)) & ~(alignment - 1);
+            m_max_buffers = max_buffers;
+            m_allocated   = 0;
+            m_free        = nullptr;
+            m_buffers     = max_buffers > 0 ? (u8**)allocator->allocate(sizeof(u8*) * max_buffers) : nullptr;
+        }
+
+        void iobufferpool_t::exit()
+        {
+            for (s32 i = 0; i < m_allocated; ++i)
+                m_allocator->deallocate(m_buffers[i]);
+            if (m_buffers != nullptr)
+                m_allocator->deallocate(m_buffers);
+            m_buffers   = nullptr;
+            m_free      = nullptr;
+            m_allocated = 0;
+        }
+
+        u8* iobufferpool_t::obtain_nowait()
+        {
+            m_lock.lock();
+            node_t* node = m_free;
+            if (node != nullptr)
+            {
+                m_free = node->m_next;
+                m_lock.unlock();
+                return (u8*)node;
+            }
+            if (m_allocated == m_max_buffers)
+            {
+                m_lock.unlock();
+                return nullptr;
+            }
+
+            u8* buffer = (u8*)m_allocator->allocate(m_buffer_size, m_alignment);
+            if (buffer != nullptr)
+                m_buffers[m_allocated++] = buffer;
+            m_lock.unlock();
+            return buffer;
+        }
+
+        u8* iobufferpool_t::obtain()
+        {
+            u8* buffer = obtain_nowait();
+            while (buffer == nullptr && m_allocated > 0)
+            {
+                io_yield();
+                buffer = obtain_nowait();
+            }
+            return buffer;
+        }
+
+        void iobufferpool_t::release(u8* buffer)
+        {
+            if (buffer == nullptr)
+                return;
+            node_t* node = (node_t*)buffer;
+            m_lock.lock();
+            node->m_next = m_free;
+            m_free       = node;
+            m_lock.unlock();
+        }
+
+    } // namespace nfs
+}; // namespace ncore
@@ -0,0 +1,130 @@
+#include "ccore/c_target.h"
+#include "ccore/c_debug.h"
+#include "cbase/c_allocator.h"
+
+#include "cfilesystem/private/c_atomic.h"
+#include "cfilesystem/private/c_iorequest.h"
+#include "cfilesystem/private/c_ioqueue.h"
+
+namespace ncore
+{
+    namespace nfs
+    {
+        // -----------------------------------------------------------
+        // iomqueue_t
+        // -----------------------------------------------------------
+
+        void iomqueue_t::init(alloc_t* allocator, u32 capacity)
+        {
+            u32 size = 2;
+            while (size < capacity)
+                size <<= 1;
+
+            m_cells = (cell_t*)allocator->allocate(sizeof(cell_t) * size, ESettings::MEM_ALIGNMENT);
+            for (u32 i = 0; i < size; ++i)
+            {
+                m_cells[i].m_seq = i;
+                m_cells[i].m_req = nullptr;
+            }
+            m_mask = size - 1;
+            m_head = 0;
+            m_tail = 0;
+        }
+
+        void iomqueue_t::exit(alloc_t* allocator)
+        {
+            allocator->deallocate(m_cells);
+            m_cells = nullptr;
+        }
+
+        bool iomqueue_t::push(iorequest_t* req)
+        {
+            s64     pos  = natomic::load(&m_tail);
+            cell_t* cell = nullptr;
+            while (true)
+            {
+                cell            = &m_cells[pos & m_mask];
+                s64 const seq   = natomic::load(&cell->m_seq);
+                s64 const delta = seq - pos;
+                if (delta == 0)
+                {
+                    if (natomic::cas(&m_tail, pos, pos + 1))
+                        break;
+                    pos = natomic::load(&m_tail);
+                }
+                else if (delta < 0)
+                {
+                    return false; // Full
+                }
+                else
+                {
+                    pos = natomic::load(&m_tail);
+                }
+            }
+            cell->m_req = req;
+            natomic::store(&cell->m_seq, pos + 1);
+            return true;
+        }
+
+        iorequest_t* iomqueue_t::pop()
+        {
+            s64     pos  = natomic::load(&m_head);
+            cell_t* cell = nullptr;
+            while (true)
+            {
+                cell            = &m_cells[pos & m_mask];
+                s64 const seq   = natomic::load(&cell->m_seq);
+                s64 const delta = seq - (pos + 1);
+                if (delta == 0)
+                {
+                    if (natomic::cas(&m_head, pos, pos + 1))
+                        break;
+                    pos = natomic::load(&m_head);
+                }
+                else if (delta < 0)
+                {
+                    return nullptr; // Empty
+                }
+                else
+                {
+                    pos = natomic::load(&m_head);
+                }
+            }
+            iorequest_t* req = cell->m_req;
+            natomic::store(&cell->m_seq, pos + m_mask + 1);
+            return req;
+        }
+
+        // -----------------------------------------------------------
+        // ioqueue_t
+        // -----------------------------------------------------------
+
+        void ioqueue_t::init(alloc_t* allocator, u32 capacity, u32 merge_max, s32 max_active)
+        {
+            m_device     = nullptr;
+            m_active     = 0;
+            m_cancelled  = 0;
+            m_max_active = max_active > 0 ? max_active : 1;
+            m_submitted.init(allocator, capacity);
+            m_scheduler.init(allocator, merge_max);
+        }
+
+        void ioqueue_t::exit(alloc_t* allocator)
+        {
+            m_scheduler.exit(allocator);
+            m_submitted.exit(allocator);
+            m_device = nullptr;
+        }
+
+        bool ioqueue_t::try_enter()
+        {
+            if (natomic::add(&m_active, 1) < m_max_active)
+                return true;
+            natomic::add(&m_active, -1);
+            return false;
+        }
+
+        void ioqueue_t::leave() { natomic::add(&m_active, -1); }
+
+    } // namespace nfs
+}; // namespace ncore
@@ -0,0 +1,360 @@
+#include "ccore/c_target.h"
+#include "ccore/c_debug.h"
+#include "cbase/c_allocator.h"
+
+#include "cfilesystem/private/c_atomic.h"
+#include "cfilesystem/private/c_enumerations.h"
+#include "cfilesystem/private/c_filesystem.h"
+#include "cfilesystem/private/c_iorequest.h"
+#include "cfilesystem/private/c_ioscheduler.h"
+
+namespace ncore
+{
+    namespace nfs
+    {
+        // Sort order of a queue, (file, offset)
+        static inline bool sBefore(iorequest_t const* a, iorequest_t const* b)
+        {
+            if (a->m_filehandle != b->m_filehandle)
+                return a->m_filehandle < b->m_filehandle;
+            return a->m_offset < b->m_offset;
+        }
+
+        static inline bool sBeforeCursor(iorequest_t const* r, filehandle_t const* fh, u64 offset)
+        {
+            if (r->m_filehandle != fh)
+                return r->m_filehandle < fh;
+            return r->m_offset < offset;
+        }
+
+        // Two requests on the same file that overlap where at least one of them is
+        // a write (or a call) must be executed in the order they have been submitted.
+        // Calls that are not bound to a file are independent jobs.
+        static inline bool sOverlaps(filehandle_t const* fh, s32 op, u64 offset, u64 size, iorequest_t const* b)
+        {
+            if (fh == nullptr || fh != b->m_filehandle)
+                return false;
+            if (op == EIoOp::READ && b->m_op == EIoOp::READ)
+                return false;
+            u64 const end  = (offset + size) < offset ? (u64)-1 : (offset + size);
+            u64 const bend = (b->m_offset + b->m_size) < b->m_offset ? (u64)-1 : (b->m_offset + b->m_size);
+            return offset < bend && b->m_offset < end;
+        }
+
+        static inline bool sConflicts(iorequest_t const* a, iorequest_t const* b) { return sOverlaps(a->m_filehandle, a->m_op, a->m_offset, a->m_size, b); }
+
+        // Every file keeps the list of its requests that are in the scheduler, so that
+        // the conflicts of a request are looked for among the requests of its file only
+        static inline void sLinkFile(iorequest_t* req)
+        {
+            filehandle_t* fh = req->m_filehandle;
+            req->m_file_next = nullptr;
+            req->m_file_prev = nullptr;
+            if (fh == nullptr)
+                return;
+            req->m_file_prev = fh->m_queued_tail;
+            if (fh->m_queued_tail != nullptr)
+                fh->m_queued_tail->m_file_next = req;
+            else
+                fh->m_queued_head = req;
+            fh->m_queued_tail = req;
+        }
+
+        static inline void sUnlinkFile(iorequest_t* req)
+        {
+            filehandle_t* fh = req->m_filehandle;
+            if (fh == nullptr)
+                return;
+            if (req->m_file_prev != nullptr)
+                req->m_file_prev->m_file_next = req->m_file_next;
+            else
+                fh->m_queued_head = req->m_file_next;
+            if (req->m_file_next != nullptr)
+                req->m_file_next->m_file_prev = req->m_file_prev;
+            else
+                fh->m_queued_tail = req->m_file_prev;
+            req->m_file_prev = nullptr;
+            req->m_file_next = nullptr;
+        }
+
+        void ioscheduler_t::init(alloc_t* allocator, u32 merge_max)
+        {
+            for (s32 c = 0; c < EIoPriority::COUNT; ++c)
+            {
+                m_queue[c]         = nullptr;
+                m_cursor_fh[c]     = nullptr;
+                m_cursor_offset[c] = 0;
+            }
+            m_class_latency_us[EIoPriority::HIGH]   = 5 * 1000;
+            m_class_latency_us[EIoPriority::NORMAL] = 50 * 1000;
+            m_class_latency_us[EIoPriority::LOW]    = 500 * 1000;
+            m_deadline_slack_us                     = 1000;
+            m_next_timeout                          = (u64)-1;
+            m_sequence                              = 0;
+            for (s32 i = 0; i < MAX_ACTIVE; ++i)
+                m_active[i].m_filehandle = nullptr;
+            m_active_count = 0;
+
+            m_merge_max    = merge_max;
+            m_merge_buffer = merge_max > 0 ? (u8*)allocator->allocate(merge_max, ESettings::MEM_ALIGNMENT) : nullptr;
+            m_merge_busy   = 0;
+            m_count        = 0;
+        }
+
+        void ioscheduler_t::exit(alloc_t* allocator)
+        {
+            if (m_merge_buffer != nullptr)
+                allocator->deallocate(m_merge_buffer);
+            m_merge_buffer = nullptr;
+            m_merge_max    = 0;
+        }
+
+        void ioscheduler_t::push(iorequest_t* req, u64 now)
+        {
+            s32 const c     = req->m_priority;
+            req->m_sequence = m_sequence++;
+            req->m_active   = -1;
+            if (req->m_deadline == 0)
+                req->m_deadline = now + m_class_latency_us[c];
+            if (req->m_timeout != 0 && req->m_timeout < m_next_timeout)
+                m_next_timeout = req->m_timeout;
+
+            // Find the sorted position (after equal keys), but never in front of
+            // a request that it conflicts with.
+            iorequest_t** pos     = nullptr;
+            iorequest_t** barrier = nullptr;
+            s32           pos_i   = 0;
+            s32           bar_i   = -1;
+            s32           i       = 0;
+            iorequest_t** link    = &m_queue[c];
+            for (; *link != nullptr; link = &(*link)->m_next, ++i)
+            {
+                if (pos == nullptr && sBefore(req, *link))
+                {
+                    pos   = link;
+                    pos_i = i;
+                }
+                if (sConflicts(req, *link))
+                {
+                    barrier = &(*link)->m_next;
+                    bar_i   = i;
+                }
+            }
+            if (pos == nullptr)
+            {
+                pos   = link;
+                pos_i = i;
+            }
+            if (barrier != nullptr && bar_i >= pos_i)
+                pos = barrier;
+
+            req->m_next = *pos;
+            *pos        = req;
+            sLinkFile(req);
+            m_count += 1;
+        }
+
+        // A queued request has to wait when it conflicts with a request that is
+        // running or with a request that was submitted before it, in any class. Only
+        // the requests of its own file are looked at, the ones before it in the list
+        // of the file are the older ones.
+        bool ioscheduler_t::is_blocked(iorequest_t const* req) const
+        {
+            filehandle_t const* fh = req->m_filehandle;
+            if (fh == nullptr || natomic::load(&req->m_state) != EIoState::QUEUED)
+                return false;
+            if (m_active_count >= MAX_ACTIVE)
+                return true;
+            if (fh->m_running > 0)
+            {
+                for (s32 i = 0; i < MAX_ACTIVE; ++i)
+                {
+                    active_t const& a = m_active[i];
+                    if (a.m_filehandle == fh && sOverlaps(a.m_filehandle, a.m_op, a.m_offset, a.m_size, req))
+                        return true;
+                }
+            }
+            for (iorequest_t const* q = fh->m_queued_head; q != nullptr && q != req; q = q->m_file_next)
+            {
+                if (sConflicts(q, req) && natomic::load(&q->m_state) == EIoState::QUEUED)
+                    return true;
+            }
+            return false;
+        }
+
+        iorequest_t* ioscheduler_t::pop(u64 now, u32 merge_max)
+        {
+            if (m_count == 0)
+                return nullptr;
+
+            // Starvation guard, promote the request with the earliest deadline when
+            // it is (nearly) due.
+            iorequest_t** best = nullptr;
+            for (s32 c = 0; c < EIoPriority::COUNT; ++c)
+            {
+                for (iorequest_t** link = &m_queue[c]; *link != nullptr; link = &(*link)->m_next)
+                {
+                    if ((*link)->m_deadline <= (now + m_deadline_slack_us))
+                    {
+                        if ((best == nullptr || (*link)->m_deadline < (*best)->m_deadline) && !is_blocked(*link))
+                            best = link;
+                    }
+                }
+            }
+
+            // Otherwise the highest class, the first request at or after the cursor
+            // that is not blocked
+            if (best == nullptr)
+            {
+                for (s32 c = 0; c < EIoPriority::COUNT; ++c)
+                {
+                    if (m_queue[c] == nullptr)
+                        continue;
+                    iorequest_t** link = &m_queue[c];
+                    while (*link != nullptr && sBeforeCursor(*link, m_cursor_fh[c], m_cursor_offset[c]))
+                        link = &(*link)->m_next;
+                    for (; *link != nullptr && best == nullptr; link = &(*link)->m_next)
+                    {
+                        if (!is_blocked(*link))
+                            best = link;
+                    }
+                    for (link = &m_queue[c]; *link != nullptr && best == nullptr; link = &(*link)->m_next) // Wrap around
+                    {
+                        if (!is_blocked(*link))
+                            best = link;
+                    }
+                    if (best != nullptr)
+                        break;
+                }
+            }
+
+            // Everything that is queued waits for a running request
+            if (best == nullptr)
+                return nullptr;
+
+            iorequest_t* req = *best;
+            *best            = req->m_next;
+            req->m_next      = nullptr;
+            sUnlinkFile(req);
+            m_count -= 1;
+            if (!natomic::cas(&req->m_state, EIoState::QUEUED, EIoState::RUNNING))
+                return req; // Cancelled or timed out
+
+            // Merge the reads that directly follow in the queue
+            u64 const start = req->m_offset;
+            u64       end   = req->m_offset + req->m_size;
+            if (req->m_op == EIoOp::READ && req->m_span_count == 0 && merge_max > 0 && req->m_size <= merge_max)
+            {
+                iorequest_t* tail = req;
+                while (*best != nullptr)
+                {
+                    iorequest_t* n = *best;
+                    if (n->m_filehandle != req->m_filehandle || n->m_op != EIoOp::READ || n->m_span_count != 0)
+                        break;
+                    if (n->m_offset < start || n->m_offset > end)
+                        break;
+                    u64 const nend = (n->m_offset + n->m_size) > end ? (n->m_offset + n->m_size) : end;
+                    if ((nend - start) > merge_max)
+                        break;
+                    if (is_blocked(n))
+                        break;
+                    if (!natomic::cas(&n->m_state, EIoState::QUEUED, EIoState::RUNNING))
+                        break;
+
+                    *best        = n->m_next;
+                    n->m_next    = nullptr;
+                    sUnlinkFile(n);
+                    tail->m_next = n;
+                    tail         = n;
+                    end          = nend;
+                    m_count -= 1;
+                }
+            }
+
+            m_cursor_fh[req->m_priority]     = req->m_filehandle;
+            m_cursor_offset[req->m_priority] = end;
+
+            // Add it (or the merged chain) to the active set
+            if (req->m_filehandle != nullptr)
+            {
+                for (s32 i = 0; i < MAX_ACTIVE; ++i)
+                {
+                    active_t& a = m_active[i];
+                    if (a.m_filehandle == nullptr)
+                    {
+                        a.m_filehandle = req->m_filehandle;
+                        a.m_op         = req->m_op;
+                        a.m_offset     = start;
+                        a.m_size       = (req->m_op == EIoOp::READ) ? (end - start) : req->m_size;
+                        req->m_active  = i;
+                        req->m_filehandle->m_running += 1;
+                        m_active_count += 1;
+                        break;
+                    }
+                }
+            }
+            return req;
+        }
+
+        void ioscheduler_t::retire(s32 active)
+        {
+            if (active < 0 || active >= MAX_ACTIVE || m_active[active].m_filehandle == nullptr)
+                return;
+            m_active[active].m_filehandle->m_running -= 1;
+            m_active[active].m_filehandle = nullptr;
+            m_active_count -= 1;
+        }
+
+        iorequest_t* ioscheduler_t::expire(u64 now)
+        {
+            iorequest_t* head = nullptr;
+            iorequest_t* tail = nullptr;
+            m_next_timeout    = (u64)-1;
+            for (s32 c = 0; c < EIoPriority::COUNT; ++c)
+            {
+                iorequest_t** link = &m_queue[c];
+                while (*link != nullptr)
+                {
+                    iorequest_t* req = *link;
+                    bool         out = natomic::load(&req->m_state) != EIoState::QUEUED;
+                    if (!out && req->m_timeout != 0)
+                    {
+                        if (req->m_timeout <= now)
+                            out = natomic::cas(&req->m_state, EIoState::QUEUED, EIoState::TIMEDOUT) || natomic::load(&req->m_state) != EIoState::QUEUED;
+                        else if (req->m_timeout < m_next_timeout)
+                            m_next_timeout = req->m_timeout;
+                    }
+
+                    if (!out)
+                    {
+                        link = &req->m_next;
+                        continue;
+                    }
+
+                    *link       = req->m_next;
+                    req->m_next = nullptr;
+                    sUnlinkFile(req);
+                    m_count -= 1;
+                    if (tail == nullptr)
+                        head = req;
+                    else
+                        tail->m_next = req;
+                    tail = req;
+                }
+            }
+            return head;
+        }
+
+        u8* ioscheduler_t::acquire_merge_buffer()
+        {
+            if (m_merge_buffer == nullptr)
+                return nullptr;
+            if (natomic::cas(&m_merge_busy, 0, 1))
+                return m_merge_buffer;
+            return nullptr;
+        }
+
+        void ioscheduler_t::release_merge_buffer() { natomic::store(&m_merge_busy, 0); }
+
+    } // namespace nfs
+}; // namespace ncore
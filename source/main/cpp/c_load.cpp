@@ -0,0 +1,116 @@
+#include "ccore/c_target.h"
+#include "ccore/c_debug.h"
+#include "cbase/c_allocator.h"
+#include "cbase/c_buffer.h"
+
+#include "cfilesystem/c_async.h"
+#include "cfilesystem/c_filesystem.h"
+
+#include "cfilesystem/private/c_enumerations.h"
+#include "cfilesystem/private/c_filedevice.h"
+#include "cfilesystem/private/c_filesystem.h"
+
+namespace ncore
+{
+    namespace nfs
+    {
+        extern filesys_t* mImpl;
+
+        filedata_t load(filepath_t const& filepath, alloc_t* allocator) { return mImpl->load(filepath, allocator); }
+        s64        load_into(filepath_t const& filepath, buffer_t& buffer) { return mImpl->load_into(filepath, buffer); }
+        void       load(filepath_t const* filepaths, s32 count, alloc_t* allocator, filedata_t* out_data) { mImpl->load(filepaths, count, allocator, out_data); }
+        void       unload(filedata_t& data) { mImpl->unload(data); }
+
+        // -----------------------------------------------------------
+        // filesys_t, whole file loading
+        // -----------------------------------------------------------
+
+        filedata_t filesys_t::load(filepath_t const& filepath, alloc_t* allocator)
+        {
+            filedata_t    data;
+            filedevice_t* fd = filepath.m_dirpath.m_device->m_fileDevice;
+
+            u8 const* bytes   = nullptr;
+            u64       size    = 0;
+            void*     mapping = nullptr;
+            if (fd->loadFile(filepath, allocator, m_load_map_threshold, bytes, size, mapping))
+            {
+                data.m_data      = bytes;
+                data.m_size      = size;
+                data.m_allocator = mapping == nullptr ? allocator : nullptr;
+                data.m_mapping   = mapping;
+                data.m_device    = fd;
+            }
+            return data;
+        }
+
+        s64 filesys_t::load_into(filepath_t const& filepath, buffer_t& buffer)
+        {
+            filedevice_t* fd   = filepath.m_dirpath.m_device->m_fileDevice;
+            u64           size = 0;
+            if (!fd->loadFile(filepath, buffer.m_begin, (u64)buffer.size(), size))
+                return -1;
+            return (s64)size;
+        }
+
+        void filesys_t::unload(filedata_t& data)
+        {
+            if (data.m_mapping != nullptr)
+                data.m_device->unmapFile(data.m_mapping);
+            else if (data.m_allocator != nullptr && data.m_data != nullptr)
+                data.m_allocator->deallocate((void*)data.m_data);
+            data = filedata_t();
+        }
+
+        class load_call_t : public async_call_t
+        {
+        public:
+            virtual EFileError::Enum operator()(s64& result)
+            {
+                *m_out = m_owner->load(*m_filepath, m_allocator);
+                result = (s64)m_out->m_size;
+                return m_out->isValid() ? EFileError::Error_Ok() : EFileError::Error_NoFile();
+            }
+
+            filesys_t*        m_owner;
+            filepath_t const* m_filepath;
+            alloc_t*          m_allocator;
+            filedata_t*       m_out;
+        };
+
+        // A window of loads is kept in flight on the IO threads, when there are no IO
+        // threads the requests execute directly and this is a plain loop.
+        void filesys_t::load(filepath_t const* filepaths, s32 count, alloc_t* allocator, filedata_t* out_data)
+        {
+            enum
+            {
+                WINDOW = 32
+            };
+            load_call_t calls[WINDOW];
+            async_t     tokens[WINDOW];
+
+            for (s32 i = 0; i < count; ++i)
+            {
+                s32 const slot = i % WINDOW;
+                if (i >= WINDOW)
+                    tokens[slot].wait();
+
+                load_call_t& call = calls[slot];
+                call.m_owner      = this;
+                call.m_filepath   = &filepaths[i];
+                call.m_allocator  = allocator;
+                call.m_out        = &out_data[i];
+                out_data[i]       = filedata_t();
+
+                tokens[slot] = submit_call(filepaths[i].m_dirpath.m_device->m_fileDevice, nullptr, &call, nullptr, EIoPriority::NORMAL);
+                if (tokens[slot].error().value != EFileError::ERROR_ASYNC_BUSY)
+                    out_data[i] = load(filepaths[i], allocator); // No request available
+            }
+
+            s32 const first = count > WINDOW ? count - WINDOW : 0;
+            for (s32 i = first; i < count; ++i)
+                tokens[i % WINDOW].wait();
+        }
+
+    } // namespace nfs
+}; // namespace ncore
@@ -0,0 +1,315 @@
+#include "ccore/c_target.h"
+#include "ccore/c_debug.h"
+#include "cbase/c_memory.h"
+
+#include "cfilesystem/c_filepath.h"
+#include "cfilesystem/c_filesystem.h"
+#include "cfilesystem/c_mmapstream.h"
+
+#include "cfilesystem/private/c_atomic.h"
+#include "cfilesystem/private/c_enumerations.h"
+#include "cfilesystem/private/c_filedevice.h"
+#include "cfilesystem/private/c_filesystem.h"
+
+namespace ncore
+{
+    namespace nfs
+    {
+        extern filesys_t* mImpl;
+
+        mmapstream_t::mmapstream_t()
+            : m_device(nullptr), m_handle(nullptr), m_data(nullptr), m_mapping(nullptr), m_mapped(0), m_length(0), m_pos(0), m_extent(0), m_flush_interval_us(0), m_flushed_us(0), m_dirty_begin(0), m_dirty_end(0), m_flushing(0), m_writable(false)
+        {
+            m_flusher.m_stream = this;
+        }
+
+        mmapstream_t::~mmapstream_t() { vclose(); }
+
+        bool mmapstream_t::open(filepath_t const& filepath, mmapoptions_t const& options)
+        {
+            if (m_handle != nullptr)
+                return false;
+
+            filedevice_t* fd = filepath.m_dirpath.m_device->m_fileDevice;
+            if (options.m_writable && !fd->canWrite())
+                return false;
+
+            void* handle = nullptr;
+            bool  opened = false;
+            if (!options.m_writable)
+                opened = fd->openFile(filepath, EFileMode::Value_Open, EFileAccess::Value_Read, EFileOp::Value_Sync, handle);
+            else if (fd->hasFile(filepath))
+                opened = fd->openFile(filepath, EFileMode::Value_Open, EFileAccess::Value_ReadWrite, EFileOp::Value_Sync, handle);
+            else
+                opened = fd->createFile(filepath, true, true, handle);
+            if (!opened)
+                return false;
+
+            u64 length = 0;
+            fd->getLengthOfFile(handle, length);
+
+            m_device            = fd;
+            m_handle            = handle;
+            m_writable          = options.m_writable;
+            m_extent            = options.m_extent > 0 ? options.m_extent : (64 * 1024 * 1024);
+            m_flush_interval_us = options.m_flush_interval_us;
+            m_flushed_us        = io_clock_us();
+            m_length            = length;
+            m_pos               = 0;
+            m_dirty_begin       = 0;
+            m_dirty_end         = 0;
+
+            // An empty file is mapped by the first write
+            if (length > 0 && !remap(length))
+            {
+                fd->closeFile(handle);
+                m_handle = nullptr;
+                return false;
+            }
+            return true;
+        }
+
+        // The file is cut back to its logical length, that needs the view to be gone
+        void mmapstream_t::vclose()
+        {
+            if (m_handle == nullptr)
+                return;
+
+            acquire();
+            unmap();
+            if (m_writable && m_mapped != m_length)
+                m_device->setLengthOfFile(m_handle, m_length);
+            m_device->closeFile(m_handle);
+            m_handle = nullptr;
+            m_mapped = 0;
+            m_length = 0;
+            m_pos    = 0;
+            release();
+        }
+
+        void mmapstream_t::vflush()
+        {
+            if (m_handle == nullptr || !m_writable)
+                return;
+            acquire();
+            flush_dirty(false);
+            release();
+        }
+
+        bool mmapstream_t::sync()
+        {
+            if (m_handle == nullptr || !m_writable)
+                return false;
+            acquire();
+            bool const result = flush_dirty(true);
+            release();
+            return result;
+        }
+
+        void mmapstream_t::vsetLength(u64 length)
+        {
+            if (m_handle == nullptr || !m_writable)
+                return;
+
+            acquire();
+            unmap();
+            if (m_device->setLengthOfFile(m_handle, length))
+            {
+                m_length = length;
+                m_mapped = length;
+            }
+            m_lock.lock();
+            if (m_dirty_end > m_length)
+                m_dirty_end = m_length;
+            if (m_dirty_begin >= m_dirty_end)
+                m_dirty_begin = m_dirty_end = 0;
+            m_lock.unlock();
+            if (m_mapped > 0)
+                remap(m_mapped);
+            release();
+        }
+
+        s64 mmapstream_t::vsetPos(s64 pos)
+        {
+            s64 const old = m_pos;
+            m_pos         = pos < 0 ? 0 : pos;
+            return old;
+        }
+
+        s64 mmapstream_t::vread(u8* buffer, s64 count)
+        {
+            u8 const* data = nullptr;
+            s64 const n    = vview(data, count);
+            if (n > 0)
+                nmem::memcpy(buffer, data, (u32)n);
+            return n;
+        }
+
+        s64 mmapstream_t::vview(u8 const*& buffer, s64 count)
+        {
+            buffer = nullptr;
+            if (m_data == nullptr || count <= 0 || (u64)m_pos >= m_length)
+                return 0;
+            s64 const n = ((u64)(m_pos + count) <= m_length) ? count : (s64)(m_length - (u64)m_pos);
+            buffer      = m_data + m_pos;
+            m_pos += n;
+            return n;
+        }
+
+        s64 mmapstream_t::vwrite(const u8* buffer, s64 count)
+        {
+            u8*       data = nullptr;
+            s64 const n    = view_writable(data, count);
+            if (n > 0)
+                nmem::memcpy(data, buffer, (u32)n);
+            return n;
+        }
+
+        // The range is marked as written before the caller fills it, a scheduled flush
+        // that runs in between only writes back the pages too early.
+        s64 mmapstream_t::view_writable(u8*& buffer, s64 count)
+        {
+            buffer = nullptr;
+            if (m_handle == nullptr || !m_writable || count <= 0)
+                return 0;
+
+            u64 const end = (u64)(m_pos + count);
+            if (!grow(end))
+                return 0;
+            buffer = m_data + m_pos;
+            touch((u64)m_pos, end);
+            m_pos += count;
+            return count;
+        }
+
+        // The mapping is replaced by one that covers whole extents beyond end, a file
+        // can be extended while it is mapped.
+        bool mmapstream_t::grow(u64 end)
+        {
+            if (end <= m_mapped)
+                return true;
+
+            u64 const size = ((end + m_extent - 1) / m_extent) * m_extent;
+            acquire();
+            bool result = m_device->setLengthOfFile(m_handle, size);
+            if (result)
+            {
+                m_mapped = size;
+                result   = remap(size);
+            }
+            release();
+            return result;
+        }
+
+        void mmapstream_t::touch(u64 pos, u64 end)
+        {
+            m_lock.lock();
+            if (m_dirty_begin == m_dirty_end)
+            {
+                m_dirty_begin = pos;
+                m_dirty_end   = end;
+            }
+            else
+            {
+                m_dirty_begin = pos < m_dirty_begin ? pos : m_dirty_begin;
+                m_dirty_end   = end > m_dirty_end ? end : m_dirty_end;
+            }
+            m_lock.unlock();
+
+            if (end > m_length)
+                m_length = end;
+            schedule();
+        }
+
+        // At most one flush is in flight, a write that finds one queued or running does
+        // not schedule another.
+        void mmapstream_t::schedule()
+        {
+            if (m_flush_interval_us == 0)
+                return;
+            u64 const now = io_clock_us();
+            if ((now - m_flushed_us) < m_flush_interval_us)
+                return;
+            if (!natomic::cas(&m_flushing, 0, 1))
+                return;
+            m_flushed_us = now;
+
+            if (natomic::load(&mImpl->m_ioworkers_count) > 0)
+            {
+                async_t const token = mImpl->submit_call(m_device, nullptr, &m_flusher, &m_flusher, EIoPriority::LOW);
+                if (token.error().value == EFileError::ERROR_ASYNC_BUSY)
+                    return;
+            }
+            flush_dirty(false);
+            release();
+        }
+
+        // The caller holds m_flushing
+        bool mmapstream_t::flush_dirty(bool wait)
+        {
+            m_lock.lock();
+            u64 const begin = m_dirty_begin;
+            u64 const end   = m_dirty_end;
+            m_dirty_begin   = 0;
+            m_dirty_end     = 0;
+            m_lock.unlock();
+
+            if (m_data == nullptr)
+                return !wait || m_device->flushFile(m_handle);
+            return m_device->flushMapping(m_handle, m_data + begin, end - begin, wait);
+        }
+
+        void mmapstream_t::acquire()
+        {
+            while (!natomic::cas(&m_flushing, 0, 1))
+                io_yield();
+        }
+
+        void mmapstream_t::release() { natomic::store(&m_flushing, 0); }
+
+        // The caller holds m_flushing
+        bool mmapstream_t::remap(u64 size)
+        {
+            unmap();
+            bool result = false;
+            if (m_writable)
+            {
+                result = m_device->mapFileWritable(m_handle, 0, size, m_data, m_mapping);
+            }
+            else
+            {
+                u8 const* data = nullptr;
+                result         = m_device->mapFile(m_handle, 0, size, data, m_mapping);
+                m_data         = (u8*)data;
+            }
+            if (!result)
+            {
+                m_data    = nullptr;
+                m_mapping = nullptr;
+                return false;
+            }
+            m_mapped = size;
+            return true;
+        }
+
+        // Unmapping keeps what was written, the pages stay in the cache and are written
+        // back by the system.
+        void mmapstream_t::unmap()
+        {
+            if (m_mapping != nullptr)
+                m_device->unmapFile(m_mapping);
+            m_data    = nullptr;
+            m_mapping = nullptr;
+        }
+
+        EFileError::Enum mmapstream_t::flusher_t::operator()(s64& result)
+        {
+            m_stream->flush_dirty(false);
+            result = 0;
+            return EFileError::Error_Ok();
+        }
+
+        void mmapstream_t::flusher_t::operator()(async_t const& token, EFileError::Enum error, s64 bytes) { m_stream->release(); }
+
+    } // namespace nfs
+}; // namespace ncore
@@ -0,0 +1,626 @@
+#include "ccore/c_target.h"
+#include "ccore/c_debug.h"
+#include "cbase/c_allocator.h"
+#include "cbase/c_memory.h"
+
+#include "cfilesystem/c_filepath.h"
+#include "cfilesystem/c_filesystem.h"
+#include "cfilesystem/c_recordlog.h"
+
+#include "cfilesystem/private/c_crc32.h"
+#include "cfilesystem/private/c_enumerations.h"
+#include "cfilesystem/private/c_filedevice.h"
+#include "cfilesystem/private/c_filesystem.h"
+#include "cfilesystem/private/c_segment.h"
+
+namespace ncore
+{
+    namespace nfs
+    {
+        extern filesys_t* mImpl;
+
+        enum
+        {
+            RECORDLOG_MAGIC   = 0x474F4C52, // "RLOG"
+            RECORDLOG_VERSION = 1,
+            SEGMENT_HEADER    = 16, // <magic:u32><version:u32><first:u64>
+            RECORD_HEADER     = 8,  // <size:u32><crc:u32>
+            INDEX_ENTRY       = 16, // <record:u64><offset:u64>
+            READ_BUFFER_SIZE  = 256 * 1024,
+        };
+
+        struct segmentheader_t
+        {
+            u32 m_magic;
+            u32 m_version;
+            s64 m_first;
+        };
+
+        struct indexentry_t
+        {
+            s64 m_record;
+            u64 m_offset;
+        };
+
+        static inline u32 sRecordCrc(u32 size, u8 const* data) { return crc32c(crc32c(0, &size, sizeof(size)), data, size); }
+
+        static char* sCopyPath(alloc_t* allocator, const char* path)
+        {
+            s32 len = 0;
+            while (path[len] != '\0')
+                len += 1;
+            char* copy = (char*)allocator->allocate(len + 1);
+            nmem::memcpy(copy, path, len + 1);
+            return copy;
+        }
+
+        static bool sReadExact(filedevice_t* device, void* handle, u64 pos, void* buffer, u64 count)
+        {
+            u64 n = 0;
+            return device->readFile(handle, pos, buffer, count, n) && n == count;
+        }
+
+        static bool sWriteExact(filedevice_t* device, void* handle, u64 pos, void const* buffer, u64 count)
+        {
+            u64 n = 0;
+            return device->writeFile(handle, pos, buffer, count, n) && n == count;
+        }
+
+        // -----------------------------------------------------------
+        // recordwriter_t
+        // -----------------------------------------------------------
+
+        recordwriter_t::recordwriter_t() : m_allocator(nullptr), m_device(nullptr), m_path(nullptr), m_segment_size(0), m_index_interval(0), m_segment(-1), m_handle(nullptr), m_index_handle(nullptr), m_length(0), m_index_length(0), m_count(0), m_scratch(nullptr), m_scratch_size(0), m_open(false) {}
+
+        recordwriter_t::~recordwriter_t() { close(); }
+
+        bool recordwriter_t::open(recordlogoptions_t const& options)
+        {
+            if (m_open || options.m_path == nullptr)
+                return false;
+
+            char name[ESettings::MAX_PATH];
+            if (!segment_name(options.m_path, 0, "rec", name, ESettings::MAX_PATH))
+                return false;
+
+            m_allocator      = mImpl->m_allocator;
+            m_device         = filepath(name).m_dirpath.m_device->m_fileDevice;
+            m_segment_size   = options.m_segment_size;
+            m_index_interval = options.m_index_interval > 0 ? options.m_index_interval : 1;
+            if (!m_device->canWrite())
+                return false;
+            m_path = sCopyPath(m_allocator, options.m_path);
+
+            s64 last = -1;
+            while (segment_name(m_path, last + 1, "rec", name, ESettings::MAX_PATH) && m_device->hasFile(filepath(name)))
+                last += 1;
+
+            m_count     = 0;
+            bool result = last < 0 ? create_segment(0, 0) : recover_segment(last);
+            if (!result)
+            {
+                close_segment();
+                m_allocator->deallocate(m_path);
+                m_path = nullptr;
+                return false;
+            }
+            m_open = true;
+            return true;
+        }
+
+        void recordwriter_t::close()
+        {
+            if (!m_open)
+                return;
+            close_segment();
+            if (m_scratch != nullptr)
+                m_allocator->deallocate(m_scratch);
+            m_allocator->deallocate(m_path);
+            m_scratch      = nullptr;
+            m_scratch_size = 0;
+            m_path         = nullptr;
+            m_open         = false;
+        }
+
+        // A record goes to the next segment when it does not fit, unless it would be
+        // the first record of the segment.
+        s64 recordwriter_t::append(void const* data, u32 size)
+        {
+            if (!m_open)
+                return -1;
+
+            if (m_length > SEGMENT_HEADER && (m_length + RECORD_HEADER + size) > m_segment_size)
+            {
+                s64 const index = m_segment + 1;
+                close_segment();
+                if (!create_segment(index, m_count))
+                {
+                    close_segment();
+                    return -1;
+                }
+            }
+
+            u32 header[2];
+            header[0] = size;
+            header[1] = sRecordCrc(size, (u8 const*)data);
+
+            ciospan_t spans[2];
+            spans[0].m_data = (u8 const*)header;
+            spans[0].m_size = RECORD_HEADER;
+            spans[1].m_data = (u8 const*)data;
+            spans[1].m_size = size;
+
+            u64 n = 0;
+            if (!m_device->writeFileV(m_handle, m_length, spans, 2, n) || n != (RECORD_HEADER + size))
+                return -1;
+
+            // The index is a hint for seeking, a missing entry only makes a seek scan longer
+            if ((m_count % m_index_interval) == 0)
+            {
+                indexentry_t entry;
+                entry.m_record = m_count;
+                entry.m_offset = m_length;
+                if (sWriteExact(m_device, m_index_handle, m_index_length, &entry, INDEX_ENTRY))
+                    m_index_length += INDEX_ENTRY;
+            }
+
+            m_length += RECORD_HEADER + size;
+            return m_count++;
+        }
+
+        bool recordwriter_t::flush()
+        {
+            if (!m_open || m_handle == nullptr)
+                return false;
+            bool const index = m_device->flushFile(m_index_handle);
+            return m_device->flushFile(m_handle) && index;
+        }
+
+        bool recordwriter_t::create_segment(s64 index, s64 first)
+        {
+            char  name[ESettings::MAX_PATH];
+            void* handle = nullptr;
+            if (!segment_name(m_path, index, "rec", name, ESettings::MAX_PATH) || !m_device->createFile(filepath(name), true, true, handle))
+                return false;
+            m_handle = handle;
+            segment_name(m_path, index, "idx", name, ESettings::MAX_PATH);
+            if (!m_device->createFile(filepath(name), true, true, handle))
+                return false;
+            m_index_handle = handle;
+
+            // The header goes first, a reader ignores a segment until it is complete
+            segmentheader_t header;
+            header.m_magic   = RECORDLOG_MAGIC;
+            header.m_version = RECORDLOG_VERSION;
+            header.m_first   = first;
+            if (!sWriteExact(m_device, m_handle, 0, &header, SEGMENT_HEADER))
+                return false;
+            m_device->reserveFile(m_handle, m_segment_size);
+
+            m_segment      = index;
+            m_length       = SEGMENT_HEADER;
+            m_index_length = 0;
+            return true;
+        }
+
+        // The scan starts at the last index entry that lies within the segment, the
+        // segment and its index are cut at the end of the last valid record.
+        bool recordwriter_t::recover_segment(s64 index)
+        {
+            char  name[ESettings::MAX_PATH];
+            void* handle = nullptr;
+            segment_name(m_path, index, "rec", name, ESettings::MAX_PATH);
+            if (!m_device->openFile(filepath(name), EFileMode::Value_Open, EFileAccess::Value_ReadWrite, EFileOp::Value_Sync, handle))
+                return false;
+            m_handle = handle;
+            segment_name(m_path, index, "idx", name, ESettings::MAX_PATH);
+            if (!m_device->openFile(filepath(name), EFileMode::Value_Open, EFileAccess::Value_ReadWrite, EFileOp::Value_Sync, handle) && !m_device->createFile(filepath(name), true, true, handle))
+                return false;
+            m_index_handle = handle;
+
+            segmentheader_t header;
+            u64             length       = 0;
+            u64             index_length = 0;
+            if (!m_device->getLengthOfFile(m_handle, length) || !m_device->getLengthOfFile(m_index_handle, index_length))
+                return false;
+            if (length < SEGMENT_HEADER || !sReadExact(m_device, m_handle, 0, &header, SEGMENT_HEADER) || header.m_magic != RECORDLOG_MAGIC)
+                return false;
+
+            s64 entries = (s64)(index_length / INDEX_ENTRY);
+            s64 record  = header.m_first;
+            u64 pos     = SEGMENT_HEADER;
+            while (entries > 0)
+            {
+                indexentry_t entry;
+                if (sReadExact(m_device, m_index_handle, (u64)(entries - 1) * INDEX_ENTRY, &entry, INDEX_ENTRY) && entry.m_offset < length)
+                {
+                    record = entry.m_record;
+                    pos    = entry.m_offset;
+                    break;
+                }
+                entries -= 1;
+            }
+
+            while ((pos + RECORD_HEADER) <= length)
+            {
+                u32 frame[2];
+                if (!sReadExact(m_device, m_handle, pos, frame, RECORD_HEADER) || (pos + RECORD_HEADER + frame[0]) > length)
+                    break;
+                u8* data = scratch(frame[0]);
+                if (data == nullptr || !sReadExact(m_device, m_handle, pos + RECORD_HEADER, data, frame[0]) || sRecordCrc(frame[0], data) != frame[1])
+                    break;
+                pos += RECORD_HEADER + frame[0];
+                record += 1;
+            }
+
+            // An entry that points at the record that has been cut off goes as well, the
+            // next append adds it again
+            index_length = (u64)entries * INDEX_ENTRY;
+            if (entries > 0)
+            {
+                indexentry_t last;
+                if (sReadExact(m_device, m_index_handle, index_length - INDEX_ENTRY, &last, INDEX_ENTRY) && last.m_offset >= pos)
+                    index_length -= INDEX_ENTRY;
+            }
+            if (!m_device->setLengthOfFile(m_handle, pos) || !m_device->setLengthOfFile(m_index_handle, index_length))
+                return false;
+
+            m_segment      = index;
+            m_length       = pos;
+            m_index_length = index_length;
+            m_count        = record;
+            return true;
+        }
+
+        // The storage that was reserved beyond the last record is given back
+        void recordwriter_t::close_segment()
+        {
+            if (m_handle != nullptr)
+            {
+                m_device->setLengthOfFile(m_handle, m_length);
+                m_device->flushFile(m_handle);
+                m_device->closeFile(m_handle);
+            }
+            if (m_index_handle != nullptr)
+            {
+                m_device->flushFile(m_index_handle);
+                m_device->closeFile(m_index_handle);
+            }
+            m_handle       = nullptr;
+            m_index_handle = nullptr;
+            m_segment      = -1;
+        }
+
+        u8* recordwriter_t::scratch(u32 size)
+        {
+            if (size <= m_scratch_size && m_scratch != nullptr)
+                return m_scratch;
+            if (m_scratch != nullptr)
+                m_allocator->deallocate(m_scratch);
+            m_scratch_size = size < READ_BUFFER_SIZE ? (u32)READ_BUFFER_SIZE : size;
+            m_scratch      = (u8*)m_allocator->allocate(m_scratch_size, ESettings::MEM_ALIGNMENT);
+            if (m_scratch == nullptr)
+                m_scratch_size = 0;
+            return m_scratch;
+        }
+
+        // -----------------------------------------------------------
+        // recordreader_t
+        // -----------------------------------------------------------
+
+        recordreader_t::recordreader_t()
+            : m_allocator(nullptr), m_device(nullptr), m_path(nullptr), m_firsts(nullptr), m_segment_count(0), m_segment_capacity(0), m_segment(-1), m_handle(nullptr), m_length(0), m_pos(0), m_record(0), m_view(nullptr), m_view_pos(0), m_view_size(0), m_mapping(nullptr), m_buffer(nullptr), m_buffer_size(0), m_mappable(true), m_open(false)
+        {
+        }
+
+        recordreader_t::~recordreader_t() { close(); }
+
+        bool recordreader_t::open(const char* path)
+        {
+            if (m_open || path == nullptr)
+                return false;
+
+            char name[ESettings::MAX_PATH];
+            if (!segment_name(path, 0, "rec", name, ESettings::MAX_PATH))
+                return false;
+
+            m_allocator     = mImpl->m_allocator;
+            m_device        = filepath(name).m_dirpath.m_device->m_fileDevice;
+            m_path          = sCopyPath(m_allocator, path);
+            m_segment_count = 0;
+            m_mappable      = true;
+            m_open          = true;
+            if (!discover() || m_segment_count == 0 || !open_segment(0))
+            {
+                close();
+                return false;
+            }
+            return true;
+        }
+
+        void recordreader_t::close()
+        {
+            if (!m_open)
+                return;
+            close_segment();
+            if (m_buffer != nullptr)
+                m_allocator->deallocate(m_buffer);
+            if (m_firsts != nullptr)
+                m_allocator->deallocate(m_firsts);
+            m_allocator->deallocate(m_path);
+            m_buffer           = nullptr;
+            m_buffer_size      = 0;
+            m_firsts           = nullptr;
+            m_segment_count    = 0;
+            m_segment_capacity = 0;
+            m_path             = nullptr;
+            m_open             = false;
+        }
+
+        // A record that has not been completely written yet is reported as END, the
+        // writer may still be busy with it. Once the segment is finished (the next one
+        // exists) a record that is still incomplete or fails its checksum is CORRUPT.
+        s32 recordreader_t::next(u8 const*& out_data, u32& out_size)
+        {
+            out_data = nullptr;
+            out_size = 0;
+            if (!m_open || m_segment < 0)
+                return ERecordLog::END;
+
+            while (true)
+            {
+                if ((m_pos + RECORD_HEADER) <= m_length)
+                {
+                    u8 const* frame = fetch(m_pos, RECORD_HEADER);
+                    if (frame == nullptr)
+                        return ERecordLog::END;
+                    u32 header[2];
+                    nmem::memcpy(header, frame, RECORD_HEADER);
+                    if ((m_pos + RECORD_HEADER + header[0]) <= m_length)
+                    {
+                        u8 const* record = fetch(m_pos, RECORD_HEADER + header[0]);
+                        if (record == nullptr)
+                            return ERecordLog::END;
+                        if (sRecordCrc(header[0], record + RECORD_HEADER) != header[1])
+                        {
+                            if ((m_segment + 1) < m_segment_count || (discover() && (m_segment + 1) < m_segment_count))
+                                return ERecordLog::CORRUPT;
+                            release_view(); // Read it again next time
+                            return ERecordLog::END;
+                        }
+                        out_data = record + RECORD_HEADER;
+                        out_size = header[0];
+                        m_pos += RECORD_HEADER + header[0];
+                        m_record += 1;
+                        return ERecordLog::RECORD;
+                    }
+                }
+
+                if (grow())
+                    continue;
+                s32 const moved = advance();
+                if (moved != ERecordLog::RECORD)
+                    return moved;
+            }
+        }
+
+        // The segment holding the record is found by a binary search over the first
+        // records of the segments, the position in the segment by a binary search over
+        // its index, the records after that index entry are skipped.
+        bool recordreader_t::seek(s64 record)
+        {
+            if (!m_open || record < 0)
+                return false;
+            discover();
+
+            s64 lo = 0;
+            s64 hi = m_segment_count - 1;
+            while (lo < hi)
+            {
+                s64 const mid = (lo + hi + 1) / 2;
+                if (m_firsts[mid] <= record)
+                    lo = mid;
+                else
+                    hi = mid - 1;
+            }
+            if (lo != m_segment && !open_segment(lo))
+                return false;
+
+            u64 offset = SEGMENT_HEADER;
+            s64 first  = m_firsts[lo];
+            find_indexed(record, offset, first);
+            m_pos    = offset;
+            m_record = first;
+
+            while (m_record < record)
+            {
+                u8 const* data = nullptr;
+                u32       size = 0;
+                if (next(data, size) != ERecordLog::RECORD)
+                    return false;
+            }
+            return true;
+        }
+
+        // Pick up the segments that have been created since the last call
+        bool recordreader_t::discover()
+        {
+            char name[ESettings::MAX_PATH];
+            while (segment_name(m_path, m_segment_count, "rec", name, ESettings::MAX_PATH) && m_device->hasFile(filepath(name)))
+            {
+                void* handle = nullptr;
+                if (!m_device->openFile(filepath(name), EFileMode::Value_Open, EFileAccess::Value_Read, EFileOp::Value_Sync, handle))
+                    break;
+                segmentheader_t header;
+                bool const      valid = sReadExact(m_device, handle, 0, &header, SEGMENT_HEADER) && header.m_magic == RECORDLOG_MAGIC;
+                m_device->closeFile(handle);
+                if (!valid)
+                    break;
+
+                if (m_segment_count == m_segment_capacity)
+                {
+                    s64 const capacity = m_segment_capacity > 0 ? m_segment_capacity * 2 : 16;
+                    s64*      firsts   = (s64*)m_allocator->allocate((u32)(capacity * sizeof(s64)));
+                    if (m_firsts != nullptr)
+                    {
+                        nmem::memcpy(firsts, m_firsts, (u32)(m_segment_count * sizeof(s64)));
+                        m_allocator->deallocate(m_firsts);
+                    }
+                    m_firsts           = firsts;
+                    m_segment_capacity = capacity;
+                }
+                m_firsts[m_segment_count++] = header.m_first;
+            }
+            return true;
+        }
+
+        bool recordreader_t::open_segment(s64 index)
+        {
+            close_segment();
+
+            char name[ESettings::MAX_PATH];
+            segment_name(m_path, index, "rec", name, ESettings::MAX_PATH);
+            if (!m_device->openFile(filepath(name), EFileMode::Value_Open, EFileAccess::Value_Read, EFileOp::Value_Sync, m_handle))
+            {
+                m_handle = nullptr;
+                return false;
+            }
+            m_device->getLengthOfFile(m_handle, m_length);
+            m_segment = index;
+            m_pos     = SEGMENT_HEADER;
+            m_record  = m_firsts[index];
+            return true;
+        }
+
+        void recordreader_t::close_segment()
+        {
+            release_view();
+            if (m_handle != nullptr)
+                m_device->closeFile(m_handle);
+            m_handle  = nullptr;
+            m_segment = -1;
+            m_length  = 0;
+        }
+
+        bool recordreader_t::grow()
+        {
+            u64 length = 0;
+            if (!m_device->getLengthOfFile(m_handle, length) || length <= m_length)
+                return false;
+            m_length = length;
+            return true;
+        }
+
+        // Move on to the next segment once it exists. The writer finishes a segment
+        // before it creates the next one, so the length read after that is final.
+        // Returns RECORD when there is more to read.
+        s32 recordreader_t::advance()
+        {
+            if ((m_segment + 1) >= m_segment_count)
+            {
+                discover();
+                if ((m_segment + 1) >= m_segment_count)
+                    return ERecordLog::END;
+            }
+            if (grow())
+                return ERecordLog::RECORD;
+            if (m_pos != m_length)
+                return ERecordLog::CORRUPT;
+            if (!open_segment(m_segment + 1))
+                return ERecordLog::END;
+            return ERecordLog::RECORD;
+        }
+
+        bool recordreader_t::find_indexed(s64 record, u64& out_offset, s64& out_record)
+        {
+            char name[ESettings::MAX_PATH];
+            segment_name(m_path, m_segment, "idx", name, ESettings::MAX_PATH);
+            void* handle = nullptr;
+            if (!m_device->openFile(filepath(name), EFileMode::Value_Open, EFileAccess::Value_Read, EFileOp::Value_Sync, handle))
+                return false;
+
+            u64 length = 0;
+            m_device->getLengthOfFile(handle, length);
+
+            // Last entry at or before the record
+            bool found = false;
+            s64  lo    = 0;
+            s64  hi    = (s64)(length / INDEX_ENTRY) - 1;
+            while (lo <= hi)
+            {
+                s64 const    mid = (lo + hi) / 2;
+                indexentry_t entry;
+                if (!sReadExact(m_device, handle, (u64)mid * INDEX_ENTRY, &entry, INDEX_ENTRY))
+                    break;
+                if (entry.m_record <= record)
+                {
+                    out_record = entry.m_record;
+                    out_offset = entry.m_offset;
+                    found      = true;
+                    lo         = mid + 1;
+                }
+                else
+                {
+                    hi = mid - 1;
+                }
+            }
+            m_device->closeFile(handle);
+            return found;
+        }
+
+        // The view covers the segment from pos up to its known length, it is mapped again
+        // when a record goes beyond it. Without mapping a buffer is read from pos.
+        u8 const* recordreader_t::fetch(u64 pos, u64 count)
+        {
+            if (m_view != nullptr && pos >= m_view_pos && (pos + count) <= (m_view_pos + m_view_size))
+                return m_view + (pos - m_view_pos);
+
+            release_view();
+            if (m_mappable)
+            {
+                u8 const* data    = nullptr;
+                void*     mapping = nullptr;
+                if (m_device->mapFile(m_handle, pos, m_length - pos, data, mapping))
+                {
+                    m_view      = data;
+                    m_mapping   = mapping;
+                    m_view_pos  = pos;
+                    m_view_size = m_length - pos;
+                    return m_view;
+                }
+                m_mappable = false;
+            }
+
+            u64 size = m_length - pos;
+            if (size > READ_BUFFER_SIZE)
+                size = count > READ_BUFFER_SIZE ? count : (u64)READ_BUFFER_SIZE;
+            if (size > m_buffer_size)
+            {
+                if (m_buffer != nullptr)
+                    m_allocator->deallocate(m_buffer);
+                m_buffer      = (u8*)m_allocator->allocate((u32)size, ESettings::MEM_ALIGNMENT);
+                m_buffer_size = m_buffer != nullptr ? size : 0;
+                if (m_buffer == nullptr)
+                    return nullptr;
+            }
+            u64 n = 0;
+            if (!m_device->readFile(m_handle, pos, m_buffer, size, n) || n < count)
+                return nullptr;
+            m_view      = m_buffer;
+            m_view_pos  = pos;
+            m_view_size = n;
+            return m_view;
+        }
+
+        void recordreader_t::release_view()
+        {
+            if (m_mapping != nullptr)
+                m_device->unmapFile(m_mapping);
+            m_mapping   = nullptr;
+            m_view      = nullptr;
+            m_view_pos  = 0;
+            m_view_size = 0;
+        }
+
+    } // namespace nfs
+}; // namespace ncore
@@ -0,0 +1,176 @@
+#include "ccore/c_target.h"
+#include "ccore/c_debug.h"
+#include "cbase/c_allocator.h"
+
+#include "cfilesystem/c_async.h"
+#include "cfilesystem/c_dirpath.h"
+#include "cfilesystem/c_filepath.h"
+#include "cfilesystem/c_filesystem.h"
+#include "cfilesystem/c_stream.h"
+
+#include "cfilesystem/private/c_atomic.h"
+#include "cfilesystem/private/c_commit.h"
+#include "cfilesystem/private/c_enumerations.h"
+#include "cfilesystem/private/c_filedevice.h"
+#include "cfilesystem/private/c_filesystem.h"
+#include "cfilesystem/private/c_istream.h"
+
+namespace ncore
+{
+    namespace nfs
+    {
+        extern filesys_t* mImpl;
+
+        bool replace_open(filepath_t const& target, stream_t& out_stream) { return mImpl->replace_open(target, out_stream); }
+        bool replace_commit(stream_t& stream, filepath_t const& target) { return mImpl->replace_commit(stream, target); }
+        s32  replace_commit(stream_t* streams, filepath_t const* targets, s32 count) { return mImpl->replace_commit(streams, targets, count); }
+
+        // -----------------------------------------------------------
+        // filesys_t, atomic file replace
+        // -----------------------------------------------------------
+
+        bool filesys_t::replace_open(filepath_t const& target, stream_t& out_stream)
+        {
+            filedevice_t* fd     = target.m_dirpath.m_device->m_fileDevice;
+            void*         handle = nullptr;
+            if (!fd->canWrite() || !fd->createTempFile(target, handle))
+            {
+                out_stream = stream_t(get_nullstream(), nullptr);
+                return false;
+            }
+            return attach(fd, handle, EFileAccess::Value_ReadWrite, EFileOp::Value_Sync, out_stream);
+        }
+
+        // The data is made durable before the file is linked, otherwise a crash could
+        // leave the new name pointing at a file without its data. The stream is closed
+        // either way, a temporary file that was not linked is removed by the close.
+        static bool sReplaceLink(filesys_t* fs, stream_t& stream, filepath_t const& target, bool group)
+        {
+            filehandle_t* fh = filesys_t::get_filehandle(stream);
+            if (fh == nullptr)
+                return false;
+
+            bool result;
+            if (group)
+                result = fs->commit(stream);
+            else
+                result = fh->m_filedevice->flushFile(fh->m_handle);
+            result = result && fh->m_filedevice->linkTempFile(fh->m_handle, target);
+            fs->close(stream);
+            return result;
+        }
+
+        bool filesys_t::replace_commit(stream_t& stream, filepath_t const& target)
+        {
+            if (!sReplaceLink(this, stream, target, true))
+                return false;
+            return commit(target.m_dirpath);
+        }
+
+        class replace_call_t : public async_call_t
+        {
+        public:
+            virtual EFileError::Enum operator()(s64& result)
+            {
+                s32 linked = 0;
+                for (s32 i = m_begin; i < m_end; ++i)
+                {
+                    m_linked[i] = sReplaceLink(m_fs, m_streams[i], m_targets[i], false);
+                    if (m_linked[i])
+                        linked += 1;
+                }
+                result = linked;
+                return EFileError::Error_Ok();
+            }
+
+            filesys_t*        m_fs;
+            stream_t*         m_streams;
+            filepath_t const* m_targets;
+            bool*             m_linked;
+            s32               m_begin;
+            s32               m_end;
+        };
+
+        // The files are flushed and linked in groups on the IO threads, afterwards every
+        // directory is flushed once for all of its new entries.
+        s32 filesys_t::replace_commit(stream_t* streams, filepath_t const* targets, s32 count)
+        {
+            enum
+            {
+                WINDOW    = 16,
+                GROUP_MIN = 4,
+            };
+            if (count <= 0)
+                return 0;
+
+            bool* linked  = (bool*)m_allocator->allocate(sizeof(bool) * count * 2);
+            bool* durable = linked + count;
+
+            s32 const workers = natomic::load(&m_ioworkers_count);
+            s32       group   = (count + workers) / (workers + 1);
+            if (group < GROUP_MIN)
+                group = GROUP_MIN;
+
+            replace_call_t calls[WINDOW];
+            async_t        tokens[WINDOW];
+            bool           inflight[WINDOW];
+            for (s32 w = 0; w < WINDOW; ++w)
+                inflight[w] = false;
+
+            s32 slot = 0;
+            for (s32 begin = 0; begin < count; begin += group)
+            {
+                if (inflight[slot])
+                {
+                    tokens[slot].wait();
+                    inflight[slot] = false;
+                }
+
+                replace_call_t& call = calls[slot];
+                call.m_fs            = this;
+                call.m_streams       = streams;
+                call.m_targets       = targets;
+                call.m_linked        = linked;
+                call.m_begin         = begin;
+                call.m_end           = (begin + group) < count ? (begin + group) : count;
+
+                filedevice_t* fd = targets[begin].m_dirpath.m_device->m_fileDevice;
+                tokens[slot]     = submit_call(fd, nullptr, &call, nullptr, EIoPriority::NORMAL);
+                if (tokens[slot].error().value == EFileError::ERROR_ASYNC_BUSY)
+                {
+                    inflight[slot] = true;
+                }
+                else
+                {
+                    s64 result = 0; // No request available
+                    call(result);
+                }
+                slot = (slot + 1) % WINDOW;
+            }
+            for (s32 w = 0; w < WINDOW; ++w)
+            {
+                if (inflight[w])
+                    tokens[w].wait();
+            }
+
+            s32 committed = 0;
+            for (s32 i = 0; i < count; ++i)
+            {
+                durable[i] = false;
+                if (!linked[i])
+                    continue;
+
+                s32 j = 0; // An earlier file in the same directory
+                while (j < i && !(linked[j] && targets[j].m_dirpath == targets[i].m_dirpath))
+                    j += 1;
+                durable[i] = j < i ? durable[j] : commit(targets[i].m_dirpath);
+                if (durable[i])
+                    committed += 1;
+            }
+
+            m_allocator->deallocate(linked);
+            return committed;
+        }
+
+    } // namespace nfs
+}; // namespace ncore
@@ -0,0 +1,510 @@
+#include "ccore/c_target.h"
+#include "ccore/c_debug.h"
+#include "cbase/c_allocator.h"
+#include "cbase/c_memory.h"
+
+#include "cfilesystem/c_filepath.h"
+#include "cfilesystem/c_filesystem.h"
+
+#include "cfilesystem/private/c_atomic.h"
+#include "cfilesystem/private/c_enumerations.h"
+#include "cfilesystem/private/c_filedevice.h"
+#include "cfilesystem/private/c_filesystem.h"
+#include "cfilesystem/private/c_ioscheduler.h"
+#include "cfilesystem/private/c_shmcache.h"
+
+namespace ncore
+{
+    namespace nfs
+    {
+        extern filesys_t* mImpl;
+
+        enum
+        {
+            SHMCACHE_MAGIC     = 0x43534846, // "FHSC"
+            SHMCACHE_ALIGN     = 64,
+            SHMCACHE_SLOT_SIZE = 16 * 1024, // One slot for every this many bytes
+            SHMCACHE_MIN_SLOTS = 64,
+            SHMCACHE_WAIT_US   = 1000000, // For the creator to initialize the header
+            SHMCACHE_OWNER_US  = 100000,  // Interval at which a waiter checks the owner of the lock
+        };
+
+        static inline u64 sAlignUp(u64 value, u64 align) { return (value + align - 1) & ~(align - 1); }
+
+        static inline u32 sSlotOf(s64 key, u32 mask) { return (u32)(((u64)key * 0x9E3779B97F4A7C15ull) >> 32) & mask; }
+
+        // A decorator of another device, everything but whole file loading is passed on.
+        // Loading a file looks it up by its identity in the index of the shared memory,
+        // an entry with another write time or size is stale and is replaced. A miss reads
+        // the file straight into a new block of the data ring, blocks are allocated in
+        // ring order and the entries in the way are evicted, when one of them is in use
+        // the file is loaded from the device instead.
+        //
+        // Finding and referencing an entry is lock-free, allocation takes the lock in
+        // the shared memory (the file is read after it has been released). A process
+        // that ends while it holds an entry keeps that entry from being evicted.
+        //
+        // The lock holds the process id of its owner. A process that ends while it holds
+        // the lock may have left the ring and the index half updated, a waiter that finds
+        // the owner gone disables the cache for all the processes, from then on every
+        // file is loaded from the device. A reused process id delays the detection until
+        // that process has ended too.
+        class filedevice_cache_t : public filedevice_t
+        {
+        public:
+            DCORE_CLASS_PLACEMENT_NEW_DELETE
+
+            filedevice_cache_t(filedevice_t* device, u8* base, u64 size) : m_device(device), m_base(base), m_size(size)
+            {
+                m_header = (shmcacheheader_t*)base;
+                m_slots  = (shmslot_t*)(base + sAlignUp(sizeof(shmcacheheader_t), SHMCACHE_ALIGN));
+                m_data   = base + m_header->m_data_offset;
+            }
+            virtual ~filedevice_cache_t() {}
+
+            virtual void destruct(alloc_t* allocator) { allocator->destruct(this); }
+
+            virtual bool canWrite() const { return m_device->canWrite(); }
+            virtual bool canSeek() const { return m_device->canSeek(); }
+
+            virtual bool getDeviceInfo(filedevice_t* device, u64& totalSpace, u64& freeSpace) const { return m_device->getDeviceInfo(device, totalSpace, freeSpace); }
+
+            virtual bool openFile(filepath_t const& szFilename, EFileMode::Enum mode, EFileAccess::Enum access, EFileOp::Enum op, void*& outHandle) { return m_device->openFile(szFilename, mode, access, op, outHandle); }
+            virtual bool createFile(const filepath_t& szFilename, bool boRead, bool boWrite, void*& nFileHandle) { return m_device->createFile(szFilename, boRead, boWrite, nFileHandle); }
+            virtual bool readFile(void* pHandle, u64 pos, void* buffer, u64 count, u64& outNumBytesRead) { return m_device->readFile(pHandle, pos, buffer, count, outNumBytesRead); }
+            virtual bool writeFile(void* pHandle, u64 pos, void const* buffer, u64 count, u64& outNumBytesWritten) { return m_device->writeFile(pHandle, pos, buffer, count, outNumBytesWritten); }
+            virtual bool flushFile(void* pHandle) { return m_device->flushFile(pHandle); }
+            virtual bool closeFile(void* pHandle) { return m_device->closeFile(pHandle); }
+
+            virtual bool readFileV(void* pHandle, u64 pos, iospan_t const* spans, s32 count, u64& outNumBytesRead) { return m_device->readFileV(pHandle, pos, spans, count, outNumBytesRead); }
+            virtual bool writeFileV(void* pHandle, u64 pos, ciospan_t const* spans, s32 count, u64& outNumBytesWritten) { return m_device->writeFileV(pHandle, pos, spans, count, outNumBytesWritten); }
+
+            virtual bool loadFile(filepath_t const& szFilename, alloc_t* allocator, u64 mapThreshold, u8 const*& outData, u64& outSize, void*& outMapping);
+            virtual bool loadFile(filepath_t const& szFilename, u8* buffer, u64 capacity, u64& outSize);
+            virtual bool unmapFile(void* mapping);
+            virtual bool mapFile(void* pHandle, u64 pos, u64 count, u8 const*& outData, void*& outMapping) { return m_device->mapFile(pHandle, pos, count, outData, outMapping); }
+            virtual bool mapFileWritable(void* pHandle, u64 pos, u64 count, u8*& outData, void*& outMapping) { return m_device->mapFileWritable(pHandle, pos, count, outData, outMapping); }
+            virtual bool flushMapping(void* pHandle, void const* address, u64 count, bool boWait) { return m_device->flushMapping(pHandle, address, count, boWait); }
+
+            virtual bool statFile(filepath_t const& szFilename, u64& outSize, fileattrs_t* outAttr, filetimes_t* outTimes) { return m_device->statFile(szFilename, outSize, outAttr, outTimes); }
+            virtual bool identifyFile(filepath_t const& szFilename, u64& outId, u64& outModified, u64& outSize) { return m_device->identifyFile(szFilename, outId, outModified, outSize); }
+
+            virtual bool createStream(filepath_t const& szFilename, bool boRead, bool boWrite, stream_t& strm) { return m_device->createStream(szFilename, boRead, boWrite, strm); }
+            virtual bool closeStream(stream_t& strm) { return m_device->closeStream(strm); }
+
+            virtual bool setLengthOfFile(void* pHandle, u64 inLength) { return m_device->setLengthOfFile(pHandle, inLength); }
+            virtual bool getLengthOfFile(void* pHandle, u64& outLength) { return m_device->getLengthOfFile(pHandle, outLength); }
+
+            virtual bool setFileTime(filepath_t const& szFilename, filetimes_t const& times) { return m_device->setFileTime(szFilename, times); }
+            virtual bool getFileTime(filepath_t const& szFilename, filetimes_t& outTimes) { return m_device->getFileTime(szFilename, outTimes); }
+            virtual bool setFileAttr(filepath_t const& szFilename, fileattrs_t const& attr) { return m_device->setFileAttr(szFilename, attr); }
+            virtual bool getFileAttr(filepath_t const& szFilename, fileattrs_t& attr) { return m_device->getFileAttr(szFilename, attr); }
+
+            virtual bool setFileTime(void* pHandle, filetimes_t const& times) { return m_device->setFileTime(pHandle, times); }
+            virtual bool getFileTime(void* pHandle, filetimes_t& outTimes) { return m_device->getFileTime(pHandle, outTimes); }
+
+            virtual bool hasFile(filepath_t const& szFilename) { return m_device->hasFile(szFilename); }
+            virtual bool moveFile(filepath_t const& szFilename, filepath_t const& szToFilename, bool boOverwrite) { return m_device->moveFile(szFilename, szToFilename, boOverwrite); }
+            virtual bool copyFile(filepath_t const& szFilename, filepath_t const& szToFilename, bool boOverwrite) { return m_device->copyFile(szFilename, szToFilename, boOverwrite); }
+            virtual bool deleteFile(filepath_t const& szFilename) { return m_device->deleteFile(szFilename); }
+
+            virtual bool openDir(dirpath_t const& szDirPath, void*& nDirHandle) { return m_device->openDir(szDirPath, nDirHandle); }
+            virtual bool hasDir(dirpath_t const& szDirPath) { return m_device->hasDir(szDirPath); }
+            virtual bool moveDir(dirpath_t const& szDirPath, dirpath_t const& szToDirPath, bool boOverwrite) { return m_device->moveDir(szDirPath, szToDirPath, boOverwrite); }
+            virtual bool copyDir(dirpath_t const& szDirPath, dirpath_t const& szToDirPath, bool boOverwrite) { return m_device->copyDir(szDirPath, szToDirPath, boOverwrite); }
+            virtual bool createDir(dirpath_t const& szDirPath) { return m_device->createDir(szDirPath); }
+            virtual bool deleteDir(dirpath_t const& szDirPath) { return m_device->deleteDir(szDirPath); }
+
+            virtual s32  deleteFiles(filepath_t const* szFilenames, s32 count) { return m_device->deleteFiles(szFilenames, count); }
+            virtual bool removeDir(dirpath_t const& szDirPath) { return m_device->removeDir(szDirPath); }
+            virtual bool canClone(dirpath_t const& szDirPath) { return m_device->canClone(szDirPath); }
+            virtual bool cloneFileRange(void* pSrcHandle, u64 srcPos, void* pDstHandle, u64 dstPos, u64 count) { return m_device->cloneFileRange(pSrcHandle, srcPos, pDstHandle, dstPos, count); }
+
+            virtual bool isSparseFile(void* pHandle) { return m_device->isSparseFile(pHandle); }
+            virtual bool setSparseFile(void* pHandle) { return m_device->setSparseFile(pHandle); }
+            virtual bool nextDataExtent(void* pHandle, u64 pos, u64& outDataPos, u64& outDataEnd) { return m_device->nextDataExtent(pHandle, pos, outDataPos, outDataEnd); }
+            virtual bool punchHole(void* pHandle, u64 pos, u64 count) { return m_device->punchHole(pHandle, pos, count); }
+            virtual bool preallocate(void* pHandle, u64 pos, u64 count) { return m_device->preallocate(pHandle, pos, count); }
+            virtual bool reserveFile(void* pHandle, u64 size) { return m_device->reserveFile(pHandle, size); }
+            virtual bool adviseFile(void* pHandle, u64 pos, u64 count, s32 advice) { return m_device->adviseFile(pHandle, pos, count, advice); }
+            virtual bool syncFileRange(void* pHandle, u64 pos, u64 count, bool boWait) { return m_device->syncFileRange(pHandle, pos, count, boWait); }
+            virtual bool flushDir(dirpath_t const& szDirPath) { return m_device->flushDir(szDirPath); }
+            virtual bool syncVolume(void* const* pHandles, s32 count) { return m_device->syncVolume(pHandles, count); }
+            virtual bool createTempFile(filepath_t const& szFilename, void*& outHandle) { return m_device->createTempFile(szFilename, outHandle); }
+            virtual bool linkTempFile(void* pHandle, filepath_t const& szFilename) { return m_device->linkTempFile(pHandle, szFilename); }
+
+            virtual bool setDirTime(dirpath_t const& szDirPath, filetimes_t const& ftimes) { return m_device->setDirTime(szDirPath, ftimes); }
+            virtual bool getDirTime(dirpath_t const& szDirPath, filetimes_t& ftimes) { return m_device->getDirTime(szDirPath, ftimes); }
+            virtual bool setDirAttr(dirpath_t const& szDirPath, fileattrs_t const& attr) { return m_device->setDirAttr(szDirPath, attr); }
+            virtual bool getDirAttr(dirpath_t const& szDirPath, fileattrs_t& attr) { return m_device->getDirAttr(szDirPath, attr); }
+
+            virtual bool enumerate(dirpath_t const& szDirPath, enumerate_delegate_t& enumerator) { return m_device->enumerate(szDirPath, enumerator); }
+
+            bool lock();
+            void unlock() { natomic::store(&m_header->m_lock, 0); }
+            s32  acquire(filepath_t const& szFilename, u64& outSize);
+            s32  find(s64 key, u64 modified, u64 size);
+            s32  insert(filepath_t const& szFilename, s64 key, u64 modified, u64 size);
+            bool allocate(u64 need, s32 slot, u64& outOffset);
+            bool evict_range(u64 begin, u64 end, u64& outEnd);
+            bool evict_block(u64 offset);
+            void format_block(u64 offset, u64 size, s32 slot);
+            void release(s32 slot) { natomic::add(&m_slots[slot].m_refs, -1); }
+            u8*  data_of(s32 slot) { return m_data + m_slots[slot].m_offset + sizeof(shmblock_t); }
+
+            filedevice_t*     m_device;
+            u8*               m_base;
+            u64               m_size;
+            shmcacheheader_t* m_header;
+            shmslot_t*        m_slots;
+            u8*               m_data;
+        };
+
+        // Returns false when the cache has been disabled
+        bool filedevice_cache_t::lock()
+        {
+            s32 const self  = shm_process_id();
+            u64       start = 0;
+            while (natomic::load(&m_header->m_disabled) == 0)
+            {
+                s32 const owner = natomic::load(&m_header->m_lock);
+                if (owner == 0)
+                {
+                    if (natomic::cas(&m_header->m_lock, 0, self))
+                    {
+                        if (natomic::load(&m_header->m_disabled) == 0)
+                            return true;
+                        unlock();
+                        return false;
+                    }
+                    continue;
+                }
+
+                u64 const now = io_clock_us();
+                if (start == 0)
+                {
+                    start = now;
+                }
+                else if ((now - start) >= SHMCACHE_OWNER_US)
+                {
+                    if (!shm_process_alive(owner) && natomic::load(&m_header->m_lock) == owner)
+                        natomic::store(&m_header->m_disabled, 1);
+                    start = now;
+                }
+                io_yield();
+            }
+            return false;
+        }
+
+        // Returns the slot of the file with a reference held, or -1 when it is not cached
+        // and could not be added (the caller loads it from the device).
+        s32 filedevice_cache_t::acquire(filepath_t const& szFilename, u64& outSize)
+        {
+            if (natomic::load(&m_header->m_disabled) != 0)
+                return -1;
+
+            u64 id       = 0;
+            u64 modified = 0;
+            u64 size     = 0;
+            if (!m_device->identifyFile(szFilename, id, modified, size) || size == 0)
+                return -1;
+
+            s64 const key  = (s64)id >= EShmKey::FIRST ? (s64)id : ((s64)id + EShmKey::FIRST);
+            s32       slot = find(key, modified, size);
+            if (slot < 0)
+                slot = insert(szFilename, key, modified, size);
+            outSize = size;
+            return slot;
+        }
+
+        s32 filedevice_cache_t::find(s64 key, u64 modified, u64 size)
+        {
+            u32 const mask = m_header->m_slot_count - 1;
+            u32       s    = sSlotOf(key, mask);
+            for (u32 i = 0; i < m_header->m_slot_count; ++i, s = (s + 1) & mask)
+            {
+                shmslot_t& slot = m_slots[s];
+                s64 const  k    = natomic::load(&slot.m_key);
+                if (k == EShmKey::EMPTY)
+                    return -1;
+                if (k != key)
+                    continue;
+
+                s32 refs = natomic::load(&slot.m_refs);
+                while (refs >= 0 && !natomic::cas(&slot.m_refs, refs, refs + 1))
+                    refs = natomic::load(&slot.m_refs);
+                if (refs < 0)
+                    continue;
+
+                // The slot may have been reused between reading the key and the reference
+                if (natomic::load(&slot.m_key) == key && slot.m_modified == modified && slot.m_size == size)
+                    return (s32)s;
+                release((s32)s);
+            }
+            return -1;
+        }
+
+        // The slot is claimed under the lock and only published (key, then a reference
+        // for the caller) once the data has been read.
+        s32 filedevice_cache_t::insert(filepath_t const& szFilename, s64 key, u64 modified, u64 size)
+        {
+            u64 const need = sAlignUp(sizeof(shmblock_t) + size, SHMCACHE_ALIGN);
+            if (need > (m_header->m_data_size / 4))
+                return -1;
+
+            if (!lock())
+                return -1;
+
+            // Stale entries of the file are evicted when they are not in use
+            u32 const mask = m_header->m_slot_count - 1;
+            u32       s    = sSlotOf(key, mask);
+            s32       free = -1;
+            for (u32 i = 0; i < m_header->m_slot_count; ++i, s = (s + 1) & mask)
+            {
+                shmslot_t& slot = m_slots[s];
+                s64 const  k    = natomic::load(&slot.m_key);
+                if (k == key && natomic::cas(&slot.m_refs, 0, -1))
+                    natomic::store(&slot.m_key, (s64)EShmKey::REMOVED);
+                if (free < 0 && (k == EShmKey::EMPTY || natomic::load(&slot.m_key) == EShmKey::REMOVED))
+                    free = (s32)s;
+                if (k == EShmKey::EMPTY)
+                    break;
+            }
+            if (free < 0)
+            {
+                unlock();
+                return -1;
+            }
+
+            shmslot_t& slot = m_slots[free];
+            natomic::store(&slot.m_refs, -1);
+            natomic::store(&slot.m_key, (s64)EShmKey::RESERVED);
+            slot.m_offset = ~(u64)0; // Does not own its old block anymore
+
+            u64 offset = 0;
+            if (!allocate(need, free, offset))
+            {
+                natomic::store(&slot.m_key, (s64)EShmKey::REMOVED);
+                unlock();
+                return -1;
+            }
+            slot.m_offset   = offset;
+            slot.m_modified = modified;
+            slot.m_size     = size;
+            unlock();
+
+            void* handle = nullptr;
+            u64   n      = 0;
+            bool  loaded = false;
+            if (m_device->openFile(szFilename, EFileMode::Value_Open, EFileAccess::Value_Read, EFileOp::Value_Sync, handle))
+            {
+                loaded = m_device->readFile(handle, 0, data_of(free), size, n) && n == size;
+                m_device->closeFile(handle);
+            }
+            if (!loaded)
+            {
+                natomic::store(&slot.m_key, (s64)EShmKey::REMOVED);
+                return -1;
+            }
+
+            natomic::store(&slot.m_key, key);
+            natomic::store(&slot.m_refs, 1);
+            return free;
+        }
+
+        // The caller holds the lock. The block goes at the head of the ring, when it does
+        // not fit before the end the rest of the ring is freed and the head wraps around.
+        bool filedevice_cache_t::allocate(u64 need, s32 slot, u64& outOffset)
+        {
+            u64 const size = m_header->m_data_size;
+            u64       head = m_header->m_head;
+            u64       end  = 0;
+            if ((head + need) > size)
+            {
+                if (!evict_range(head, size, end))
+                    return false;
+                if (head < size)
+                    format_block(head, size - head, -1);
+                m_header->m_used_end = size;
+                head                 = 0;
+                m_header->m_head     = 0;
+            }
+
+            if (!evict_range(head, head + need, end))
+                return false;
+            if (end > (head + need))
+                format_block(head + need, end - (head + need), -1);
+            format_block(head, need, slot);
+
+            m_header->m_head = head + need;
+            if (m_header->m_head > m_header->m_used_end)
+                m_header->m_used_end = m_header->m_head;
+            outOffset = head;
+            return true;
+        }
+
+        // Evict the blocks that overlap [begin, end), outEnd is where the last of them ends
+        bool filedevice_cache_t::evict_range(u64 begin, u64 end, u64& outEnd)
+        {
+            u64 p = begin;
+            while (p < end && p < m_header->m_used_end)
+            {
+                if (!evict_block(p))
+                    return false;
+                p += ((shmblock_t const*)(m_data + p))->m_size;
+            }
+            outEnd = p > end ? p : end;
+            return true;
+        }
+
+        bool filedevice_cache_t::evict_block(u64 offset)
+        {
+            shmblock_t const* block = (shmblock_t const*)(m_data + offset);
+            if (block->m_slot < 0)
+                return true;
+
+            shmslot_t& slot = m_slots[block->m_slot];
+            s64 const  key  = natomic::load(&slot.m_key);
+            if (slot.m_offset != offset || key == EShmKey::EMPTY || key == EShmKey::REMOVED)
+                return true; // The slot has moved on, the block is free
+            if (key == EShmKey::RESERVED || !natomic::cas(&slot.m_refs, 0, -1))
+                return false;
+            natomic::store(&slot.m_key, (s64)EShmKey::REMOVED);
+            return true;
+        }
+
+        void filedevice_cache_t::format_block(u64 offset, u64 size, s32 slot)
+        {
+            shmblock_t* block = (shmblock_t*)(m_data + offset);
+            block->m_size     = size;
+            block->m_slot     = slot;
+            block->m_reserved = 0;
+        }
+
+        // With a map threshold the caller accepts a mapping, it gets the shared data and
+        // unmapFile releases it. Otherwise the data is copied out of the cache.
+        bool filedevice_cache_t::loadFile(filepath_t const& szFilename, alloc_t* allocator, u64 mapThreshold, u8 const*& outData, u64& outSize, void*& outMapping)
+        {
+            u64       size = 0;
+            s32 const slot = acquire(szFilename, size);
+            if (slot < 0)
+                return m_device->loadFile(szFilename, allocator, mapThreshold, outData, outSize, outMapping);
+
+            if (mapThreshold > 0)
+            {
+                outData    = data_of(slot);
+                outSize    = size;
+                outMapping = &m_slots[slot];
+                return true;
+            }
+
+            // The allocator takes a u32 size, larger files are loaded by the device
+            if (size > 0xFFFFFFFF)
+            {
+                release(slot);
+                return m_device->loadFile(szFilename, allocator, mapThreshold, outData, outSize, outMapping);
+            }
+
+            u8* data = (u8*)allocator->allocate((u32)size, ESettings::MEM_ALIGNMENT);
+            if (data != nullptr)
+                nmem::memcpy(data, data_of(slot), (u32)size);
+            release(slot);
+            outData    = data;
+            outSize    = data != nullptr ? size : 0;
+            outMapping = nullptr;
+            return data != nullptr;
+        }
+
+        bool filedevice_cache_t::loadFile(filepath_t const& szFilename, u8* buffer, u64 capacity, u64& outSize)
+        {
+            u64       size = 0;
+            s32 const slot = acquire(szFilename, size);
+            if (slot < 0)
+                return m_device->loadFile(szFilename, buffer, capacity, outSize);
+
+            if (size > 0xFFFFFFFF)
+            {
+                release(slot);
+                return m_device->loadFile(szFilename, buffer, capacity, outSize);
+            }
+
+            bool const fits = size <= capacity;
+            if (fits)
+                nmem::memcpy(buffer, data_of(slot), (u32)size);
+            release(slot);
+            outSize = fits ? size : 0;
+            return fits;
+        }
+
+        bool filedevice_cache_t::unmapFile(void* mapping)
+        {
+            shmslot_t* slot = (shmslot_t*)mapping;
+            if (slot >= m_slots && slot < (m_slots + m_header->m_slot_count))
+            {
+                release((s32)(slot - m_slots));
+                return true;
+            }
+            return m_device->unmapFile(mapping);
+        }
+
+        // One slot for every SHMCACHE_SLOT_SIZE bytes, the rest of the memory is the ring
+        static bool sInitCache(u8* base, u64 size)
+        {
+            u32 slots = SHMCACHE_MIN_SLOTS;
+            while (((u64)slots * SHMCACHE_SLOT_SIZE) < size && slots < 0x40000000)
+                slots <<= 1;
+
+            shmcacheheader_t* header     = (shmcacheheader_t*)base;
+            u64 const         slots_at   = sAlignUp(sizeof(shmcacheheader_t), SHMCACHE_ALIGN);
+            u64 const         data_at    = sAlignUp(slots_at + (u64)slots * sizeof(shmslot_t), SHMCACHE_ALIGN);
+            if ((data_at + 4 * SHMCACHE_ALIGN) > size)
+                return false;
+
+            header->m_slot_count  = slots;
+            header->m_size        = size;
+            header->m_data_offset = data_at;
+            header->m_data_size   = (size - data_at) & ~(u64)(SHMCACHE_ALIGN - 1);
+            header->m_used_end    = 0;
+            header->m_head        = 0;
+            header->m_magic       = SHMCACHE_MAGIC;
+            natomic::store(&header->m_ready, 1);
+            return true;
+        }
+
+        filedevice_t* create_cache_device(filedevice_t* device, const char* name, u64 size)
+        {
+            if (device == nullptr)
+                device = gCreateFileDevice(true);
+
+            bool  created = false;
+            void* base    = shm_attach(name, size, created);
+            if (base == nullptr)
+                return nullptr;
+
+            shmcacheheader_t* header = (shmcacheheader_t*)base;
+            bool              ready  = created ? sInitCache((u8*)base, size) : false;
+            if (!created)
+            {
+                u64 const start = io_clock_us();
+                while (natomic::load(&header->m_ready) == 0 && (io_clock_us() - start) < SHMCACHE_WAIT_US)
+                    io_yield();
+                ready = natomic::load(&header->m_ready) != 0;
+            }
+            if (!ready || header->m_magic != SHMCACHE_MAGIC || header->m_size != size)
+            {
+                shm_detach(base, size);
+                return nullptr;
+            }
+            return mImpl->m_allocator->construct<filedevice_cache_t>(device, (u8*)base, size);
+        }
+
+        void destroy_cache_device(filedevice_t* device)
+        {
+            filedevice_cache_t* cache = (filedevice_cache_t*)device;
+            mImpl->release_ioqueue(device);
+            shm_detach(cache->m_base, cache->m_size);
+            mImpl->m_allocator->destruct(cache);
+        }
+
+    } // namespace nfs
+}; // namespace ncore
@@ -49,7 +49,13 @@ namespace ncore
         bool stream_t::isAsync() const { return m_caps.CanAsync() != 0; }
 
         u64  stream_t::getLength() const { return m_pimpl->getLength(); }
-        void stream_t::setLength(u64 length) { m_pimpl->setLength(length); }
+        void stream_t::setLength(u64 length)
+        {
+            // An explicit length replaces the trim to the end of what was written
+            if (m_filehandle != nullptr && m_filehandle != INVALID_FILE_HANDLE && m_filehandle->m_reserve == EReserve::EXTENDED)
+                m_filehandle->m_reserve = EReserve::KEEP_SIZE;
+            m_pimpl->setLength(length);
+        }
         s64  stream_t::getPos() const { return m_offset; }
         s64  stream_t::setPos(s64 pos) { return m_pimpl->setPos(pos); }
 
@@ -69,6 +75,148 @@ namespace ncore
             return bytesWritten;
         }
 
+        s64 stream_t::read(iospan_t const* spans, s32 count)
+        {
+            if (m_filehandle == nullptr || m_filehandle == INVALID_FILE_HANDLE)
+            {
+                s64 bytesRead = 0;
+                for (s32 i = 0; i < count; ++i)
+                    bytesRead += m_pimpl->read(spans[i].m_data, (s64)spans[i].m_size);
+                return bytesRead;
+            }
+
+            u64 bytesRead = 0;
+            if (!m_filehandle->m_filedevice->readFileV(m_filehandle->m_handle, (u64)m_offset, spans, count, bytesRead))
+                return 0;
+            note_read(m_filehandle, (u64)m_offset, (u64)m_offset + bytesRead);
+            m_offset += (s64)bytesRead;
+            return (s64)bytesRead;
+        }
+
+        s64 stream_t::write(ciospan_t const* spans, s32 count)
+        {
+            if (m_filehandle == nullptr || m_filehandle == INVALID_FILE_HANDLE)
+            {
+                s64 bytesWritten = 0;
+                for (s32 i = 0; i < count; ++i)
+                    bytesWritten += m_pimpl->write(spans[i].m_data, (s64)spans[i].m_size);
+                return bytesWritten;
+            }
+
+            u64 bytesWritten = 0;
+            if (!m_filehandle->m_filedevice->writeFileV(m_filehandle->m_handle, (u64)m_offset, spans, count, bytesWritten))
+                return 0;
+            note_write_end(m_filehandle, (u64)m_offset + bytesWritten);
+            note_written(m_filehandle, (u64)m_offset, (u64)m_offset + bytesWritten);
+            m_offset += (s64)bytesWritten;
+            return (s64)bytesWritten;
+        }
+
+        bool stream_t::reserve(u64 size, bool keep_size)
+        {
+            if (m_filehandle == nullptr || m_filehandle == INVALID_FILE_HANDLE || !canWrite())
+                return false;
+
+            filehandle_t* fh = m_filehandle;
+            filedevice_t* fd = fh->m_filedevice;
+            if (keep_size)
+            {
+                if (!fd->reserveFile(fh->m_handle, size))
+                    return false;
+                if (fh->m_reserve == EReserve::NONE)
+                    fh->m_reserve = EReserve::KEEP_SIZE;
+                return true;
+            }
+
+            u64 length = 0;
+            if (!fd->getLengthOfFile(fh->m_handle, length))
+                return false;
+            if (fh->m_reserve != EReserve::EXTENDED)
+            {
+                fh->m_reserve_base = length;
+                fh->m_write_end    = 0;
+            }
+            if (size <= length)
+                return true;
+            if (!fd->preallocate(fh->m_handle, 0, size))
+                return false;
+            fh->m_reserve = EReserve::EXTENDED;
+            return true;
+        }
+
+        bool stream_t::advise(s32 advice, u64 pos, u64 size)
+        {
+            if (m_filehandle == nullptr || m_filehandle == INVALID_FILE_HANDLE)
+                return false;
+            return m_filehandle->m_filedevice->adviseFile(m_filehandle->m_handle, pos, size, advice);
+        }
+
+        enum
+        {
+            STREAM_PAGE_SIZE = 4096,
+        };
+
+        bool stream_t::set_streaming(s32 mode, u64 window)
+        {
+            if (m_filehandle == nullptr || m_filehandle == INVALID_FILE_HANDLE)
+                return false;
+            if ((mode & EStreaming::WRITE) != 0 && !canWrite())
+                return false;
+
+            filehandle_t* fh   = m_filehandle;
+            u64 const     page = (u64)m_offset & ~(u64)(STREAM_PAGE_SIZE - 1);
+
+            fh->m_streaming     = mode;
+            fh->m_stream_window = window > STREAM_PAGE_SIZE ? window : STREAM_PAGE_SIZE;
+            fh->m_read_dropped  = page;
+            fh->m_write_started = page;
+            fh->m_write_synced  = page;
+            if ((mode & EStreaming::READ) != 0)
+            {
+                fh->m_filedevice->adviseFile(fh->m_handle, 0, 0, EFileAdvice::SEQUENTIAL);
+                fh->m_filedevice->adviseFile(fh->m_handle, 0, 0, EFileAdvice::NOREUSE);
+            }
+            return true;
+        }
+
+        void stream_behind_read(filehandle_t* fh, u64 pos, u64 end)
+        {
+            // Going back restarts the window at the new position
+            if (pos < fh->m_read_dropped)
+                fh->m_read_dropped = pos & ~(u64)(STREAM_PAGE_SIZE - 1);
+
+            u64 const behind = end & ~(u64)(STREAM_PAGE_SIZE - 1);
+            if (behind >= (fh->m_read_dropped + fh->m_stream_window))
+            {
+                fh->m_filedevice->adviseFile(fh->m_handle, fh->m_read_dropped, behind - fh->m_read_dropped, EFileAdvice::DONTNEED);
+                fh->m_read_dropped = behind;
+            }
+        }
+
+        void stream_behind_write(filehandle_t* fh, u64 pos, u64 end)
+        {
+            if (pos < fh->m_write_synced)
+            {
+                fh->m_write_synced  = pos & ~(u64)(STREAM_PAGE_SIZE - 1);
+                fh->m_write_started = fh->m_write_synced;
+            }
+            if (end < (fh->m_write_started + fh->m_stream_window))
+                return;
+
+            // The previous window has had the time of a whole window to be written back,
+            // waiting for it rarely blocks. Once it is clean its pages can be dropped.
+            filedevice_t* fd = fh->m_filedevice;
+            if (fh->m_write_started > fh->m_write_synced)
+            {
+                u64 const size = fh->m_write_started - fh->m_write_synced;
+                if (fd->syncFileRange(fh->m_handle, fh->m_write_synced, size, true))
+                    fd->adviseFile(fh->m_handle, fh->m_write_synced, size, EFileAdvice::DONTNEED);
+                fh->m_write_synced = fh->m_write_started;
+            }
+            fd->syncFileRange(fh->m_handle, fh->m_write_started, end - fh->m_write_started, false);
+            fh->m_write_started = end;
+        }
+
         stream_t& stream_t::operator=(const stream_t& str)
         {
             m_filehandle = str.m_filehandle;
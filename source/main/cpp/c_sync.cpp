@@ -0,0 +1,445 @@
+#include "ccore/c_target.h"
+#include "ccore/c_debug.h"
+#include "cbase/c_allocator.h"
+
+#include "cfilesystem/c_attributes.h"
+#include "cfilesystem/c_filesystem.h"
+
+#include "cfilesystem/private/c_atomic.h"
+#include "cfilesystem/private/c_delta.h"
+#include "cfilesystem/private/c_enumerations.h"
+#include "cfilesystem/private/c_filedevice.h"
+#include "cfilesystem/private/c_filesystem.h"
+
+namespace ncore
+{
+    namespace nfs
+    {
+        extern filesys_t* mImpl;
+
+        bool sync(filepath_t const& src, filepath_t const& dst, syncoptions_t const& options) { return mImpl->sync(src, dst, options); }
+
+        // -----------------------------------------------------------
+        // filesys_t, delta sync
+        // -----------------------------------------------------------
+
+        // The state of the sync of one file. m_buffer is the window on the source, it
+        // holds [m_buf_start, m_buf_end). The literal (data that has to come from the
+        // source) starts at m_lit, a run of matched blocks of the destination is
+        // collected so that neighbouring blocks are cloned/copied with one call.
+        struct syncfile_t
+        {
+            filedevice_t* m_srcfd;
+            filedevice_t* m_dstfd;
+            void*         m_src;
+            void*         m_dst;
+            void*         m_temp;
+            u64           m_src_size;
+            u64           m_dst_size;
+            u32           m_block_size;
+            u32           m_buffer_size;
+            u8*           m_buffer;
+            u8*           m_other;
+            u64           m_buf_start;
+            u64           m_buf_end;
+            u64           m_lit;
+            u64           m_run_from;
+            u64           m_run_to;
+            u64           m_run_size;
+            u64           m_matched;
+            u64           m_written;
+            bool          m_clone;
+        };
+
+        // About the square root of the size, which balances the number of signatures
+        // against the amount of data sent for a changed block.
+        static u32 sBlockSize(u64 size, u32 block_size)
+        {
+            enum
+            {
+                BLOCK_MIN = 1024,
+                BLOCK_MAX = 1024 * 1024,
+            };
+            if (block_size > 0)
+                return block_size;
+            u32 block = BLOCK_MIN;
+            while (block < BLOCK_MAX && ((u64)block * block) < size)
+                block <<= 1;
+            return block;
+        }
+
+        static inline bool sRead(filedevice_t* fd, void* handle, u64 pos, u8* data, u64 count)
+        {
+            u64 n = 0;
+            return fd->readFile(handle, pos, data, count, n) && n == count;
+        }
+
+        static inline bool sWrite(filedevice_t* fd, void* handle, u64 pos, u8 const* data, u64 count)
+        {
+            u64 n = 0;
+            return fd->writeFile(handle, pos, data, count, n) && n == count;
+        }
+
+        static bool sSameBytes(u8 const* a, u8 const* b, u32 size)
+        {
+            u32 i = 0;
+            for (; (i + 8) <= size; i += 8)
+            {
+                if (*(u64 const*)(a + i) != *(u64 const*)(b + i))
+                    return false;
+            }
+            for (; i < size; ++i)
+            {
+                if (a[i] != b[i])
+                    return false;
+            }
+            return true;
+        }
+
+        static bool sSameWriteTime(filetimes_t const& a, filetimes_t const& b)
+        {
+            datetime_t ta;
+            datetime_t tb;
+            a.getLastWriteTime(ta);
+            b.getLastWriteTime(tb);
+            return ta == tb;
+        }
+
+        static bool sSameContent(syncfile_t& f, bool& out_same)
+        {
+            out_same = false;
+            for (u64 pos = 0; pos < f.m_src_size; pos += f.m_buffer_size)
+            {
+                u32 const count = (u32)((pos + f.m_buffer_size) < f.m_src_size ? f.m_buffer_size : (f.m_src_size - pos));
+                if (!sRead(f.m_srcfd, f.m_src, pos, f.m_buffer, count) || !sRead(f.m_dstfd, f.m_dst, pos, f.m_other, count))
+                    return false;
+                if (!sSameBytes(f.m_buffer, f.m_other, count))
+                    return true;
+            }
+            out_same = true;
+            return true;
+        }
+
+        // Compare the blocks at the same offset and write the ones that differ, the
+        // destination is then cut or extended to the size of the source.
+        static bool sSyncInPlace(syncfile_t& f)
+        {
+            u32 const block = f.m_block_size;
+            for (u64 pos = 0; pos < f.m_src_size; pos += f.m_buffer_size)
+            {
+                u32 const count = (u32)((pos + f.m_buffer_size) < f.m_src_size ? f.m_buffer_size : (f.m_src_size - pos));
+                u32 const have  = pos >= f.m_dst_size ? 0 : (u32)((pos + count) <= f.m_dst_size ? count : (f.m_dst_size - pos));
+                if (!sRead(f.m_srcfd, f.m_src, pos, f.m_buffer, count))
+                    return false;
+                if (have > 0 && !sRead(f.m_dstfd, f.m_dst, pos, f.m_other, have))
+                    return false;
+
+                // Consecutive blocks that differ are written with one call
+                u32 run_begin = 0;
+                u32 run_end   = 0;
+                for (u32 at = 0; at < count; at += block)
+                {
+                    u32 const n = (at + block) < count ? block : (count - at);
+                    if ((at + n) <= have && sSameBytes(f.m_buffer + at, f.m_other + at, n))
+                    {
+                        if (run_end > run_begin && !sWrite(f.m_dstfd, f.m_dst, pos + run_begin, f.m_buffer + run_begin, run_end - run_begin))
+                            return false;
+                        f.m_written += run_end - run_begin;
+                        f.m_matched += n;
+                        run_begin = run_end = 0;
+                        continue;
+                    }
+                    if (run_end == run_begin)
+                        run_begin = at;
+                    run_end = at + n;
+                }
+                if (run_end > run_begin && !sWrite(f.m_dstfd, f.m_dst, pos + run_begin, f.m_buffer + run_begin, run_end - run_begin))
+                    return false;
+                f.m_written += run_end - run_begin;
+            }
+            return f.m_src_size == f.m_dst_size || f.m_dstfd->setLengthOfFile(f.m_dst, f.m_src_size);
+        }
+
+        static bool sFlushLiteral(syncfile_t& f, u64 pos)
+        {
+            if (f.m_lit < pos)
+            {
+                if (!sWrite(f.m_dstfd, f.m_temp, f.m_lit, f.m_buffer + (f.m_lit - f.m_buf_start), pos - f.m_lit))
+                    return false;
+                f.m_written += pos - f.m_lit;
+            }
+            f.m_lit = pos;
+            return true;
+        }
+
+        static bool sFlushRun(syncfile_t& f)
+        {
+            u64 const size = f.m_run_size;
+            if (size == 0)
+                return true;
+            f.m_run_size = 0;
+            f.m_matched += size;
+
+            // Cloning needs ranges aligned to the clusters of the volume, once it fails
+            // the rest of the runs are copied.
+            if (f.m_clone && f.m_dstfd->cloneFileRange(f.m_dst, f.m_run_from, f.m_temp, f.m_run_to, size))
+                return true;
+            f.m_clone = false;
+
+            for (u64 done = 0; done < size; done += f.m_buffer_size)
+            {
+                u64 const count = (done + f.m_buffer_size) < size ? f.m_buffer_size : (size - done);
+                if (!sRead(f.m_dstfd, f.m_dst, f.m_run_from + done, f.m_other, count) || !sWrite(f.m_dstfd, f.m_temp, f.m_run_to + done, f.m_other, count))
+                    return false;
+            }
+            return true;
+        }
+
+        static bool sAddRun(syncfile_t& f, u64 from, u64 to, u64 size)
+        {
+            if (f.m_run_size > 0 && from == (f.m_run_from + f.m_run_size) && to == (f.m_run_to + f.m_run_size))
+            {
+                f.m_run_size += size;
+                return true;
+            }
+            if (!sFlushRun(f))
+                return false;
+            f.m_run_from = from;
+            f.m_run_to   = to;
+            f.m_run_size = size;
+            return true;
+        }
+
+        // Make sure the source up to need_end is in the buffer, the data before pos is
+        // no longer needed: the literal up to pos is written and the rest moves to the
+        // start of the buffer.
+        static bool sFill(syncfile_t& f, u64 pos, u64 need_end)
+        {
+            if (need_end <= f.m_buf_end)
+                return true;
+            if (!sFlushLiteral(f, pos))
+                return false;
+
+            u32 const keep  = (u32)(f.m_buf_end - pos);
+            u8 const* from  = f.m_buffer + (pos - f.m_buf_start);
+            for (u32 i = 0; i < keep; ++i)
+                f.m_buffer[i] = from[i];
+            f.m_buf_start = pos;
+            f.m_buf_end   = pos + keep;
+
+            u64 const end = (pos + f.m_buffer_size) < f.m_src_size ? (pos + f.m_buffer_size) : f.m_src_size;
+            if (end > f.m_buf_end && !sRead(f.m_srcfd, f.m_src, f.m_buf_end, f.m_buffer + keep, end - f.m_buf_end))
+                return false;
+            f.m_buf_end = end;
+            return need_end <= f.m_buf_end;
+        }
+
+        // The signatures of the blocks of the destination are searched for at every
+        // offset of the source with the rolling checksum. The new file is written to a
+        // temporary file, a matched block is taken from the destination and the data
+        // between the matches from the source.
+        static bool sSyncReplace(syncfile_t& f, alloc_t* allocator)
+        {
+            enum
+            {
+                MAX_BLOCKS = 16 * 1024 * 1024,
+            };
+            u32 const block  = f.m_block_size;
+            u64 const count  = f.m_dst_size / block;
+            u32 const blocks = count < MAX_BLOCKS ? (u32)count : (u32)MAX_BLOCKS;
+
+            deltaindex_t index;
+            if (!index.init(allocator, block, blocks))
+                return false;
+            for (u64 pos = 0; pos < ((u64)blocks * block); pos += f.m_buffer_size)
+            {
+                u64 const end = (pos + f.m_buffer_size) < ((u64)blocks * block) ? (pos + f.m_buffer_size) : ((u64)blocks * block);
+                if (!sRead(f.m_dstfd, f.m_dst, pos, f.m_other, end - pos))
+                {
+                    index.exit();
+                    return false;
+                }
+                for (u64 at = pos; at < end; at += block)
+                    index.add((u32)(at / block), f.m_other + (at - pos));
+            }
+
+            bool result = f.m_dstfd->setLengthOfFile(f.m_temp, f.m_src_size);
+            u64  pos    = 0;
+            if (result && index.count() > 0 && f.m_src_size >= block)
+            {
+                result = sFill(f, pos, pos + block);
+
+                rollsum_t sum;
+                if (result)
+                    sum.init(f.m_buffer + (pos - f.m_buf_start), block);
+                while (result)
+                {
+                    s64 const found = index.find(sum.digest(), f.m_buffer + (pos - f.m_buf_start));
+                    if (found >= 0)
+                    {
+                        result = sFlushLiteral(f, pos) && sAddRun(f, (u64)found * block, pos, block);
+                        pos += block;
+                        f.m_lit = pos;
+                        if (!result || (pos + block) > f.m_src_size)
+                            break;
+                        result = sFill(f, pos, pos + block);
+                        if (result)
+                            sum.init(f.m_buffer + (pos - f.m_buf_start), block);
+                    }
+                    else
+                    {
+                        if ((pos + block) >= f.m_src_size)
+                            break;
+                        result = sFill(f, pos, pos + block + 1);
+                        if (result)
+                        {
+                            u8 const* window = f.m_buffer + (pos - f.m_buf_start);
+                            sum.roll(window[0], window[block]);
+                            pos += 1;
+                        }
+                    }
+                }
+            }
+            index.exit();
+
+            // Everything after the last match comes from the source
+            while (result && f.m_lit < f.m_src_size)
+            {
+                u64 const at  = f.m_lit;
+                u64 const end = (at + f.m_buffer_size) < f.m_src_size ? (at + f.m_buffer_size) : f.m_src_size;
+                result        = sFill(f, at, end) && sFlushLiteral(f, f.m_buf_end);
+            }
+            result = result && sFlushRun(f);
+            return result && (f.m_matched + f.m_written) == f.m_src_size;
+        }
+
+        static inline void sCountSync(syncstats_t* stats, bool skipped, u64 matched, u64 written)
+        {
+            if (stats == nullptr)
+                return;
+            natomic::add(&stats->m_files, 1);
+            if (skipped)
+                natomic::add(&stats->m_files_skipped, 1);
+            natomic::add(&stats->m_bytes_matched, (s64)matched);
+            natomic::add(&stats->m_bytes_written, (s64)written);
+        }
+
+        // The times of the source are given to the destination last, a sync that fails
+        // half-way leaves a destination with other times and SIZE_TIME syncs it again.
+        bool filesys_t::sync(filepath_t const& src, filepath_t const& dst, syncoptions_t const& options)
+        {
+            copyoptions_t const copy_options;
+            return sync(src, dst, options, copy_options);
+        }
+
+        // A destination that does not exist yet is copied with copy_options.
+        bool filesys_t::sync(filepath_t const& src, filepath_t const& dst, syncoptions_t const& options, copyoptions_t const& copy_options)
+        {
+            filedevice_t* srcfd = src.m_dirpath.m_device->m_fileDevice;
+            filedevice_t* dstfd = dst.m_dirpath.m_device->m_fileDevice;
+            if (!dstfd->canWrite())
+                return false;
+
+            u64         src_size = 0;
+            filetimes_t src_times;
+            if (!srcfd->statFile(src, src_size, nullptr, &src_times))
+                return false;
+
+            u64         dst_size = 0;
+            filetimes_t dst_times;
+            if (!dstfd->statFile(dst, dst_size, nullptr, &dst_times))
+            {
+                if (!copy(src, dst, copy_options))
+                    return false;
+                dstfd->setFileTime(dst, src_times);
+                sCountSync(options.m_stats, false, 0, src_size);
+                return true;
+            }
+
+            if (options.m_check == ESyncCheck::SIZE_TIME && src_size == dst_size && sSameWriteTime(src_times, dst_times))
+            {
+                sCountSync(options.m_stats, true, 0, 0);
+                return true;
+            }
+
+            syncfile_t f;
+            f.m_srcfd       = srcfd;
+            f.m_dstfd       = dstfd;
+            f.m_src         = nullptr;
+            f.m_dst         = nullptr;
+            f.m_temp        = nullptr;
+            f.m_src_size    = src_size;
+            f.m_dst_size    = dst_size;
+            f.m_block_size  = sBlockSize(src_size > dst_size ? src_size : dst_size, options.m_block_size);
+            f.m_buffer_size = f.m_block_size * 4;
+            if (f.m_buffer_size < (4 * 1024 * 1024))
+                f.m_buffer_size = f.m_block_size * ((4 * 1024 * 1024) / f.m_block_size);
+            f.m_buffer    = nullptr;
+            f.m_other     = nullptr;
+            f.m_buf_start = 0;
+            f.m_buf_end   = 0;
+            f.m_lit       = 0;
+            f.m_run_from  = 0;
+            f.m_run_to    = 0;
+            f.m_run_size  = 0;
+            f.m_matched   = 0;
+            f.m_written   = 0;
+            f.m_clone     = dstfd->canClone(dst.m_dirpath);
+
+            f.m_buffer = (u8*)m_allocator->allocate(f.m_buffer_size, ESettings::MEM_ALIGNMENT);
+            f.m_other  = (u8*)m_allocator->allocate(f.m_buffer_size, ESettings::MEM_ALIGNMENT);
+            bool result = f.m_buffer != nullptr && f.m_other != nullptr;
+            result      = result && srcfd->openFile(src, EFileMode::Value_Open, EFileAccess::Value_Read, EFileOp::Value_Sync, f.m_src);
+            result      = result && dstfd->openFile(dst, EFileMode::Value_Open, EFileAccess::Value_ReadWrite, EFileOp::Value_Sync, f.m_dst);
+
+            // A destination with the same content is left alone, REPLACE would otherwise
+            // make a new file of the same data.
+            bool same = false;
+            if (result && options.m_write == ESyncWrite::REPLACE && src_size == dst_size)
+                result = sSameContent(f, same);
+
+            if (result && !same)
+            {
+                if (options.m_write == ESyncWrite::IN_PLACE)
+                {
+                    result = sSyncInPlace(f) && dstfd->flushFile(f.m_dst);
+                }
+                else if (dstfd->createTempFile(dst, f.m_temp))
+                {
+                    // The destination is closed before it is replaced
+                    result = sSyncReplace(f, m_allocator);
+                    dstfd->closeFile(f.m_dst);
+                    f.m_dst = nullptr;
+                    result  = result && dstfd->flushFile(f.m_temp) && dstfd->linkTempFile(f.m_temp, dst);
+                    dstfd->closeFile(f.m_temp);
+                }
+                else
+                {
+                    // REPLACE promises an atomic replace, the destination is left as it is
+                    result = false;
+                }
+            }
+            else if (same)
+            {
+                f.m_matched = src_size;
+            }
+
+            if (f.m_src != nullptr)
+                srcfd->closeFile(f.m_src);
+            if (f.m_dst != nullptr)
+                dstfd->closeFile(f.m_dst);
+            if (f.m_buffer != nullptr)
+                m_allocator->deallocate(f.m_buffer);
+            if (f.m_other != nullptr)
+                m_allocator->deallocate(f.m_other);
+
+            if (result)
+            {
+                dstfd->setFileTime(dst, src_times);
+                sCountSync(options.m_stats, f.m_written == 0 && src_size == dst_size, f.m_matched, f.m_written);
+            }
+            return result;
+        }
+
+    } // namespace nfs
+}; // namespace ncore
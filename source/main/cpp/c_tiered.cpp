@@ -0,0 +1,910 @@
+#include "ccore/c_target.h"
+#include "ccore/c_debug.h"
+#include "cbase/c_allocator.h"
+#include "cbase/c_memory.h"
+
+#include "cfilesystem/c_filepath.h"
+#include "cfilesystem/c_filesystem.h"
+
+#include "cfilesystem/private/c_atomic.h"
+#include "cfilesystem/private/c_enumerations.h"
+#include "cfilesystem/private/c_filedevice.h"
+#include "cfilesystem/private/c_filesystem.h"
+#include "cfilesystem/private/c_ioscheduler.h"
+#include "cfilesystem/private/c_tinylfu.h"
+
+namespace ncore
+{
+    namespace nfs
+    {
+        extern filesys_t* mImpl;
+
+        enum
+        {
+            TIER_MIN_BUCKETS   = 64,
+            TIER_SYNC_BATCH    = 64,
+            TIER_MAX_FILE_SIZE = 0xFFFFFFFF, // Entries are allocated with a u32 size
+        };
+
+        static inline u32 sBucketOf(u64 key, u32 mask) { return (u32)((key * 0x9E3779B97F4A7C15ull) >> 32) & mask; }
+
+        // A file in the memory tier. m_refs is guarded by the lock of the device, it is
+        // -1 while the entry is being evicted. An entry that has been dropped is not
+        // resident anymore, the last reference frees it.
+        struct tierentry_t
+        {
+            u64          m_key;
+            u64          m_modified;
+            u64          m_size;
+            u8*          m_data;
+            s32          m_refs;
+            s32 volatile m_dirty;
+            bool         m_resident;
+            filepath_t   m_path; // Where dirty data is written back to
+            tierentry_t* m_hash_next;
+            tierentry_t* m_lru_prev; // Towards the most recently used
+            tierentry_t* m_lru_next;
+            tierentry_t* m_evict_next;
+
+            DCORE_CLASS_PLACEMENT_NEW_DELETE
+        };
+
+        // The handle given out by the device. A read-only handle of a file in the memory
+        // tier has no handle of the slow device until an operation needs one.
+        struct tierhandle_t
+        {
+            void*        m_handle;
+            tierentry_t* m_entry;
+            filepath_t   m_path;
+            bool         m_write;
+            bool         m_written; // Written through, the identity on the device has changed
+
+            DCORE_CLASS_PLACEMENT_NEW_DELETE
+        };
+
+        // A decorator of the slow device with a memory tier of whole files. Opening or
+        // loading a file counts its use in the frequency sketch, a file that is used
+        // often enough and that wins against the victims it would evict is read into
+        // memory. The entries are in a hash table and a LRU list under one spinlock,
+        // the data of an entry is copied outside of the lock while a reference is held.
+        class filedevice_tiered_t : public filedevice_t
+        {
+        public:
+            DCORE_CLASS_PLACEMENT_NEW_DELETE
+
+            filedevice_tiered_t(filedevice_t* device, alloc_t* allocator, tieroptions_t const& options) : m_device(device), m_allocator(allocator), m_options(options), m_lru_head(nullptr), m_lru_tail(nullptr), m_used(0)
+            {
+                u32 buckets = TIER_MIN_BUCKETS;
+                while (buckets < options.m_sketch_width)
+                    buckets <<= 1;
+                m_bucket_mask = buckets - 1;
+                m_buckets     = (tierentry_t**)allocator->allocate(sizeof(tierentry_t*) * buckets);
+                for (u32 i = 0; i < buckets; ++i)
+                    m_buckets[i] = nullptr;
+                m_sketch.init(allocator, options.m_sketch_width);
+
+                if (m_options.m_max_file_size > TIER_MAX_FILE_SIZE)
+                    m_options.m_max_file_size = TIER_MAX_FILE_SIZE;
+            }
+
+            virtual ~filedevice_tiered_t()
+            {
+                while (m_lru_head != nullptr)
+                {
+                    tierentry_t* e = m_lru_head;
+                    write_back(e, nullptr);
+                    unlink_locked(e);
+                    free_entry(e);
+                }
+                m_sketch.exit();
+                m_allocator->deallocate(m_buckets);
+            }
+
+            virtual void destruct(alloc_t* allocator) { allocator->destruct(this); }
+
+            virtual bool canWrite() const { return m_device->canWrite(); }
+            virtual bool canSeek() const { return m_device->canSeek(); }
+
+            virtual bool getDeviceInfo(filedevice_t* device, u64& totalSpace, u64& freeSpace) const { return m_device->getDeviceInfo(device, totalSpace, freeSpace); }
+
+            virtual bool openFile(filepath_t const& szFilename, EFileMode::Enum mode, EFileAccess::Enum access, EFileOp::Enum op, void*& outHandle);
+            virtual bool createFile(const filepath_t& szFilename, bool boRead, bool boWrite, void*& nFileHandle);
+            virtual bool readFile(void* pHandle, u64 pos, void* buffer, u64 count, u64& outNumBytesRead);
+            virtual bool writeFile(void* pHandle, u64 pos, void const* buffer, u64 count, u64& outNumBytesWritten);
+            virtual bool flushFile(void* pHandle);
+            virtual bool closeFile(void* pHandle);
+
+            virtual bool readFileV(void* pHandle, u64 pos, iospan_t const* spans, s32 count, u64& outNumBytesRead);
+            virtual bool writeFileV(void* pHandle, u64 pos, ciospan_t const* spans, s32 count, u64& outNumBytesWritten);
+
+            virtual bool loadFile(filepath_t const& szFilename, alloc_t* allocator, u64 mapThreshold, u8 const*& outData, u64& outSize, void*& outMapping);
+            virtual bool loadFile(filepath_t const& szFilename, u8* buffer, u64 capacity, u64& outSize);
+            virtual bool unmapFile(void* mapping) { return m_device->unmapFile(mapping); }
+            virtual bool mapFile(void* pHandle, u64 pos, u64 count, u8 const*& outData, void*& outMapping);
+            virtual bool mapFileWritable(void* pHandle, u64 pos, u64 count, u8*& outData, void*& outMapping);
+            virtual bool flushMapping(void* pHandle, void const* address, u64 count, bool boWait) { return m_device->flushMapping(inner(pHandle), address, count, boWait); }
+
+            virtual bool statFile(filepath_t const& szFilename, u64& outSize, fileattrs_t* outAttr, filetimes_t* outTimes) { return m_device->statFile(szFilename, outSize, outAttr, outTimes); }
+            virtual bool identifyFile(filepath_t const& szFilename, u64& outId, u64& outModified, u64& outSize) { return m_device->identifyFile(szFilename, outId, outModified, outSize); }
+
+            virtual bool createStream(filepath_t const& szFilename, bool boRead, bool boWrite, stream_t& strm) { return m_device->createStream(szFilename, boRead, boWrite, strm); }
+            virtual bool closeStream(stream_t& strm) { return m_device->closeStream(strm); }
+
+            virtual bool setLengthOfFile(void* pHandle, u64 inLength);
+            virtual bool getLengthOfFile(void* pHandle, u64& outLength);
+
+            virtual bool setFileTime(filepath_t const& szFilename, filetimes_t const& times) { return m_device->setFileTime(szFilename, times); }
+            virtual bool getFileTime(filepath_t const& szFilename, filetimes_t& outTimes) { return m_device->getFileTime(szFilename, outTimes); }
+            virtual bool setFileAttr(filepath_t const& szFilename, fileattrs_t const& attr) { return m_device->setFileAttr(szFilename, attr); }
+            virtual bool getFileAttr(filepath_t const& szFilename, fileattrs_t& attr) { return m_device->getFileAttr(szFilename, attr); }
+
+            virtual bool setFileTime(void* pHandle, filetimes_t const& times) { return m_device->setFileTime(inner(pHandle), times); }
+            virtual bool getFileTime(void* pHandle, filetimes_t& outTimes) { return m_device->getFileTime(inner(pHandle), outTimes); }
+
+            virtual bool hasFile(filepath_t const& szFilename) { return m_device->hasFile(szFilename); }
+            virtual bool moveFile(filepath_t const& szFilename, filepath_t const& szToFilename, bool boOverwrite);
+            virtual bool copyFile(filepath_t const& szFilename, filepath_t const& szToFilename, bool boOverwrite);
+            virtual bool deleteFile(filepath_t const& szFilename);
+
+            virtual bool openDir(dirpath_t const& szDirPath, void*& nDirHandle) { return m_device->openDir(szDirPath, nDirHandle); }
+            virtual bool hasDir(dirpath_t const& szDirPath) { return m_device->hasDir(szDirPath); }
+            virtual bool moveDir(dirpath_t const& szDirPath, dirpath_t const& szToDirPath, bool boOverwrite) { return m_device->moveDir(szDirPath, szToDirPath, boOverwrite); }
+            virtual bool copyDir(dirpath_t const& szDirPath, dirpath_t const& szToDirPath, bool boOverwrite) { return m_device->copyDir(szDirPath, szToDirPath, boOverwrite); }
+            virtual bool createDir(dirpath_t const& szDirPath) { return m_device->createDir(szDirPath); }
+            virtual bool deleteDir(dirpath_t const& szDirPath) { return m_device->deleteDir(szDirPath); }
+
+            virtual s32  deleteFiles(filepath_t const* szFilenames, s32 count);
+            virtual bool removeDir(dirpath_t const& szDirPath) { return m_device->removeDir(szDirPath); }
+            virtual bool canClone(dirpath_t const& szDirPath) { return m_device->canClone(szDirPath); }
+            virtual bool cloneFileRange(void* pSrcHandle, u64 srcPos, void* pDstHandle, u64 dstPos, u64 count);
+
+            virtual bool isSparseFile(void* pHandle) { return m_device->isSparseFile(inner(pHandle)); }
+            virtual bool setSparseFile(void* pHandle) { return m_device->setSparseFile(inner(pHandle)); }
+            virtual bool nextDataExtent(void* pHandle, u64 pos, u64& outDataPos, u64& outDataEnd) { return m_device->nextDataExtent(inner(pHandle), pos, outDataPos, outDataEnd); }
+            virtual bool punchHole(void* pHandle, u64 pos, u64 count);
+            virtual bool preallocate(void* pHandle, u64 pos, u64 count);
+            virtual bool reserveFile(void* pHandle, u64 size) { return m_device->reserveFile(inner(pHandle), size); }
+            virtual bool adviseFile(void* pHandle, u64 pos, u64 count, s32 advice);
+            virtual bool syncFileRange(void* pHandle, u64 pos, u64 count, bool boWait);
+            virtual bool flushDir(dirpath_t const& szDirPath) { return m_device->flushDir(szDirPath); }
+            virtual bool syncVolume(void* const* pHandles, s32 count);
+            virtual bool createTempFile(filepath_t const& szFilename, void*& outHandle);
+            virtual bool linkTempFile(void* pHandle, filepath_t const& szFilename);
+
+            virtual bool setDirTime(dirpath_t const& szDirPath, filetimes_t const& ftimes) { return m_device->setDirTime(szDirPath, ftimes); }
+            virtual bool getDirTime(dirpath_t const& szDirPath, filetimes_t& ftimes) { return m_device->getDirTime(szDirPath, ftimes); }
+            virtual bool setDirAttr(dirpath_t const& szDirPath, fileattrs_t const& attr) { return m_device->setDirAttr(szDirPath, attr); }
+            virtual bool getDirAttr(dirpath_t const& szDirPath, fileattrs_t& attr) { return m_device->getDirAttr(szDirPath, attr); }
+
+            virtual bool enumerate(dirpath_t const& szDirPath, enumerate_delegate_t& enumerator) { return m_device->enumerate(szDirPath, enumerator); }
+
+            tierentry_t* acquire(filepath_t const& szFilename);
+            tierentry_t* promote(filepath_t const& szFilename, u64 key, u64 modified, u64 size);
+            tierentry_t* lock_entry(u64 key);
+            tierentry_t* find_locked(u64 key) const;
+            bool         make_room_locked(u64 key, u64 size, tierentry_t*& outVictims);
+            void         link_locked(tierentry_t* e);
+            void         unlink_locked(tierentry_t* e);
+            void         unhash_locked(tierentry_t* e);
+            void         touch_locked(tierentry_t* e);
+            bool         drop_locked(tierentry_t* e);
+            void         release(tierentry_t* e);
+            void         detach(tierhandle_t* th);
+            void         forget(filepath_t const& szFilename, bool boWriteBack);
+            void         refresh(tierentry_t* e);
+            bool         write_back(tierentry_t* e, void* pHandle);
+            void         free_entry(tierentry_t* e);
+            tierhandle_t* wrap(filepath_t const& szFilename, void* pHandle, tierentry_t* e, bool boWrite);
+            void*        inner(void* pHandle);
+
+            filedevice_t* m_device;
+            alloc_t*      m_allocator;
+            tieroptions_t m_options;
+            spinlock_t    m_lock;
+            tinylfu_t     m_sketch;
+            tierentry_t** m_buckets;
+            u32           m_bucket_mask;
+            tierentry_t*  m_lru_head;
+            tierentry_t*  m_lru_tail;
+            u64           m_used;
+        };
+
+        // -----------------------------------------------------------
+        // entries
+        // -----------------------------------------------------------
+
+        // Counts the use of the file and returns its entry with a reference held, a file
+        // that is not in memory yet is promoted when it is hot. A resident entry that no
+        // longer matches the file on the device is dropped, unless it has data that has
+        // not been written back.
+        tierentry_t* filedevice_tiered_t::acquire(filepath_t const& szFilename)
+        {
+            u64 id       = 0;
+            u64 modified = 0;
+            u64 size     = 0;
+            if (!m_device->identifyFile(szFilename, id, modified, size))
+                return nullptr;
+
+            tierentry_t* e = lock_entry(id);
+            m_sketch.increment(id);
+            if (e != nullptr && (e->m_modified != modified || e->m_size != size) && natomic::load(&e->m_dirty) == 0)
+            {
+                tierentry_t* stale = drop_locked(e) ? e : nullptr;
+                m_lock.unlock();
+                if (stale != nullptr)
+                    free_entry(stale);
+                m_lock.lock();
+                e = nullptr;
+            }
+            if (e != nullptr)
+            {
+                e->m_refs += 1;
+                touch_locked(e);
+                m_lock.unlock();
+                return e;
+            }
+            bool const hot = size > 0 && size <= m_options.m_max_file_size && size <= m_options.m_budget && m_sketch.estimate(id) >= m_options.m_promote_threshold;
+            m_lock.unlock();
+            return hot ? promote(szFilename, id, modified, size) : nullptr;
+        }
+
+        // The file is read before the lock is taken, another thread may have promoted it
+        // in the meantime. The victims are taken out of the LRU list under the lock and
+        // evicted (written back when dirty) after it has been released.
+        tierentry_t* filedevice_tiered_t::promote(filepath_t const& szFilename, u64 key, u64 modified, u64 size)
+        {
+            u8* data = (u8*)m_allocator->allocate((u32)size, ESettings::MEM_ALIGNMENT);
+            if (data == nullptr)
+                return nullptr;
+            u64 n = 0;
+            if (!m_device->loadFile(szFilename, data, size, n) || n != size)
+            {
+                m_allocator->deallocate(data);
+                return nullptr;
+            }
+
+            tierentry_t* e  = m_allocator->construct<tierentry_t>();
+            e->m_key        = key;
+            e->m_modified   = modified;
+            e->m_size       = size;
+            e->m_data       = data;
+            e->m_refs       = 1;
+            e->m_dirty      = 0;
+            e->m_resident   = true;
+            e->m_path       = szFilename;
+            e->m_hash_next  = nullptr;
+            e->m_lru_prev   = nullptr;
+            e->m_lru_next   = nullptr;
+            e->m_evict_next = nullptr;
+
+            tierentry_t* victims = nullptr;
+            tierentry_t* other   = lock_entry(key);
+            bool const   admit   = other == nullptr && make_room_locked(key, size, victims);
+            if (admit)
+                link_locked(e);
+            else if (other != nullptr)
+                other->m_refs += 1;
+            m_lock.unlock();
+
+            while (victims != nullptr)
+            {
+                tierentry_t* v = victims;
+                victims        = v->m_evict_next;
+                write_back(v, nullptr);
+                m_lock.lock();
+                unhash_locked(v);
+                m_lock.unlock();
+                free_entry(v);
+            }
+
+            if (!admit)
+            {
+                free_entry(e);
+                return other;
+            }
+            return e;
+        }
+
+        // Returns with the lock held, an entry of the key that is being evicted is waited for
+        tierentry_t* filedevice_tiered_t::lock_entry(u64 key)
+        {
+            for (;;)
+            {
+                m_lock.lock();
+                tierentry_t* e = find_locked(key);
+                if (e == nullptr || e->m_refs >= 0)
+                    return e;
+                m_lock.unlock();
+                io_yield();
+            }
+        }
+
+        tierentry_t* filedevice_tiered_t::find_locked(u64 key) const
+        {
+            tierentry_t* e = m_buckets[sBucketOf(key, m_bucket_mask)];
+            while (e != nullptr && e->m_key != key)
+                e = e->m_hash_next;
+            return e;
+        }
+
+        // The least recently used entries that are not in use are the victims, the
+        // candidate has to be estimated to be used more often than every one of them.
+        // Nothing is evicted when the candidate is not admitted.
+        bool filedevice_tiered_t::make_room_locked(u64 key, u64 size, tierentry_t*& outVictims)
+        {
+            u64          freed = 0;
+            tierentry_t* v     = m_lru_tail;
+            while ((m_used - freed + size) > m_options.m_budget)
+            {
+                while (v != nullptr && v->m_refs != 0)
+                    v = v->m_lru_prev;
+                if (v == nullptr || !m_sketch.admit(key, v->m_key))
+                    return false;
+                freed += v->m_size;
+                v = v->m_lru_prev;
+            }
+
+            while ((m_used + size) > m_options.m_budget)
+            {
+                v = m_lru_tail;
+                while (v->m_refs != 0)
+                    v = v->m_lru_prev;
+                unlink_locked(v);
+                v->m_refs       = -1; // Stays in the table until it has been evicted
+                v->m_evict_next = outVictims;
+                outVictims      = v;
+            }
+            return true;
+        }
+
+        void filedevice_tiered_t::link_locked(tierentry_t* e)
+        {
+            tierentry_t*& bucket = m_buckets[sBucketOf(e->m_key, m_bucket_mask)];
+            e->m_hash_next       = bucket;
+            bucket               = e;
+
+            e->m_lru_prev = nullptr;
+            e->m_lru_next = m_lru_head;
+            if (m_lru_head != nullptr)
+                m_lru_head->m_lru_prev = e;
+            m_lru_head = e;
+            if (m_lru_tail == nullptr)
+                m_lru_tail = e;
+            m_used += e->m_size;
+        }
+
+        // Takes the entry out of the LRU list and the budget, an entry that is unlinked
+        // this way has to be taken out of the table with unhash_locked().
+        void filedevice_tiered_t::unlink_locked(tierentry_t* e)
+        {
+            if (e->m_lru_prev != nullptr)
+                e->m_lru_prev->m_lru_next = e->m_lru_next;
+            else
+                m_lru_head = e->m_lru_next;
+            if (e->m_lru_next != nullptr)
+                e->m_lru_next->m_lru_prev = e->m_lru_prev;
+            else
+                m_lru_tail = e->m_lru_prev;
+            e->m_lru_prev = nullptr;
+            e->m_lru_next = nullptr;
+            m_used -= e->m_size;
+        }
+
+        void filedevice_tiered_t::unhash_locked(tierentry_t* e)
+        {
+            tierentry_t** link = &m_buckets[sBucketOf(e->m_key, m_bucket_mask)];
+            while (*link != nullptr && *link != e)
+                link = &(*link)->m_hash_next;
+            if (*link == e)
+                *link = e->m_hash_next;
+            e->m_hash_next = nullptr;
+            e->m_resident  = false;
+        }
+
+        void filedevice_tiered_t::touch_locked(tierentry_t* e)
+        {
+            if (m_lru_head == e)
+                return;
+            unlink_locked(e);
+            e->m_lru_next          = m_lru_head;
+            m_lru_head->m_lru_prev = e;
+            m_lru_head             = e;
+            m_used += e->m_size;
+        }
+
+        // Returns true when the caller has to free the entry (after releasing the lock)
+        bool filedevice_tiered_t::drop_locked(tierentry_t* e)
+        {
+            if (e->m_resident)
+            {
+                unlink_locked(e);
+                unhash_locked(e);
+            }
+            return e->m_refs == 0;
+        }
+
+        void filedevice_tiered_t::release(tierentry_t* e)
+        {
+            m_lock.lock();
+            e->m_refs -= 1;
+            bool const unused = e->m_refs == 0 && !e->m_resident;
+            m_lock.unlock();
+            if (unused)
+                free_entry(e);
+        }
+
+        // The handle continues without the memory tier, what is dirty is written back first
+        void filedevice_tiered_t::detach(tierhandle_t* th)
+        {
+            tierentry_t* e = th->m_entry;
+            if (e == nullptr)
+                return;
+            write_back(e, inner(th));
+            m_lock.lock();
+            drop_locked(e);
+            e->m_refs -= 1;
+            bool const unused = e->m_refs == 0;
+            m_lock.unlock();
+            th->m_entry = nullptr;
+            if (unused)
+                free_entry(e);
+        }
+
+        // Drops the file from the memory tier before the device changes or removes it
+        void filedevice_tiered_t::forget(filepath_t const& szFilename, bool boWriteBack)
+        {
+            u64 id       = 0;
+            u64 modified = 0;
+            u64 size     = 0;
+            if (!m_device->identifyFile(szFilename, id, modified, size))
+                return;
+
+            tierentry_t* e = lock_entry(id);
+            if (e == nullptr)
+            {
+                m_lock.unlock();
+                return;
+            }
+            if (boWriteBack && natomic::load(&e->m_dirty) != 0)
+            {
+                e->m_refs += 1;
+                m_lock.unlock();
+                write_back(e, nullptr);
+                m_lock.lock();
+                e->m_refs -= 1;
+            }
+            bool const unused = drop_locked(e);
+            m_lock.unlock();
+            if (unused)
+                free_entry(e);
+        }
+
+        // After a write the device has a new write time for the file, the entry takes it
+        // over so that it is not seen as stale.
+        void filedevice_tiered_t::refresh(tierentry_t* e)
+        {
+            u64 id       = 0;
+            u64 modified = 0;
+            u64 size     = 0;
+            if (!m_device->identifyFile(e->m_path, id, modified, size))
+                return;
+            m_lock.lock();
+            if (e->m_resident && id == e->m_key && size == e->m_size)
+                e->m_modified = modified;
+            m_lock.unlock();
+        }
+
+        // The dirty flag is cleared before the data is written, a write that happens at
+        // the same time marks the entry dirty again.
+        bool filedevice_tiered_t::write_back(tierentry_t* e, void* pHandle)
+        {
+            if (natomic::exchange(&e->m_dirty, 0) == 0)
+                return true;
+
+            void* handle = pHandle;
+            if (handle == nullptr && !m_device->openFile(e->m_path, EFileMode::Value_Open, EFileAccess::Value_ReadWrite, EFileOp::Value_Sync, handle))
+            {
+                natomic::store(&e->m_dirty, 1);
+                return false;
+            }
+            u64        n       = 0;
+            bool const written = m_device->writeFile(handle, 0, e->m_data, e->m_size, n) && n == e->m_size;
+            if (pHandle == nullptr)
+                m_device->closeFile(handle);
+            if (!written)
+                natomic::store(&e->m_dirty, 1);
+            else
+                refresh(e);
+            return written;
+        }
+
+        void filedevice_tiered_t::free_entry(tierentry_t* e)
+        {
+            m_allocator->deallocate(e->m_data);
+            m_allocator->destruct(e);
+        }
+
+        tierhandle_t* filedevice_tiered_t::wrap(filepath_t const& szFilename, void* pHandle, tierentry_t* e, bool boWrite)
+        {
+            tierhandle_t* th = m_allocator->construct<tierhandle_t>();
+            th->m_handle     = pHandle;
+            th->m_entry      = e;
+            th->m_path       = szFilename;
+            th->m_write      = boWrite;
+            th->m_written    = false;
+            return th;
+        }
+
+        // The handle of the slow device, opened for reading when the file was served from memory
+        void* filedevice_tiered_t::inner(void* pHandle)
+        {
+            tierhandle_t* th = (tierhandle_t*)pHandle;
+            if (th->m_handle == nullptr)
+                m_device->openFile(th->m_path, EFileMode::Value_Open, EFileAccess::Value_Read, EFileOp::Value_Sync, th->m_handle);
+            return th->m_handle;
+        }
+
+        // -----------------------------------------------------------
+        // files
+        // -----------------------------------------------------------
+
+        // Modes that replace the content or only append do not use the memory tier
+        bool filedevice_tiered_t::openFile(filepath_t const& szFilename, EFileMode::Enum mode, EFileAccess::Enum access, EFileOp::Enum op, void*& outHandle)
+        {
+            bool const write = !access.IsRead();
+            if (mode.IsCreate() || mode.IsTruncate())
+                forget(szFilename, false);
+
+            tierentry_t* e = nullptr;
+            if (mode.IsOpen() || mode.IsOpenOrCreate())
+                e = acquire(szFilename);
+
+            void* handle = nullptr;
+            if ((write || e == nullptr) && !m_device->openFile(szFilename, mode, access, op, handle))
+            {
+                if (e != nullptr)
+                    release(e);
+                return false;
+            }
+            outHandle = wrap(szFilename, handle, e, write);
+            return true;
+        }
+
+        bool filedevice_tiered_t::createFile(const filepath_t& szFilename, bool boRead, bool boWrite, void*& nFileHandle)
+        {
+            forget(szFilename, false);
+            void* handle = nullptr;
+            if (!m_device->createFile(szFilename, boRead, boWrite, handle))
+                return false;
+            nFileHandle = wrap(szFilename, handle, nullptr, boWrite);
+            return true;
+        }
+
+        bool filedevice_tiered_t::readFile(void* pHandle, u64 pos, void* buffer, u64 count, u64& outNumBytesRead)
+        {
+            tierhandle_t* th = (tierhandle_t*)pHandle;
+            tierentry_t*  e  = th->m_entry;
+            if (e == nullptr)
+                return m_device->readFile(th->m_handle, pos, buffer, count, outNumBytesRead);
+
+            u64 const n = pos < e->m_size ? ((e->m_size - pos) < count ? (e->m_size - pos) : count) : 0;
+            if (n > 0)
+                nmem::memcpy(buffer, e->m_data + pos, (u32)n);
+            outNumBytesRead = n;
+            return true;
+        }
+
+        // A write within the file updates the memory tier and, unless writing back, the
+        // device. A write that extends the file detaches it from the memory tier.
+        bool filedevice_tiered_t::writeFile(void* pHandle, u64 pos, void const* buffer, u64 count, u64& outNumBytesWritten)
+        {
+            tierhandle_t* th = (tierhandle_t*)pHandle;
+            if (!th->m_write)
+                return m_device->writeFile(inner(pHandle), pos, buffer, count, outNumBytesWritten);
+            if (th->m_entry != nullptr && (pos + count) > th->m_entry->m_size)
+                detach(th);
+
+            tierentry_t* e = th->m_entry;
+            if (e == nullptr)
+                return m_device->writeFile(th->m_handle, pos, buffer, count, outNumBytesWritten);
+
+            if (m_options.m_write == ETierWrite::BACK)
+            {
+                nmem::memcpy(e->m_data + pos, buffer, (u32)count);
+                natomic::store(&e->m_dirty, 1);
+                outNumBytesWritten = count;
+                return true;
+            }
+            th->m_written = true;
+            if (!m_device->writeFile(th->m_handle, pos, buffer, count, outNumBytesWritten))
+                return false;
+            nmem::memcpy(e->m_data + pos, buffer, (u32)outNumBytesWritten);
+            return true;
+        }
+
+        bool filedevice_tiered_t::flushFile(void* pHandle)
+        {
+            tierhandle_t* th = (tierhandle_t*)pHandle;
+            if (th->m_entry != nullptr && !write_back(th->m_entry, th->m_handle))
+                return false;
+            return th->m_handle == nullptr || m_device->flushFile(th->m_handle);
+        }
+
+        // Dirty data of the file stays in memory, it is written back by a flush, on
+        // eviction or when the device is destroyed.
+        bool filedevice_tiered_t::closeFile(void* pHandle)
+        {
+            tierhandle_t* th = (tierhandle_t*)pHandle;
+            bool const    ok = th->m_handle == nullptr || m_device->closeFile(th->m_handle);
+            if (th->m_entry != nullptr)
+            {
+                if (th->m_written)
+                    refresh(th->m_entry);
+                release(th->m_entry);
+            }
+            m_allocator->destruct(th);
+            return ok;
+        }
+
+        bool filedevice_tiered_t::readFileV(void* pHandle, u64 pos, iospan_t const* spans, s32 count, u64& outNumBytesRead)
+        {
+            tierhandle_t* th = (tierhandle_t*)pHandle;
+            if (th->m_entry == nullptr)
+                return m_device->readFileV(th->m_handle, pos, spans, count, outNumBytesRead);
+
+            u64 total = 0;
+            for (s32 i = 0; i < count; ++i)
+            {
+                u64 n = 0;
+                readFile(pHandle, pos + total, spans[i].m_data, spans[i].m_size, n);
+                total += n;
+                if (n < spans[i].m_size)
+                    break;
+            }
+            outNumBytesRead = total;
+            return true;
+        }
+
+        bool filedevice_tiered_t::writeFileV(void* pHandle, u64 pos, ciospan_t const* spans, s32 count, u64& outNumBytesWritten)
+        {
+            tierhandle_t* th = (tierhandle_t*)pHandle;
+            if (!th->m_write)
+                return m_device->writeFileV(inner(pHandle), pos, spans, count, outNumBytesWritten);
+
+            u64 total = 0;
+            for (s32 i = 0; i < count; ++i)
+                total += spans[i].m_size;
+            if (th->m_entry != nullptr && (pos + total) > th->m_entry->m_size)
+                detach(th);
+
+            tierentry_t* e = th->m_entry;
+            if (e == nullptr)
+                return m_device->writeFileV(th->m_handle, pos, spans, count, outNumBytesWritten);
+
+            bool const back = m_options.m_write == ETierWrite::BACK;
+            if (!back)
+            {
+                th->m_written = true;
+                if (!m_device->writeFileV(th->m_handle, pos, spans, count, total))
+                    return false;
+            }
+
+            u64 at = pos;
+            for (s32 i = 0; i < count && at < (pos + total); ++i)
+            {
+                u64 const n = (pos + total - at) < spans[i].m_size ? (pos + total - at) : spans[i].m_size;
+                nmem::memcpy(e->m_data + at, spans[i].m_data, (u32)n);
+                at += n;
+            }
+            if (back)
+                natomic::store(&e->m_dirty, 1);
+            outNumBytesWritten = total;
+            return true;
+        }
+
+        // The data is always copied out, the memory tier does not hand out its entries
+        bool filedevice_tiered_t::loadFile(filepath_t const& szFilename, alloc_t* allocator, u64 mapThreshold, u8 const*& outData, u64& outSize, void*& outMapping)
+        {
+            tierentry_t* e = acquire(szFilename);
+            if (e == nullptr)
+                return m_device->loadFile(szFilename, allocator, mapThreshold, outData, outSize, outMapping);
+
+            u8* data = (u8*)allocator->allocate((u32)e->m_size, ESettings::MEM_ALIGNMENT);
+            if (data != nullptr)
+                nmem::memcpy(data, e->m_data, (u32)e->m_size);
+            outData    = data;
+            outSize    = data != nullptr ? e->m_size : 0;
+            outMapping = nullptr;
+            release(e);
+            return data != nullptr;
+        }
+
+        bool filedevice_tiered_t::loadFile(filepath_t const& szFilename, u8* buffer, u64 capacity, u64& outSize)
+        {
+            tierentry_t* e = acquire(szFilename);
+            if (e == nullptr)
+                return m_device->loadFile(szFilename, buffer, capacity, outSize);
+
+            bool const fits = e->m_size <= capacity;
+            if (fits)
+                nmem::memcpy(buffer, e->m_data, (u32)e->m_size);
+            outSize = fits ? e->m_size : 0;
+            release(e);
+            return fits;
+        }
+
+        // A mapping shows the file on the device, dirty data is written back first
+        bool filedevice_tiered_t::mapFile(void* pHandle, u64 pos, u64 count, u8 const*& outData, void*& outMapping)
+        {
+            tierhandle_t* th = (tierhandle_t*)pHandle;
+            if (th->m_entry != nullptr)
+                write_back(th->m_entry, th->m_handle);
+            return m_device->mapFile(inner(pHandle), pos, count, outData, outMapping);
+        }
+
+        bool filedevice_tiered_t::mapFileWritable(void* pHandle, u64 pos, u64 count, u8*& outData, void*& outMapping)
+        {
+            tierhandle_t* th = (tierhandle_t*)pHandle;
+            detach(th);
+            return m_device->mapFileWritable(th->m_handle, pos, count, outData, outMapping);
+        }
+
+        bool filedevice_tiered_t::setLengthOfFile(void* pHandle, u64 inLength)
+        {
+            tierhandle_t* th = (tierhandle_t*)pHandle;
+            detach(th);
+            return m_device->setLengthOfFile(th->m_handle, inLength);
+        }
+
+        bool filedevice_tiered_t::getLengthOfFile(void* pHandle, u64& outLength)
+        {
+            tierhandle_t* th = (tierhandle_t*)pHandle;
+            if (th->m_entry == nullptr)
+                return m_device->getLengthOfFile(th->m_handle, outLength);
+            outLength = th->m_entry->m_size;
+            return true;
+        }
+
+        bool filedevice_tiered_t::moveFile(filepath_t const& szFilename, filepath_t const& szToFilename, bool boOverwrite)
+        {
+            forget(szFilename, true);
+            if (boOverwrite)
+                forget(szToFilename, false);
+            return m_device->moveFile(szFilename, szToFilename, boOverwrite);
+        }
+
+        bool filedevice_tiered_t::copyFile(filepath_t const& szFilename, filepath_t const& szToFilename, bool boOverwrite)
+        {
+            u64 id       = 0;
+            u64 modified = 0;
+            u64 size     = 0;
+            if (m_device->identifyFile(szFilename, id, modified, size))
+            {
+                tierentry_t* e = lock_entry(id);
+                if (e != nullptr)
+                    e->m_refs += 1;
+                m_lock.unlock();
+                if (e != nullptr)
+                {
+                    write_back(e, nullptr); // The copy is made by the device
+                    release(e);
+                }
+            }
+            if (boOverwrite)
+                forget(szToFilename, false);
+            return m_device->copyFile(szFilename, szToFilename, boOverwrite);
+        }
+
+        bool filedevice_tiered_t::deleteFile(filepath_t const& szFilename)
+        {
+            forget(szFilename, false);
+            return m_device->deleteFile(szFilename);
+        }
+
+        s32 filedevice_tiered_t::deleteFiles(filepath_t const* szFilenames, s32 count)
+        {
+            for (s32 i = 0; i < count; ++i)
+                forget(szFilenames[i], false);
+            return m_device->deleteFiles(szFilenames, count);
+        }
+
+        bool filedevice_tiered_t::cloneFileRange(void* pSrcHandle, u64 srcPos, void* pDstHandle, u64 dstPos, u64 count)
+        {
+            tierhandle_t* src = (tierhandle_t*)pSrcHandle;
+            tierhandle_t* dst = (tierhandle_t*)pDstHandle;
+            if (src->m_entry != nullptr)
+                write_back(src->m_entry, src->m_handle);
+            detach(dst);
+            return m_device->cloneFileRange(inner(src), srcPos, dst->m_handle, dstPos, count);
+        }
+
+        bool filedevice_tiered_t::punchHole(void* pHandle, u64 pos, u64 count)
+        {
+            tierhandle_t* th = (tierhandle_t*)pHandle;
+            detach(th);
+            return m_device->punchHole(th->m_handle, pos, count);
+        }
+
+        bool filedevice_tiered_t::preallocate(void* pHandle, u64 pos, u64 count)
+        {
+            tierhandle_t* th = (tierhandle_t*)pHandle;
+            detach(th);
+            return m_device->preallocate(th->m_handle, pos, count);
+        }
+
+        // A file that is served from memory needs no read-ahead from the device
+        bool filedevice_tiered_t::adviseFile(void* pHandle, u64 pos, u64 count, s32 advice)
+        {
+            tierhandle_t* th = (tierhandle_t*)pHandle;
+            if (th->m_entry != nullptr && th->m_handle == nullptr)
+                return true;
+            return m_device->adviseFile(inner(pHandle), pos, count, advice);
+        }
+
+        bool filedevice_tiered_t::syncFileRange(void* pHandle, u64 pos, u64 count, bool boWait)
+        {
+            tierhandle_t* th = (tierhandle_t*)pHandle;
+            if (th->m_entry != nullptr && !write_back(th->m_entry, th->m_handle))
+                return false;
+            return th->m_handle == nullptr || m_device->syncFileRange(th->m_handle, pos, count, boWait);
+        }
+
+        // The handles are passed on in batches, a handle that was served from memory has
+        // nothing on the device to sync.
+        bool filedevice_tiered_t::syncVolume(void* const* pHandles, s32 count)
+        {
+            void* handles[TIER_SYNC_BATCH];
+            bool  ok = true;
+            for (s32 i = 0; i < count;)
+            {
+                s32 n = 0;
+                for (; i < count && n < TIER_SYNC_BATCH; ++i)
+                {
+                    tierhandle_t* th = (tierhandle_t*)pHandles[i];
+                    if (th->m_entry != nullptr && !write_back(th->m_entry, th->m_handle))
+                        ok = false;
+                    if (th->m_handle != nullptr)
+                        handles[n++] = th->m_handle;
+                }
+                if (n > 0 && !m_device->syncVolume(handles, n))
+                    ok = false;
+            }
+            return ok;
+        }
+
+        bool filedevice_tiered_t::createTempFile(filepath_t const& szFilename, void*& outHandle)
+        {
+            void* handle = nullptr;
+            if (!m_device->createTempFile(szFilename, handle))
+                return false;
+            outHandle = wrap(szFilename, handle, nullptr, true);
+            return true;
+        }
+
+        bool filedevice_tiered_t::linkTempFile(void* pHandle, filepath_t const& szFilename)
+        {
+            tierhandle_t* th = (tierhandle_t*)pHandle;
+            forget(szFilename, false);
+            return m_device->linkTempFile(th->m_handle, szFilename);
+        }
+
+        // -----------------------------------------------------------
+        // -----------------------------------------------------------
+
+        filedevice_t* create_tiered_device(filedevice_t* device, tieroptions_t const& options)
+        {
+            if (device == nullptr)
+                device = gCreateFileDevice(true);
+            if (device == nullptr || options.m_budget == 0)
+                return nullptr;
+            return mImpl->m_allocator->construct<filedevice_tiered_t>(device, mImpl->m_allocator, options);
+        }
+
+        void destroy_tiered_device(filedevice_t* device)
+        {
+            mImpl->release_ioqueue(device);
+            mImpl->m_allocator->destruct((filedevice_tiered_t*)device);
+        }
+
+    } // namespace nfs
+}; // namespace ncore
@@ -0,0 +1,86 @@
+#include "ccore/c_target.h"
+#include "ccore/c_debug.h"
+#include "cbase/c_allocator.h"
+#include "cbase/c_memory.h"
+
+#include "cfilesystem/private/c_tinylfu.h"
+
+namespace ncore
+{
+    namespace nfs
+    {
+        static const u64 sRowSeeds[tinylfu_t::ROWS] = {0x9E3779B97F4A7C15ull, 0xC2B2AE3D27D4EB4Full, 0x165667B19E3779F9ull, 0xD6E8FEB86659FD93ull};
+
+        tinylfu_t::tinylfu_t() : m_allocator(nullptr), m_table(nullptr), m_mask(0), m_sample(0), m_additions(0) {}
+
+        void tinylfu_t::init(alloc_t* allocator, u32 width)
+        {
+            u32 w = 16;
+            while (w < width)
+                w <<= 1;
+
+            m_allocator = allocator;
+            m_mask      = w - 1;
+            m_sample    = w * SAMPLE_SIZE;
+            m_additions = 0;
+            m_table     = (u8*)allocator->allocate((ROWS * w) / 2);
+            nmem::memset(m_table, 0, (ROWS * w) / 2);
+        }
+
+        void tinylfu_t::exit()
+        {
+            if (m_table != nullptr)
+                m_allocator->deallocate(m_table);
+            m_table = nullptr;
+        }
+
+        u32 tinylfu_t::index(u64 key, s32 row) const
+        {
+            u64 h = key * sRowSeeds[row];
+            h ^= h >> 29;
+            return (u32)(h >> 32) & m_mask;
+        }
+
+        // Only the rows that are not saturated are incremented
+        void tinylfu_t::increment(u64 key)
+        {
+            bool added = false;
+            for (s32 row = 0; row < ROWS; ++row)
+            {
+                u32 const i     = row * (m_mask + 1) + index(key, row);
+                u8&       cell  = m_table[i >> 1];
+                u32 const shift = (i & 1) * 4;
+                u32 const count = (cell >> shift) & 0xF;
+                if (count < MAX_COUNT)
+                {
+                    cell  = (u8)(cell + (1 << shift));
+                    added = true;
+                }
+            }
+            if (added && ++m_additions >= m_sample)
+                age();
+        }
+
+        u32 tinylfu_t::estimate(u64 key) const
+        {
+            u32 result = MAX_COUNT;
+            for (s32 row = 0; row < ROWS; ++row)
+            {
+                u32 const i     = row * (m_mask + 1) + index(key, row);
+                u32 const count = (m_table[i >> 1] >> ((i & 1) * 4)) & 0xF;
+                if (count < result)
+                    result = count;
+            }
+            return result;
+        }
+
+        void tinylfu_t::age()
+        {
+            u32 const bytes = (ROWS * (m_mask + 1)) / 2;
+            for (u32 i = 0; i < bytes; ++i)
+                m_table[i] = (u8)((m_table[i] >> 1) & 0x77);
+            m_additions /= 2;
+        }
+
+    } // namespace nfs
+}; // namespace ncore
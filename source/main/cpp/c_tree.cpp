@@ -0,0 +1,444 @@
+#include "ccore/c_target.h"
+#include "ccore/c_debug.h"
+#include "cbase/c_allocator.h"
+
+#include "cfilesystem/c_async.h"
+#include "cfilesystem/c_dirpath.h"
+#include "cfilesystem/c_enumerator.h"
+#include "cfilesystem/c_filepath.h"
+#include "cfilesystem/c_filesystem.h"
+#include "cfilesystem/c_hash.h"
+
+#include "cfilesystem/private/c_atomic.h"
+#include "cfilesystem/private/c_dirstack.h"
+#include "cfilesystem/private/c_enumerations.h"
+#include "cfilesystem/private/c_filedevice.h"
+#include "cfilesystem/private/c_filesystem.h"
+
+namespace ncore
+{
+    namespace nfs
+    {
+        extern filesys_t* mImpl;
+
+        bool copy(dirpath_t const& src, dirpath_t const& dst, copyoptions_t const& options) { return mImpl->copy(src, dst, options); }
+        bool sync(dirpath_t const& src, dirpath_t const& dst, syncoptions_t const& options) { return mImpl->sync(src, dst, options); }
+        bool hash(dirpath_t const& dirpath, hash128_t& out_hash) { return mImpl->hash(dirpath, out_hash); }
+
+        // -----------------------------------------------------------
+        // filesys_t, directory tree copy, sync, hash and delete
+        // -----------------------------------------------------------
+        //
+        // The calling thread walks the tree (producer) and hands the files in groups
+        // to the IO threads (consumers). A fixed window of groups is in flight, when
+        // it is full the walk waits for the oldest group. Directories are created by
+        // the walk before any of their files are handed out and removed bottom-up
+        // once all the groups have finished. Pruning walks the destination of a sync
+        // and deletes what is not in the source.
+        //
+        // A group runs as a call on the work queue, so the groups of one device are
+        // not limited by m_max_io_per_device. The files of a group are copied, synced
+        // and hashed with a parallelism of 1, the parallelism comes from the groups.
+
+        namespace ETreeOp
+        {
+            enum EEnum
+            {
+                COPY   = 0,
+                DELETE = 1,
+                SYNC   = 2,
+                PRUNE  = 3,
+                HASH   = 4,
+            };
+        }
+
+        struct treejob_t
+        {
+            filesys_t*           m_fs;
+            s32                  m_op;
+            dirpath_t const*     m_src;
+            dirpath_t const*     m_dst;
+            copyoptions_t const* m_options; // COPY and SYNC, the options of a single file
+            syncoptions_t const* m_sync;
+            s32 volatile         m_failed;
+            s64 volatile         m_sum_lo; // HASH, the sum of the hashes of the entries
+            s64 volatile         m_sum_hi;
+            s64 volatile         m_entries;
+        };
+
+        // The hash of a directory tree is the sum of the hashes of its entries, which
+        // does not depend on the order in which they are hashed. An entry hash is the
+        // hash of its relative path combined with the hash of its content.
+        namespace ETreeEntry
+        {
+            enum EEnum
+            {
+                FILE_ENTRY = 1,
+                DIR_ENTRY  = 2,
+            };
+        }
+
+        static void sAddEntry(treejob_t* job, utf16::rune const* path, s32 len, hash128_t const& content, u64 kind)
+        {
+            hash128_t const path_hash = hash128(path, (u64)len * sizeof(utf16::rune));
+
+            u64 node[5];
+            node[0] = path_hash.m_lo;
+            node[1] = path_hash.m_hi;
+            node[2] = content.m_lo;
+            node[3] = content.m_hi;
+            node[4] = kind;
+
+            hash128_t const entry = hash128(node, sizeof(node));
+            natomic::add(&job->m_sum_lo, (s64)entry.m_lo);
+            natomic::add(&job->m_sum_hi, (s64)entry.m_hi);
+            natomic::add(&job->m_entries, 1);
+        }
+
+        static bool sAddFileEntry(treejob_t* job, filepath_t const& filepath, hash128_t const& content)
+        {
+            filepath_t relpath = filepath;
+            relpath.makeRelativeTo(*job->m_src);
+
+            utf16::rune str[ESettings::MAX_PATH];
+            s32 const   len = relpath.to_strlen();
+            if (len > ESettings::MAX_PATH)
+                return false;
+            runes_t path(str, str + len);
+            relpath.to_string(path);
+            sAddEntry(job, str, len, content, ETreeEntry::FILE_ENTRY);
+            return true;
+        }
+
+        static bool sAddDirEntry(treejob_t* job, dirpath_t const& dirpath)
+        {
+            dirpath_t subpath;
+            dirpath_t::getSubDir(*job->m_src, dirpath, subpath);
+
+            utf16::rune str[ESettings::MAX_PATH];
+            s32 const   len = subpath.to_strlen();
+            if (len > ESettings::MAX_PATH)
+                return false;
+            runes_t path(str, str + len);
+            subpath.to_string(path);
+
+            hash128_t none;
+            none.m_lo = 0;
+            none.m_hi = 0;
+            sAddEntry(job, str, len, none, ETreeEntry::DIR_ENTRY);
+            return true;
+        }
+
+        class treegroup_t : public async_call_t
+        {
+        public:
+            enum
+            {
+                SIZE = 32
+            };
+
+            virtual EFileError::Enum operator()(s64& result)
+            {
+                s32 done = 0;
+                if (m_job->m_op == ETreeOp::DELETE || m_job->m_op == ETreeOp::PRUNE)
+                {
+                    done = m_device->deleteFiles(m_files, m_count);
+                }
+                else if (m_job->m_op == ETreeOp::HASH)
+                {
+                    for (s32 i = 0; i < m_count; ++i)
+                    {
+                        hash128_t content;
+                        if (m_job->m_fs->hash(m_files[i], content, 1) && sAddFileEntry(m_job, m_files[i], content))
+                            done += 1;
+                    }
+                }
+                else
+                {
+                    for (s32 i = 0; i < m_count; ++i)
+                    {
+                        filepath_t dstfilepath = m_files[i];
+                        dstfilepath.makeRelativeTo(*m_job->m_src);
+                        dstfilepath.makeAbsoluteTo(*m_job->m_dst);
+                        bool const ok = m_job->m_op == ETreeOp::SYNC ? m_job->m_fs->sync(m_files[i], dstfilepath, *m_job->m_sync, *m_job->m_options) : m_job->m_fs->copy(m_files[i], dstfilepath, *m_job->m_options);
+                        if (ok)
+                            done += 1;
+                    }
+                }
+                if (done != m_count)
+                    natomic::add(&m_job->m_failed, m_count - done);
+                result = done;
+                return EFileError::Error_Ok();
+            }
+
+            treejob_t*    m_job;
+            filedevice_t* m_device;
+            filepath_t    m_files[SIZE];
+            s32           m_count;
+
+            DCORE_CLASS_PLACEMENT_NEW_DELETE
+        };
+
+        class treewalker_t : public enumerate_delegate_t
+        {
+        public:
+            enum
+            {
+                WINDOW = 16
+            };
+
+            treewalker_t(treejob_t* job, alloc_t* allocator) : m_job(job), m_allocator(allocator), m_dirs(allocator), m_slot(0)
+            {
+                for (s32 i = 0; i < WINDOW; ++i)
+                {
+                    m_groups[i]           = m_allocator->construct<treegroup_t>();
+                    m_groups[i]->m_job    = job;
+                    m_groups[i]->m_device = nullptr;
+                    m_groups[i]->m_count  = 0;
+                    m_inflight[i]         = false;
+                }
+            }
+
+            ~treewalker_t()
+            {
+                for (s32 i = 0; i < WINDOW; ++i)
+                    m_allocator->destruct(m_groups[i]);
+            }
+
+            virtual bool operator()(s32 depth, filepath_t const& fp, fileattrs_t const& fa, filetimes_t const& ft)
+            {
+                if (m_job->m_op == ETreeOp::PRUNE)
+                {
+                    // Walking the destination, m_dst is the source. The destination file is
+                    // only deleted when the source is known not to have it.
+                    filepath_t srcfilepath = fp;
+                    srcfilepath.makeRelativeTo(*m_job->m_src);
+                    srcfilepath.makeAbsoluteTo(*m_job->m_dst);
+                    bool found = true;
+                    if (!srcfilepath.m_dirpath.m_device->m_fileDevice->findFile(srcfilepath, found) || found)
+                        return true;
+                }
+
+                treegroup_t* group = m_groups[m_slot];
+                if (group->m_count > 0 && group->m_device != fp.m_dirpath.m_device->m_fileDevice)
+                    flush();
+
+                group = m_groups[m_slot];
+                if (group->m_count == 0)
+                    group->m_device = fp.m_dirpath.m_device->m_fileDevice;
+                group->m_files[group->m_count++] = fp;
+                if (group->m_count == treegroup_t::SIZE)
+                    flush();
+                return natomic::load(&m_job->m_failed) == 0 || m_job->m_op == ETreeOp::DELETE || m_job->m_op == ETreeOp::PRUNE;
+            }
+
+            virtual bool operator()(s32 depth, dirpath_t const& dp)
+            {
+                if (m_job->m_op == ETreeOp::DELETE)
+                {
+                    m_dirs.push(dp);
+                    return true;
+                }
+                if (m_job->m_op == ETreeOp::HASH)
+                {
+                    if (sAddDirEntry(m_job, dp))
+                        return true;
+                    natomic::add(&m_job->m_failed, 1);
+                    return false;
+                }
+
+                dirpath_t subpath;
+                dirpath_t::getSubDir(*m_job->m_src, dp, subpath);
+                dirpath_t dstdirpath = *m_job->m_dst + subpath;
+                filedevice_t* dstfd  = dstdirpath.m_device->m_fileDevice;
+                if (m_job->m_op == ETreeOp::PRUNE)
+                {
+                    if (!dstfd->hasDir(dstdirpath))
+                        m_dirs.push(dp);
+                    return true;
+                }
+                if (!dstfd->hasDir(dstdirpath) && !dstfd->createDir(dstdirpath))
+                {
+                    natomic::add(&m_job->m_failed, 1);
+                    return false;
+                }
+                return true;
+            }
+
+            // Hand the current group to an IO thread and make the next slot available
+            void flush()
+            {
+                treegroup_t* group = m_groups[m_slot];
+                if (group->m_count == 0)
+                    return;
+
+                m_tokens[m_slot] = m_job->m_fs->submit_call(nullptr, nullptr, group, nullptr, EIoPriority::NORMAL);
+                if (m_tokens[m_slot].error().value == EFileError::ERROR_ASYNC_BUSY)
+                {
+                    m_inflight[m_slot] = true;
+                }
+                else
+                {
+                    s64 result = 0; // No request available
+                    (*group)(result);
+                    group->m_count = 0;
+                }
+
+                m_slot = (m_slot + 1) % WINDOW;
+                if (m_inflight[m_slot])
+                {
+                    m_tokens[m_slot].wait();
+                    m_inflight[m_slot] = false;
+                }
+                m_groups[m_slot]->m_count = 0;
+            }
+
+            void finish()
+            {
+                flush();
+                for (s32 i = 0; i < WINDOW; ++i)
+                {
+                    if (m_inflight[i])
+                    {
+                        m_tokens[i].wait();
+                        m_inflight[i] = false;
+                    }
+                }
+            }
+
+            treejob_t*   m_job;
+            alloc_t*     m_allocator;
+            dirstack_t   m_dirs;
+            treegroup_t* m_groups[WINDOW];
+            async_t      m_tokens[WINDOW];
+            bool         m_inflight[WINDOW];
+            s32          m_slot;
+        };
+
+        bool filesys_t::copy(dirpath_t const& src, dirpath_t const& dst, copyoptions_t const& options)
+        {
+            copyoptions_t file_options = options;
+            file_options.m_parallelism = 1;
+
+            treejob_t job;
+            job.m_fs      = this;
+            job.m_op      = ETreeOp::COPY;
+            job.m_src     = &src;
+            job.m_dst     = &dst;
+            job.m_options = &file_options;
+            job.m_sync    = nullptr;
+            job.m_failed  = 0;
+            job.m_sum_lo  = 0;
+            job.m_sum_hi  = 0;
+            job.m_entries = 0;
+
+            treewalker_t walker(&job, m_allocator);
+            bool const   walked = src.m_device->m_fileDevice->enumerate(src, walker);
+            walker.finish();
+            return walked && natomic::load(&job.m_failed) == 0;
+        }
+
+        bool filesys_t::sync(dirpath_t const& src, dirpath_t const& dst, syncoptions_t const& options)
+        {
+            copyoptions_t file_options;
+            file_options.m_parallelism = 1;
+
+            treejob_t job;
+            job.m_fs      = this;
+            job.m_op      = ETreeOp::SYNC;
+            job.m_src     = &src;
+            job.m_dst     = &dst;
+            job.m_options = &file_options;
+            job.m_sync    = &options;
+            job.m_failed  = 0;
+            job.m_sum_lo  = 0;
+            job.m_sum_hi  = 0;
+            job.m_entries = 0;
+
+            bool walked = false;
+            {
+                treewalker_t walker(&job, m_allocator);
+                walked = src.m_device->m_fileDevice->enumerate(src, walker);
+                walker.finish();
+            }
+            if (!walked || !options.m_delete)
+                return walked && natomic::load(&job.m_failed) == 0;
+
+            // The walk of the destination deletes the files and directories that are
+            // not in the source, the directories after all of their files are gone.
+            treejob_t prune;
+            prune.m_fs      = this;
+            prune.m_op      = ETreeOp::PRUNE;
+            prune.m_src     = &dst;
+            prune.m_dst     = &src;
+            prune.m_options = nullptr;
+            prune.m_sync    = nullptr;
+            prune.m_failed  = 0;
+            prune.m_sum_lo  = 0;
+            prune.m_sum_hi  = 0;
+            prune.m_entries = 0;
+
+            treewalker_t walker(&prune, m_allocator);
+            bool const   pruned = dst.m_device->m_fileDevice->enumerate(dst, walker);
+            walker.finish();
+
+            dirpath_t dir;
+            while (walker.m_dirs.pop(dir))
+                dir.m_device->m_fileDevice->removeDir(dir);
+            return pruned && natomic::load(&job.m_failed) == 0 && natomic::load(&prune.m_failed) == 0;
+        }
+
+        bool filesys_t::hash(dirpath_t const& dirpath, hash128_t& out_hash)
+        {
+            treejob_t job;
+            job.m_fs      = this;
+            job.m_op      = ETreeOp::HASH;
+            job.m_src     = &dirpath;
+            job.m_dst     = nullptr;
+            job.m_options = nullptr;
+            job.m_sync    = nullptr;
+            job.m_failed  = 0;
+            job.m_sum_lo  = 0;
+            job.m_sum_hi  = 0;
+            job.m_entries = 0;
+
+            treewalker_t walker(&job, m_allocator);
+            bool const   walked = dirpath.m_device->m_fileDevice->enumerate(dirpath, walker);
+            walker.finish();
+            if (!walked || natomic::load(&job.m_failed) != 0)
+                return false;
+
+            u64 node[3];
+            node[0]  = (u64)natomic::load(&job.m_sum_lo);
+            node[1]  = (u64)natomic::load(&job.m_sum_hi);
+            node[2]  = (u64)natomic::load(&job.m_entries);
+            out_hash = hash128(node, sizeof(node));
+            return true;
+        }
+
+        void filesys_t::rm(dirpath_t const& dirpath)
+        {
+            treejob_t job;
+            job.m_fs      = this;
+            job.m_op      = ETreeOp::DELETE;
+            job.m_src     = &dirpath;
+            job.m_dst     = nullptr;
+            job.m_options = nullptr;
+            job.m_sync    = nullptr;
+            job.m_failed  = 0;
+            job.m_sum_lo  = 0;
+            job.m_sum_hi  = 0;
+            job.m_entries = 0;
+
+            treewalker_t walker(&job, m_allocator);
+            if (!dirpath.m_device->m_fileDevice->enumerate(dirpath, walker))
+                return;
+            walker.finish();
+
+            dirpath_t dir;
+            while (walker.m_dirs.pop(dir))
+                dir.m_device->m_fileDevice->removeDir(dir);
+        }
+
+    } // namespace nfs
+}; // namespace ncore
@@ -0,0 +1,114 @@
+#ifndef __C_FILESYSTEM_APPENDLOG_H__
+#define __C_FILESYSTEM_APPENDLOG_H__
+#include "ccore/c_target.h"
+#ifdef USE_PRAGMA_ONCE
+#    pragma once
+#endif
+
+#include "ccore/c_debug.h"
+
+#include "cfilesystem/c_async.h"
+#include "cfilesystem/private/c_enumerations.h"
+
+namespace ncore
+{
+    class alloc_t;
+
+    namespace nfs
+    {
+        class filedevice_t;
+
+        // Segments are named "<m_path>.<index>.log" (index with 8 digits). The segment
+        // size is rounded up to a multiple of the slab size.
+        struct appendlogoptions_t
+        {
+            inline appendlogoptions_t() : m_path(nullptr), m_segment_size(64 * 1024 * 1024), m_slab_size(1024 * 1024), m_slab_count(8) {}
+            const char* m_path;
+            u64         m_segment_size;
+            u32         m_slab_size;  // Size of an in-memory buffer
+            s32         m_slab_count; // Number of in-memory buffers
+        };
+
+        // Append-only log for many producer threads.
+        //
+        // A producer reserves its byte range with one atomic fetch-add on the tail and
+        // copies its data into the in-memory slab(s) that hold the range, no lock is
+        // taken. The slabs form a ring over the log, the slab of a range is known from
+        // its offset. The producer that completes a slab wakes the flusher, which runs
+        // as a request on the IO threads (or on the producer when there are none), writes
+        // the slabs in order to the segment files and hands them back to the producers.
+        // When all the slabs are waiting to be written the producers wait (back-pressure).
+        // The flusher opens the next segment when a segment is full.
+        //
+        // Opening an existing log continues after the end of its last segment.
+        class appendlog_t
+        {
+        public:
+            appendlog_t();
+            ~appendlog_t();
+
+            bool open(appendlogoptions_t const& options);
+            void close();
+
+            // Append size bytes, returns the offset of the data in the log or -1 when the
+            // log is not open. The data is in the log once it has been flushed.
+            s64 append(void const* data, u32 size);
+
+            // Write what has been appended so far, flush() does not wait for it and sync()
+            // waits until it has been written and is durable. sync() returns false when
+            // a write failed.
+            void flush();
+            bool sync();
+
+            s64 size() const;    // Bytes appended
+            s64 written() const; // Bytes written to the segments
+
+        private:
+            struct slab_t
+            {
+                u8*          m_data;
+                s64 volatile m_base;      // Offset in the log of the range the slab holds
+                s64 volatile m_committed; // Bytes of the range that have been copied in
+            };
+
+            class flusher_t : public async_call_t, public async_delegate_t
+            {
+            public:
+                virtual EFileError::Enum operator()(s64& result);
+                virtual void             operator()(async_t const& token, EFileError::Enum error, s64 bytes);
+                appendlog_t*             m_log;
+            };
+
+            void kick();
+            void run();
+            void drain();
+            bool write(s64 from, s64 to, u8 const* data);
+            bool open_segment(s64 index, bool create);
+            void close_segment();
+            void request_flush(s64 to);
+            void acquire_flusher();
+
+            alloc_t*      m_allocator;
+            filedevice_t* m_device;
+            char*         m_path;
+            u64           m_segment_size;
+            s64           m_slab_size;
+            s32           m_slab_count;
+            slab_t*       m_slabs;
+            s64 volatile  m_tail;     // End of the reserved bytes
+            s64 volatile  m_written;  // End of the bytes written to the segments
+            s64 volatile  m_flush_to; // A flush of the partial slab has been asked up to here
+            s32 volatile  m_pending;  // The flusher has to (re)check the slabs
+            s32 volatile  m_busy;     // The flusher is running (or queued)
+            s32 volatile  m_queued;   // Flusher requests that have not been delivered
+            s32 volatile  m_failed;
+            s64           m_segment; // Index of the open segment, -1 when none
+            void*         m_handle;
+            flusher_t     m_flusher;
+            bool          m_open;
+        };
+
+    } // namespace nfs
+}; // namespace ncore
+
+#endif // __C_FILESYSTEM_APPENDLOG_H__
@@ -0,0 +1,92 @@
+#ifndef __C_FILESYSTEM_ASYNC_H__
+#define __C_FILESYSTEM_ASYNC_H__
+#include "ccore/c_target.h"
+#ifdef USE_PRAGMA_ONCE
+#    pragma once
+#endif
+
+#include "ccore/c_debug.h"
+
+#include "cfilesystem/private/c_enumerations.h"
+
+namespace ncore
+{
+    namespace nfs
+    {
+        class async_t;
+        class filesys_t;
+        class stream_t;
+
+        // When a delegate is passed to read_async/write_async it is called from the
+        // thread that completed the request (normally the thread running doIO).
+        // After the delegate returns the request is retired, polling the token
+        // afterwards will return ERROR_NOASYNC.
+        class async_delegate_t
+        {
+        public:
+            virtual void operator()(async_t const& token, EFileError::Enum error, s64 bytes) = 0;
+        };
+
+        // A blocking operation (open, close, stat, ...) that is executed by an IO
+        // thread as an asynchronous request, the returned error and the result are
+        // passed on to the delegate of the request.
+        class async_call_t
+        {
+        public:
+            virtual EFileError::Enum operator()(s64& result) = 0;
+        };
+
+        // Completion token of an asynchronous read or write.
+        //
+        // A token is owned by the one that issued the request, once poll() or wait()
+        // has reported completion the request is retired and the outcome is cached
+        // inside the token (error() and result()). When copies of a token are polled
+        // only one of them gets the outcome, the others get ERROR_NOASYNC. A token of
+        // a request with a delegate gives ERROR_NOASYNC once the delegate is called.
+        class async_t
+        {
+        public:
+            async_t();
+            async_t(const async_t&);
+
+            bool isValid() const;
+
+            // The outcome of the request once it completed (ERROR_OK or the failure),
+            // ERROR_ASYNC_BUSY while it is still in flight and ERROR_NOASYNC when this
+            // token does not (or no longer) refer to a request.
+            EFileError::Enum poll();
+
+            // Block until the request has completed, returns error(). While waiting the
+            // calling thread helps executing queued requests.
+            EFileError::Enum wait();
+
+            // Block until one of the tokens has completed, returns its index or -1
+            // when none of the tokens refer to a request.
+            static s32 wait_any(async_t* tokens, s32 count);
+
+            // Cancel the request, this only succeeds while it is still queued. When it
+            // returns true the buffer of the request will not be touched anymore, the
+            // request completes with ERROR_CANCELLED.
+            bool cancel();
+
+            EFileError::Enum error() const { return m_error; }
+            s64              result() const { return m_result; }
+
+            async_t& operator=(const async_t&);
+
+        private:
+            async_t(filesys_t* owner, async_id_t id, EFileError::Enum error);
+
+            filesys_t*       m_owner;
+            async_id_t       m_id;
+            EFileError::Enum m_error;
+            s64              m_result;
+
+            friend class filesys_t;
+            friend class stream_t;
+        };
+
+    } // namespace nfs
+}; // namespace ncore
+
+#endif // __C_FILESYSTEM_ASYNC_H__
@@ -0,0 +1,209 @@
+#ifndef __C_FILESYSTEM_AWAIT_H__
+#define __C_FILESYSTEM_AWAIT_H__
+#include "ccore/c_target.h"
+#ifdef USE_PRAGMA_ONCE
+#    pragma once
+#endif
+
+#include "ccore/c_debug.h"
+
+#include "cfilesystem/private/c_enumerations.h"
+#include "cfilesystem/c_async.h"
+
+#if defined(__cpp_impl_coroutine) && defined(__has_include)
+#    if __has_include(<coroutine>)
+#        include <coroutine>
+#        define DFS_COROUTINES 1
+#    endif
+#endif
+#ifndef DFS_COROUTINES
+#    define DFS_COROUTINES 0
+#endif
+
+// Use DFS_AWAIT(nfs::read_await(...)) to write code that suspends the coroutine
+// when the toolchain supports coroutines and that blocks otherwise.
+#if DFS_COROUTINES
+#    define DFS_AWAIT(awaitable) (co_await(awaitable))
+#else
+#    define DFS_AWAIT(awaitable) ((awaitable).wait())
+#endif
+
+namespace ncore
+{
+    class filepath_t;
+    class dirpath_t;
+
+    namespace nfs
+    {
+        class stream_t;
+        class fileattrs_t;
+        class filetimes_t;
+        class enumerate_delegate_t;
+
+        struct ioresult_t
+        {
+            inline ioresult_t() : m_error(EFileError::ERROR_NOASYNC), m_result(0) {}
+            inline bool isOk() const { return m_error.value == EFileError::ERROR_OK; }
+
+            EFileError::Enum m_error;
+            s64              m_result;
+        };
+
+        // Awaitable file operation
+        //
+        // The request is issued when the coroutine suspends and the coroutine is
+        // resumed from the completion path, normally on the thread that is running
+        // doIO. The state lives inside the awaitable which lives in the coroutine
+        // frame, there is no allocation per await.
+        // wait() issues the request and blocks the calling thread until it has
+        // completed, this is what DFS_AWAIT does on a toolchain without coroutines.
+        class awaitable_t : protected async_delegate_t
+        {
+        public:
+            ioresult_t wait();
+
+#if DFS_COROUTINES
+            inline bool       await_ready() const { return false; }
+            inline bool       await_suspend(std::coroutine_handle<> coroutine) { return suspend(coroutine.address(), &sResume); }
+            inline ioresult_t await_resume() const { return m_outcome; }
+#endif
+
+        protected:
+            awaitable_t(s32 priority);
+
+            virtual async_t start() = 0;
+
+            bool         suspend(void* coroutine, void (*resume)(void*));
+            virtual void operator()(async_t const& token, EFileError::Enum error, s64 bytes);
+
+#if DFS_COROUTINES
+            static void sResume(void* coroutine) { std::coroutine_handle<>::from_address(coroutine).resume(); }
+#endif
+
+            s32 volatile m_state;
+            s32          m_priority;
+            ioresult_t   m_outcome;
+            void*        m_coroutine;
+            void (*m_resume)(void*);
+        };
+
+        class read_awaitable_t : public awaitable_t
+        {
+        public:
+            read_awaitable_t(stream_t& stream, s64 offset, u8* buffer, s64 size, s32 priority);
+
+        protected:
+            virtual async_t start();
+
+            stream_t* m_stream;
+            s64       m_offset;
+            u8*       m_buffer;
+            s64       m_size;
+        };
+
+        class write_awaitable_t : public awaitable_t
+        {
+        public:
+            write_awaitable_t(stream_t& stream, s64 offset, u8 const* buffer, s64 size, s32 priority);
+
+        protected:
+            virtual async_t start();
+
+            stream_t* m_stream;
+            s64       m_offset;
+            u8 const* m_buffer;
+            s64       m_size;
+        };
+
+        // Open, close, flush, stat and enumerate are blocking calls on the device,
+        // they are executed as a request on an IO thread.
+        class call_awaitable_t : public awaitable_t, protected async_call_t
+        {
+        protected:
+            call_awaitable_t(s32 priority) : awaitable_t(priority) {}
+        };
+
+        class open_awaitable_t : public call_awaitable_t
+        {
+        public:
+            open_awaitable_t(filepath_t const& filepath, EFileMode::Enum mode, EFileAccess::Enum access, EFileOp::Enum op, stream_t& out_stream, s32 priority);
+
+        protected:
+            virtual async_t          start();
+            virtual EFileError::Enum operator()(s64& result);
+
+            filepath_t const* m_filepath;
+            EFileMode::Enum   m_mode;
+            EFileAccess::Enum m_access;
+            EFileOp::Enum     m_op;
+            stream_t*         m_stream;
+        };
+
+        class close_awaitable_t : public call_awaitable_t
+        {
+        public:
+            close_awaitable_t(stream_t& stream, s32 priority);
+
+        protected:
+            virtual async_t          start();
+            virtual EFileError::Enum operator()(s64& result);
+
+            stream_t* m_stream;
+        };
+
+        class flush_awaitable_t : public call_awaitable_t
+        {
+        public:
+            flush_awaitable_t(stream_t& stream, s32 priority);
+
+        protected:
+            virtual async_t          start();
+            virtual EFileError::Enum operator()(s64& result);
+
+            stream_t* m_stream;
+        };
+
+        class stat_awaitable_t : public call_awaitable_t
+        {
+        public:
+            stat_awaitable_t(filepath_t const& filepath, fileattrs_t& out_attrs, filetimes_t& out_times, s32 priority);
+
+        protected:
+            virtual async_t          start();
+            virtual EFileError::Enum operator()(s64& result);
+
+            filepath_t const* m_filepath;
+            fileattrs_t*      m_attrs;
+            filetimes_t*      m_times;
+        };
+
+        // The whole directory walk is one batch, the delegate is called on the IO
+        // thread and the coroutine is resumed once the walk has finished.
+        class enumerate_awaitable_t : public call_awaitable_t
+        {
+        public:
+            enumerate_awaitable_t(dirpath_t const& dirpath, enumerate_delegate_t& delegate, s32 priority);
+
+        protected:
+            virtual async_t          start();
+            virtual EFileError::Enum operator()(s64& result);
+
+            dirpath_t const*      m_dirpath;
+            enumerate_delegate_t* m_delegate;
+        };
+
+        // The result of read/write is the number of bytes transferred, open, close,
+        // flush and stat have a result of 0 and enumerate has the number of entries
+        // reported to the delegate.
+        inline read_awaitable_t      read_await(stream_t& stream, s64 offset, u8* buffer, s64 size, s32 priority = EIoPriority::NORMAL) { return read_awaitable_t(stream, offset, buffer, size, priority); }
+        inline write_awaitable_t     write_await(stream_t& stream, s64 offset, u8 const* buffer, s64 size, s32 priority = EIoPriority::NORMAL) { return write_awaitable_t(stream, offset, buffer, size, priority); }
+        inline open_awaitable_t      open_await(filepath_t const& filepath, EFileMode::Enum mode, EFileAccess::Enum access, EFileOp::Enum op, stream_t& out_stream, s32 priority = EIoPriority::NORMAL) { return open_awaitable_t(filepath, mode, access, op, out_stream, priority); }
+        inline close_awaitable_t     close_await(stream_t& stream, s32 priority = EIoPriority::NORMAL) { return close_awaitable_t(stream, priority); }
+        inline flush_awaitable_t     flush_await(stream_t& stream, s32 priority = EIoPriority::NORMAL) { return flush_awaitable_t(stream, priority); }
+        inline stat_awaitable_t      stat_await(filepath_t const& filepath, fileattrs_t& out_attrs, filetimes_t& out_times, s32 priority = EIoPriority::NORMAL) { return stat_awaitable_t(filepath, out_attrs, out_times, priority); }
+        inline enumerate_awaitable_t enumerate_await(dirpath_t const& dirpath, enumerate_delegate_t& delegate, s32 priority = EIoPriority::NORMAL) { return enumerate_awaitable_t(dirpath, delegate, priority); }
+
+    } // namespace nfs
+}; // namespace ncore
+
+#endif // __C_FILESYSTEM_AWAIT_H__
@@ -0,0 +1,60 @@
+#ifndef __C_FILESYSTEM_BATCH_H__
+#define __C_FILESYSTEM_BATCH_H__
+#include "ccore/c_target.h"
+#ifdef USE_PRAGMA_ONCE
+#    pragma once
+#endif
+
+#include "ccore/c_debug.h"
+
+#include "cfilesystem/private/c_enumerations.h"
+
+namespace ncore
+{
+    class filepath_t;
+
+    namespace nfs
+    {
+        class stream_t;
+        class fileattrs_t;
+        class filetimes_t;
+
+        // Results of a batch, one entry per file in struct-of-arrays form. The arrays
+        // are owned by the caller and must hold at least the number of files in the
+        // batch, only the arrays used by the operation have to be set:
+        //   batch_stat: m_errors, m_sizes and optionally m_attrs, m_times
+        //   batch_load: m_errors, m_sizes, m_data
+        //   batch_open: m_errors, m_streams
+        // m_errors holds an EFileError::EEnumValue per file, batch_open gives
+        // ERROR_NO_FILE when the device could not open the file and ERROR_MAX_FILES
+        // when all file handles are in use.
+        struct batch_t
+        {
+            inline batch_t() : m_errors(nullptr), m_sizes(nullptr), m_attrs(nullptr), m_times(nullptr), m_data(nullptr), m_streams(nullptr), m_arena(nullptr), m_arena_size(0), m_arena_used(0) {}
+
+            s8*          m_errors;
+            u64*         m_sizes;
+            fileattrs_t* m_attrs;
+            filetimes_t* m_times;
+            u8**         m_data;
+            stream_t*    m_streams;
+
+            // batch_load places the files back to back in the arena, a file that does not
+            // fit fails with ERROR_IO and m_arena_used can exceed m_arena_size.
+            u8*          m_arena;
+            u64          m_arena_size;
+            s64 volatile m_arena_used;
+        };
+
+        // The files of a batch are split into groups that execute as requests on the
+        // IO threads, the number of groups that run at the same time on one device is
+        // limited by context_t::m_max_io_per_device. Without IO threads the batch
+        // executes on the calling thread. Returns the number of files that succeeded.
+        s32 batch_stat(filepath_t const* filepaths, s32 count, batch_t& out);
+        s32 batch_load(filepath_t const* filepaths, s32 count, batch_t& out);
+        s32 batch_open(filepath_t const* filepaths, s32 count, EFileMode::Enum mode, EFileAccess::Enum access, EFileOp::Enum op, batch_t& out);
+
+    } // namespace nfs
+}; // namespace ncore
+
+#endif // __C_FILESYSTEM_BATCH_H__
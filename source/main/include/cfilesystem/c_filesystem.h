@@ -25,13 +25,158 @@ namespace ncore
 
         struct context_t
         {
-            inline context_t() : m_allocator(nullptr), m_max_open_files(32), m_max_path_objects(8192), m_default_slash('/') {}
+            inline context_t() : m_allocator(nullptr), m_max_open_files(32), m_max_async(64), m_max_io_per_device(1), m_load_map_threshold(16 * 1024 * 1024), m_iobuffer_size(1024 * 1024), m_iobuffer_alignment(4096), m_max_iobuffers(16), m_commit_window_us(1000), m_commit_volume_threshold(64), m_max_path_objects(8192), m_default_slash('/') {}
             alloc_t* m_allocator;
             u32      m_max_open_files;
+            u32      m_max_async;               // Maximum number of asynchronous requests in flight (at most 65535)
+            s32      m_max_io_per_device;       // Maximum number of IO threads executing requests of one device (tree walks and chunked copies are not limited by it)
+            u64      m_load_map_threshold;      // load() maps files of at least this size instead of reading them (0 = never)
+            u32      m_iobuffer_size;           // Size of a buffer of the direct IO buffer pool
+            u32      m_iobuffer_alignment;      // Alignment of direct IO, a multiple of the sector size
+            s32      m_max_iobuffers;           // Maximum number of buffers in the direct IO buffer pool
+            u32      m_commit_window_us;        // Longest time a commit waits for others to join its batch
+            s32      m_commit_volume_threshold; // A batch with this many files of one device syncs their volume (0 = never)
             u32      m_max_path_objects;
             char     m_default_slash;
         };
 
+        // The content of a file returned by load(), it is either allocated from the
+        // allocator that was passed to load() or a read-only mapping of the file.
+        // Release it with unload().
+        struct filedata_t
+        {
+            inline filedata_t() : m_data(nullptr), m_size(0), m_allocator(nullptr), m_mapping(nullptr), m_device(nullptr) {}
+            inline bool isValid() const { return m_device != nullptr; }
+
+            u8 const*     m_data;
+            u64           m_size;
+            alloc_t*      m_allocator;
+            void*         m_mapping;
+            filedevice_t* m_device;
+        };
+
+        struct copystats_t
+        {
+            inline copystats_t() : m_files(0), m_bytes_cloned(0), m_bytes_copied(0) {}
+            s64 volatile m_files;
+            s64 volatile m_bytes_cloned; // Bytes that share the data blocks of the source
+            s64 volatile m_bytes_copied; // Bytes that have been physically copied
+        };
+
+        // Files of at least m_parallel_threshold bytes are copied in chunks of
+        // m_chunk_size bytes by up to m_parallelism threads (the calling thread and
+        // the IO threads, 0 = all of them), smaller files are copied by the calling
+        // thread alone.
+        // With m_clone a file is cloned instead when the device supports it for the
+        // destination (copy-on-write, the data blocks are shared with the source).
+        struct copyoptions_t
+        {
+            inline copyoptions_t() : m_chunk_size(8 * 1024 * 1024), m_parallel_threshold(64 * 1024 * 1024), m_parallelism(0), m_overwrite(true), m_clone(true), m_stats(nullptr) {}
+            u64          m_chunk_size;
+            u64          m_parallel_threshold;
+            s32          m_parallelism;
+            bool         m_overwrite;
+            bool         m_clone;
+            copystats_t* m_stats; // Optional, the bytes cloned and copied are added to it
+        };
+
+        struct syncstats_t
+        {
+            inline syncstats_t() : m_files(0), m_files_skipped(0), m_bytes_matched(0), m_bytes_written(0) {}
+            s64 volatile m_files;
+            s64 volatile m_files_skipped; // Files that were already the same
+            s64 volatile m_bytes_matched; // Bytes of the destination that were reused
+            s64 volatile m_bytes_written; // Bytes that came from the source
+        };
+
+        namespace ESyncCheck
+        {
+            enum EEnum
+            {
+                SIZE_TIME = 0, // Same size and last write time means unchanged
+                CONTENT   = 1, // The content is compared
+            };
+        }
+
+        namespace ESyncWrite
+        {
+            enum EEnum
+            {
+                IN_PLACE = 0, // Only the blocks that differ are written to the destination
+                REPLACE  = 1, // A new file is made from the matching blocks and the differences
+            };
+        }
+
+        // A changed file is compared in blocks of m_block_size bytes (0 = from the size
+        // of the file). IN_PLACE writes the blocks that differ at the same offset, which
+        // suits files that are changed in place. REPLACE finds the blocks of the
+        // destination anywhere in the source with a rolling checksum, which also matches
+        // data that has moved, and atomically replaces the destination with the result;
+        // the sync fails when the device has no temporary files. With
+        // m_delete the files and directories that are not in the source are removed.
+        struct syncoptions_t
+        {
+            inline syncoptions_t() : m_block_size(0), m_check(ESyncCheck::SIZE_TIME), m_write(ESyncWrite::IN_PLACE), m_delete(false), m_stats(nullptr) {}
+            u32          m_block_size;
+            s32          m_check; // ESyncCheck
+            s32          m_write; // ESyncWrite
+            bool         m_delete;
+            syncstats_t* m_stats; // Optional, the files and bytes are added to it
+        };
+
+        namespace ETierWrite
+        {
+            enum EEnum
+            {
+                THROUGH = 0, // Writes go to the memory tier and to the device
+                BACK    = 1, // Writes go to the memory tier, the device gets them on flush/eviction
+            };
+        }
+
+        // m_promote_threshold is the estimated number of uses (at most 15) before a file
+        // is considered for the memory tier, the sketch width is the number of counters
+        // per row of the frequency sketch (about the number of files that matter).
+        struct tieroptions_t
+        {
+            inline tieroptions_t() : m_budget(256 * 1024 * 1024), m_max_file_size(16 * 1024 * 1024), m_promote_threshold(2), m_sketch_width(4096), m_write(ETierWrite::THROUGH) {}
+            u64 m_budget;
+            u64 m_max_file_size; // At most 4 GB - 1
+            u32 m_promote_threshold;
+            u32 m_sketch_width;
+            s32 m_write; // ETierWrite
+        };
+
+        struct casstats_t
+        {
+            inline casstats_t() : m_chunks_stored(0), m_chunks_deduped(0), m_bytes_stored(0), m_bytes_deduped(0) {}
+            s64 volatile m_chunks_stored;
+            s64 volatile m_chunks_deduped; // Chunks that were already in the store
+            s64 volatile m_bytes_stored;
+            s64 volatile m_bytes_deduped;
+        };
+
+        // m_store is the directory of the chunks, it has to be on the backing device.
+        // The chunk sizes are those of the content-defined chunking (the average is a
+        // power of 2), m_cache_size is the budget of the cache of chunks that reads
+        // go through. With m_verify every chunk read from the store is hashed again.
+        struct casoptions_t
+        {
+            inline casoptions_t() : m_store(nullptr), m_min_chunk(16 * 1024), m_avg_chunk(64 * 1024), m_max_chunk(256 * 1024), m_cache_size(64 * 1024 * 1024), m_verify(false), m_stats(nullptr) {}
+            const char* m_store;
+            u32         m_min_chunk;
+            u32         m_avg_chunk;
+            u32         m_max_chunk;
+            u64         m_cache_size;
+            bool        m_verify;
+            casstats_t* m_stats; // Optional, the chunks stored and deduplicated are added to it
+        };
+
+        struct iostats_t
+        {
+            s64 m_cancelled; // Asynchronous requests completed with ERROR_CANCELLED
+            s64 m_timedout;  // Asynchronous requests completed with ERROR_TIMEDOUT
+        };
+
         void create(context_t const&);
         void destroy();
 
@@ -50,12 +195,104 @@ namespace ncore
         void rename(filepath_t const&, filepath_t const&);
         void move(filepath_t const& src, filepath_t const& dst);
         void copy(filepath_t const& src, filepath_t const& dst);
+        bool copy(filepath_t const& src, filepath_t const& dst, copyoptions_t const& options);
+        // Copying a directory tree, and rm of a directory, walk the tree on the calling
+        // thread while the files are copied/deleted on the IO threads.
+        bool copy(dirpath_t const& src, dirpath_t const& dst, copyoptions_t const& options);
+
+        // Clone a directory tree, files fall back to a copy when they cannot be cloned
+        bool snapshot(dirpath_t const& src, dirpath_t const& dst, copystats_t& out_stats);
+
+        // Make dst the same as src and only write what has changed, a file that is not in
+        // the destination is copied. The files of a tree are synced on the IO threads.
+        bool sync(filepath_t const& src, filepath_t const& dst, syncoptions_t const& options);
+        bool sync(dirpath_t const& src, dirpath_t const& dst, syncoptions_t const& options);
         void rm(filepath_t const&);
         void rm(dirpath_t const&);
 
+        void get_iostats(iostats_t& stats);
+
+        // Group commit, make the data written to a stream durable or the entries of a
+        // directory (new, renamed and removed files). The commits of all threads are
+        // collected in batches, a batch is flushed as a whole (on the IO threads when
+        // it is large) and all of its committers return together. Many files of one
+        // device are synced with their volume (see context_t::m_commit_volume_threshold).
+        // Returns false when the data could not be made durable.
+        bool commit(stream_t& stream);
+        bool commit(dirpath_t const& dirpath);
+
+        // Atomic replace of a file ("safe save"). replace_open returns a stream on a new
+        // temporary file next to the target that is not visible under any name a reader
+        // would open. replace_commit makes its data durable, puts it in place of the
+        // target in one atomic step and closes the stream, readers see the old or the
+        // new file and never a partial one. A stream that is closed without a commit is
+        // discarded. The data and directory flushes are grouped like commit(), the batch
+        // variant links the files on the IO threads and returns how many were replaced.
+        // Fails when the device does not support temporary files.
+        bool replace_open(filepath_t const& target, stream_t& out_stream);
+        bool replace_commit(stream_t& stream, filepath_t const& target);
+        s32  replace_commit(stream_t* streams, filepath_t const* targets, s32 count);
+
+        // A system file device that does unbuffered (direct) IO, the page cache is not
+        // used which suits large streaming reads and writes that are not read again.
+        // Transfers that are not aligned to context_t::m_iobuffer_alignment are done
+        // through buffers of a pool allocated from the context allocator. Register the
+        // device under a name with register_device(). Returns nullptr when direct IO
+        // is not supported on the platform.
+        filedevice_t* create_direct_device(bool can_write);
+        void          destroy_direct_device(filedevice_t* device);
+
+        // A device that passes everything on to device (the system device when nullptr)
+        // and keeps the files loaded through it (load(), load_into()) in shared memory of
+        // size bytes. All the processes on the host that create a cache device with the
+        // same name and size share the files. A file that has changed (identity, write
+        // time or size) is loaded again. load() hands out the shared data when mapping
+        // is enabled (context_t::m_load_map_threshold > 0), unload() releases it.
+        // When a process dies while it is updating the shared memory the cache turns
+        // itself off for all processes and everything is loaded from device.
+        // Returns nullptr when the shared memory could not be created or attached, or
+        // when it exists with another size.
+        filedevice_t* create_cache_device(filedevice_t* device, const char* name, u64 size);
+        void          destroy_cache_device(filedevice_t* device);
+
+        // A device with a memory tier over device (the slow tier). Every open and load of
+        // a file counts its use, a file that is used often enough is read into memory
+        // when it is admitted by TinyLFU: it has to be used more often than the least
+        // recently used files it would push out of the budget. Reads of a file in memory
+        // do not touch the device, a file that has changed on the device is dropped.
+        // Writes that stay within a file in memory go to both tiers (THROUGH), or only to
+        // memory until the file is flushed or evicted (BACK); a write that extends a file
+        // drops it from memory. Destroying the device writes back what is still dirty.
+        filedevice_t* create_tiered_device(filedevice_t* device, tieroptions_t const& options);
+        void          destroy_tiered_device(filedevice_t* device);
+
+        // A content-addressed device on top of device. A file is kept as a manifest at
+        // its own path on the device, the list of the chunks it was cut into; a chunk
+        // is stored once in the store under the hash of its content, however many files
+        // contain it. Copying, moving and deleting a file only touches its manifest.
+        // Files are written sequentially, a write has to append to the end of the file.
+        // Chunks are never removed from the store by the device.
+        filedevice_t* create_cas_device(filedevice_t* device, casoptions_t const& options);
+        void          destroy_cas_device(filedevice_t* device);
+
+        // Load a whole file with the minimum number of device calls (open, size, read, close),
+        // large files are mapped (see context_t::m_load_map_threshold).
+        // load_into returns the size of the file or -1 when it failed or did not fit.
+        // The batch variant loads the files concurrently on the IO threads, the allocator
+        // must be thread-safe when IO threads are running.
+        filedata_t load(filepath_t const& filepath, alloc_t* allocator);
+        s64        load_into(filepath_t const& filepath, buffer_t& buffer);
+        void       load(filepath_t const* filepaths, s32 count, alloc_t* allocator, filedata_t* out_data);
+        void       unload(filedata_t& data);
+
         // doIO; user has to call this from either the main thread or an IO thread.
         // This call will block the calling thread and it will stay in a do-while
         // until io_thread_t->quit() is true.
+        // doIO can run on multiple threads, every file device has its own queue and
+        // calls that are not bound to a device share a work queue.
+        // An idle IO thread blocks in io_thread_t->wait() and is woken up with
+        // io_thread_t->signal() when a request is submitted, signal() must not be
+        // lost when it happens before wait().
         class io_thread_t;
         extern void doIO(io_thread_t*);
     }; // namespace nfs
@@ -0,0 +1,58 @@
+#ifndef __C_FILESYSTEM_HASH_H__
+#define __C_FILESYSTEM_HASH_H__
+#include "ccore/c_target.h"
+#ifdef USE_PRAGMA_ONCE
+#    pragma once
+#endif
+
+namespace ncore
+{
+    class filepath_t;
+    class dirpath_t;
+
+    namespace nfs
+    {
+        struct hash128_t
+        {
+            u64 m_lo;
+            u64 m_hi;
+        };
+
+        inline bool operator==(hash128_t const& a, hash128_t const& b) { return a.m_lo == b.m_lo && a.m_hi == b.m_hi; }
+        inline bool operator!=(hash128_t const& a, hash128_t const& b) { return a.m_lo != b.m_lo || a.m_hi != b.m_hi; }
+
+        // Non-cryptographic hash of content (files, chunks), the data is consumed in
+        // stripes of 64 bytes by 8 independent 64-bit lanes that are scrambled after
+        // every block of 16 stripes and folded into 128 bits at the end. The lanes only
+        // use 32x32->64 bit multiplies so that they map onto vector registers, the
+        // blocks are hashed with AVX2 or SSE2 on x64 and with NEON on arm64. All the
+        // kernels give the same hash.
+        hash128_t hash128(void const* data, u64 size);
+        inline u64 hash64(void const* data, u64 size) { return hash128(data, size).m_lo; }
+
+        // 32 lowercase hex digits and a terminating zero, out must hold 33 characters
+        void hash_to_hex(hash128_t const& hash, char* out);
+
+        // A file of more than HASH_CHUNK_SIZE bytes is hashed as a tree: the hashes of
+        // its chunks are combined with the size of the file, which lets the chunks be
+        // hashed in parallel. A smaller file has the hash128 of its content.
+        enum
+        {
+            HASH_CHUNK_SIZE = 4 * 1024 * 1024,
+        };
+        hash128_t hash128_combine(hash128_t const* chunks, u64 count, u64 size);
+
+        // The hash of a file, the chunks of a large file are hashed on the IO threads.
+        // Files are read through a mapping when they are at least
+        // context_t::m_load_map_threshold bytes.
+        bool hash(filepath_t const& filepath, hash128_t& out_hash);
+
+        // The hash of a directory tree, from the relative paths of its files and
+        // directories and the hashes of the files. The files are hashed on the IO threads
+        // while the tree is enumerated, the order of the enumeration does not matter.
+        bool hash(dirpath_t const& dirpath, hash128_t& out_hash);
+
+    } // namespace nfs
+}; // namespace ncore
+
+#endif // __C_FILESYSTEM_HASH_H__
@@ -0,0 +1,111 @@
+#ifndef __C_FILESYSTEM_MMAPSTREAM_H__
+#define __C_FILESYSTEM_MMAPSTREAM_H__
+#include "ccore/c_target.h"
+#ifdef USE_PRAGMA_ONCE
+#    pragma once
+#endif
+
+#include "ccore/c_debug.h"
+#include "cbase/c_stream.h"
+
+#include "cfilesystem/c_async.h"
+#include "cfilesystem/private/c_atomic.h"
+#include "cfilesystem/private/c_enumerations.h"
+
+namespace ncore
+{
+    class filepath_t;
+
+    namespace nfs
+    {
+        class filedevice_t;
+
+        struct mmapoptions_t
+        {
+            inline mmapoptions_t() : m_writable(true), m_extent(64 * 1024 * 1024), m_flush_interval_us(1000000) {}
+            bool m_writable;
+            u64  m_extent;            // The file grows in steps of this size
+            u32  m_flush_interval_us; // Minimum time between scheduled flushes, 0 = only on flush()
+        };
+
+        // A stream over a memory mapping of the whole file, for random updates where a
+        // system call per small write would dominate. A read or write is a memcpy, view()
+        // and view_writable() give the mapped bytes at the position directly.
+        //
+        // Writing beyond the end grows the file (and its mapping) by whole extents, the
+        // file is cut back to the end of what was written when the stream is closed.
+        // The range that has been written since the last flush is tracked, once the flush
+        // interval has passed a write hands it to the IO threads which start its
+        // write-back without waiting (msync MS_ASYNC). flush() does the same right away,
+        // sync() waits until everything written is durable.
+        //
+        // Opening fails when the device cannot map files.
+        class mmapstream_t : public istream_t
+        {
+        public:
+            mmapstream_t();
+            virtual ~mmapstream_t();
+
+            bool open(filepath_t const& filepath, mmapoptions_t const& options);
+            bool isOpen() const { return m_handle != nullptr; }
+            bool sync();
+
+            // Writable span of count bytes at the position, the file grows when needed.
+            // Returns the number of bytes in the span (0 when the stream is read-only) and
+            // moves the position past it.
+            s64 view_writable(u8*& buffer, s64 count);
+
+            virtual bool vcanSeek() const { return true; }
+            virtual bool vcanRead() const { return true; }
+            virtual bool vcanWrite() const { return m_writable; }
+            virtual bool vcanView() const { return true; }
+            virtual void vflush();
+            virtual void vclose();
+            virtual u64  vgetLength() const { return m_length; }
+            virtual void vsetLength(u64 length);
+            virtual s64  vsetPos(s64 pos);
+            virtual s64  vgetPos() const { return m_pos; }
+            virtual s64  vread(u8* buffer, s64 count);
+            virtual s64  vview(u8 const*& buffer, s64 count);
+            virtual s64  vwrite(const u8* buffer, s64 count);
+
+        private:
+            class flusher_t : public async_call_t, public async_delegate_t
+            {
+            public:
+                virtual EFileError::Enum operator()(s64& result);
+                virtual void             operator()(async_t const& token, EFileError::Enum error, s64 bytes);
+                mmapstream_t*            m_stream;
+            };
+
+            void acquire();
+            void release();
+            bool remap(u64 size);
+            void unmap();
+            bool grow(u64 end);
+            void touch(u64 pos, u64 end);
+            void schedule();
+            bool flush_dirty(bool wait);
+
+            filedevice_t* m_device;
+            void*         m_handle;
+            u8*           m_data;    // Mapping of [0, m_mapped)
+            void*         m_mapping; // As returned by the device
+            u64           m_mapped;  // Size of the mapping (and of the file)
+            u64           m_length;  // Logical length of the file
+            s64           m_pos;
+            u64           m_extent;
+            u32           m_flush_interval_us;
+            u64           m_flushed_us; // io_clock_us() of the last scheduled flush
+            u64           m_dirty_begin; // Range written since the last flush
+            u64           m_dirty_end;
+            spinlock_t    m_lock;     // Dirty range, shared with the flusher
+            s32 volatile  m_flushing; // A flush is queued or running, the mapping stays put
+            flusher_t     m_flusher;
+            bool          m_writable;
+        };
+
+    } // namespace nfs
+}; // namespace ncore
+
+#endif // __C_FILESYSTEM_MMAPSTREAM_H__
@@ -0,0 +1,140 @@
+#ifndef __C_FILESYSTEM_RECORDLOG_H__
+#define __C_FILESYSTEM_RECORDLOG_H__
+#include "ccore/c_target.h"
+#ifdef USE_PRAGMA_ONCE
+#    pragma once
+#endif
+
+#include "ccore/c_debug.h"
+
+#include "cfilesystem/private/c_enumerations.h"
+
+namespace ncore
+{
+    class alloc_t;
+
+    namespace nfs
+    {
+        class filedevice_t;
+
+        // Record log format
+        //
+        // The records are framed as <size:u32><crc:u32><data> where crc is the CRC-32C of
+        // the size followed by the data. They are numbered from 0 and stored in segments
+        // named "<path>.<index>.rec" (index with 8 digits), a segment starts with a header
+        // that holds the number of its first record. A record does not cross a segment,
+        // a record larger than the segment size gets a segment of its own.
+        // Every segment has a sparse index "<path>.<index>.idx" that holds the offset of
+        // every m_index_interval-th record as <record:u64><offset:u64>, a seek needs a
+        // binary search over the segments, one over the index and a short scan.
+        struct recordlogoptions_t
+        {
+            inline recordlogoptions_t() : m_path(nullptr), m_segment_size(64 * 1024 * 1024), m_index_interval(64) {}
+            const char* m_path;
+            u64         m_segment_size;
+            u32         m_index_interval;
+        };
+
+        namespace ERecordLog
+        {
+            enum EEnum
+            {
+                RECORD  = 0, // A record has been read
+                END     = 1, // No (complete) record after the current one yet
+                CORRUPT = 2, // A record of a finished segment failed its checksum
+            };
+        }
+
+        // Writes records at the end of the log, one thread at a time. Opening an existing
+        // log checks the records after the last index entry of the last segment and cuts
+        // off a record that was not completely written.
+        class recordwriter_t
+        {
+        public:
+            recordwriter_t();
+            ~recordwriter_t();
+
+            bool open(recordlogoptions_t const& options);
+            void close();
+
+            // Returns the number of the record or -1 when it could not be written
+            s64  append(void const* data, u32 size);
+            bool flush();
+
+            s64 count() const { return m_count; }
+
+        private:
+            bool create_segment(s64 index, s64 first);
+            bool recover_segment(s64 index);
+            void close_segment();
+            u8*  scratch(u32 size);
+
+            alloc_t*      m_allocator;
+            filedevice_t* m_device;
+            char*         m_path;
+            u64           m_segment_size;
+            u32           m_index_interval;
+            s64           m_segment; // Index of the open segment
+            void*         m_handle;
+            void*         m_index_handle;
+            u64           m_length;       // Length of the open segment
+            u64           m_index_length; // Length of its index
+            s64           m_count;        // Number of the next record
+            u8*           m_scratch;
+            u32           m_scratch_size;
+            bool          m_open;
+        };
+
+        // Reads the records in order and follows the log while it is written (tailing),
+        // when next() returns END it can be called again later to get the records that
+        // have been appended since. The segments are mapped when the device supports it,
+        // otherwise they are read through a buffer. The data of a record stays valid until
+        // the next call to next(), seek() or close().
+        class recordreader_t
+        {
+        public:
+            recordreader_t();
+            ~recordreader_t();
+
+            bool open(const char* path);
+            void close();
+
+            s32  next(u8 const*& out_data, u32& out_size); // ERecordLog
+            bool seek(s64 record);                         // Next record read is this one
+            s64  position() const { return m_record; }
+
+        private:
+            bool      discover();
+            bool      open_segment(s64 index);
+            void      close_segment();
+            bool      grow();
+            s32       advance();
+            bool      find_indexed(s64 record, u64& out_offset, s64& out_record);
+            u8 const* fetch(u64 pos, u64 count);
+            void      release_view();
+
+            alloc_t*      m_allocator;
+            filedevice_t* m_device;
+            char*         m_path;
+            s64*          m_firsts; // First record of every segment
+            s64           m_segment_count;
+            s64           m_segment_capacity;
+            s64           m_segment; // Index of the open segment, -1 when none
+            void*         m_handle;
+            u64           m_length; // Known length of the open segment
+            u64           m_pos;    // Offset of the next record in the open segment
+            s64           m_record; // Number of the next record
+            u8 const*     m_view;   // Bytes of the segment at m_view_pos
+            u64           m_view_pos;
+            u64           m_view_size;
+            void*         m_mapping; // Mapping of the view, nullptr when read into m_buffer
+            u8*           m_buffer;
+            u64           m_buffer_size;
+            bool          m_mappable;
+            bool          m_open;
+        };
+
+    } // namespace nfs
+}; // namespace ncore
+
+#endif // __C_FILESYSTEM_RECORDLOG_H__
@@ -9,6 +9,7 @@
 #include "cbase/c_buffer.h"
 
 #include "cfilesystem/private/c_enumerations.h"
+#include "cfilesystem/c_async.h"
 
 namespace ncore
 {
@@ -44,6 +45,51 @@ namespace ncore
             s64 read(u8*, s64);
             s64 write(u8 const*, s64);
 
+            // Vectored read/write at the current position, the spans are filled/written
+            // back-to-back with one device call where the device supports it.
+            s64 read(iospan_t const* spans, s32 count);
+            s64 write(ciospan_t const* spans, s32 count);
+
+            // Asynchronous read/write at an absolute offset, the stream position is
+            // not used nor updated. The buffer must stay valid until the request has
+            // completed. On a stream that was not opened with EFileOp::Async the
+            // request is executed immediately and a completed token is returned.
+            // The priority is one of EIoPriority, the deadline is relative to now (0 means
+            // the default latency of the priority class).
+            // A request that has not been started within timeout_us (0 means no timeout)
+            // completes with ERROR_TIMEDOUT, the timeout is checked by the IO threads.
+            async_t read_async(s64 offset, u8* buffer, s64 size, async_delegate_t* delegate = nullptr, s32 priority = EIoPriority::NORMAL, u32 deadline_us = 0, u32 timeout_us = 0);
+            async_t write_async(s64 offset, u8 const* buffer, s64 size, async_delegate_t* delegate = nullptr, s32 priority = EIoPriority::NORMAL, u32 deadline_us = 0, u32 timeout_us = 0);
+
+            // Vectored variants, the span array and the buffers must stay valid until
+            // the request has completed.
+            async_t read_async(s64 offset, iospan_t const* spans, s32 count, async_delegate_t* delegate = nullptr, s32 priority = EIoPriority::NORMAL, u32 deadline_us = 0, u32 timeout_us = 0);
+            async_t write_async(s64 offset, ciospan_t const* spans, s32 count, async_delegate_t* delegate = nullptr, s32 priority = EIoPriority::NORMAL, u32 deadline_us = 0, u32 timeout_us = 0);
+
+            // Cancel all queued requests of this stream, returns the number of
+            // requests that were cancelled.
+            s32 cancel_all();
+
+            // Reserve storage for a file of size bytes up front so that it does not grow
+            // one write at a time. With keep_size the length of the file is unchanged and
+            // only the storage is reserved, otherwise the file is extended to size. Either
+            // way the storage that has not been written is given back when the stream is
+            // closed (the file is trimmed to the end of what was written).
+            bool reserve(u64 size, bool keep_size = true);
+
+            // Tell the page cache how [pos, pos + size) of the file is going to be used
+            // (EFileAdvice, size 0 = up to the end of the file). Returns false when the
+            // device does not support the hint, it is only a hint either way.
+            bool advise(s32 advice, u64 pos = 0, u64 size = 0);
+
+            // Streaming mode (EStreaming) for a single pass over a file that should not
+            // evict the working set of other processes. With READ the pages that have been
+            // read are dropped every window bytes. With WRITE the write-back of every window
+            // is started as soon as it is written and the window before it is waited for
+            // and dropped, which bounds the dirty pages of the stream to about two windows.
+            // Only read() and write() at the stream position take part, not the async ones.
+            bool set_streaming(s32 mode, u64 window = 8 * 1024 * 1024);
+
             stream_t& operator=(const stream_t&);
 
         protected:
@@ -0,0 +1,100 @@
+#ifndef __C_FILESYSTEM_ATOMIC_H__
+#define __C_FILESYSTEM_ATOMIC_H__
+#include "ccore/c_target.h"
+#ifdef USE_PRAGMA_ONCE
+#    pragma once
+#endif
+
+#include "ccore/c_debug.h"
+
+#if defined(_MSC_VER)
+#    include <intrin.h>
+#endif
+
+namespace ncore
+{
+    namespace nfs
+    {
+        // Minimal set of atomic operations used by the asynchronous IO layer.
+        // All operations are sequentially consistent, add/exchange return the
+        // previous value.
+        namespace natomic
+        {
+#if defined(_MSC_VER)
+            inline s32  load(s32 volatile const* p) { return _InterlockedCompareExchange((long volatile*)p, 0, 0); }
+            inline void store(s32 volatile* p, s32 v) { _InterlockedExchange((long volatile*)p, v); }
+            inline s32  add(s32 volatile* p, s32 v) { return _InterlockedExchangeAdd((long volatile*)p, v); }
+            inline s32  exchange(s32 volatile* p, s32 v) { return _InterlockedExchange((long volatile*)p, v); }
+            inline bool cas(s32 volatile* p, s32 expected, s32 desired) { return _InterlockedCompareExchange((long volatile*)p, desired, expected) == expected; }
+
+            inline s64  load(s64 volatile const* p) { return _InterlockedCompareExchange64((__int64 volatile*)p, 0, 0); }
+            inline void store(s64 volatile* p, s64 v) { _InterlockedExchange64((__int64 volatile*)p, v); }
+            inline s64  add(s64 volatile* p, s64 v) { return _InterlockedExchangeAdd64((__int64 volatile*)p, v); }
+            inline bool cas(s64 volatile* p, s64 expected, s64 desired) { return _InterlockedCompareExchange64((__int64 volatile*)p, desired, expected) == expected; }
+
+            inline void* load_ptr(void* volatile const* p) { return _InterlockedCompareExchangePointer((void* volatile*)p, nullptr, nullptr); }
+            inline void  store_ptr(void* volatile* p, void* v) { _InterlockedExchangePointer(p, v); }
+            inline bool  cas_ptr(void* volatile* p, void* expected, void* desired) { return _InterlockedCompareExchangePointer(p, desired, expected) == expected; }
+
+            inline void pause() { _mm_pause(); }
+#else
+            inline s32  load(s32 volatile const* p) { return __atomic_load_n(p, __ATOMIC_SEQ_CST); }
+            inline void store(s32 volatile* p, s32 v) { __atomic_store_n(p, v, __ATOMIC_SEQ_CST); }
+            inline s32  add(s32 volatile* p, s32 v) { return __atomic_fetch_add(p, v, __ATOMIC_SEQ_CST); }
+            inline s32  exchange(s32 volatile* p, s32 v) { return __atomic_exchange_n(p, v, __ATOMIC_SEQ_CST); }
+            inline bool cas(s32 volatile* p, s32 expected, s32 desired) { return __atomic_compare_exchange_n(p, &expected, desired, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST); }
+
+            inline s64  load(s64 volatile const* p) { return __atomic_load_n(p, __ATOMIC_SEQ_CST); }
+            inline void store(s64 volatile* p, s64 v) { __atomic_store_n(p, v, __ATOMIC_SEQ_CST); }
+            inline s64  add(s64 volatile* p, s64 v) { return __atomic_fetch_add(p, v, __ATOMIC_SEQ_CST); }
+            inline bool cas(s64 volatile* p, s64 expected, s64 desired) { return __atomic_compare_exchange_n(p, &expected, desired, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST); }
+
+            inline void* load_ptr(void* volatile const* p) { return __atomic_load_n(p, __ATOMIC_SEQ_CST); }
+            inline void  store_ptr(void* volatile* p, void* v) { __atomic_store_n(p, v, __ATOMIC_SEQ_CST); }
+            inline bool  cas_ptr(void* volatile* p, void* expected, void* desired) { return __atomic_compare_exchange_n(p, &expected, desired, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST); }
+
+#    if defined(__x86_64__) || defined(__i386__)
+            inline void pause() { __builtin_ia32_pause(); }
+#    elif defined(__aarch64__) || defined(__arm__)
+            inline void pause() { __asm__ __volatile__("yield"); }
+#    else
+            inline void pause() {}
+#    endif
+#endif
+        } // namespace natomic
+
+        // A very small test-and-test-and-set lock, only used around short
+        // critical sections (a few pointer swaps).
+        class spinlock_t
+        {
+        public:
+            inline spinlock_t() : m_lock(0) {}
+
+            inline void lock()
+            {
+                while (true)
+                {
+                    if (natomic::exchange(&m_lock, 1) == 0)
+                        return;
+                    while (natomic::load(&m_lock) != 0)
+                        natomic::pause();
+                }
+            }
+            inline void unlock() { natomic::store(&m_lock, 0); }
+
+        private:
+            s32 volatile m_lock;
+        };
+
+        // Yield the time-slice of the calling thread (implemented per platform)
+        extern void io_yield();
+
+        // Block the calling thread while *address still holds value, a thread that
+        // changes it calls io_wake_all() afterwards (implemented per platform)
+        extern void io_wait(s32 volatile* address, s32 value);
+        extern void io_wake_all(s32 volatile* address);
+
+    } // namespace nfs
+}; // namespace ncore
+
+#endif // __C_FILESYSTEM_ATOMIC_H__
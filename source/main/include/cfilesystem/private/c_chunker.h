@@ -0,0 +1,44 @@
+#ifndef __C_FILESYSTEM_CHUNKER_H__
+#define __C_FILESYSTEM_CHUNKER_H__
+#include "ccore/c_target.h"
+#ifdef USE_PRAGMA_ONCE
+#    pragma once
+#endif
+
+namespace ncore
+{
+    namespace nfs
+    {
+        // Content-defined chunking (FastCDC). A gear hash rolls over the data and a
+        // chunk ends where the hash has its top bits clear. Before the average size a
+        // mask with more bits is used than after it, which keeps the sizes close to
+        // the average. Boundaries depend on the bytes around them only, an insert or
+        // a removal changes the chunks around it and the following chunks realign.
+        class chunker_t
+        {
+        public:
+            // Sizes are clamped to min <= avg <= max, avg is rounded down to a power of 2
+            void init(u32 min_size, u32 avg_size, u32 max_size);
+
+            // The length of the chunk at the start of data. When no boundary is found it
+            // is the smaller of size and the maximum, the caller that has more data to
+            // follow should only cut when it has passed at least the maximum.
+            u32 cut(u8 const* data, u64 size) const;
+
+            inline u32 min_size() const { return m_min; }
+            inline u32 avg_size() const { return m_avg; }
+            inline u32 max_size() const { return m_max; }
+
+        private:
+            u64 m_gear[256];
+            u64 m_mask_small; // Before the average size, harder to match
+            u64 m_mask_large; // After it, easier to match
+            u32 m_min;
+            u32 m_avg;
+            u32 m_max;
+        };
+
+    } // namespace nfs
+}; // namespace ncore
+
+#endif // __C_FILESYSTEM_CHUNKER_H__
@@ -0,0 +1,82 @@
+#ifndef __C_FILESYSTEM_COMMIT_H__
+#define __C_FILESYSTEM_COMMIT_H__
+#include "ccore/c_target.h"
+#ifdef USE_PRAGMA_ONCE
+#    pragma once
+#endif
+
+#include "cfilesystem/c_dirpath.h"
+#include "cfilesystem/private/c_atomic.h"
+
+namespace ncore
+{
+    namespace nfs
+    {
+        class filesys_t;
+        class filedevice_t;
+
+        // Group commit, the flushes requested by all threads are collected in a batch
+        // that is flushed as a whole and all of its committers return together.
+        //
+        // The first committer of a batch is its leader. When no other batch is being
+        // flushed it flushes right away, otherwise it waits until the flush in flight
+        // has completed (or the window has passed) and everyone that commits meanwhile
+        // joins its batch. So a lone committer does not pay for the window and under
+        // load the batches grow with the latency of a flush. The other committers of
+        // a batch sleep until it is done.
+        struct commitentry_t
+        {
+            filedevice_t* m_device;
+            void*         m_handle; // A file to flush, or
+            dirpath_t     m_dir;    // a directory of which the entries are flushed
+        };
+
+        struct commitbatch_t
+        {
+            enum
+            {
+                MAX_ENTRIES = 256,
+            };
+
+            commitentry_t m_entries[MAX_ENTRIES];
+            s8 volatile   m_results[MAX_ENTRIES]; // ECommitResult
+            s32 volatile  m_count;
+            s32 volatile  m_state;   // ECommitState
+            s32 volatile  m_waiters; // Committers that still have to pick up their result
+            s32 volatile  m_next;    // Next entry to flush
+            u64           m_opened;  // io_clock_us() when the batch was opened
+        };
+
+        class groupcommit_t
+        {
+        public:
+            enum
+            {
+                MAX_BATCHES = 4,
+            };
+
+            void init(u32 window_us, s32 volume_threshold);
+
+            // Blocks until the entry is durable, returns false when flushing it failed
+            bool commit(filesys_t* fs, commitentry_t const& entry);
+
+            // Flush the entries of a closed batch that have not been flushed yet, this
+            // is done by the leader and by the IO threads it hands the batch to.
+            static void flush_entries(commitbatch_t* batch);
+
+        private:
+            commitbatch_t* open_batch();
+            void           flush(filesys_t* fs, commitbatch_t* batch);
+
+            spinlock_t     m_lock;
+            commitbatch_t* m_open;
+            s32 volatile   m_flushing; // Batches being flushed
+            u32            m_window_us;
+            s32            m_volume_threshold;
+            commitbatch_t  m_batches[MAX_BATCHES];
+        };
+
+    } // namespace nfs
+}; // namespace ncore
+
+#endif // __C_FILESYSTEM_COMMIT_H__
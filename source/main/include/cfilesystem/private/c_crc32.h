@@ -0,0 +1,19 @@
+#ifndef __C_FILESYSTEM_CRC32_H__
+#define __C_FILESYSTEM_CRC32_H__
+#include "ccore/c_target.h"
+#ifdef USE_PRAGMA_ONCE
+#    pragma once
+#endif
+
+namespace ncore
+{
+    namespace nfs
+    {
+        // CRC-32C (Castagnoli), the checksum of the framed log formats. Pass the result
+        // of the previous call as crc to continue a checksum, start with 0.
+        u32 crc32c(u32 crc, void const* data, u64 size);
+
+    } // namespace nfs
+}; // namespace ncore
+
+#endif // __C_FILESYSTEM_CRC32_H__
@@ -0,0 +1,81 @@
+#ifndef __C_FILESYSTEM_DELTA_H__
+#define __C_FILESYSTEM_DELTA_H__
+#include "ccore/c_target.h"
+#ifdef USE_PRAGMA_ONCE
+#    pragma once
+#endif
+
+namespace ncore
+{
+    class alloc_t;
+
+    namespace nfs
+    {
+        // The weak checksum of the delta sync (rsync), two 16-bit sums over a window
+        // of fixed size that roll one byte at a time.
+        struct rollsum_t
+        {
+            inline void init(u8 const* data, u32 size)
+            {
+                m_a    = 0;
+                m_b    = 0;
+                m_size = size;
+                for (u32 i = 0; i < size; ++i)
+                {
+                    m_a += data[i];
+                    m_b += m_a;
+                }
+            }
+
+            // The window moves one byte, out leaves it at the start and in enters at the end
+            inline void roll(u8 out, u8 in)
+            {
+                m_a += (u32)in - (u32)out;
+                m_b += m_a - m_size * (u32)out;
+            }
+
+            inline u32 digest() const { return (m_a & 0xFFFF) | (m_b << 16); }
+
+            u32 m_a;
+            u32 m_b;
+            u32 m_size;
+        };
+
+        // The blocks of a file by their weak and strong checksum. A lookup compares the
+        // weak checksum first, the strong hash of the window is only computed when one
+        // of the blocks has the same weak checksum. Only full blocks are added.
+        class deltaindex_t
+        {
+        public:
+            deltaindex_t();
+
+            bool init(alloc_t* allocator, u32 block_size, u32 max_blocks);
+            void exit();
+
+            void add(u32 block, u8 const* data);
+            s64  find(u32 weak, u8 const* data) const; // The block, -1 when there is none
+
+            inline u32 block_size() const { return m_block_size; }
+            inline u32 count() const { return m_count; }
+
+        private:
+            struct sig_t
+            {
+                u32 m_weak;
+                u32 m_block;
+                u64 m_strong;
+            };
+
+            alloc_t* m_allocator;
+            sig_t*   m_sigs;
+            u32*     m_table; // Open addressing on the weak checksum, 1 + index of the sig
+            u32      m_mask;
+            u32      m_count;
+            u32      m_max;
+            u32      m_block_size;
+        };
+
+    } // namespace nfs
+}; // namespace ncore
+
+#endif // __C_FILESYSTEM_DELTA_H__
@@ -0,0 +1,74 @@
+#ifndef __C_FILESYSTEM_DIRSTACK_H__
+#define __C_FILESYSTEM_DIRSTACK_H__
+#include "ccore/c_target.h"
+#ifdef USE_PRAGMA_ONCE
+#    pragma once
+#endif
+
+#include "cbase/c_allocator.h"
+#include "cfilesystem/c_dirpath.h"
+
+namespace ncore
+{
+    namespace nfs
+    {
+        // Directories in the order they have been discovered by a walk, popping them
+        // gives the children before their parent which is the order to remove them.
+        class dirstack_t
+        {
+        public:
+            inline dirstack_t(alloc_t* allocator) : m_allocator(allocator), m_top(nullptr) {}
+            inline ~dirstack_t()
+            {
+                dirpath_t dir;
+                while (pop(dir)) {}
+            }
+
+            inline void push(dirpath_t const& dir)
+            {
+                if (m_top == nullptr || m_top->m_count == chunk_t::SIZE)
+                {
+                    chunk_t* chunk = m_allocator->construct<chunk_t>();
+                    chunk->m_count = 0;
+                    chunk->m_prev  = m_top;
+                    m_top          = chunk;
+                }
+                m_top->m_dirs[m_top->m_count++] = dir;
+            }
+
+            inline bool pop(dirpath_t& out_dir)
+            {
+                if (m_top == nullptr)
+                    return false;
+                out_dir = m_top->m_dirs[--m_top->m_count];
+                if (m_top->m_count == 0)
+                {
+                    chunk_t* chunk = m_top;
+                    m_top          = chunk->m_prev;
+                    m_allocator->destruct(chunk);
+                }
+                return true;
+            }
+
+        private:
+            struct chunk_t
+            {
+                enum
+                {
+                    SIZE = 64
+                };
+                dirpath_t m_dirs[SIZE];
+                s32       m_count;
+                chunk_t*  m_prev;
+
+                DCORE_CLASS_PLACEMENT_NEW_DELETE
+            };
+
+            alloc_t* m_allocator;
+            chunk_t* m_top;
+        };
+
+    } // namespace nfs
+}; // namespace ncore
+
+#endif // __C_FILESYSTEM_DIRSTACK_H__
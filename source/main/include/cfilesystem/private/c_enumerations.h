@@ -22,6 +22,57 @@ namespace ncore
             };
         }
 
+        namespace EIoPriority
+        {
+            enum EEnum
+            {
+                HIGH   = 0, // Latency sensitive requests
+                NORMAL = 1,
+                LOW    = 2, // Bulk and background requests
+                COUNT  = 3,
+            };
+        }
+
+        // Expected access pattern of a range of a file, the page cache uses it to
+        // decide what to read ahead and what to keep.
+        namespace EFileAdvice
+        {
+            enum EEnum
+            {
+                NORMAL     = 0,
+                SEQUENTIAL = 1, // Read ahead aggressively
+                RANDOM     = 2, // Do not read ahead
+                WILLNEED   = 3, // Start reading the range into the page cache
+                DONTNEED   = 4, // Drop the (clean) pages of the range from the page cache
+                NOREUSE    = 5, // The range is accessed once
+            };
+        }
+
+        // Streaming mode of a stream, the pages behind the read/write position are
+        // dropped from the page cache once a window of them has been passed.
+        namespace EStreaming
+        {
+            enum EEnum
+            {
+                NONE  = 0x00,
+                READ  = 0x01, // Drop the pages that have been read
+                WRITE = 0x02, // Write back and drop the pages that have been written
+            };
+        }
+
+        // One buffer of a vectored (scatter/gather) read or write
+        struct iospan_t
+        {
+            u8* m_data;
+            u64 m_size;
+        };
+
+        struct ciospan_t
+        {
+            u8 const* m_data;
+            u64       m_size;
+        };
+
         namespace ESettings
         {
             enum EEnum
@@ -203,6 +254,9 @@ namespace ncore
                 ERROR_NOASYNC,         ///< No asynchronous operation has been performed
                 ERROR_NOCWD,           ///< Current directory does not exist
                 ERROR_NAMETOOLONG,     ///< Filename is too long
+                ERROR_IO,              ///< Device failed to read or write
+                ERROR_CANCELLED,       ///< Asynchronous operation was cancelled
+                ERROR_TIMEDOUT,        ///< Asynchronous operation was not started before its timeout
             };
 
             struct Enum
@@ -223,6 +277,9 @@ namespace ncore
                 inline bool IsNoAsync() { return value == ERROR_NOASYNC; }
                 inline bool IsNoCwd() { return value == ERROR_NOCWD; }
                 inline bool IsNameTooLong() { return value == ERROR_NAMETOOLONG; }
+                inline bool IsIo() { return value == ERROR_IO; }
+                inline bool IsCancelled() { return value == ERROR_CANCELLED; }
+                inline bool IsTimedOut() { return value == ERROR_TIMEDOUT; }
 
                 const char* ToString() const;
 
@@ -244,6 +301,9 @@ namespace ncore
             inline Enum Error_NoAsync() { return Enum(ERROR_NOASYNC); }
             inline Enum Error_NoCwd() { return Enum(ERROR_NOCWD); }
             inline Enum Error_NameTooLong() { return Enum(ERROR_NAMETOOLONG); }
+            inline Enum Error_Io() { return Enum(ERROR_IO); }
+            inline Enum Error_Cancelled() { return Enum(ERROR_CANCELLED); }
+            inline Enum Error_TimedOut() { return Enum(ERROR_TIMEDOUT); }
 
         } // namespace EFileError
 
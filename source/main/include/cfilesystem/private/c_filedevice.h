@@ -27,12 +27,20 @@ namespace ncore
         class fileattrs_t;
         class filetimes_t;
         class stream_t;
+        class iobufferpool_t;
 
         // System file device
         extern filedevice_t* gCreateFileDevice(bool boCanWrite);
         extern void          gDestroyFileDevice(filedevice_t*);
         extern filedevice_t* gNullFileDevice();
 
+        // System file device with unbuffered (direct) IO, reads and writes bypass the
+        // page cache. The device keeps the alignment that the system requires, parts
+        // of a transfer that are not aligned go through buffers from the pool.
+        // Returns nullptr when the platform does not support it.
+        extern filedevice_t* gCreateDirectFileDevice(alloc_t* allocator, iobufferpool_t* pool, bool boCanWrite);
+        extern void          gDestroyDirectFileDevice(alloc_t* allocator, filedevice_t*);
+
         // File device
         //
         // This interface exists to present a way to implement different types
@@ -60,6 +68,47 @@ namespace ncore
             virtual bool flushFile(void* pHandle)                                                                                 = 0;
             virtual bool closeFile(void* pHandle)                                                                                 = 0;
 
+            // Vectored read/write, the spans are read/written back-to-back starting at pos.
+            // The default implementation issues one readFile/writeFile per span and stops
+            // at the first short transfer, a device can override it with a native call.
+            virtual bool readFileV(void* pHandle, u64 pos, iospan_t const* spans, s32 count, u64& outNumBytesRead);
+            virtual bool writeFileV(void* pHandle, u64 pos, ciospan_t const* spans, s32 count, u64& outNumBytesWritten);
+
+            // Whole file loading, the default opens the file, queries the length, reads it
+            // with one call and closes it. The first variant allocates the data from the
+            // allocator, unless the device can map the file and its size is at least
+            // mapThreshold (0 = never map), then outMapping is set and has to be passed
+            // to unmapFile. The second variant fails when the file does not fit.
+            virtual bool loadFile(filepath_t const& szFilename, alloc_t* allocator, u64 mapThreshold, u8 const*& outData, u64& outSize, void*& outMapping);
+            virtual bool loadFile(filepath_t const& szFilename, u8* buffer, u64 capacity, u64& outSize);
+            virtual bool unmapFile(void* mapping);
+
+            // Map [pos, pos + count) of an open file read-only, the range must be within the
+            // file. outData points at pos, outMapping has to be passed to unmapFile. The view
+            // shows what is written to the file after it was mapped. Not supported by default.
+            virtual bool mapFile(void* pHandle, u64 pos, u64 count, u8 const*& outData, void*& outMapping);
+
+            // Writable variant of mapFile, the handle must be open for reading and writing.
+            // The changes reach the file when the pages are written back by the system or
+            // by flushMapping. flushMapping starts the write-back of [address, address + count)
+            // of a view (msync MS_ASYNC), with boWait it also waits until the data of the
+            // file is durable. Not supported by default.
+            virtual bool mapFileWritable(void* pHandle, u64 pos, u64 count, u8*& outData, void*& outMapping);
+            virtual bool flushMapping(void* pHandle, void const* address, u64 count, bool boWait);
+
+            // Size, attributes and times of a file in one call, outAttr and outTimes may be
+            // null. The default opens the file, a device can override it with a path query.
+            virtual bool statFile(filepath_t const& szFilename, u64& outSize, fileattrs_t* outAttr, filetimes_t* outTimes);
+
+            // Whether a file exists, without opening it. Returns false when that could not
+            // be decided (access denied, device error), a file or directory that is not
+            // there is not an error. The default asks hasFile.
+            virtual bool findFile(filepath_t const& szFilename, bool& outFound);
+
+            // Identity of a file (inode, file index) with its last write time and size, any
+            // change of the file changes one of them. Not supported by default.
+            virtual bool identifyFile(filepath_t const& szFilename, u64& outId, u64& outModified, u64& outSize);
+
             virtual bool createStream(filepath_t const& szFilename, bool boRead, bool boWrite, stream_t& strm) = 0;
             virtual bool closeStream(stream_t& strm)                                                           = 0;
 
@@ -86,6 +135,60 @@ namespace ncore
             virtual bool createDir(dirpath_t const& szDirPath)                                               = 0;
             virtual bool deleteDir(dirpath_t const& szDirPath)                                               = 0;
 
+            // Delete a group of files, the default calls deleteFile for each of them.
+            // Returns the number of files that have been deleted.
+            virtual s32 deleteFiles(filepath_t const* szFilenames, s32 count);
+
+            // Remove one empty directory, not supported by default.
+            virtual bool removeDir(dirpath_t const& szDirPath);
+
+            // Block cloning (copy-on-write) of a range of one file into another file on the
+            // same volume, the destination must already be large enough. Not supported by
+            // default, canClone tells whether files in the directory can be cloned.
+            virtual bool canClone(dirpath_t const& szDirPath);
+            virtual bool cloneFileRange(void* pSrcHandle, u64 srcPos, void* pDstHandle, u64 dstPos, u64 count);
+
+            // Sparse files only have storage for the ranges that hold data, the holes read
+            // as zeros. By default files are not sparse and all of a file is data.
+            // nextDataExtent finds the first range of data at or after pos (SEEK_DATA) and
+            // where it ends (SEEK_HOLE), it returns false when there is no more data.
+            // punchHole releases the storage of a range, preallocate reserves storage for
+            // a range and extends the file when the range goes beyond the end.
+            virtual bool isSparseFile(void* pHandle);
+            virtual bool setSparseFile(void* pHandle);
+            virtual bool nextDataExtent(void* pHandle, u64 pos, u64& outDataPos, u64& outDataEnd);
+            virtual bool punchHole(void* pHandle, u64 pos, u64 count);
+            virtual bool preallocate(void* pHandle, u64 pos, u64 count);
+
+            // Reserve storage for size bytes without changing the length of the file, the
+            // storage beyond the end is given back by setLengthOfFile. Not supported by default.
+            virtual bool reserveFile(void* pHandle, u64 size);
+
+            // Access pattern hint for [pos, pos + count) of an open file (count 0 = up to
+            // the end of the file), returns false when the hint is not supported.
+            virtual bool adviseFile(void* pHandle, u64 pos, u64 count, s32 advice);
+
+            // Start the write-back of the dirty pages of [pos, pos + count), with boWait
+            // it also waits until they are on the disk. A device may write back more than
+            // the range (the default flushes the whole file when it has to wait).
+            virtual bool syncFileRange(void* pHandle, u64 pos, u64 count, bool boWait);
+
+            // Make the entries of a directory durable (created, renamed and removed files),
+            // not supported by default.
+            virtual bool flushDir(dirpath_t const& szDirPath);
+
+            // Make all the data of the volume(s) that hold the files durable at once (syncfs),
+            // cheaper than flushing many files one by one. Not supported by default.
+            virtual bool syncVolume(void* const* pHandles, s32 count);
+
+            // A temporary file in the directory of szFilename (on the same volume) that is
+            // not visible under that name, it is removed when it is closed unless it has been
+            // linked into place. linkTempFile atomically replaces szFilename with it, readers
+            // see either the old or the new file. The data must be flushed before linking
+            // for it to be durable. Not supported by default.
+            virtual bool createTempFile(filepath_t const& szFilename, void*& outHandle);
+            virtual bool linkTempFile(void* pHandle, filepath_t const& szFilename);
+
             virtual bool setDirTime(dirpath_t const& szDirPath, filetimes_t const& ftimes) = 0;
             virtual bool getDirTime(dirpath_t const& szDirPath, filetimes_t& ftimes)       = 0;
             virtual bool setDirAttr(dirpath_t const& szDirPath, fileattrs_t const& attr)   = 0;
@@ -8,6 +8,12 @@
 #include "cbase/c_allocator.h"
 
 #include "cfilesystem/private/c_enumerations.h"
+#include "cfilesystem/private/c_atomic.h"
+#include "cfilesystem/private/c_commit.h"
+#include "cfilesystem/private/c_iobuffers.h"
+#include "cfilesystem/private/c_iorequest.h"
+#include "cfilesystem/private/c_ioscheduler.h"
+#include "cfilesystem/private/c_ioqueue.h"
 
 namespace ncore
 {
@@ -21,6 +27,27 @@ namespace ncore
         class filesys_t;
         class filedevice_t;
         class stream_t;
+        class async_t;
+        class async_delegate_t;
+        class async_call_t;
+        class io_thread_t;
+        struct filedata_t;
+        struct batch_t;
+        struct copyoptions_t;
+        struct copystats_t;
+        struct copyjob_t;
+        struct syncoptions_t;
+        struct hash128_t;
+
+        namespace EReserve
+        {
+            enum EEnum
+            {
+                NONE      = 0, // No storage has been reserved
+                KEEP_SIZE = 1, // Storage reserved beyond the end of the file
+                EXTENDED  = 2, // The file was extended, m_write_end tracks the real end
+            };
+        }
 
         struct filehandle_t
         {
@@ -31,8 +58,46 @@ namespace ncore
             filedevice_t* m_filedevice;
             filehandle_t* m_prev;
             filehandle_t* m_next;
+            s32           m_reserve;       // EReserve
+            u64           m_reserve_base;  // Length of the file when it was extended
+            s64 volatile  m_write_end;     // Highest end of a write, only tracked when EXTENDED
+            s32           m_streaming;     // EStreaming
+            u64           m_stream_window; // Bytes passed before the pages behind are dropped
+            u64           m_read_dropped;  // Pages before this offset have been dropped
+            u64           m_write_started; // Write-back has been started up to this offset
+            u64           m_write_synced;  // Written, synced and dropped up to this offset
+            iorequest_t*  m_queued_head;   // Requests of the file in the scheduler, oldest first
+            iorequest_t*  m_queued_tail;
+            s32           m_running;       // Slots of the active set of the scheduler it holds
         };
 
+        // Writes on a file that was extended by stream_t::reserve() record how far the
+        // file has really been written, close() trims the file to it.
+        inline void note_write_end(filehandle_t* fh, u64 end)
+        {
+            if (fh->m_reserve != EReserve::EXTENDED)
+                return;
+            s64 cur = natomic::load(&fh->m_write_end);
+            while ((s64)end > cur && !natomic::cas(&fh->m_write_end, cur, (s64)end))
+                cur = natomic::load(&fh->m_write_end);
+        }
+
+        // Drop-behind of a stream in streaming mode, called after every read/write.
+        extern void stream_behind_read(filehandle_t* fh, u64 pos, u64 end);
+        extern void stream_behind_write(filehandle_t* fh, u64 pos, u64 end);
+
+        inline void note_read(filehandle_t* fh, u64 pos, u64 end)
+        {
+            if ((fh->m_streaming & EStreaming::READ) != 0)
+                stream_behind_read(fh, pos, end);
+        }
+
+        inline void note_written(filehandle_t* fh, u64 pos, u64 end)
+        {
+            if ((fh->m_streaming & EStreaming::WRITE) != 0)
+                stream_behind_write(fh, pos, end);
+        }
+
         class filesys_t
         {
         public:
@@ -43,20 +108,95 @@ namespace ncore
             static void destroy(stream_t& stream);
 
             // -----------------------------------------------------------
-            void open(const filepath_t& filename, EFileMode::Enum mode, EFileAccess::Enum access, EFileOp::Enum op, stream_t& out_stream);
-            void close(stream_t& stream);
+            EFileError::Enum open(const filepath_t& filename, EFileMode::Enum mode, EFileAccess::Enum access, EFileOp::Enum op, stream_t& out_stream);
+            void             close(stream_t& stream);
+            bool             attach(filedevice_t* fd, void* handle, EFileAccess::Enum access, EFileOp::Enum op, stream_t& out_stream);
             bool exists(filepath_t const&);
             bool exists(dirpath_t const&);
             s64  size(filepath_t const&);
             void rename(filepath_t const&, filepath_t const&);
             void move(filepath_t const& src, filepath_t const& dst);
             void copy(filepath_t const& src, filepath_t const& dst);
+            bool copy(filepath_t const& src, filepath_t const& dst, copyoptions_t const& options);
+            bool copy(dirpath_t const& src, dirpath_t const& dst, copyoptions_t const& options);
+            bool snapshot(dirpath_t const& src, dirpath_t const& dst, copystats_t& out_stats);
+            void copy_chunks(copyjob_t& job, s32 threads);
+            bool sync(filepath_t const& src, filepath_t const& dst, syncoptions_t const& options);
+            bool sync(filepath_t const& src, filepath_t const& dst, syncoptions_t const& options, copyoptions_t const& copy_options);
+            bool sync(dirpath_t const& src, dirpath_t const& dst, syncoptions_t const& options);
+            bool hash(filepath_t const& filepath, hash128_t& out_hash);
+            bool hash(filepath_t const& filepath, hash128_t& out_hash, s32 parallelism);
+            bool hash(dirpath_t const& dirpath, hash128_t& out_hash);
             void rm(filepath_t const&);
             void rm(dirpath_t const&);
 
+            filedata_t load(filepath_t const& filepath, alloc_t* allocator);
+            s64        load_into(filepath_t const& filepath, buffer_t& buffer);
+            void       load(filepath_t const* filepaths, s32 count, alloc_t* allocator, filedata_t* out_data);
+            void       unload(filedata_t& data);
+
+            s32 batch_stat(filepath_t const* filepaths, s32 count, batch_t& out);
+            s32 batch_load(filepath_t const* filepaths, s32 count, batch_t& out);
+            s32 batch_open(filepath_t const* filepaths, s32 count, EFileMode::Enum mode, EFileAccess::Enum access, EFileOp::Enum op, batch_t& out);
+
+            bool commit(stream_t& stream);
+            bool commit(dirpath_t const& dirpath);
+
+            bool replace_open(filepath_t const& target, stream_t& out_stream);
+            bool replace_commit(stream_t& stream, filepath_t const& target);
+            s32  replace_commit(stream_t* streams, filepath_t const* targets, s32 count);
+
+            // -----------------------------------------------------------
+            // Asynchronous IO
+            enum
+            {
+                MAX_IOQUEUES  = 8,
+                WORK_IOQUEUE  = MAX_IOQUEUES, // Calls that are not bound to a device
+                MAX_IOWORKERS = 32,
+            };
+
+            async_t      submit(EIoOp::EEnum op, filedevice_t* fd, filehandle_t* fh, u64 offset, void* buffer, u64 size, s32 span_count, async_delegate_t* delegate, s32 priority, u32 deadline_us, u32 timeout_us, bool async);
+            async_t      submit_call(filedevice_t* fd, filehandle_t* fh, async_call_t* call, async_delegate_t* delegate, s32 priority);
+            iorequest_t* lookup_iorequest(async_id_t id);
+            iorequest_t* obtain_iorequest();
+            void         release_iorequest(iorequest_t* req);
+            bool         cancel_iorequest(async_id_t id);
+            s32          cancel_filehandle(filehandle_t* fh);
+            bool         cancel_queued(iorequest_t* req);
+            ioqueue_t*   get_ioqueue(filedevice_t* fd);
+            void         release_ioqueue(filedevice_t* fd);
+            bool         process_iorequest(s32 worker = 0);
+            bool         process_ioqueue(ioqueue_t* q);
+            bool         has_pending_io() const;
+            s32          register_ioworker(io_thread_t* io_thread);
+            void         unregister_ioworker(s32 worker);
+            void         idle_ioworker(s32 worker, io_thread_t* io_thread);
+            void         wake_ioworker();
+            void         execute_iorequest(iorequest_t* req);
+            void         execute_merged_iorequest(iorequest_t* chain, u8* merge_buffer);
+            void         complete_iorequest(iorequest_t* req);
+
+            static filehandle_t* get_filehandle(stream_t const& stream);
+
+            u32          m_max_async;
+            s32          m_max_io_per_device;
+            iorequest_t* m_iorequests_array;
+            s64 volatile m_iorequests_free;
+            ioqueue_t    m_ioqueues[MAX_IOQUEUES + 1];
+            ioworker_t   m_ioworkers[MAX_IOWORKERS];
+            s32 volatile m_ioworkers_count;
+            s64 volatile m_stats_cancelled;
+            s64 volatile m_stats_timedout;
+
             // -----------------------------------------------------------
             //
             u32      m_max_open_files;
+            u64      m_load_map_threshold;
+            u32      m_iobuffer_size;
+            u32      m_iobuffer_alignment;
+            s32      m_max_iobuffers;
+            u32      m_commit_window_us;
+            s32      m_commit_volume_threshold;
             u32      m_max_path_objects;
             char     m_default_slash;
             alloc_t* m_allocator;
@@ -65,12 +205,16 @@ namespace ncore
             filehandle_t* obtain_filehandle();
             void          release_filehandle(filehandle_t* fh);
 
+            spinlock_t    m_filehandles_lock; // open/close can also run on an IO thread
             filehandle_t* m_filehandles_free;
             filehandle_t* m_filehandles_active;
             filehandle_t* m_filehandles_array;
             s32           m_filehandles_free_index;
             s32           m_filehandles_count;
 
+            iobufferpool_t m_iobuffers; // Aligned bounce buffers of the direct IO devices
+            groupcommit_t  m_commit;
+
             DCORE_CLASS_PLACEMENT_NEW_DELETE
         };
     } // namespace nfs
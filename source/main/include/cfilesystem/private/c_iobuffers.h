@@ -0,0 +1,55 @@
+#ifndef __C_FILESYSTEM_IOBUFFERS_H__
+#define __C_FILESYSTEM_IOBUFFERS_H__
+#include "ccore/c_target.h"
+#ifdef USE_PRAGMA_ONCE
+#    pragma once
+#endif
+
+#include "cfilesystem/private/c_atomic.h"
+
+namespace ncore
+{
+    class alloc_t;
+
+    namespace nfs
+    {
+        // A pool of aligned buffers of one size for unbuffered (direct) IO. Buffers are
+        // allocated on first use and are reused after release, a free buffer holds
+        // the link to the next free buffer. When all m_max_buffers are in use obtain()
+        // yields until one is released, obtain_nowait() returns nullptr instead.
+        class iobufferpool_t
+        {
+        public:
+            iobufferpool_t();
+
+            void init(alloc_t* allocator, u32 buffer_size, u32 alignment, s32 max_buffers);
+            void exit();
+
+            u8*  obtain();
+            u8*  obtain_nowait();
+            void release(u8* buffer);
+
+            inline u32 buffer_size() const { return m_buffer_size; }
+            inline u32 alignment() const { return m_alignment; }
+            inline s32 allocated() const { return m_allocated; }
+
+        private:
+            struct node_t
+            {
+                node_t* m_next;
+            };
+
+            alloc_t*   m_allocator;
+            u32        m_buffer_size;
+            u32        m_alignment;
+            s32        m_max_buffers;
+            s32        m_allocated;
+            node_t*    m_free;
+            u8**       m_buffers; // All allocated buffers, for exit()
+            spinlock_t m_lock;
+        };
+
+    } // namespace nfs
+}; // namespace ncore
+
+#endif // __C_FILESYSTEM_IOBUFFERS_H__
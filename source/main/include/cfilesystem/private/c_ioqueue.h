@@ -0,0 +1,79 @@
+#ifndef __C_FILESYSTEM_IOQUEUE_H__
+#define __C_FILESYSTEM_IOQUEUE_H__
+#include "ccore/c_target.h"
+#ifdef USE_PRAGMA_ONCE
+#    pragma once
+#endif
+
+#include "cfilesystem/private/c_atomic.h"
+#include "cfilesystem/private/c_iorequest.h"
+#include "cfilesystem/private/c_ioscheduler.h"
+
+namespace ncore
+{
+    class alloc_t;
+
+    namespace nfs
+    {
+        class filedevice_t;
+
+        // Bounded multi-producer ring of requests (Vyukov style sequence numbers).
+        // Producers never block, they only do a CAS on the tail. The consumer side
+        // is serialized by the owner of the ring.
+        class iomqueue_t
+        {
+        public:
+            void init(alloc_t* allocator, u32 capacity);
+            void exit(alloc_t* allocator);
+
+            bool         push(iorequest_t* req);
+            iorequest_t* pop();
+            bool         empty() const { return natomic::load(&m_head) == natomic::load(&m_tail); }
+
+        private:
+            struct cell_t
+            {
+                s64 volatile m_seq;
+                iorequest_t* m_req;
+            };
+
+            cell_t*      m_cells;
+            s64          m_mask;
+            s64 volatile m_head;
+            u8           m_pad[64 - sizeof(s64)];
+            s64 volatile m_tail;
+        };
+
+        // The queue of one file device, requests for a slow device do not hold up
+        // the requests for other devices. The number of IO threads that execute
+        // requests of one device at the same time is limited by m_max_active.
+        struct ioqueue_t
+        {
+            void init(alloc_t* allocator, u32 capacity, u32 merge_max, s32 max_active);
+            void exit(alloc_t* allocator);
+
+            bool has_work() const { return !m_submitted.empty() || m_scheduler.count() > 0; }
+
+            bool try_enter();
+            void leave();
+
+            filedevice_t* volatile m_device;
+            s32 volatile           m_active;
+            s32 volatile           m_cancelled; // Requests cancelled since the last expire
+            s32                    m_max_active;
+            iomqueue_t             m_submitted;
+            ioscheduler_t          m_scheduler;
+            spinlock_t             m_scheduler_lock; // Only taken by IO threads, never by producers
+        };
+
+        // An IO thread that is running doIO
+        struct ioworker_t
+        {
+            void* volatile m_thread; // io_thread_t*
+            s32 volatile   m_idle;
+        };
+
+    } // namespace nfs
+}; // namespace ncore
+
+#endif // __C_FILESYSTEM_IOQUEUE_H__
@@ -0,0 +1,83 @@
+#ifndef __C_FILESYSTEM_IOREQUEST_H__
+#define __C_FILESYSTEM_IOREQUEST_H__
+#include "ccore/c_target.h"
+#ifdef USE_PRAGMA_ONCE
+#    pragma once
+#endif
+
+#include "cfilesystem/private/c_enumerations.h"
+
+namespace ncore
+{
+    namespace nfs
+    {
+        struct filehandle_t;
+        class async_delegate_t;
+
+        namespace EIoOp
+        {
+            enum EEnum
+            {
+                READ  = 0,
+                WRITE = 1,
+                CALL  = 2, // m_buffer is an async_call_t, ordered like a write covering the whole file
+            };
+        }
+
+        namespace EIoState
+        {
+            enum EEnum
+            {
+                FREE       = 0, // In the free list
+                QUEUED     = 1, // Waiting in the queue for an IO thread
+                RUNNING    = 2, // Being submitted or executed
+                DELIVERING = 3, // Completed, the delegate is being called
+                DONE       = 4, // Completed, waiting to be retired by poll/wait
+                CANCELLED  = 5, // Cancelled while queued, waiting for an IO thread to complete it
+                TIMEDOUT   = 6, // Timed out while queued, waiting for an IO thread to complete it
+            };
+        }
+
+        // An asynchronous read or write, the index of the request in the pool
+        // together with the salt form the async_id_t of the completion token.
+        struct iorequest_t
+        {
+            s32 volatile      m_state;
+            s32               m_salt;
+            s32               m_index;
+            s32               m_op;
+            s32               m_priority;
+            u64               m_deadline; // Absolute, in io_clock_us() time
+            u64               m_timeout;  // Absolute, in io_clock_us() time, 0 means no timeout
+            s32               m_queue;    // Index of the device queue, -1 when executed directly
+            s32               m_active;   // Slot in the active set of the scheduler, -1 when not running from a queue
+            u64               m_sequence; // Order in which the scheduler received it
+            filehandle_t*     m_filehandle;
+            u64               m_offset;
+            void*             m_buffer;
+            u64               m_size;       // Total number of bytes
+            s32               m_span_count; // When > 0 m_buffer is an array of iospan_t/ciospan_t
+            s64               m_result;
+            s32               m_error;
+            async_delegate_t* m_delegate;
+            iorequest_t*      m_next;
+            iorequest_t*      m_file_prev; // The queued requests of the same file, in submission order
+            iorequest_t*      m_file_next;
+            s32               m_next_free; // Index + 1 of the next free request
+        };
+
+        // The index is packed in the low 16 bits of the async_id_t, a larger pool
+        // would alias requests and defeat the salt check.
+        enum
+        {
+            MAX_IOREQUESTS = 0xFFFF,
+        };
+
+        inline async_id_t iorequest_id(iorequest_t const* req) { return ((u32)(req->m_salt & 0xFFFF) << 16) | (u32)(req->m_index & 0xFFFF); }
+        inline s32        iorequest_index(async_id_t id) { return (s32)(id & 0xFFFF); }
+        inline s32        iorequest_salt(async_id_t id) { return (s32)(id >> 16); }
+
+    } // namespace nfs
+}; // namespace ncore
+
+#endif // __C_FILESYSTEM_IOREQUEST_H__
@@ -0,0 +1,102 @@
+#ifndef __C_FILESYSTEM_IOSCHEDULER_H__
+#define __C_FILESYSTEM_IOSCHEDULER_H__
+#include "ccore/c_target.h"
+#ifdef USE_PRAGMA_ONCE
+#    pragma once
+#endif
+
+#include "cfilesystem/private/c_enumerations.h"
+#include "cfilesystem/private/c_iorequest.h"
+
+namespace ncore
+{
+    class alloc_t;
+
+    namespace nfs
+    {
+        struct filehandle_t;
+
+        // Monotonic clock in micro-seconds (implemented per platform)
+        extern u64 io_clock_us();
+
+        // Scheduler for the requests that are executed by doIO.
+        //
+        // Every priority class has its own queue that is kept sorted on (file, offset)
+        // and is served in elevator (C-SCAN) order. Higher classes are served first,
+        // except when a request is close to its deadline, then it is promoted and
+        // served before anything else. Requests that did not specify a deadline get
+        // one from their class latency, so that background requests can not starve.
+        //
+        // Adjacent or overlapping reads on the same file in the same class are
+        // merged into one device read when a merge buffer is available.
+        //
+        // Overlapping requests on the same file where one of them is a write (or a
+        // call) are executed in the order they have been submitted, in any priority
+        // class, and never at the same time. pop() skips a request that conflicts with
+        // an older queued request or with a request that is still running (the
+        // active set), when everything is blocked it returns nullptr. The requests
+        // that a request can conflict with are found through its file handle, which
+        // keeps its queued requests and the number of active slots it holds.
+        class ioscheduler_t
+        {
+        public:
+            enum
+            {
+                MAX_ACTIVE = 32, // Requests (or merged chains) running at the same time
+            };
+
+            void init(alloc_t* allocator, u32 merge_max);
+            void exit(alloc_t* allocator);
+
+            bool empty() const { return m_count == 0; }
+            s32  count() const { return m_count; }
+
+            void push(iorequest_t* req, u64 now);
+
+            // Returns the next request to execute, when merging was possible the
+            // merged requests are linked through m_next in offset order.
+            // A request that was cancelled after it was pushed is returned on its
+            // own, its state is not RUNNING.
+            // A request that is returned RUNNING is in the active set (m_active of
+            // the first request), it must be retired once it has been executed.
+            iorequest_t* pop(u64 now, u32 merge_max);
+            void         retire(s32 active);
+
+            // Removes the cancelled requests and the requests whose timeout has passed
+            // (those are marked TIMEDOUT), they are returned linked through m_next.
+            iorequest_t* expire(u64 now);
+            bool         has_expired(u64 now) const { return now >= m_next_timeout; }
+
+            // The merge buffer can be used by one thread at a time
+            u8*  acquire_merge_buffer();
+            void release_merge_buffer();
+
+            struct active_t
+            {
+                filehandle_t* m_filehandle; // nullptr when the slot is free
+                s32           m_op;
+                u64           m_offset;
+                u64           m_size;
+            };
+
+            bool is_blocked(iorequest_t const* req) const;
+
+            iorequest_t*  m_queue[EIoPriority::COUNT];
+            filehandle_t* m_cursor_fh[EIoPriority::COUNT];
+            u64           m_cursor_offset[EIoPriority::COUNT];
+            u64           m_class_latency_us[EIoPriority::COUNT];
+            u64           m_deadline_slack_us;
+            u64           m_next_timeout;
+            u64           m_sequence;
+            active_t      m_active[MAX_ACTIVE];
+            s32           m_active_count;
+            u32           m_merge_max;
+            u8*           m_merge_buffer;
+            s32 volatile  m_merge_busy;
+            s32           m_count;
+        };
+
+    } // namespace nfs
+}; // namespace ncore
+
+#endif // __C_FILESYSTEM_IOSCHEDULER_H__
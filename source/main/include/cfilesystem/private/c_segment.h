@@ -0,0 +1,46 @@
+#ifndef __C_FILESYSTEM_SEGMENT_H__
+#define __C_FILESYSTEM_SEGMENT_H__
+#include "ccore/c_target.h"
+#ifdef USE_PRAGMA_ONCE
+#    pragma once
+#endif
+
+namespace ncore
+{
+    namespace nfs
+    {
+        // Name of a segment of a log, "<path>.<index>.<ext>" with an index of 8 digits.
+        // Returns false when the name does not fit in capacity characters.
+        inline bool segment_name(const char* path, s64 index, const char* ext, char* out, s32 capacity)
+        {
+            s32 n = 0;
+            while (path[n] != '\0')
+            {
+                if (n >= (capacity - 10))
+                    return false;
+                out[n] = path[n];
+                n += 1;
+            }
+            out[n++] = '.';
+            s64 value = index;
+            for (s32 i = n + 7; i >= n; --i)
+            {
+                out[i] = (char)('0' + (value % 10));
+                value /= 10;
+            }
+            n += 8;
+            out[n++] = '.';
+            for (s32 i = 0; ext[i] != '\0'; ++i)
+            {
+                if (n >= (capacity - 1))
+                    return false;
+                out[n++] = ext[i];
+            }
+            out[n] = '\0';
+            return true;
+        }
+
+    } // namespace nfs
+}; // namespace ncore
+
+#endif // __C_FILESYSTEM_SEGMENT_H__
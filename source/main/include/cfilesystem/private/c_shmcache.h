@@ -0,0 +1,78 @@
+#ifndef __C_FILESYSTEM_SHMCACHE_H__
+#define __C_FILESYSTEM_SHMCACHE_H__
+#include "ccore/c_target.h"
+#ifdef USE_PRAGMA_ONCE
+#    pragma once
+#endif
+
+#include "cfilesystem/private/c_atomic.h"
+
+namespace ncore
+{
+    namespace nfs
+    {
+        // Layout of the shared memory of a file cache, the same in every process:
+        //   [header][slots (index)][data ring]
+        // The memory is zero when it has been created, the creator initializes the
+        // header and sets m_ready, the other processes wait for that.
+
+        struct shmcacheheader_t
+        {
+            u32          m_magic;
+            s32 volatile m_ready;
+            u32          m_slot_count; // Power of 2
+            u32          m_reserved;
+            u64          m_size;        // Of the whole shared memory
+            u64          m_data_offset; // Of the data ring from the start
+            u64          m_data_size;
+            u64          m_used_end; // The ring has been formatted with blocks up to here
+            u64          m_head;     // Next block is allocated here
+            s32 volatile m_lock;     // Allocation of blocks and slots, the process id of the owner (0 = free)
+            s32 volatile m_disabled; // The owner of the lock died, the cache is not used anymore
+        };
+
+        namespace EShmKey
+        {
+            enum EEnum
+            {
+                EMPTY    = 0, // Never used, ends a probe sequence
+                REMOVED  = 1, // Evicted, the probe sequence continues past it
+                RESERVED = 2, // Taken by a process that is loading the file
+                FIRST    = 3, // Keys of files start here
+            };
+        }
+
+        // One cached file. m_refs counts the readers, -1 means it is being filled or has
+        // been evicted, an entry can only be evicted when no reader holds it.
+        struct shmslot_t
+        {
+            s64 volatile m_key; // File identity (EShmKey)
+            u64          m_modified;
+            u64          m_size;
+            u64          m_offset; // Of its block in the data ring
+            s32 volatile m_refs;
+            s32          m_reserved;
+        };
+
+        // Header of a block of the data ring, the data of the file follows it. A block
+        // whose slot does not point back at it (evicted, or never used) is free.
+        struct shmblock_t
+        {
+            u64 m_size; // Of the block, header included
+            s32 m_slot; // -1 when free
+            s32 m_reserved;
+        };
+
+        // Named shared memory of the host (platform), outCreated tells whether this call
+        // created it. Returns nullptr when it could not be created or attached.
+        extern void* shm_attach(const char* name, u64 size, bool& outCreated);
+        extern void  shm_detach(void* base, u64 size);
+
+        // Identity of the calling process and whether a process is still running (platform)
+        extern s32  shm_process_id();
+        extern bool shm_process_alive(s32 pid);
+
+    } // namespace nfs
+}; // namespace ncore
+
+#endif // __C_FILESYSTEM_SHMCACHE_H__
@@ -0,0 +1,54 @@
+#ifndef __C_FILESYSTEM_TINYLFU_H__
+#define __C_FILESYSTEM_TINYLFU_H__
+#include "ccore/c_target.h"
+#ifdef USE_PRAGMA_ONCE
+#    pragma once
+#endif
+
+namespace ncore
+{
+    class alloc_t;
+
+    namespace nfs
+    {
+        // Frequency sketch of the TinyLFU admission policy, a count-min sketch of 4 rows
+        // with 4-bit counters. Once the number of increments reaches the sample size
+        // (10 x width) all counters are halved, so the popularity of the past fades.
+        // A candidate is admitted in place of a victim when it is estimated to be used
+        // more often. Not thread-safe.
+        class tinylfu_t
+        {
+        public:
+            enum
+            {
+                ROWS        = 4,
+                MAX_COUNT   = 15,
+                SAMPLE_SIZE = 10, // Times the width
+            };
+
+            tinylfu_t();
+
+            void init(alloc_t* allocator, u32 width); // Width is rounded up to a power of 2
+            void exit();
+
+            void increment(u64 key);
+            u32  estimate(u64 key) const;
+            bool admit(u64 candidate, u64 victim) const { return estimate(candidate) > estimate(victim); }
+            void age();
+
+            inline u32 width() const { return m_mask + 1; }
+
+        private:
+            u32 index(u64 key, s32 row) const;
+
+            alloc_t* m_allocator;
+            u8*      m_table; // ROWS rows of width counters, two counters per byte
+            u32      m_mask;
+            u32      m_sample;
+            u32      m_additions;
+        };
+
+    } // namespace nfs
+}; // namespace ncore
+
+#endif // __C_FILESYSTEM_TINYLFU_H__
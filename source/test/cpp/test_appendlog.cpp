@@ -0,0 +1,196 @@
+#include "ccore/c_target.h"
+#include "cbase/c_allocator.h"
+
+#include "cunittest/cunittest.h"
+
+#include "cfilesystem/c_appendlog.h"
+#include "cfilesystem/c_dirpath.h"
+#include "cfilesystem/c_filepath.h"
+#include "cfilesystem/c_filesystem.h"
+#include "cfilesystem/c_threading.h"
+
+#include "cfilesystem/private/c_enumerations.h"
+#include "cfilesystem/private/c_filedevice.h"
+#include "cfilesystem/private/c_filesystem.h"
+#include "cfilesystem/private/c_segment.h"
+
+#include "test_helpers.h"
+
+using namespace ncore;
+using namespace ncore::nfs;
+
+extern alloc_t* gTestAllocator;
+
+namespace ncore
+{
+    static const char* sLogTestDir = "curdir:\\cfilesystem_test\\";
+    static const char* sLogDir     = "curdir:\\cfilesystem_test\\appendlog\\";
+    static const char* sLogPath    = "curdir:\\cfilesystem_test\\appendlog\\events";
+
+    // True when segment index of the log holds exactly size bytes of data
+    static bool sSegmentIs(s64 index, u8 const* data, u64 size)
+    {
+        char name[ESettings::MAX_PATH];
+        segment_name(sLogPath, index, "log", name, ESettings::MAX_PATH);
+        filedata_t file = nfs::load(nfs::filepath(name), gTestAllocator);
+        bool const same = file.isValid() && file.m_size == size && sSame(file.m_data, data, size);
+        nfs::unload(file);
+        return same;
+    }
+
+    static bool sSegmentExists(s64 index)
+    {
+        char name[ESettings::MAX_PATH];
+        segment_name(sLogPath, index, "log", name, ESettings::MAX_PATH);
+        return nfs::exists(nfs::filepath(name));
+    }
+} // namespace ncore
+
+UNITTEST_SUITE_BEGIN(appendlog)
+{
+    UNITTEST_FIXTURE(main)
+    {
+        enum
+        {
+            DATA_SIZE    = 64 * 1024,
+            SLAB_SIZE    = 4096,
+            SLAB_COUNT   = 4,
+            SEGMENT_SIZE = 16384,
+        };
+
+        static u8* sData = nullptr;
+
+        static void sOptions(appendlogoptions_t& options)
+        {
+            options.m_path         = sLogPath;
+            options.m_segment_size = SEGMENT_SIZE;
+            options.m_slab_size    = SLAB_SIZE;
+            options.m_slab_count   = SLAB_COUNT;
+        }
+
+        // Every test starts without segments of an earlier one
+        static void sClearLog()
+        {
+            nfs::rm(nfs::dirpath(sLogDir));
+            sMakeDir(sLogDir);
+        }
+
+        UNITTEST_FIXTURE_SETUP()
+        {
+            nfs::context_t ctxt;
+            ctxt.m_allocator = gTestAllocator;
+            nfs::create(ctxt);
+
+            sData = (u8*)gTestAllocator->allocate(DATA_SIZE);
+            sFill(sData, DATA_SIZE, 43);
+            sMakeDir(sLogTestDir);
+            sMakeDir(sLogDir);
+        }
+
+        UNITTEST_FIXTURE_TEARDOWN()
+        {
+            nfs::rm(nfs::dirpath(sLogDir));
+            gTestAllocator->deallocate(sData);
+            nfs::destroy();
+        }
+
+        UNITTEST_TEST(append_and_sync)
+        {
+            enum
+            {
+                RECORD  = 1000,
+                RECORDS = 50,
+            };
+
+            sClearLog();
+
+            appendlogoptions_t options;
+            sOptions(options);
+            appendlog_t log;
+            CHECK_TRUE(log.open(options));
+
+            // Records cross slab and segment boundaries
+            for (s32 i = 0; i < RECORDS; ++i)
+                CHECK_EQUAL(i * RECORD, log.append(sData + i * RECORD, RECORD));
+            CHECK_EQUAL(RECORDS * RECORD, log.size());
+            CHECK_TRUE(log.sync());
+            CHECK_EQUAL(RECORDS * RECORD, log.written());
+            log.close();
+
+            // 3 full segments and the rest
+            for (s32 i = 0; i < 3; ++i)
+                CHECK_TRUE(sSegmentIs(i, sData + i * SEGMENT_SIZE, SEGMENT_SIZE));
+            CHECK_TRUE(sSegmentIs(3, sData + 3 * SEGMENT_SIZE, RECORDS * RECORD - 3 * SEGMENT_SIZE));
+            CHECK_FALSE(sSegmentExists(4));
+
+            CHECK_EQUAL(-1, log.append(sData, 10));
+            CHECK_FALSE(log.sync());
+        }
+
+        UNITTEST_TEST(reopen_continues)
+        {
+            sClearLog();
+
+            appendlogoptions_t options;
+            sOptions(options);
+            appendlog_t log;
+            CHECK_TRUE(log.open(options));
+            CHECK_EQUAL(0, log.append(sData, 1000));
+            log.close();
+
+            // The tail is in the middle of a slab
+            CHECK_TRUE(log.open(options));
+            CHECK_EQUAL(1000, log.size());
+            CHECK_EQUAL(1000, log.append(sData + 1000, 500));
+            CHECK_EQUAL(1500, log.append(sData + 1500, SEGMENT_SIZE));
+            log.close();
+
+            CHECK_TRUE(sSegmentIs(0, sData, SEGMENT_SIZE));
+            CHECK_TRUE(sSegmentIs(1, sData + SEGMENT_SIZE, 1500));
+        }
+
+        UNITTEST_TEST(flush_on_io_thread)
+        {
+            sClearLog();
+
+            appendlogoptions_t options;
+            sOptions(options);
+            appendlog_t log;
+            CHECK_TRUE(log.open(options));
+
+            parked_thread_t thread;
+            s32 const       worker = mImpl->register_ioworker(&thread);
+
+            // The flusher is queued, nothing is written until an IO thread runs it
+            CHECK_EQUAL(0, log.append(sData, 1000));
+            log.flush();
+            CHECK_EQUAL(0, log.written());
+            doIO(&thread);
+            CHECK_EQUAL(1000, log.written());
+
+            // A full slab wakes the flusher without a flush
+            CHECK_EQUAL(1000, log.append(sData + 1000, SLAB_SIZE));
+            CHECK_EQUAL(1000, log.written());
+            doIO(&thread);
+            CHECK_EQUAL(SLAB_SIZE, log.written());
+
+            // sync() and close() wait for the flusher, they need a running IO thread
+            mImpl->unregister_ioworker(worker);
+            log.close();
+            CHECK_TRUE(sSegmentIs(0, sData, 1000 + SLAB_SIZE));
+        }
+
+        UNITTEST_TEST(invalid_options)
+        {
+            appendlog_t        log;
+            appendlogoptions_t options;
+            CHECK_FALSE(log.open(options));
+
+            sOptions(options);
+            options.m_slab_count = 1;
+            CHECK_FALSE(log.open(options));
+            CHECK_EQUAL(-1, log.append(sData, 10));
+        }
+    }
+}
+UNITTEST_SUITE_END
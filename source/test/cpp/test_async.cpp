@@ -0,0 +1,517 @@
+#include "ccore/c_target.h"
+#include "cbase/c_allocator.h"
+
+#include "cunittest/cunittest.h"
+
+#include "cfilesystem/c_async.h"
+#include "cfilesystem/c_attributes.h"
+#include "cfilesystem/c_await.h"
+#include "cfilesystem/c_dirpath.h"
+#include "cfilesystem/c_filepath.h"
+#include "cfilesystem/c_filesystem.h"
+#include "cfilesystem/c_stream.h"
+#include "cfilesystem/c_threading.h"
+
+#include "cfilesystem/private/c_filedevice.h"
+#include "cfilesystem/private/c_filesystem.h"
+
+#include "test_helpers.h"
+
+using namespace ncore;
+using namespace ncore::nfs;
+
+extern alloc_t* gTestAllocator;
+
+namespace ncore
+{
+    static const char* sAsyncDir  = "curdir:\\cfilesystem_test\\";
+    static const char* sAsyncFile = "curdir:\\cfilesystem_test\\async.bin";
+
+    class count_delegate_t : public async_delegate_t
+    {
+    public:
+        count_delegate_t() : m_calls(0), m_ok(0), m_bytes(0) {}
+
+        virtual void operator()(async_t const& token, EFileError::Enum error, s64 bytes)
+        {
+            m_calls += 1;
+            if (error.IsOk())
+                m_ok += 1;
+            m_bytes += bytes;
+        }
+
+        s32 m_calls;
+        s32 m_ok;
+        s64 m_bytes;
+    };
+
+#if DFS_COROUTINES
+    // Fire and forget coroutine, it runs until its first suspension when it is called
+    struct await_task_t
+    {
+        struct promise_type
+        {
+            await_task_t        get_return_object() { return await_task_t(); }
+            std::suspend_never  initial_suspend() noexcept { return {}; }
+            std::suspend_never  final_suspend() noexcept { return {}; }
+            void                return_void() {}
+            void                unhandled_exception() {}
+        };
+    };
+
+    static await_task_t sReadTwice(stream_t& stream, u8* buffer, ioresult_t* out, s32* done)
+    {
+        out[0] = DFS_AWAIT(read_await(stream, 0, buffer, 256));
+        out[1] = DFS_AWAIT(read_await(stream, 256, buffer + 256, 256, EIoPriority::HIGH));
+        *done  = 1;
+    }
+#endif
+} // namespace ncore
+
+UNITTEST_SUITE_BEGIN(async)
+{
+    UNITTEST_FIXTURE(main)
+    {
+        enum
+        {
+            DATA_SIZE = 64 * 1024,
+        };
+
+        static u8* sData = nullptr;
+        static u8* sRead = nullptr;
+
+        UNITTEST_FIXTURE_SETUP()
+        {
+            nfs::context_t ctxt;
+            ctxt.m_allocator = gTestAllocator;
+            nfs::create(ctxt);
+
+            sData = (u8*)gTestAllocator->allocate(DATA_SIZE);
+            sRead = (u8*)gTestAllocator->allocate(DATA_SIZE);
+            sFill(sData, DATA_SIZE, 1);
+            sMakeDir(sAsyncDir);
+            sWriteFile(sAsyncFile, sData, DATA_SIZE);
+        }
+
+        UNITTEST_FIXTURE_TEARDOWN()
+        {
+            nfs::rm(nfs::filepath(sAsyncFile));
+            gTestAllocator->deallocate(sRead);
+            gTestAllocator->deallocate(sData);
+            nfs::destroy();
+        }
+
+        UNITTEST_TEST(read_async_on_sync_stream)
+        {
+            stream_t stream;
+            nfs::open(nfs::filepath(sAsyncFile), EFileMode::Value_Open, EFileAccess::Value_Read, EFileOp::Value_Sync, stream);
+            CHECK_TRUE(stream.isOpen());
+
+            // Not an asynchronous stream, the request has been executed already
+            async_t token = stream.read_async(1000, sRead, 4096);
+            CHECK_TRUE(token.isValid());
+            CHECK_TRUE(token.poll().IsOk());
+            CHECK_EQUAL(4096, token.result());
+            CHECK_TRUE(sSame(sData + 1000, sRead, 4096));
+
+            // Retired, the outcome stays in the token
+            CHECK_TRUE(token.poll().IsOk());
+            CHECK_TRUE(token.wait().IsOk());
+            nfs::close(stream);
+        }
+
+        UNITTEST_TEST(write_async_then_read_async)
+        {
+            stream_t stream;
+            nfs::open(nfs::filepath(sAsyncFile), EFileMode::Value_Open, EFileAccess::Value_ReadWrite, EFileOp::Value_Async, stream);
+            CHECK_TRUE(stream.isOpen());
+            CHECK_TRUE(stream.isAsync());
+
+            sFill(sData + 8192, 512, 2);
+            async_t write = stream.write_async(8192, sData + 8192, 512);
+            CHECK_TRUE(write.wait().IsOk());
+            CHECK_EQUAL(512, write.result());
+
+            async_t read = stream.read_async(8192, sRead, 512);
+            CHECK_TRUE(read.wait().IsOk());
+            CHECK_EQUAL(512, read.result());
+            CHECK_TRUE(sSame(sData + 8192, sRead, 512));
+
+            // The stream position is not used nor updated
+            CHECK_EQUAL(0, stream.getPos());
+            nfs::close(stream);
+        }
+
+        UNITTEST_TEST(delegate_retires_the_request)
+        {
+            stream_t stream;
+            nfs::open(nfs::filepath(sAsyncFile), EFileMode::Value_Open, EFileAccess::Value_Read, EFileOp::Value_Async, stream);
+
+            count_delegate_t delegate;
+            async_t          token = stream.read_async(0, sRead, 100, &delegate);
+            token.wait();
+            CHECK_EQUAL(1, delegate.m_calls);
+            CHECK_EQUAL(1, delegate.m_ok);
+            CHECK_EQUAL(100, delegate.m_bytes);
+            CHECK_TRUE(token.poll().IsNoAsync());
+            nfs::close(stream);
+        }
+
+        UNITTEST_TEST(wait_any)
+        {
+            stream_t stream;
+            nfs::open(nfs::filepath(sAsyncFile), EFileMode::Value_Open, EFileAccess::Value_Read, EFileOp::Value_Async, stream);
+
+            async_t tokens[3];
+            CHECK_EQUAL(-1, async_t::wait_any(tokens, 3));
+
+            tokens[1]     = stream.read_async(4096, sRead, 1024);
+            s32 const any = async_t::wait_any(tokens, 3);
+            CHECK_EQUAL(1, any);
+            CHECK_TRUE(tokens[1].error().IsOk());
+            CHECK_TRUE(sSame(sData + 4096, sRead, 1024));
+            nfs::close(stream);
+        }
+
+        UNITTEST_TEST(invalid_requests)
+        {
+            stream_t stream;
+            async_t  token = stream.read_async(0, sRead, 16);
+            CHECK_TRUE(token.poll().IsBadf());
+
+            nfs::open(nfs::filepath(sAsyncFile), EFileMode::Value_Open, EFileAccess::Value_Read, EFileOp::Value_Async, stream);
+            token = stream.read_async(0, sRead, 16, nullptr, EIoPriority::COUNT);
+            CHECK_TRUE(token.poll().IsPriority());
+            token = stream.write_async(0, sData, 16);
+            CHECK_TRUE(token.poll().IsDeviceReadonly());
+            nfs::close(stream);
+        }
+
+        UNITTEST_TEST(high_priority_first)
+        {
+            parked_thread_t thread;
+            s32 const       worker = mImpl->register_ioworker(&thread);
+
+            stream_t stream;
+            nfs::open(nfs::filepath(sAsyncFile), EFileMode::Value_Open, EFileAccess::Value_Read, EFileOp::Value_Async, stream);
+
+            async_t low  = stream.read_async(0, sRead, 1024, nullptr, EIoPriority::LOW);
+            async_t high = stream.read_async(32768, sRead + 32768, 1024, nullptr, EIoPriority::HIGH);
+            CHECK_TRUE(low.poll().IsAsyncBusy());
+            CHECK_TRUE(high.poll().IsAsyncBusy());
+
+            CHECK_TRUE(mImpl->process_iorequest());
+            CHECK_TRUE(high.poll().IsOk());
+            CHECK_TRUE(low.poll().IsAsyncBusy());
+            CHECK_TRUE(low.wait().IsOk());
+            CHECK_TRUE(sSame(sData, sRead, 1024));
+            CHECK_TRUE(sSame(sData + 32768, sRead + 32768, 1024));
+
+            nfs::close(stream);
+            mImpl->unregister_ioworker(worker);
+        }
+
+        UNITTEST_TEST(read_waits_for_older_write)
+        {
+            parked_thread_t thread;
+            s32 const       worker = mImpl->register_ioworker(&thread);
+
+            stream_t stream;
+            nfs::open(nfs::filepath(sAsyncFile), EFileMode::Value_Open, EFileAccess::Value_ReadWrite, EFileOp::Value_Async, stream);
+
+            // The read is more urgent but overlaps the queued write, it has to see the new data
+            sFill(sData + 16384, 256, 3);
+            async_t write = stream.write_async(16384, sData + 16384, 256, nullptr, EIoPriority::LOW);
+            async_t read  = stream.read_async(16384, sRead, 256, nullptr, EIoPriority::HIGH);
+
+            CHECK_TRUE(mImpl->process_iorequest());
+            CHECK_TRUE(write.poll().IsOk());
+            CHECK_TRUE(read.poll().IsAsyncBusy());
+            CHECK_TRUE(read.wait().IsOk());
+            CHECK_TRUE(sSame(sData + 16384, sRead, 256));
+
+            nfs::close(stream);
+            mImpl->unregister_ioworker(worker);
+        }
+
+        UNITTEST_TEST(queued_until_an_io_thread_runs)
+        {
+            enum
+            {
+                COUNT = 8,
+            };
+
+            parked_thread_t thread;
+            s32 const       worker = mImpl->register_ioworker(&thread);
+
+            stream_t stream;
+            nfs::open(nfs::filepath(sAsyncFile), EFileMode::Value_Open, EFileAccess::Value_Read, EFileOp::Value_Async, stream);
+
+            async_t tokens[COUNT];
+            for (s32 i = 0; i < COUNT; ++i)
+                tokens[i] = stream.read_async(i * 4096, sRead + i * 4096, 4096);
+            for (s32 i = 0; i < COUNT; ++i)
+                CHECK_TRUE(tokens[i].poll().IsAsyncBusy());
+
+            // An IO thread that is told to quit right away still drains the queues
+            doIO(&thread);
+            for (s32 i = 0; i < COUNT; ++i)
+            {
+                CHECK_TRUE(tokens[i].poll().IsOk());
+                CHECK_EQUAL(4096, tokens[i].result());
+            }
+            CHECK_TRUE(sSame(sData, sRead, COUNT * 4096));
+
+            // Without IO threads a request executes on the calling thread
+            mImpl->unregister_ioworker(worker);
+            async_t token = stream.read_async(0, sRead, 16);
+            CHECK_TRUE(token.poll().IsOk());
+            nfs::close(stream);
+        }
+
+        UNITTEST_TEST(request_pool_exhausted)
+        {
+            enum
+            {
+                MAX_ASYNC = 64, // context_t default
+            };
+
+            parked_thread_t thread;
+            s32 const       worker = mImpl->register_ioworker(&thread);
+
+            stream_t stream;
+            nfs::open(nfs::filepath(sAsyncFile), EFileMode::Value_Open, EFileAccess::Value_Read, EFileOp::Value_Async, stream);
+
+            async_t tokens[MAX_ASYNC];
+            for (s32 i = 0; i < MAX_ASYNC; ++i)
+                tokens[i] = stream.read_async(i * 16, sRead + i * 16, 16);
+            async_t over = stream.read_async(0, sRead, 16);
+            CHECK_TRUE(over.poll().IsMaxAsync());
+
+            for (s32 i = 0; i < MAX_ASYNC; ++i)
+                CHECK_TRUE(tokens[i].wait().IsOk());
+            CHECK_TRUE(sSame(sData, sRead, MAX_ASYNC * 16));
+
+            nfs::close(stream);
+            mImpl->unregister_ioworker(worker);
+        }
+
+        UNITTEST_TEST(read_and_write_awaitables)
+        {
+            stream_t stream;
+            nfs::open(nfs::filepath(sAsyncFile), EFileMode::Value_Open, EFileAccess::Value_ReadWrite, EFileOp::Value_Async, stream);
+
+            sFill(sData + 20000, 300, 4);
+            ioresult_t const written = write_await(stream, 20000, sData + 20000, 300).wait();
+            CHECK_TRUE(written.isOk());
+            CHECK_EQUAL(300, written.m_result);
+
+            ioresult_t const read = read_await(stream, 20000, sRead, 300, EIoPriority::LOW).wait();
+            CHECK_TRUE(read.isOk());
+            CHECK_EQUAL(300, read.m_result);
+            CHECK_TRUE(sSame(sData + 20000, sRead, 300));
+            nfs::close(stream);
+        }
+
+        UNITTEST_TEST(call_awaitables)
+        {
+            parked_thread_t thread;
+            s32 const       worker = mImpl->register_ioworker(&thread);
+
+            filepath_t const fp = nfs::filepath(sAsyncFile);
+            stream_t         stream;
+            CHECK_TRUE(open_await(fp, EFileMode::Value_Open, EFileAccess::Value_ReadWrite, EFileOp::Value_Async, stream).wait().isOk());
+            CHECK_TRUE(stream.isOpen());
+            CHECK_EQUAL(DATA_SIZE, stream.getLength());
+
+            fileattrs_t attrs;
+            filetimes_t times;
+            CHECK_TRUE(stat_await(fp, attrs, times).wait().isOk());
+            CHECK_TRUE(flush_await(stream).wait().isOk());
+            CHECK_TRUE(close_await(stream).wait().isOk());
+            CHECK_FALSE(stream.isOpen());
+            CHECK_TRUE(close_await(stream).wait().m_error.IsBadf());
+
+            filepath_t const missing = nfs::filepath("curdir:\\cfilesystem_test\\missing.bin");
+            CHECK_TRUE(open_await(missing, EFileMode::Value_Open, EFileAccess::Value_Read, EFileOp::Value_Sync, stream).wait().m_error.IsNoFile());
+
+            mImpl->unregister_ioworker(worker);
+        }
+
+        UNITTEST_TEST(cancel_queued_request)
+        {
+            parked_thread_t thread;
+            s32 const       worker = mImpl->register_ioworker(&thread);
+
+            iostats_t before;
+            get_iostats(before);
+
+            stream_t stream;
+            nfs::open(nfs::filepath(sAsyncFile), EFileMode::Value_Open, EFileAccess::Value_Read, EFileOp::Value_Async, stream);
+
+            async_t token = stream.read_async(0, sRead, 1024);
+            CHECK_TRUE(token.cancel());
+            CHECK_FALSE(token.cancel());
+            CHECK_TRUE(token.wait().IsCancelled());
+            CHECK_EQUAL(-1, token.result());
+
+            async_t tokens[4];
+            for (s32 i = 0; i < 4; ++i)
+                tokens[i] = stream.read_async(i * 1024, sRead + i * 1024, 1024);
+            CHECK_EQUAL(4, stream.cancel_all());
+            CHECK_EQUAL(0, stream.cancel_all());
+            for (s32 i = 0; i < 4; ++i)
+                CHECK_TRUE(tokens[i].wait().IsCancelled());
+
+            iostats_t after;
+            get_iostats(after);
+            CHECK_EQUAL(before.m_cancelled + 5, after.m_cancelled);
+
+            // Once it has been executed it cannot be cancelled
+            mImpl->unregister_ioworker(worker);
+            token = stream.read_async(0, sRead, 1024);
+            CHECK_FALSE(token.cancel());
+            CHECK_TRUE(token.wait().IsOk());
+            nfs::close(stream);
+        }
+
+        UNITTEST_TEST(timeout_of_queued_request)
+        {
+            parked_thread_t thread;
+            s32 const       worker = mImpl->register_ioworker(&thread);
+
+            iostats_t before;
+            get_iostats(before);
+
+            stream_t stream;
+            nfs::open(nfs::filepath(sAsyncFile), EFileMode::Value_Open, EFileAccess::Value_Read, EFileOp::Value_Async, stream);
+
+            async_t stale = stream.read_async(0, sRead, 1024, nullptr, EIoPriority::NORMAL, 0, 1);
+            async_t fresh = stream.read_async(4096, sRead + 4096, 1024, nullptr, EIoPriority::NORMAL, 0, 60 * 1000 * 1000);
+            u64 const start = io_clock_us();
+            while (io_clock_us() < start + 10)
+            {
+            }
+
+            CHECK_TRUE(stale.wait().IsTimedOut());
+            CHECK_TRUE(fresh.wait().IsOk());
+            CHECK_TRUE(sSame(sData + 4096, sRead + 4096, 1024));
+
+            iostats_t after;
+            get_iostats(after);
+            CHECK_EQUAL(before.m_timedout + 1, after.m_timedout);
+
+            nfs::close(stream);
+            mImpl->unregister_ioworker(worker);
+        }
+
+        UNITTEST_TEST(vectored_read_and_write)
+        {
+            stream_t stream;
+            nfs::open(nfs::filepath(sAsyncFile), EFileMode::Value_Open, EFileAccess::Value_ReadWrite, EFileOp::Value_Sync, stream);
+
+            // Scatter, an empty span in the middle is skipped
+            iospan_t spans[3];
+            spans[0].m_data = sRead;
+            spans[0].m_size = 100;
+            spans[1].m_data = sRead + 100;
+            spans[1].m_size = 0;
+            spans[2].m_data = sRead + 1000;
+            spans[2].m_size = 900;
+            stream.setPos(2000);
+            CHECK_EQUAL(1000, stream.read(spans, 3));
+            CHECK_EQUAL(3000, stream.getPos());
+            CHECK_TRUE(sSame(sData + 2000, sRead, 100));
+            CHECK_TRUE(sSame(sData + 2100, sRead + 1000, 900));
+
+            // Gather, the pieces end up back-to-back in the file
+            sFill(sRead, 3000, 5);
+            ciospan_t pieces[3];
+            pieces[0].m_data = sRead + 2000;
+            pieces[0].m_size = 1000;
+            pieces[1].m_data = sRead;
+            pieces[1].m_size = 1000;
+            pieces[2].m_data = sRead + 1000;
+            pieces[2].m_size = 1000;
+            stream.setPos(40000);
+            CHECK_EQUAL(3000, stream.write(pieces, 3));
+            CHECK_EQUAL(43000, stream.getPos());
+
+            stream.setPos(40000);
+            CHECK_EQUAL(3000, stream.read(sData + 40000, 3000));
+            CHECK_TRUE(sSame(sRead + 2000, sData + 40000, 1000));
+            CHECK_TRUE(sSame(sRead, sData + 41000, 2000));
+
+            // Short at the end of the file
+            spans[0].m_data = sRead;
+            spans[0].m_size = 64;
+            spans[1].m_data = sRead + 64;
+            spans[1].m_size = 64;
+            stream.setPos(DATA_SIZE - 100);
+            CHECK_EQUAL(100, stream.read(spans, 2));
+            nfs::close(stream);
+        }
+
+        UNITTEST_TEST(vectored_async)
+        {
+            parked_thread_t thread;
+            s32 const       worker = mImpl->register_ioworker(&thread);
+
+            stream_t stream;
+            nfs::open(nfs::filepath(sAsyncFile), EFileMode::Value_Open, EFileAccess::Value_ReadWrite, EFileOp::Value_Async, stream);
+
+            sFill(sData + 50000, 600, 6);
+            ciospan_t pieces[2];
+            pieces[0].m_data = sData + 50000;
+            pieces[0].m_size = 200;
+            pieces[1].m_data = sData + 50200;
+            pieces[1].m_size = 400;
+            async_t write = stream.write_async(50000, pieces, 2);
+
+            iospan_t spans[2];
+            spans[0].m_data = sRead + 400;
+            spans[0].m_size = 200;
+            spans[1].m_data = sRead;
+            spans[1].m_size = 400;
+            async_t read = stream.read_async(50000, spans, 2);
+
+            CHECK_TRUE(write.wait().IsOk());
+            CHECK_EQUAL(600, write.result());
+            CHECK_TRUE(read.wait().IsOk());
+            CHECK_EQUAL(600, read.result());
+            CHECK_TRUE(sSame(sData + 50000, sRead + 400, 200));
+            CHECK_TRUE(sSame(sData + 50200, sRead, 400));
+
+            nfs::close(stream);
+            mImpl->unregister_ioworker(worker);
+        }
+
+#if DFS_COROUTINES
+        UNITTEST_TEST(coroutine_resumes_on_completion)
+        {
+            parked_thread_t thread;
+            s32 const       worker = mImpl->register_ioworker(&thread);
+
+            stream_t stream;
+            nfs::open(nfs::filepath(sAsyncFile), EFileMode::Value_Open, EFileAccess::Value_Read, EFileOp::Value_Async, stream);
+
+            // Suspends on the first read, the completions resume it on this thread
+            ioresult_t results[2];
+            s32        done = 0;
+            sReadTwice(stream, sRead, results, &done);
+            CHECK_EQUAL(0, done);
+            while (done == 0)
+                mImpl->process_iorequest();
+
+            CHECK_TRUE(results[0].isOk());
+            CHECK_TRUE(results[1].isOk());
+            CHECK_EQUAL(256, results[1].m_result);
+            CHECK_TRUE(sSame(sData, sRead, 512));
+
+            nfs::close(stream);
+            mImpl->unregister_ioworker(worker);
+        }
+#endif
+    }
+}
+UNITTEST_SUITE_END
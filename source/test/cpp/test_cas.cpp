@@ -0,0 +1,253 @@
+#include "ccore/c_target.h"
+#include "cbase/c_allocator.h"
+
+#include "cunittest/cunittest.h"
+
+#include "cfilesystem/c_dirpath.h"
+#include "cfilesystem/c_filepath.h"
+#include "cfilesystem/c_filesystem.h"
+
+#include "cfilesystem/private/c_filedevice.h"
+
+#include "test_helpers.h"
+
+using namespace ncore;
+using namespace ncore::nfs;
+
+extern alloc_t* gTestAllocator;
+
+namespace ncore
+{
+    static const char* sCasTestDir = "curdir:\\cfilesystem_test\\";
+    static const char* sCasDir     = "curdir:\\cfilesystem_test\\cas\\";
+    static const char* sCasStore   = "curdir:\\cfilesystem_test\\cas\\store\\";
+    static const char* sCasFileA   = "curdir:\\cfilesystem_test\\cas\\a.bin";
+    static const char* sCasFileB   = "curdir:\\cfilesystem_test\\cas\\b.bin";
+    static const char* sCasFileC   = "curdir:\\cfilesystem_test\\cas\\c.bin";
+
+    // Writes size bytes of data to a new file on the device, step bytes per write
+    static bool sDeviceWrite(filedevice_t* device, const char* path, u8 const* data, u64 size, u64 step)
+    {
+        void* handle = nullptr;
+        if (!device->createFile(nfs::filepath(path), true, true, handle))
+            return false;
+        bool ok = true;
+        for (u64 pos = 0; ok && pos < size; pos += step)
+        {
+            u64 const count = (size - pos) < step ? (size - pos) : step;
+            u64       n     = 0;
+            ok              = device->writeFile(handle, pos, data + pos, count, n) && n == count;
+        }
+        return device->closeFile(handle) && ok;
+    }
+
+    // True when the device gives exactly size bytes of data for the file
+    static bool sDeviceHas(filedevice_t* device, const char* path, u8 const* data, u64 size, u8* buffer, u64 capacity)
+    {
+        u64 n = 0;
+        return device->loadFile(nfs::filepath(path), buffer, capacity, n) && n == size && sSame(buffer, data, size);
+    }
+} // namespace ncore
+
+UNITTEST_SUITE_BEGIN(cas)
+{
+    UNITTEST_FIXTURE(main)
+    {
+        enum
+        {
+            DATA_SIZE = 256 * 1024,
+            FILE_SIZE = 200000,
+            MIN_CHUNK = 2 * 1024,
+            AVG_CHUNK = 8 * 1024,
+            MAX_CHUNK = 32 * 1024,
+        };
+
+        static u8*           sData   = nullptr;
+        static u8*           sRead   = nullptr;
+        static filedevice_t* sDevice = nullptr;
+
+        // Every test starts with an empty store, the stats count from there
+        static filedevice_t* sCreate(casstats_t* stats)
+        {
+            nfs::rm(nfs::dirpath(sCasDir));
+            sMakeDir(sCasDir);
+            sMakeDir(sCasStore);
+
+            casoptions_t options;
+            options.m_store     = sCasStore;
+            options.m_min_chunk = MIN_CHUNK;
+            options.m_avg_chunk = AVG_CHUNK;
+            options.m_max_chunk = MAX_CHUNK;
+            options.m_verify    = true;
+            options.m_stats     = stats;
+            return nfs::create_cas_device(sDevice, options);
+        }
+
+        UNITTEST_FIXTURE_SETUP()
+        {
+            nfs::context_t ctxt;
+            ctxt.m_allocator = gTestAllocator;
+            nfs::create(ctxt);
+
+            sData = (u8*)gTestAllocator->allocate(DATA_SIZE);
+            sRead = (u8*)gTestAllocator->allocate(DATA_SIZE);
+            sFill(sData, DATA_SIZE, 48);
+            sMakeDir(sCasTestDir);
+            sDevice = nfs::dirpath(sCasTestDir).m_device->m_fileDevice;
+        }
+
+        UNITTEST_FIXTURE_TEARDOWN()
+        {
+            nfs::rm(nfs::dirpath(sCasDir));
+            gTestAllocator->deallocate(sRead);
+            gTestAllocator->deallocate(sData);
+            nfs::destroy();
+        }
+
+        UNITTEST_TEST(same_content_is_stored_once)
+        {
+            casstats_t    stats;
+            filedevice_t* cas = sCreate(&stats);
+            CHECK_TRUE(cas != nullptr);
+
+            CHECK_TRUE(sDeviceWrite(cas, sCasFileA, sData, FILE_SIZE, FILE_SIZE));
+            CHECK_TRUE(stats.m_chunks_stored > 1);
+            CHECK_EQUAL(FILE_SIZE, stats.m_bytes_stored);
+            CHECK_EQUAL(0, stats.m_chunks_deduped);
+            CHECK_TRUE(sDeviceHas(cas, sCasFileA, sData, FILE_SIZE, sRead, DATA_SIZE));
+
+            // The device only holds the list of chunks at the path of the file
+            u64 size = 0;
+            CHECK_TRUE(cas->statFile(nfs::filepath(sCasFileA), size, nullptr, nullptr));
+            CHECK_EQUAL(FILE_SIZE, size);
+            CHECK_TRUE(nfs::size(nfs::filepath(sCasFileA)) < FILE_SIZE / 10);
+
+            // Written in other pieces, the chunks are the same
+            s64 const stored = stats.m_chunks_stored;
+            CHECK_TRUE(sDeviceWrite(cas, sCasFileB, sData, FILE_SIZE, 3000));
+            CHECK_EQUAL(stored, stats.m_chunks_stored);
+            CHECK_EQUAL(stored, stats.m_chunks_deduped);
+            CHECK_EQUAL(FILE_SIZE, stats.m_bytes_deduped);
+            CHECK_TRUE(sDeviceHas(cas, sCasFileB, sData, FILE_SIZE, sRead, DATA_SIZE));
+
+            nfs::destroy_cas_device(cas);
+        }
+
+        UNITTEST_TEST(copy_move_and_delete_keep_the_chunks)
+        {
+            casstats_t    stats;
+            filedevice_t* cas = sCreate(&stats);
+            CHECK_TRUE(cas != nullptr);
+            CHECK_TRUE(sDeviceWrite(cas, sCasFileA, sData, FILE_SIZE, FILE_SIZE));
+            s64 const stored = stats.m_chunks_stored;
+
+            CHECK_TRUE(cas->copyFile(nfs::filepath(sCasFileA), nfs::filepath(sCasFileB), true));
+            CHECK_TRUE(cas->moveFile(nfs::filepath(sCasFileB), nfs::filepath(sCasFileC), true));
+            CHECK_FALSE(cas->hasFile(nfs::filepath(sCasFileB)));
+            CHECK_TRUE(cas->deleteFile(nfs::filepath(sCasFileA)));
+            CHECK_FALSE(cas->hasFile(nfs::filepath(sCasFileA)));
+
+            // Nothing was stored or read again, the copy still has all of its chunks
+            CHECK_EQUAL(stored, stats.m_chunks_stored);
+            CHECK_EQUAL(0, stats.m_chunks_deduped);
+            CHECK_TRUE(sDeviceHas(cas, sCasFileC, sData, FILE_SIZE, sRead, DATA_SIZE));
+
+            nfs::destroy_cas_device(cas);
+        }
+
+        UNITTEST_TEST(writes_append)
+        {
+            filedevice_t* cas = sCreate(nullptr);
+            CHECK_TRUE(cas != nullptr);
+            filepath_t const fp = nfs::filepath(sCasFileA);
+
+            void* handle = nullptr;
+            CHECK_TRUE(cas->createFile(fp, true, true, handle));
+            u64 n = 0;
+            CHECK_TRUE(cas->writeFile(handle, 0, sData, 1000, n));
+            CHECK_FALSE(cas->writeFile(handle, 500, sData + 500, 100, n));
+            CHECK_FALSE(cas->writeFile(handle, 2000, sData + 2000, 100, n));
+            CHECK_EQUAL(0, n);
+            CHECK_TRUE(cas->writeFile(handle, 1000, sData + 1000, 4000, n));
+            CHECK_TRUE(cas->closeFile(handle));
+
+            // Opened again the file continues at its end
+            CHECK_TRUE(cas->openFile(fp, EFileMode::Value_Open, EFileAccess::Value_ReadWrite, EFileOp::Value_Sync, handle));
+            u64 length = 0;
+            CHECK_TRUE(cas->getLengthOfFile(handle, length));
+            CHECK_EQUAL(5000, length);
+            CHECK_FALSE(cas->writeFile(handle, 0, sData, 100, n));
+            CHECK_TRUE(cas->writeFile(handle, 5000, sData + 5000, FILE_SIZE - 5000, n));
+            CHECK_TRUE(cas->closeFile(handle));
+            CHECK_TRUE(sDeviceHas(cas, sCasFileA, sData, FILE_SIZE, sRead, DATA_SIZE));
+
+            // Read only handles do not write
+            CHECK_TRUE(cas->openFile(fp, EFileMode::Value_Open, EFileAccess::Value_Read, EFileOp::Value_Sync, handle));
+            CHECK_FALSE(cas->writeFile(handle, FILE_SIZE, sData, 100, n));
+            CHECK_TRUE(cas->closeFile(handle));
+
+            nfs::destroy_cas_device(cas);
+        }
+
+        UNITTEST_TEST(flush_shows_what_was_written)
+        {
+            filedevice_t* cas = sCreate(nullptr);
+            CHECK_TRUE(cas != nullptr);
+            filepath_t const fp = nfs::filepath(sCasFileA);
+
+            void* handle = nullptr;
+            CHECK_TRUE(cas->createFile(fp, true, true, handle));
+            u64 n = 0;
+            CHECK_TRUE(cas->writeFile(handle, 0, sData, 5000, n));
+            CHECK_TRUE(cas->flushFile(handle));
+            CHECK_TRUE(sDeviceHas(cas, sCasFileA, sData, 5000, sRead, DATA_SIZE));
+
+            // The data flushed as the last chunk is cut again by the writes after it
+            CHECK_TRUE(cas->writeFile(handle, 5000, sData + 5000, FILE_SIZE - 5000, n));
+            u64 length = 0;
+            CHECK_TRUE(cas->getLengthOfFile(handle, length));
+            CHECK_EQUAL(FILE_SIZE, length);
+            CHECK_TRUE(cas->readFile(handle, 4000, sRead, 2000, n));
+            CHECK_EQUAL(2000, n);
+            CHECK_TRUE(sSame(sRead, sData + 4000, 2000));
+            CHECK_TRUE(cas->closeFile(handle));
+            CHECK_TRUE(sDeviceHas(cas, sCasFileA, sData, FILE_SIZE, sRead, DATA_SIZE));
+
+            nfs::destroy_cas_device(cas);
+        }
+
+        UNITTEST_TEST(set_length)
+        {
+            filedevice_t* cas = sCreate(nullptr);
+            CHECK_TRUE(cas != nullptr);
+            CHECK_TRUE(sDeviceWrite(cas, sCasFileA, sData, FILE_SIZE, FILE_SIZE));
+
+            void* handle = nullptr;
+            CHECK_TRUE(cas->openFile(nfs::filepath(sCasFileA), EFileMode::Value_Open, EFileAccess::Value_ReadWrite, EFileOp::Value_Sync, handle));
+            CHECK_TRUE(cas->setLengthOfFile(handle, 100000));
+            CHECK_TRUE(cas->setLengthOfFile(handle, 101000));
+            CHECK_TRUE(cas->closeFile(handle));
+
+            // Cut back into a chunk, then grown with zeros
+            u64 n = 0;
+            CHECK_TRUE(cas->loadFile(nfs::filepath(sCasFileA), sRead, DATA_SIZE, n));
+            CHECK_EQUAL(101000, n);
+            CHECK_TRUE(sSame(sRead, sData, 100000));
+            bool zeros = true;
+            for (u32 i = 100000; i < 101000; ++i)
+                zeros = zeros && sRead[i] == 0;
+            CHECK_TRUE(zeros);
+
+            nfs::destroy_cas_device(cas);
+        }
+
+        UNITTEST_TEST(store_is_required)
+        {
+            casoptions_t options;
+            CHECK_TRUE(nfs::create_cas_device(sDevice, options) == nullptr);
+            options.m_store = "";
+            CHECK_TRUE(nfs::create_cas_device(sDevice, options) == nullptr);
+        }
+    }
+}
+UNITTEST_SUITE_END
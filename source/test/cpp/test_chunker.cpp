@@ -0,0 +1,119 @@
+#include "ccore/c_target.h"
+#include "cbase/c_allocator.h"
+
+#include "cunittest/cunittest.h"
+
+#include "cfilesystem/c_hash.h"
+
+#include "cfilesystem/private/c_chunker.h"
+
+#include "test_helpers.h"
+
+using namespace ncore;
+using namespace ncore::nfs;
+
+extern alloc_t* gTestAllocator;
+
+UNITTEST_SUITE_BEGIN(chunker)
+{
+    UNITTEST_FIXTURE(main)
+    {
+        enum
+        {
+            DATA_SIZE = 2 * 1024 * 1024,
+            MIN_SIZE  = 4 * 1024,
+            AVG_SIZE  = 16 * 1024,
+            MAX_SIZE  = 64 * 1024,
+        };
+
+        static u8*       sData = nullptr;
+        static chunker_t sChunker;
+
+        // The end offsets of the chunks of data, returns their number
+        static s32 sChunk(u8 const* data, u64 size, u64* ends, s32 capacity)
+        {
+            s32 count = 0;
+            u64 at    = 0;
+            while (at < size && count < capacity)
+            {
+                at += sChunker.cut(data + at, size - at);
+                ends[count++] = at;
+            }
+            return count;
+        }
+
+        UNITTEST_FIXTURE_SETUP()
+        {
+            sData = (u8*)gTestAllocator->allocate(DATA_SIZE + 1);
+            sFill(sData + 1, DATA_SIZE, 1);
+            sChunker.init(MIN_SIZE, AVG_SIZE, MAX_SIZE);
+        }
+        UNITTEST_FIXTURE_TEARDOWN() { gTestAllocator->deallocate(sData); }
+
+        UNITTEST_TEST(hash_is_stable)
+        {
+            // Chunks are stored under their hash, it must never change
+            hash128_t const h = hash128("abc", 3);
+            CHECK_EQUAL((u64)0xa1ad72689a29b162ull, h.m_hi);
+            CHECK_EQUAL((u64)0xa69d16992c5009f9ull, h.m_lo);
+
+            char hex[33];
+            hash_to_hex(h, hex);
+            CHECK_EQUAL('a', hex[0]);
+            CHECK_EQUAL('9', hex[31]);
+            CHECK_EQUAL('\0', hex[32]);
+        }
+
+        UNITTEST_TEST(hash_sees_length_and_bits)
+        {
+            CHECK_TRUE(hash128("abc", 3) != hash128("abc\0", 4));
+
+            hash128_t const a = hash128(sData + 1, DATA_SIZE);
+            sData[1 + 1000000] ^= 1;
+            hash128_t const b = hash128(sData + 1, DATA_SIZE);
+            sData[1 + 1000000] ^= 1;
+            CHECK_TRUE(a != b);
+            CHECK_TRUE(a == hash128(sData + 1, DATA_SIZE));
+        }
+
+        UNITTEST_TEST(chunks_are_within_bounds)
+        {
+            u64       ends[1024];
+            s32 const count = sChunk(sData + 1, DATA_SIZE, ends, 1024);
+            CHECK_TRUE(count > (DATA_SIZE / MAX_SIZE));
+            CHECK_EQUAL((u64)DATA_SIZE, ends[count - 1]);
+            for (s32 i = 0; i < count - 1; ++i)
+            {
+                u64 const size = ends[i] - (i > 0 ? ends[i - 1] : 0);
+                CHECK_TRUE(size >= MIN_SIZE && size <= MAX_SIZE);
+            }
+        }
+
+        UNITTEST_TEST(boundaries_realign_after_insert)
+        {
+            u64       ends[1024];
+            u64       shifted[1024];
+            s32 const count = sChunk(sData + 1, DATA_SIZE, ends, 1024);
+
+            // One byte inserted at offset 100, the data before it moves down one byte
+            for (s32 i = 0; i < 100; ++i)
+                sData[i] = sData[i + 1];
+            sData[100] = 0x5A;
+
+            s32 const count2 = sChunk(sData, DATA_SIZE + 1, shifted, 1024);
+            s32       same   = 0;
+            s32       j      = 0;
+            for (s32 i = 0; i < count2; ++i)
+            {
+                while (j < count && ends[j] < (shifted[i] - 1))
+                    j += 1;
+                if (j < count && ends[j] == (shifted[i] - 1))
+                    same += 1;
+            }
+            CHECK_TRUE(same >= (count - 2));
+
+            sFill(sData + 1, DATA_SIZE, 1);
+        }
+    }
+}
+UNITTEST_SUITE_END
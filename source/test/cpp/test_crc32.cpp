@@ -0,0 +1,33 @@
+#include "ccore/c_target.h"
+
+#include "cunittest/cunittest.h"
+
+#include "cfilesystem/private/c_crc32.h"
+
+using namespace ncore;
+using namespace ncore::nfs;
+
+UNITTEST_SUITE_BEGIN(crc32)
+{
+    UNITTEST_FIXTURE(main)
+    {
+        UNITTEST_FIXTURE_SETUP() {}
+        UNITTEST_FIXTURE_TEARDOWN() {}
+
+        UNITTEST_TEST(check_value)
+        {
+            const char* text = "123456789";
+            CHECK_EQUAL((u32)0xE3069283, crc32c(0, text, 9));
+            CHECK_EQUAL((u32)0, crc32c(0, text, 0));
+        }
+
+        UNITTEST_TEST(continued_equals_whole)
+        {
+            const char* text  = "The quick brown fox jumps over the lazy dog";
+            u32 const   whole = crc32c(0, text, 43);
+            u32 const   part  = crc32c(crc32c(0, text, 10), text + 10, 33);
+            CHECK_EQUAL(whole, part);
+        }
+    }
+}
+UNITTEST_SUITE_END
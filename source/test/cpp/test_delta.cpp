@@ -0,0 +1,85 @@
+#include "ccore/c_target.h"
+#include "cbase/c_allocator.h"
+
+#include "cunittest/cunittest.h"
+
+#include "cfilesystem/private/c_delta.h"
+
+#include "test_helpers.h"
+
+using namespace ncore;
+using namespace ncore::nfs;
+
+extern alloc_t* gTestAllocator;
+
+UNITTEST_SUITE_BEGIN(delta)
+{
+    UNITTEST_FIXTURE(main)
+    {
+        enum
+        {
+            DATA_SIZE  = 256 * 1024,
+            BLOCK_SIZE = 2048,
+            BLOCKS     = DATA_SIZE / BLOCK_SIZE,
+        };
+
+        static u8* sData  = nullptr;
+        static u8* sOther = nullptr;
+
+        UNITTEST_FIXTURE_SETUP()
+        {
+            sData  = (u8*)gTestAllocator->allocate(DATA_SIZE);
+            sOther = (u8*)gTestAllocator->allocate(DATA_SIZE + 1);
+            sFill(sData, DATA_SIZE, 7);
+        }
+        UNITTEST_FIXTURE_TEARDOWN()
+        {
+            gTestAllocator->deallocate(sData);
+            gTestAllocator->deallocate(sOther);
+        }
+
+        UNITTEST_TEST(rolling_equals_recompute)
+        {
+            rollsum_t sum;
+            sum.init(sData, BLOCK_SIZE);
+            for (u32 pos = 1; pos < 10000; ++pos)
+            {
+                sum.roll(sData[pos - 1], sData[pos - 1 + BLOCK_SIZE]);
+                if ((pos % 97) == 0)
+                {
+                    rollsum_t fresh;
+                    fresh.init(sData + pos, BLOCK_SIZE);
+                    CHECK_EQUAL(fresh.digest(), sum.digest());
+                }
+            }
+        }
+
+        UNITTEST_TEST(finds_blocks_after_insert)
+        {
+            deltaindex_t index;
+            CHECK_TRUE(index.init(gTestAllocator, BLOCK_SIZE, BLOCKS));
+            for (u32 b = 0; b < BLOCKS; ++b)
+                index.add(b, sData + (b * BLOCK_SIZE));
+            CHECK_EQUAL((u32)BLOCKS, index.count());
+
+            // One byte inserted at offset 100, every block after it is one byte later
+            for (u32 i = 0; i < 100; ++i)
+                sOther[i] = sData[i];
+            sOther[100] = 0x5A;
+            for (u32 i = 100; i < DATA_SIZE; ++i)
+                sOther[i + 1] = sData[i];
+
+            rollsum_t sum;
+            sum.init(sOther + 1, BLOCK_SIZE);
+            CHECK_EQUAL((s64)-1, index.find(sum.digest(), sOther + 1));
+            for (u32 b = 1; b < BLOCKS; ++b)
+            {
+                u8 const* window = sOther + (b * BLOCK_SIZE) + 1;
+                sum.init(window, BLOCK_SIZE);
+                CHECK_EQUAL((s64)b, index.find(sum.digest(), window));
+            }
+            index.exit();
+        }
+    }
+}
+UNITTEST_SUITE_END
@@ -1,12 +1,820 @@
-#include "ccore/c_target.h"
-#include "cbase/c_runes.h"
-#include "ctime/c_datetime.h"
-
-#include "cunittest/cunittest.h"
-
-#include "cfilesystem/private/c_filedevice.h"
-#include "cfilesystem/private/c_filesystem.h"
-#include "cfilesystem/c_filesystem.h"
-#include "cfilesystem/c_filepath.h"
-#include "cfilesystem/c_dirpath.h"
-#include "cfilesystem/c_stream.h"
+#include "ccore/c_target.h"
+#include "cbase/c_allocator.h"
+#include "cbase/c_buffer.h"
+#include "cbase/c_runes.h"
+#include "ctime/c_datetime.h"
+
+#include "cunittest/cunittest.h"
+
+#include "cfilesystem/private/c_filedevice.h"
+#include "cfilesystem/private/c_filesystem.h"
+#include "cfilesystem/c_batch.h"
+#include "cfilesystem/c_filesystem.h"
+#include "cfilesystem/c_filepath.h"
+#include "cfilesystem/c_dirpath.h"
+#include "cfilesystem/c_hash.h"
+#include "cfilesystem/c_stream.h"
+#include "cfilesystem/c_threading.h"
+
+#include "test_helpers.h"
+
+using namespace ncore;
+using namespace ncore::nfs;
+
+extern alloc_t* gTestAllocator;
+
+namespace ncore
+{
+    static const char* sFsDir     = "curdir:\\cfilesystem_test\\fs\\";
+    static const char* sFsFileA   = "curdir:\\cfilesystem_test\\fs\\a.bin";
+    static const char* sFsFileB   = "curdir:\\cfilesystem_test\\fs\\b.bin";
+    static const char* sFsMissing = "curdir:\\cfilesystem_test\\fs\\missing.bin";
+
+    static const char* sTreeSrc      = "curdir:\\cfilesystem_test\\fs\\src\\";
+    static const char* sTreeSrcSub   = "curdir:\\cfilesystem_test\\fs\\src\\sub\\";
+    static const char* sTreeDst      = "curdir:\\cfilesystem_test\\fs\\dst\\";
+    static const char* sTreeDstOld   = "curdir:\\cfilesystem_test\\fs\\dst\\old\\";
+    static const char* sTreeExtra    = "curdir:\\cfilesystem_test\\fs\\dst\\extra.bin";
+    static const char* sTreeOldExtra = "curdir:\\cfilesystem_test\\fs\\dst\\old\\extra.bin";
+    static const char* sTreeFiles[] = {
+        "a.bin",
+        "sub\\b.bin",
+        "sub\\big.bin",
+    };
+
+    enum
+    {
+        TREE_FILES    = 3,
+        TREE_BIG_SIZE = 4 * 1024 * 1024 + 4097, // More than one hash chunk
+    };
+
+    static void sTreePath(const char* root, s32 file, char* out, s32 capacity)
+    {
+        s32 n = 0;
+        for (const char* c = root; *c != 0 && n < capacity - 1; ++c)
+            out[n++] = *c;
+        for (const char* c = sTreeFiles[file]; *c != 0 && n < capacity - 1; ++c)
+            out[n++] = *c;
+        out[n] = 0;
+    }
+
+    // src\a.bin, src\sub\b.bin and src\sub\big.bin which is larger than 4 MB
+    static bool sMakeTree(u8 const* data, u8 const* big)
+    {
+        sMakeDir(sTreeSrc);
+        sMakeDir(sTreeSrcSub);
+
+        char path[128];
+        sTreePath(sTreeSrc, 0, path, sizeof(path));
+        bool ok = sWriteFile(path, data, 1000);
+        sTreePath(sTreeSrc, 1, path, sizeof(path));
+        ok = ok && sWriteFile(path, data + 1000, 70000);
+        sTreePath(sTreeSrc, 2, path, sizeof(path));
+        ok = ok && sWriteFile(path, big, TREE_BIG_SIZE);
+        return ok;
+    }
+
+    static bool sTreeIs(const char* root, u8 const* data, u8 const* big)
+    {
+        char path[128];
+        sTreePath(root, 0, path, sizeof(path));
+        bool same = sFileIs(path, data, 1000);
+        sTreePath(root, 1, path, sizeof(path));
+        same = same && sFileIs(path, data + 1000, 70000);
+        sTreePath(root, 2, path, sizeof(path));
+        same = same && sFileIs(path, big, TREE_BIG_SIZE);
+        return same;
+    }
+} // namespace ncore
+
+UNITTEST_SUITE_BEGIN(filesystem)
+{
+    UNITTEST_FIXTURE(main)
+    {
+        enum
+        {
+            DATA_SIZE = 256 * 1024,
+        };
+
+        static u8* sData = nullptr;
+        static u8* sRead = nullptr;
+
+        UNITTEST_FIXTURE_SETUP()
+        {
+            nfs::context_t ctxt;
+            ctxt.m_allocator = gTestAllocator;
+            nfs::create(ctxt);
+
+            sData = (u8*)gTestAllocator->allocate(DATA_SIZE);
+            sRead = (u8*)gTestAllocator->allocate(DATA_SIZE);
+            sFill(sData, DATA_SIZE, 11);
+            sMakeDir("curdir:\\cfilesystem_test\\");
+            sMakeDir(sFsDir);
+        }
+
+        UNITTEST_FIXTURE_TEARDOWN()
+        {
+            nfs::rm(nfs::dirpath(sFsDir));
+            gTestAllocator->deallocate(sRead);
+            gTestAllocator->deallocate(sData);
+            nfs::destroy();
+        }
+
+        UNITTEST_TEST(load)
+        {
+            CHECK_TRUE(sWriteFile(sFsFileA, sData, 100000));
+
+            filedata_t data = nfs::load(nfs::filepath(sFsFileA), gTestAllocator);
+            CHECK_TRUE(data.isValid());
+            CHECK_EQUAL(100000, data.m_size);
+            CHECK_TRUE(data.m_mapping == nullptr); // Below context_t::m_load_map_threshold
+            CHECK_TRUE(sSame(sData, data.m_data, 100000));
+            nfs::unload(data);
+            CHECK_FALSE(data.isValid());
+
+            data = nfs::load(nfs::filepath(sFsMissing), gTestAllocator);
+            CHECK_FALSE(data.isValid());
+        }
+
+        UNITTEST_TEST(load_into)
+        {
+            CHECK_TRUE(sWriteFile(sFsFileA, sData, 5000));
+
+            buffer_t fits(sRead, sRead + 8192);
+            CHECK_EQUAL(5000, nfs::load_into(nfs::filepath(sFsFileA), fits));
+            CHECK_TRUE(sSame(sData, sRead, 5000));
+
+            buffer_t small(sRead, sRead + 4999);
+            CHECK_EQUAL(-1, nfs::load_into(nfs::filepath(sFsFileA), small));
+            CHECK_EQUAL(-1, nfs::load_into(nfs::filepath(sFsMissing), fits));
+        }
+
+        UNITTEST_TEST(load_many)
+        {
+            CHECK_TRUE(sWriteFile(sFsFileA, sData, 3000));
+            CHECK_TRUE(sWriteFile(sFsFileB, sData + 3000, 7000));
+
+            filepath_t paths[3];
+            paths[0] = nfs::filepath(sFsFileA);
+            paths[1] = nfs::filepath(sFsMissing);
+            paths[2] = nfs::filepath(sFsFileB);
+
+            filedata_t data[3];
+            nfs::load(paths, 3, gTestAllocator, data);
+            CHECK_TRUE(data[0].isValid());
+            CHECK_FALSE(data[1].isValid());
+            CHECK_TRUE(data[2].isValid());
+            CHECK_EQUAL(3000, data[0].m_size);
+            CHECK_EQUAL(7000, data[2].m_size);
+            CHECK_TRUE(sSame(sData, data[0].m_data, 3000));
+            CHECK_TRUE(sSame(sData + 3000, data[2].m_data, 7000));
+            for (s32 i = 0; i < 3; ++i)
+                nfs::unload(data[i]);
+        }
+
+        UNITTEST_TEST(batch_stat_and_load)
+        {
+            CHECK_TRUE(sWriteFile(sFsFileA, sData, 3000));
+            CHECK_TRUE(sWriteFile(sFsFileB, sData + 3000, 7000));
+
+            filepath_t paths[3];
+            paths[0] = nfs::filepath(sFsFileA);
+            paths[1] = nfs::filepath(sFsMissing);
+            paths[2] = nfs::filepath(sFsFileB);
+
+            s8      errors[3];
+            u64     sizes[3];
+            u8*     data[3];
+            batch_t batch;
+            batch.m_errors = errors;
+            batch.m_sizes  = sizes;
+            CHECK_EQUAL(2, batch_stat(paths, 3, batch));
+            CHECK_EQUAL((s8)EFileError::ERROR_OK, errors[0]);
+            CHECK_EQUAL((s8)EFileError::ERROR_NO_FILE, errors[1]);
+            CHECK_EQUAL((s8)EFileError::ERROR_OK, errors[2]);
+            CHECK_EQUAL(3000, sizes[0]);
+            CHECK_EQUAL(7000, sizes[2]);
+
+            // The files are placed back to back (aligned) in the arena
+            batch.m_data       = data;
+            batch.m_arena      = sRead;
+            batch.m_arena_size = DATA_SIZE;
+            CHECK_EQUAL(2, batch_load(paths, 3, batch));
+            CHECK_TRUE(data[1] == nullptr);
+            CHECK_TRUE(sSame(sData, data[0], 3000));
+            CHECK_TRUE(sSame(sData + 3000, data[2], 7000));
+            CHECK_TRUE(data[0] >= sRead && (data[0] + 3000) <= (sRead + batch.m_arena_used));
+            CHECK_TRUE(data[2] >= sRead && (data[2] + 7000) <= (sRead + batch.m_arena_used));
+
+            // A file that does not fit in the arena fails on its own
+            batch.m_arena_size = 4096;
+            batch.m_arena_used = 0;
+            s32 const loaded   = batch_load(paths, 3, batch);
+            CHECK_EQUAL(1, loaded);
+            CHECK_EQUAL((s8)EFileError::ERROR_OK, errors[0]);
+            CHECK_EQUAL((s8)EFileError::ERROR_IO, errors[2]);
+        }
+
+        UNITTEST_TEST(batch_open)
+        {
+            CHECK_TRUE(sWriteFile(sFsFileA, sData, 1000));
+            CHECK_TRUE(sWriteFile(sFsFileB, sData, 2000));
+
+            filepath_t paths[3];
+            paths[0] = nfs::filepath(sFsFileA);
+            paths[1] = nfs::filepath(sFsFileB);
+            paths[2] = nfs::filepath(sFsMissing);
+
+            s8       errors[3];
+            stream_t streams[3];
+            batch_t  batch;
+            batch.m_errors  = errors;
+            batch.m_streams = streams;
+            CHECK_EQUAL(2, batch_open(paths, 3, EFileMode::Value_Open, EFileAccess::Value_Read, EFileOp::Value_Sync, batch));
+            CHECK_TRUE(streams[0].isOpen());
+            CHECK_TRUE(streams[1].isOpen());
+            CHECK_FALSE(streams[2].isOpen());
+            CHECK_EQUAL(1000, streams[0].getLength());
+            CHECK_EQUAL(2000, streams[1].getLength());
+            CHECK_EQUAL((s8)EFileError::ERROR_NO_FILE, errors[2]);
+            nfs::close(streams[0]);
+            nfs::close(streams[1]);
+        }
+
+        UNITTEST_TEST(copy_in_chunks)
+        {
+            CHECK_TRUE(sWriteFile(sFsFileA, sData, 200000));
+
+            // Above the threshold the file is copied in 13 chunks, the last one partial
+            copystats_t   stats;
+            copyoptions_t options;
+            options.m_chunk_size         = 16 * 1024;
+            options.m_parallel_threshold = 64 * 1024;
+            options.m_clone              = false;
+            options.m_stats              = &stats;
+            CHECK_TRUE(nfs::copy(nfs::filepath(sFsFileA), nfs::filepath(sFsFileB), options));
+            CHECK_TRUE(sFileIs(sFsFileB, sData, 200000));
+            CHECK_EQUAL(1, stats.m_files);
+            CHECK_EQUAL(200000, stats.m_bytes_copied);
+            CHECK_EQUAL(0, stats.m_bytes_cloned);
+
+            // Overwrites the destination, one chunk
+            options.m_chunk_size = 256 * 1024;
+            CHECK_TRUE(sWriteFile(sFsFileA, sData + 1000, 150000));
+            CHECK_TRUE(nfs::copy(nfs::filepath(sFsFileA), nfs::filepath(sFsFileB), options));
+            CHECK_TRUE(sFileIs(sFsFileB, sData + 1000, 150000));
+
+            options.m_overwrite = false;
+            CHECK_FALSE(nfs::copy(nfs::filepath(sFsFileA), nfs::filepath(sFsFileB), options));
+            CHECK_FALSE(nfs::copy(nfs::filepath(sFsMissing), nfs::filepath(sFsFileB), options));
+        }
+
+        UNITTEST_TEST(copy_small_file)
+        {
+            CHECK_TRUE(sWriteFile(sFsFileA, sData, 1000));
+            nfs::rm(nfs::filepath(sFsFileB));
+
+            copystats_t   stats;
+            copyoptions_t options;
+            options.m_clone = false;
+            options.m_stats = &stats;
+            CHECK_TRUE(nfs::copy(nfs::filepath(sFsFileA), nfs::filepath(sFsFileB), options));
+            CHECK_TRUE(sFileIs(sFsFileB, sData, 1000));
+            CHECK_EQUAL(1, stats.m_files);
+            CHECK_EQUAL(1000, stats.m_bytes_copied);
+        }
+
+        UNITTEST_TEST(tree_copy_and_rm)
+        {
+            u8* big = (u8*)gTestAllocator->allocate(TREE_BIG_SIZE);
+            sFill(big, TREE_BIG_SIZE, 12);
+            CHECK_TRUE(sMakeTree(sData, big));
+
+            // The groups of the tree run as calls on the queue of the device, a file of
+            // a group must not be split into requests on that queue that it waits for.
+            parked_thread_t thread;
+            s32 const       worker = mImpl->register_ioworker(&thread);
+
+            copystats_t   stats;
+            copyoptions_t options;
+            options.m_chunk_size         = 1024 * 1024;
+            options.m_parallel_threshold = 1024 * 1024;
+            options.m_clone              = false;
+            options.m_stats              = &stats;
+            sMakeDir(sTreeDst);
+            CHECK_TRUE(nfs::copy(nfs::dirpath(sTreeSrc), nfs::dirpath(sTreeDst), options));
+            CHECK_TRUE(sTreeIs(sTreeDst, sData, big));
+            CHECK_EQUAL(TREE_FILES, stats.m_files);
+            CHECK_EQUAL(1000 + 70000 + TREE_BIG_SIZE, stats.m_bytes_copied);
+
+            char path[128];
+            nfs::rm(nfs::dirpath(sTreeDst));
+            for (s32 i = 0; i < TREE_FILES; ++i)
+            {
+                sTreePath(sTreeDst, i, path, sizeof(path));
+                CHECK_FALSE(nfs::exists(nfs::filepath(path)));
+            }
+            sTreePath(sTreeSrc, 2, path, sizeof(path));
+            CHECK_TRUE(nfs::exists(nfs::filepath(path)));
+
+            mImpl->unregister_ioworker(worker);
+            gTestAllocator->deallocate(big);
+        }
+
+        UNITTEST_TEST(snapshot)
+        {
+            u8* big = (u8*)gTestAllocator->allocate(TREE_BIG_SIZE);
+            sFill(big, TREE_BIG_SIZE, 13);
+            CHECK_TRUE(sMakeTree(sData, big));
+
+            // Cloned where the volume supports it, copied otherwise
+            copystats_t stats;
+            sMakeDir(sTreeDst);
+            CHECK_TRUE(nfs::snapshot(nfs::dirpath(sTreeSrc), nfs::dirpath(sTreeDst), stats));
+            CHECK_TRUE(sTreeIs(sTreeDst, sData, big));
+            CHECK_EQUAL(TREE_FILES, stats.m_files);
+            CHECK_EQUAL(1000 + 70000 + TREE_BIG_SIZE, stats.m_bytes_cloned + stats.m_bytes_copied);
+
+            // A clone is a file of its own, changing it leaves the source alone
+            char path[128];
+            sTreePath(sTreeDst, 0, path, sizeof(path));
+            CHECK_TRUE(sWriteFile(path, sData + 5000, 1000));
+            sTreePath(sTreeSrc, 0, path, sizeof(path));
+            CHECK_TRUE(sFileIs(path, sData, 1000));
+
+            nfs::rm(nfs::dirpath(sTreeDst));
+            gTestAllocator->deallocate(big);
+        }
+
+        UNITTEST_TEST(sparse_file)
+        {
+            enum
+            {
+                EXTENT = 64 * 1024,
+            };
+
+            stream_t stream;
+            nfs::open(nfs::filepath(sFsFileA), EFileMode::Value_Create, EFileAccess::Value_ReadWrite, EFileOp::Value_Sync, stream);
+            filehandle_t* fh = filesys_t::get_filehandle(stream);
+            filedevice_t* fd = fh->m_filedevice;
+            if (!fd->setSparseFile(fh->m_handle))
+            {
+                nfs::close(stream); // The volume has no sparse files
+                return;
+            }
+            CHECK_TRUE(fd->isSparseFile(fh->m_handle));
+
+            // Data, a hole of 2 extents and data again
+            stream.setLength(DATA_SIZE);
+            stream.setPos(0);
+            CHECK_EQUAL(EXTENT, stream.write(sData, EXTENT));
+            stream.setPos(DATA_SIZE - EXTENT);
+            CHECK_EQUAL(EXTENT, stream.write(sData + DATA_SIZE - EXTENT, EXTENT));
+
+            u64 data_pos = 0;
+            u64 data_end = 0;
+            CHECK_TRUE(fd->nextDataExtent(fh->m_handle, 0, data_pos, data_end));
+            CHECK_EQUAL(0, data_pos);
+            CHECK_TRUE(data_end >= EXTENT && data_end < (DATA_SIZE - EXTENT));
+            CHECK_TRUE(fd->nextDataExtent(fh->m_handle, data_end, data_pos, data_end));
+            CHECK_TRUE(data_pos > EXTENT && data_pos <= (DATA_SIZE - EXTENT));
+            CHECK_EQUAL(DATA_SIZE, data_end);
+            CHECK_FALSE(fd->nextDataExtent(fh->m_handle, DATA_SIZE, data_pos, data_end));
+
+            // A punched hole reads as zeros
+            CHECK_TRUE(fd->punchHole(fh->m_handle, 0, EXTENT));
+            nfs::close(stream);
+
+            for (u32 i = 0; i < DATA_SIZE; ++i)
+                sRead[i] = 0;
+            for (u32 i = DATA_SIZE - EXTENT; i < DATA_SIZE; ++i)
+                sRead[i] = sData[i];
+            CHECK_TRUE(sFileIs(sFsFileA, sRead, DATA_SIZE));
+
+            // The copy keeps the holes
+            copyoptions_t options;
+            options.m_chunk_size         = EXTENT;
+            options.m_parallel_threshold = EXTENT;
+            options.m_clone              = false;
+            CHECK_TRUE(nfs::copy(nfs::filepath(sFsFileA), nfs::filepath(sFsFileB), options));
+            CHECK_TRUE(sFileIs(sFsFileB, sRead, DATA_SIZE));
+
+            nfs::open(nfs::filepath(sFsFileB), EFileMode::Value_Open, EFileAccess::Value_Read, EFileOp::Value_Sync, stream);
+            fh = filesys_t::get_filehandle(stream);
+            CHECK_TRUE(fd->isSparseFile(fh->m_handle));
+            CHECK_TRUE(fd->nextDataExtent(fh->m_handle, 0, data_pos, data_end));
+            CHECK_TRUE(data_pos >= EXTENT);
+            nfs::close(stream);
+        }
+
+        UNITTEST_TEST(reserve)
+        {
+            enum
+            {
+                RESERVE = 1024 * 1024,
+            };
+
+            // Storage beyond the end, the length does not change
+            stream_t stream;
+            nfs::open(nfs::filepath(sFsFileA), EFileMode::Value_Create, EFileAccess::Value_ReadWrite, EFileOp::Value_Sync, stream);
+            if (stream.reserve(RESERVE))
+            {
+                CHECK_EQUAL(0, stream.getLength());
+                CHECK_EQUAL(1000, stream.write(sData, 1000));
+                CHECK_EQUAL(1000, stream.getLength());
+            }
+            nfs::close(stream);
+
+            // The file is extended and cut back at close to the end of what was written
+            CHECK_TRUE(sWriteFile(sFsFileB, sData, 3000));
+            nfs::open(nfs::filepath(sFsFileB), EFileMode::Value_Open, EFileAccess::Value_ReadWrite, EFileOp::Value_Sync, stream);
+            CHECK_TRUE(stream.reserve(RESERVE, false));
+            CHECK_EQUAL(RESERVE, stream.getLength());
+            CHECK_TRUE(stream.reserve(2000, false));
+            stream.setPos(3000);
+            CHECK_EQUAL(5000, stream.write(sData + 3000, 5000));
+            nfs::close(stream);
+            CHECK_EQUAL(8000, nfs::size(nfs::filepath(sFsFileB)));
+            CHECK_TRUE(sFileIs(sFsFileB, sData, 8000));
+
+            // Nothing written, the original length is restored
+            nfs::open(nfs::filepath(sFsFileB), EFileMode::Value_Open, EFileAccess::Value_ReadWrite, EFileOp::Value_Sync, stream);
+            CHECK_TRUE(stream.reserve(RESERVE, false));
+            nfs::close(stream);
+            CHECK_EQUAL(8000, nfs::size(nfs::filepath(sFsFileB)));
+
+            nfs::open(nfs::filepath(sFsFileB), EFileMode::Value_Open, EFileAccess::Value_Read, EFileOp::Value_Sync, stream);
+            CHECK_FALSE(stream.reserve(RESERVE));
+            nfs::close(stream);
+        }
+
+        UNITTEST_TEST(direct_device)
+        {
+            filedevice_t* direct = nfs::create_direct_device(true);
+            if (direct == nullptr)
+                return; // No direct IO on this platform
+
+            void* handle = nullptr;
+            CHECK_TRUE(direct->createFile(nfs::filepath(sFsFileA), true, true, handle));
+
+            // Unaligned position, size and memory all go through bounce buffers
+            u64 n = 0;
+            CHECK_TRUE(direct->writeFile(handle, 0, sData, 10000, n));
+            CHECK_EQUAL(10000, n);
+            CHECK_TRUE(direct->writeFile(handle, 1234, sData + 20001, 777, n));
+            CHECK_EQUAL(777, n);
+            u64 length = 0;
+            CHECK_TRUE(direct->getLengthOfFile(handle, length));
+            CHECK_EQUAL(10000, length);
+
+            for (u32 i = 0; i < 9000; ++i)
+                sRead[i + 1] = 0;
+            CHECK_TRUE(direct->readFile(handle, 100, sRead + 1, 9000, n));
+            CHECK_EQUAL(9000, n);
+            CHECK_TRUE(sSame(sRead + 1, sData + 100, 1134));
+            CHECK_TRUE(sSame(sRead + 1 + 1134, sData + 20001, 777));
+            CHECK_TRUE(sSame(sRead + 1 + 1911, sData + 2011, 9000 - 1911));
+
+            // Reading past the end returns what is there
+            CHECK_TRUE(direct->readFile(handle, 9000, sRead, 4096, n));
+            CHECK_EQUAL(1000, n);
+            CHECK_TRUE(direct->closeFile(handle));
+
+            for (u32 i = 0; i < 10000; ++i)
+                sRead[i] = sData[i];
+            for (u32 i = 0; i < 777; ++i)
+                sRead[1234 + i] = sData[20001 + i];
+            CHECK_TRUE(sFileIs(sFsFileA, sRead, 10000));
+
+            nfs::destroy_direct_device(direct);
+        }
+
+        UNITTEST_TEST(streaming)
+        {
+            enum
+            {
+                WINDOW = 16 * 1024,
+                CHUNK  = 10000,
+            };
+
+            // Write back behind the cursor, the data ends up in the file all the same
+            stream_t stream;
+            nfs::open(nfs::filepath(sFsFileA), EFileMode::Value_Create, EFileAccess::Value_ReadWrite, EFileOp::Value_Sync, stream);
+            CHECK_TRUE(stream.set_streaming(EStreaming::WRITE, WINDOW));
+            for (u32 pos = 0; pos < DATA_SIZE; pos += CHUNK)
+            {
+                u32 const size = (DATA_SIZE - pos) < CHUNK ? (DATA_SIZE - pos) : CHUNK;
+                CHECK_EQUAL(size, stream.write(sData + pos, size));
+            }
+            filehandle_t* fh = filesys_t::get_filehandle(stream);
+            CHECK_TRUE(fh->m_write_started > (DATA_SIZE - WINDOW - CHUNK));
+            CHECK_TRUE(fh->m_write_synced < fh->m_write_started);
+            nfs::close(stream);
+            CHECK_TRUE(sFileIs(sFsFileA, sData, DATA_SIZE));
+
+            // Drop behind the cursor, going back restarts the window
+            nfs::open(nfs::filepath(sFsFileA), EFileMode::Value_Open, EFileAccess::Value_Read, EFileOp::Value_Sync, stream);
+            CHECK_FALSE(stream.set_streaming(EStreaming::WRITE, WINDOW));
+            CHECK_TRUE(stream.set_streaming(EStreaming::READ, WINDOW));
+            CHECK_EQUAL(DATA_SIZE, stream.read(sRead, DATA_SIZE));
+            CHECK_TRUE(sSame(sRead, sData, DATA_SIZE));
+            fh = filesys_t::get_filehandle(stream);
+            CHECK_EQUAL(DATA_SIZE, fh->m_read_dropped);
+            stream.setPos(WINDOW);
+            CHECK_EQUAL(100, stream.read(sRead, 100));
+            CHECK_EQUAL(WINDOW, fh->m_read_dropped);
+            CHECK_TRUE(sSame(sRead, sData + WINDOW, 100));
+
+            // Plain hints only change what the page cache holds, not what is read
+            stream.advise(EFileAdvice::WILLNEED, 0, WINDOW);
+            stream.advise(EFileAdvice::RANDOM);
+            stream.setPos(0);
+            CHECK_EQUAL(WINDOW, stream.read(sRead, WINDOW));
+            CHECK_TRUE(sSame(sRead, sData, WINDOW));
+            nfs::close(stream);
+        }
+
+        UNITTEST_TEST(commit)
+        {
+            stream_t stream;
+            nfs::open(nfs::filepath(sFsFileA), EFileMode::Value_Create, EFileAccess::Value_ReadWrite, EFileOp::Value_Sync, stream);
+            CHECK_EQUAL(DATA_SIZE, stream.write(sData, DATA_SIZE));
+            CHECK_TRUE(nfs::commit(stream));
+            CHECK_TRUE(nfs::commit(stream)); // Nothing new to flush
+            nfs::close(stream);
+            CHECK_TRUE(sFileIs(sFsFileA, sData, DATA_SIZE));
+
+            // The new directory entry
+            CHECK_TRUE(nfs::commit(nfs::dirpath(sFsDir)));
+
+            // Two files, each commit stands on its own
+            const char* paths[2] = {sFsFileA, sFsFileB};
+            stream_t    streams[2];
+            for (s32 i = 0; i < 2; ++i)
+                nfs::open(nfs::filepath(paths[i]), EFileMode::Value_Create, EFileAccess::Value_ReadWrite, EFileOp::Value_Sync, streams[i]);
+            for (s32 i = 0; i < 2; ++i)
+            {
+                CHECK_EQUAL(1000, streams[i].write(sData + i * 1000, 1000));
+                CHECK_TRUE(nfs::commit(streams[i]));
+            }
+            for (s32 i = 0; i < 2; ++i)
+                nfs::close(streams[i]);
+            CHECK_TRUE(sFileIs(sFsFileA, sData, 1000));
+            CHECK_TRUE(sFileIs(sFsFileB, sData + 1000, 1000));
+
+            // A stream that did not open has nothing to commit
+            nfs::open(nfs::filepath(sFsMissing), EFileMode::Value_Open, EFileAccess::Value_Read, EFileOp::Value_Sync, stream);
+            CHECK_FALSE(stream.isOpen());
+            CHECK_FALSE(nfs::commit(stream));
+        }
+
+        UNITTEST_TEST(replace)
+        {
+            CHECK_TRUE(sWriteFile(sFsFileA, sData, 1000));
+
+            stream_t stream;
+            if (!nfs::replace_open(nfs::filepath(sFsFileA), stream))
+                return; // The device has no temporary files
+            CHECK_EQUAL(5000, stream.write(sData + 1000, 5000));
+            CHECK_TRUE(sFileIs(sFsFileA, sData, 1000)); // Not visible before the commit
+            CHECK_TRUE(nfs::replace_commit(stream, nfs::filepath(sFsFileA)));
+            CHECK_TRUE(sFileIs(sFsFileA, sData + 1000, 5000));
+
+            // Closed without a commit, the target is left alone
+            CHECK_TRUE(nfs::replace_open(nfs::filepath(sFsFileA), stream));
+            CHECK_EQUAL(100, stream.write(sData, 100));
+            nfs::close(stream);
+            CHECK_TRUE(sFileIs(sFsFileA, sData + 1000, 5000));
+
+            // A batch on the IO thread, a target that does not exist yet is created
+            parked_thread_t thread;
+            s32 const       worker = mImpl->register_ioworker(&thread);
+
+            filepath_t targets[3] = {nfs::filepath(sFsFileA), nfs::filepath(sFsFileB), nfs::filepath(sFsMissing)};
+            stream_t   streams[3];
+            for (s32 i = 0; i < 3; ++i)
+            {
+                CHECK_TRUE(nfs::replace_open(targets[i], streams[i]));
+                CHECK_EQUAL(2000, streams[i].write(sData + i * 2000, 2000));
+            }
+            CHECK_EQUAL(3, nfs::replace_commit(streams, targets, 3));
+            CHECK_TRUE(sFileIs(sFsFileA, sData, 2000));
+            CHECK_TRUE(sFileIs(sFsFileB, sData + 2000, 2000));
+            CHECK_TRUE(sFileIs(sFsMissing, sData + 4000, 2000));
+
+            mImpl->unregister_ioworker(worker);
+        }
+
+        UNITTEST_TEST(sync_file)
+        {
+            enum
+            {
+                SIZE  = 100000,
+                BLOCK = 4096,
+            };
+
+            nfs::rm(nfs::filepath(sFsFileB));
+            CHECK_TRUE(sWriteFile(sFsFileA, sData, SIZE));
+
+            // Not there yet, copied
+            syncstats_t   stats;
+            syncoptions_t options;
+            options.m_block_size = BLOCK;
+            options.m_stats      = &stats;
+            CHECK_TRUE(nfs::sync(nfs::filepath(sFsFileA), nfs::filepath(sFsFileB), options));
+            CHECK_TRUE(sFileIs(sFsFileB, sData, SIZE));
+            CHECK_EQUAL(1, stats.m_files);
+            CHECK_EQUAL(SIZE, stats.m_bytes_written);
+
+            // The destination got the times of the source
+            CHECK_TRUE(nfs::sync(nfs::filepath(sFsFileA), nfs::filepath(sFsFileB), options));
+            CHECK_EQUAL(2, stats.m_files);
+            CHECK_EQUAL(1, stats.m_files_skipped);
+            CHECK_EQUAL(SIZE, stats.m_bytes_written);
+
+            // Changed in place, only the block with the change is written
+            for (u32 i = 0; i < SIZE; ++i)
+                sRead[i] = sData[i];
+            for (u32 i = 50000; i < 51000; ++i)
+                sRead[i] = sData[200000 + i - 50000];
+            CHECK_TRUE(sWriteFile(sFsFileA, sRead, SIZE));
+
+            syncstats_t changed;
+            options.m_check = ESyncCheck::CONTENT;
+            options.m_stats = &changed;
+            CHECK_TRUE(nfs::sync(nfs::filepath(sFsFileA), nfs::filepath(sFsFileB), options));
+            CHECK_TRUE(sFileIs(sFsFileB, sRead, SIZE));
+            CHECK_EQUAL(BLOCK, changed.m_bytes_written);
+            CHECK_EQUAL(SIZE - BLOCK, changed.m_bytes_matched);
+
+            // The same content is not written again
+            CHECK_TRUE(nfs::sync(nfs::filepath(sFsFileA), nfs::filepath(sFsFileB), options));
+            CHECK_EQUAL(1, changed.m_files_skipped);
+            CHECK_EQUAL(BLOCK, changed.m_bytes_written);
+        }
+
+        UNITTEST_TEST(sync_file_replace)
+        {
+            enum
+            {
+                SIZE   = 100000,
+                BLOCK  = 4096,
+                INSERT = 10,
+            };
+
+            CHECK_TRUE(sWriteFile(sFsFileB, sData, SIZE));
+
+            // 10 bytes inserted at 20000 move the blocks after it
+            for (u32 i = 0; i < 20000; ++i)
+                sRead[i] = sData[i];
+            for (u32 i = 0; i < INSERT; ++i)
+                sRead[20000 + i] = sData[200000 + i];
+            for (u32 i = 20000; i < SIZE; ++i)
+                sRead[INSERT + i] = sData[i];
+            CHECK_TRUE(sWriteFile(sFsFileA, sRead, SIZE + INSERT));
+
+            stream_t probe;
+            bool const temp = nfs::replace_open(nfs::filepath(sFsMissing), probe);
+            if (temp)
+                nfs::close(probe);
+
+            syncstats_t   stats;
+            syncoptions_t options;
+            options.m_block_size = BLOCK;
+            options.m_check      = ESyncCheck::CONTENT;
+            options.m_write      = ESyncWrite::REPLACE;
+            options.m_stats      = &stats;
+            CHECK_TRUE(nfs::sync(nfs::filepath(sFsFileA), nfs::filepath(sFsFileB), options));
+            CHECK_TRUE(sFileIs(sFsFileB, sRead, SIZE + INSERT));
+            CHECK_EQUAL(SIZE + INSERT, stats.m_bytes_matched + stats.m_bytes_written);
+
+            // The block with the insert and the tail that is less than a block come from
+            // the source, the other 23 blocks are found in the destination
+            if (temp)
+            {
+                CHECK_EQUAL(23 * BLOCK, stats.m_bytes_matched);
+                CHECK_EQUAL(BLOCK + INSERT + (SIZE - 24 * BLOCK), stats.m_bytes_written);
+            }
+        }
+
+        UNITTEST_TEST(sync_tree)
+        {
+            u8* big = (u8*)gTestAllocator->allocate(TREE_BIG_SIZE);
+            sFill(big, TREE_BIG_SIZE, 14);
+            CHECK_TRUE(sMakeTree(sData, big));
+
+            // What the destination has and the source does not is removed
+            nfs::rm(nfs::dirpath(sTreeDst));
+            sMakeDir(sTreeDst);
+            sMakeDir(sTreeDstOld);
+            CHECK_TRUE(sWriteFile(sTreeExtra, sData, 100));
+            CHECK_TRUE(sWriteFile(sTreeOldExtra, sData, 100));
+
+            parked_thread_t thread;
+            s32 const       worker = mImpl->register_ioworker(&thread);
+
+            syncstats_t   stats;
+            syncoptions_t options;
+            options.m_delete = true;
+            options.m_stats  = &stats;
+            CHECK_TRUE(nfs::sync(nfs::dirpath(sTreeSrc), nfs::dirpath(sTreeDst), options));
+            CHECK_TRUE(sTreeIs(sTreeDst, sData, big));
+            CHECK_EQUAL(TREE_FILES, stats.m_files);
+            CHECK_EQUAL(1000 + 70000 + TREE_BIG_SIZE, stats.m_bytes_written);
+            CHECK_FALSE(nfs::exists(nfs::filepath(sTreeExtra)));
+            CHECK_FALSE(nfs::exists(nfs::dirpath(sTreeDstOld)));
+
+            // A change in the large file, the other files are the same
+            for (u32 i = 0; i < 100; ++i)
+                big[3 * 1024 * 1024 + i] = (u8)~big[3 * 1024 * 1024 + i];
+            char path[128];
+            sTreePath(sTreeSrc, 2, path, sizeof(path));
+            CHECK_TRUE(sWriteFile(path, big, TREE_BIG_SIZE));
+
+            syncstats_t changed;
+            options.m_block_size = 4096;
+            options.m_check      = ESyncCheck::CONTENT;
+            options.m_stats      = &changed;
+            CHECK_TRUE(nfs::sync(nfs::dirpath(sTreeSrc), nfs::dirpath(sTreeDst), options));
+            CHECK_TRUE(sTreeIs(sTreeDst, sData, big));
+            CHECK_EQUAL(TREE_FILES, changed.m_files);
+            CHECK_EQUAL(TREE_FILES - 1, changed.m_files_skipped);
+            CHECK_EQUAL(4096, changed.m_bytes_written);
+
+            mImpl->unregister_ioworker(worker);
+            nfs::rm(nfs::dirpath(sTreeDst));
+            gTestAllocator->deallocate(big);
+        }
+
+        UNITTEST_TEST(hash_file)
+        {
+            CHECK_TRUE(sWriteFile(sFsFileA, sData, 100000));
+            hash128_t h;
+            CHECK_TRUE(nfs::hash(nfs::filepath(sFsFileA), h));
+            CHECK_TRUE(h == hash128(sData, 100000));
+
+            // Larger than a chunk, the hashes of the chunks are combined
+            u8* big = (u8*)gTestAllocator->allocate(TREE_BIG_SIZE);
+            sFill(big, TREE_BIG_SIZE, 15);
+            CHECK_TRUE(sWriteFile(sFsFileB, big, TREE_BIG_SIZE));
+            hash128_t chunks[2];
+            chunks[0]                = hash128(big, HASH_CHUNK_SIZE);
+            chunks[1]                = hash128(big + HASH_CHUNK_SIZE, TREE_BIG_SIZE - HASH_CHUNK_SIZE);
+            hash128_t const expected = hash128_combine(chunks, 2, TREE_BIG_SIZE);
+            CHECK_TRUE(nfs::hash(nfs::filepath(sFsFileB), h));
+            CHECK_TRUE(h == expected);
+
+            // The same with a chunk handed to an IO thread
+            parked_thread_t thread;
+            s32 const       worker = mImpl->register_ioworker(&thread);
+            CHECK_TRUE(nfs::hash(nfs::filepath(sFsFileB), h));
+            CHECK_TRUE(h == expected);
+            mImpl->unregister_ioworker(worker);
+
+            CHECK_FALSE(nfs::hash(nfs::filepath(sFsMissing), h));
+            gTestAllocator->deallocate(big);
+        }
+
+        UNITTEST_TEST(hash_tree)
+        {
+            u8* big = (u8*)gTestAllocator->allocate(TREE_BIG_SIZE);
+            sFill(big, TREE_BIG_SIZE, 16);
+            CHECK_TRUE(sMakeTree(sData, big));
+
+            parked_thread_t thread;
+            s32 const       worker = mImpl->register_ioworker(&thread);
+
+            hash128_t src;
+            CHECK_TRUE(nfs::hash(nfs::dirpath(sTreeSrc), src));
+
+            // A copy has the same hash, wherever it is
+            copyoptions_t options;
+            options.m_clone = false;
+            nfs::rm(nfs::dirpath(sTreeDst));
+            sMakeDir(sTreeDst);
+            CHECK_TRUE(nfs::copy(nfs::dirpath(sTreeSrc), nfs::dirpath(sTreeDst), options));
+            hash128_t dst;
+            CHECK_TRUE(nfs::hash(nfs::dirpath(sTreeDst), dst));
+            CHECK_TRUE(dst == src);
+
+            // Changed content and a new directory both change the hash
+            char path[128];
+            sTreePath(sTreeDst, 0, path, sizeof(path));
+            CHECK_TRUE(sWriteFile(path, sData + 1, 1000));
+            CHECK_TRUE(nfs::hash(nfs::dirpath(sTreeDst), dst));
+            CHECK_TRUE(dst != src);
+            CHECK_TRUE(sWriteFile(path, sData, 1000));
+            CHECK_TRUE(nfs::hash(nfs::dirpath(sTreeDst), dst));
+            CHECK_TRUE(dst == src);
+
+            sMakeDir(sTreeDstOld);
+            CHECK_TRUE(nfs::hash(nfs::dirpath(sTreeDst), dst));
+            CHECK_TRUE(dst != src);
+
+            mImpl->unregister_ioworker(worker);
+            nfs::rm(nfs::dirpath(sTreeDst));
+            gTestAllocator->deallocate(big);
+        }
+    }
+}
+UNITTEST_SUITE_END
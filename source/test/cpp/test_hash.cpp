@@ -0,0 +1,83 @@
+#include "ccore/c_target.h"
+#include "cbase/c_allocator.h"
+
+#include "cunittest/cunittest.h"
+
+#include "cfilesystem/c_hash.h"
+
+#include "test_helpers.h"
+
+using namespace ncore;
+using namespace ncore::nfs;
+
+extern alloc_t* gTestAllocator;
+
+UNITTEST_SUITE_BEGIN(hash)
+{
+    UNITTEST_FIXTURE(main)
+    {
+        enum
+        {
+            DATA_SIZE = 1024 * 1024 + 13,
+        };
+
+        static u8* sData = nullptr;
+
+        UNITTEST_FIXTURE_SETUP()
+        {
+            sData = (u8*)gTestAllocator->allocate(DATA_SIZE);
+            sFill(sData, DATA_SIZE, 1);
+        }
+        UNITTEST_FIXTURE_TEARDOWN() { gTestAllocator->deallocate(sData); }
+
+        UNITTEST_TEST(kernels_give_the_same_hash)
+        {
+            // Whole blocks go through the vector kernel of the target, these are the
+            // hashes of the scalar kernel.
+            hash128_t h = hash128(sData, DATA_SIZE);
+            CHECK_EQUAL((u64)0x2139acc7ee973f55ull, h.m_hi);
+            CHECK_EQUAL((u64)0x9d9e8a3a777fcd48ull, h.m_lo);
+
+            h = hash128(sData, 1024);
+            CHECK_EQUAL((u64)0x6c8e87a64c6e1d64ull, h.m_hi);
+            CHECK_EQUAL((u64)0x08979451663a94cfull, h.m_lo);
+
+            h = hash128(sData, 1024 + 64 * 3);
+            CHECK_EQUAL((u64)0x6561c651f6c11850ull, h.m_hi);
+            CHECK_EQUAL((u64)0xba71ba3fbd4385c7ull, h.m_lo);
+
+            h = hash128(sData, 64 * 17 + 5);
+            CHECK_EQUAL((u64)0x0e241eb8200281a6ull, h.m_hi);
+            CHECK_EQUAL((u64)0x2e4322e104b50f51ull, h.m_lo);
+        }
+
+        UNITTEST_TEST(unaligned_data)
+        {
+            hash128_t const a = hash128(sData + 1, 4096);
+            for (u32 i = 0; i < 4096; ++i)
+                sData[i] = sData[i + 1];
+            hash128_t const b = hash128(sData, 4096);
+            CHECK_TRUE(a == b);
+            sFill(sData, DATA_SIZE, 1);
+        }
+
+        UNITTEST_TEST(combine_sees_order_and_size)
+        {
+            hash128_t chunks[3];
+            chunks[0] = hash128(sData, 1000);
+            chunks[1] = hash128(sData + 1000, 1000);
+            chunks[2] = hash128(sData + 2000, 1000);
+
+            hash128_t const a = hash128_combine(chunks, 3, 3000);
+            CHECK_TRUE(a == hash128_combine(chunks, 3, 3000));
+            CHECK_TRUE(a != hash128_combine(chunks, 3, 3001));
+            CHECK_TRUE(a != hash128_combine(chunks, 2, 3000));
+
+            hash128_t const first = chunks[0];
+            chunks[0]             = chunks[1];
+            chunks[1]             = first;
+            CHECK_TRUE(a != hash128_combine(chunks, 3, 3000));
+        }
+    }
+}
+UNITTEST_SUITE_END
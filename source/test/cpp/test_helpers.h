@@ -0,0 +1,89 @@
+#ifndef __CFILESYSTEM_TEST_HELPERS_H__
+#define __CFILESYSTEM_TEST_HELPERS_H__
+#include "ccore/c_target.h"
+#ifdef USE_PRAGMA_ONCE
+#    pragma once
+#endif
+
+#include "cbase/c_allocator.h"
+
+#include "cfilesystem/c_dirpath.h"
+#include "cfilesystem/c_filepath.h"
+#include "cfilesystem/c_filesystem.h"
+#include "cfilesystem/c_stream.h"
+#include "cfilesystem/c_threading.h"
+
+#include "cfilesystem/private/c_filedevice.h"
+#include "cfilesystem/private/c_filesystem.h"
+
+extern ncore::alloc_t* gTestAllocator;
+
+// Helpers shared by the tests
+namespace ncore
+{
+    namespace nfs
+    {
+        extern filesys_t* mImpl;
+    }
+
+    // Registers as an IO thread without running doIO, the requests stay queued
+    // until the test executes them with wait(), process_iorequest() or doIO().
+    class parked_thread_t : public nfs::io_thread_t
+    {
+    public:
+        virtual void sleep(u32 ms) {}
+        virtual bool quit() const { return true; }
+        virtual void wait() {}
+        virtual void signal() {}
+    };
+
+    // Pseudo random bytes, the same seed gives the same bytes
+    inline void sFill(u8* data, u32 size, u64 seed)
+    {
+        u64 state = seed;
+        for (u32 i = 0; i < size; ++i)
+        {
+            state   = state * 6364136223846793005ull + 1442695040888963407ull;
+            data[i] = (u8)(state >> 56);
+        }
+    }
+
+    inline bool sSame(u8 const* a, u8 const* b, u64 size)
+    {
+        for (u64 i = 0; i < size; ++i)
+        {
+            if (a[i] != b[i])
+                return false;
+        }
+        return true;
+    }
+
+    inline void sMakeDir(const char* path)
+    {
+        dirpath_t dp = nfs::dirpath(path);
+        if (!nfs::exists(dp))
+            dp.m_device->m_fileDevice->createDir(dp);
+    }
+
+    inline bool sWriteFile(const char* path, u8 const* data, u32 size)
+    {
+        nfs::stream_t stream;
+        nfs::open(nfs::filepath(path), nfs::EFileMode::Value_Create, nfs::EFileAccess::Value_ReadWrite, nfs::EFileOp::Value_Sync, stream);
+        if (!stream.isOpen())
+            return false;
+        s64 const written = stream.write(data, size);
+        nfs::close(stream);
+        return written == (s64)size;
+    }
+
+    // True when the file holds exactly size bytes of data
+    inline bool sFileIs(const char* path, u8 const* data, u64 size)
+    {
+        nfs::filedata_t file = nfs::load(nfs::filepath(path), gTestAllocator);
+        bool const      same = file.isValid() && file.m_size == size && sSame(file.m_data, data, size);
+        nfs::unload(file);
+        return same;
+    }
+} // namespace ncore
+
+#endif // __CFILESYSTEM_TEST_HELPERS_H__
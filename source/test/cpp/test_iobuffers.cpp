@@ -0,0 +1,54 @@
+#include "ccore/c_target.h"
+#include "cbase/c_allocator.h"
+
+#include "cunittest/cunittest.h"
+
+#include "cfilesystem/private/c_iobuffers.h"
+
+using namespace ncore;
+using namespace ncore::nfs;
+
+extern alloc_t* gTestAllocator;
+
+UNITTEST_SUITE_BEGIN(iobuffers)
+{
+    UNITTEST_FIXTURE(main)
+    {
+        static iobufferpool_t sPool;
+
+        UNITTEST_FIXTURE_SETUP() { sPool.init(gTestAllocator, 5000, 4096, 2); }
+        UNITTEST_FIXTURE_TEARDOWN() { sPool.exit(); }
+
+        UNITTEST_TEST(size_is_rounded_to_alignment)
+        {
+            CHECK_EQUAL((u32)8192, sPool.buffer_size());
+            CHECK_EQUAL((u32)4096, sPool.alignment());
+        }
+
+        UNITTEST_TEST(obtain_is_aligned_and_limited)
+        {
+            u8* a = sPool.obtain_nowait();
+            u8* b = sPool.obtain_nowait();
+            CHECK_TRUE(a != nullptr);
+            CHECK_TRUE(b != nullptr);
+            CHECK_TRUE(a != b);
+            CHECK_EQUAL((u64)0, ((u64)a) & 4095);
+            CHECK_EQUAL((u64)0, ((u64)b) & 4095);
+            CHECK_TRUE(sPool.obtain_nowait() == nullptr);
+
+            sPool.release(a);
+            sPool.release(b);
+        }
+
+        UNITTEST_TEST(released_buffers_are_reused)
+        {
+            u8* a = sPool.obtain();
+            sPool.release(a);
+            u8* b = sPool.obtain();
+            CHECK_EQUAL(a, b);
+            sPool.release(b);
+            CHECK_TRUE(sPool.allocated() <= 2);
+        }
+    }
+}
+UNITTEST_SUITE_END
@@ -0,0 +1,52 @@
+#include "ccore/c_target.h"
+#include "cbase/c_allocator.h"
+
+#include "cunittest/cunittest.h"
+
+#include "cfilesystem/private/c_iorequest.h"
+#include "cfilesystem/private/c_ioqueue.h"
+
+using namespace ncore;
+using namespace ncore::nfs;
+
+extern alloc_t* gTestAllocator;
+
+UNITTEST_SUITE_BEGIN(ioqueue)
+{
+    UNITTEST_FIXTURE(main)
+    {
+        static iomqueue_t  sQueue;
+        static iorequest_t sRequests[8];
+
+        UNITTEST_FIXTURE_SETUP() { sQueue.init(gTestAllocator, 4); }
+        UNITTEST_FIXTURE_TEARDOWN() { sQueue.exit(gTestAllocator); }
+
+        UNITTEST_TEST(push_pop_fifo)
+        {
+            CHECK_TRUE(sQueue.empty());
+            CHECK_TRUE(sQueue.push(&sRequests[0]));
+            CHECK_TRUE(sQueue.push(&sRequests[1]));
+            CHECK_FALSE(sQueue.empty());
+
+            CHECK_EQUAL(&sRequests[0], sQueue.pop());
+            CHECK_EQUAL(&sRequests[1], sQueue.pop());
+            CHECK_EQUAL((iorequest_t*)nullptr, sQueue.pop());
+            CHECK_TRUE(sQueue.empty());
+        }
+
+        UNITTEST_TEST(full_and_wrap_around)
+        {
+            for (s32 round = 0; round < 3; ++round)
+            {
+                for (s32 i = 0; i < 4; ++i)
+                    CHECK_TRUE(sQueue.push(&sRequests[i]));
+                CHECK_FALSE(sQueue.push(&sRequests[4]));
+
+                for (s32 i = 0; i < 4; ++i)
+                    CHECK_EQUAL(&sRequests[i], sQueue.pop());
+                CHECK_TRUE(sQueue.empty());
+            }
+        }
+    }
+}
+UNITTEST_SUITE_END
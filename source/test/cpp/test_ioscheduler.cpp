@@ -0,0 +1,216 @@
+#include "ccore/c_target.h"
+#include "cbase/c_allocator.h"
+
+#include "cunittest/cunittest.h"
+
+#include "cfilesystem/private/c_filesystem.h"
+#include "cfilesystem/private/c_iorequest.h"
+#include "cfilesystem/private/c_ioscheduler.h"
+
+using namespace ncore;
+using namespace ncore::nfs;
+
+extern alloc_t* gTestAllocator;
+
+namespace ncore
+{
+    static void sSetupRequest(iorequest_t& req, filehandle_t* fh, s32 op, s32 priority, u64 offset, u64 size)
+    {
+        req.m_state      = EIoState::QUEUED;
+        req.m_op         = op;
+        req.m_priority   = priority;
+        req.m_deadline   = 0;
+        req.m_timeout    = 0;
+        req.m_filehandle = fh;
+        req.m_offset     = offset;
+        req.m_buffer     = nullptr;
+        req.m_size       = size;
+        req.m_span_count = 0;
+        req.m_next       = nullptr;
+    }
+
+    // Pops the next request and retires it right away, as if it was executed
+    static iorequest_t* sPop(ioscheduler_t& scheduler, u64 now, u32 merge_max)
+    {
+        iorequest_t* req = scheduler.pop(now, merge_max);
+        if (req != nullptr)
+            scheduler.retire(req->m_active);
+        return req;
+    }
+} // namespace ncore
+
+UNITTEST_SUITE_BEGIN(ioscheduler)
+{
+    UNITTEST_FIXTURE(main)
+    {
+        static ioscheduler_t sScheduler;
+        static filehandle_t  sFiles[2];
+        static iorequest_t   sRequests[8];
+
+        UNITTEST_FIXTURE_SETUP() { sScheduler.init(gTestAllocator, 4096); }
+        UNITTEST_FIXTURE_TEARDOWN() { sScheduler.exit(gTestAllocator); }
+
+        UNITTEST_TEST(priority_order)
+        {
+            sSetupRequest(sRequests[0], &sFiles[0], EIoOp::READ, EIoPriority::LOW, 0, 16);
+            sSetupRequest(sRequests[1], &sFiles[0], EIoOp::READ, EIoPriority::HIGH, 8192, 16);
+            sScheduler.push(&sRequests[0], 0);
+            sScheduler.push(&sRequests[1], 0);
+
+            CHECK_EQUAL(&sRequests[1], sPop(sScheduler, 0, 0));
+            CHECK_EQUAL(&sRequests[0], sPop(sScheduler, 0, 0));
+            CHECK_TRUE(sScheduler.empty());
+        }
+
+        UNITTEST_TEST(elevator_order)
+        {
+            sSetupRequest(sRequests[0], &sFiles[0], EIoOp::READ, EIoPriority::NORMAL, 3000, 16);
+            sSetupRequest(sRequests[1], &sFiles[0], EIoOp::READ, EIoPriority::NORMAL, 1000, 16);
+            sSetupRequest(sRequests[2], &sFiles[0], EIoOp::READ, EIoPriority::NORMAL, 2000, 16);
+            sScheduler.push(&sRequests[0], 0);
+            sScheduler.push(&sRequests[1], 0);
+            sScheduler.push(&sRequests[2], 0);
+
+            CHECK_EQUAL(&sRequests[1], sPop(sScheduler, 0, 0));
+            CHECK_EQUAL(&sRequests[2], sPop(sScheduler, 0, 0));
+            CHECK_EQUAL(&sRequests[0], sPop(sScheduler, 0, 0));
+        }
+
+        UNITTEST_TEST(merge_adjacent_reads)
+        {
+            sSetupRequest(sRequests[0], &sFiles[1], EIoOp::READ, EIoPriority::NORMAL, 0, 100);
+            sSetupRequest(sRequests[1], &sFiles[1], EIoOp::READ, EIoPriority::NORMAL, 100, 100);
+            sSetupRequest(sRequests[2], &sFiles[1], EIoOp::READ, EIoPriority::NORMAL, 150, 100);
+            sSetupRequest(sRequests[3], &sFiles[1], EIoOp::READ, EIoPriority::NORMAL, 1000, 100);
+            sScheduler.push(&sRequests[2], 0);
+            sScheduler.push(&sRequests[0], 0);
+            sScheduler.push(&sRequests[3], 0);
+            sScheduler.push(&sRequests[1], 0);
+
+            iorequest_t* chain = sPop(sScheduler, 0, 4096);
+            CHECK_EQUAL(&sRequests[0], chain);
+            CHECK_EQUAL(&sRequests[1], chain->m_next);
+            CHECK_EQUAL(&sRequests[2], chain->m_next->m_next);
+            CHECK_EQUAL((iorequest_t*)nullptr, chain->m_next->m_next->m_next);
+
+            CHECK_EQUAL(&sRequests[3], sPop(sScheduler, 0, 4096));
+            CHECK_TRUE(sScheduler.empty());
+        }
+
+        UNITTEST_TEST(write_is_a_barrier)
+        {
+            sSetupRequest(sRequests[0], &sFiles[0], EIoOp::WRITE, EIoPriority::NORMAL, 100, 100);
+            sSetupRequest(sRequests[1], &sFiles[0], EIoOp::WRITE, EIoPriority::NORMAL, 50, 100);
+            sScheduler.push(&sRequests[0], 0);
+            sScheduler.push(&sRequests[1], 0);
+
+            CHECK_EQUAL(&sRequests[0], sPop(sScheduler, 0, 0));
+            CHECK_EQUAL(&sRequests[1], sPop(sScheduler, 0, 0));
+        }
+
+        UNITTEST_TEST(running_write_is_a_barrier)
+        {
+            sSetupRequest(sRequests[0], &sFiles[0], EIoOp::WRITE, EIoPriority::NORMAL, 8192, 100);
+            sSetupRequest(sRequests[1], &sFiles[0], EIoOp::READ, EIoPriority::NORMAL, 8242, 100);
+            sSetupRequest(sRequests[2], &sFiles[0], EIoOp::READ, EIoPriority::NORMAL, 12288, 100);
+            sScheduler.push(&sRequests[0], 0);
+            sScheduler.push(&sRequests[1], 0);
+            sScheduler.push(&sRequests[2], 0);
+
+            // While the write is running the overlapping read has to wait, the other
+            // read can go ahead.
+            iorequest_t* running = sScheduler.pop(0, 0);
+            CHECK_EQUAL(&sRequests[0], running);
+            CHECK_EQUAL(&sRequests[2], sPop(sScheduler, 0, 0));
+            CHECK_EQUAL((iorequest_t*)nullptr, sScheduler.pop(0, 0));
+            CHECK_EQUAL(1, sScheduler.count());
+
+            sScheduler.retire(running->m_active);
+            CHECK_EQUAL(&sRequests[1], sPop(sScheduler, 0, 0));
+            CHECK_TRUE(sScheduler.empty());
+        }
+
+        UNITTEST_TEST(barrier_across_classes)
+        {
+            sSetupRequest(sRequests[0], &sFiles[1], EIoOp::WRITE, EIoPriority::LOW, 0, 100);
+            sSetupRequest(sRequests[1], &sFiles[1], EIoOp::WRITE, EIoPriority::HIGH, 0, 100);
+            sSetupRequest(sRequests[2], &sFiles[1], EIoOp::READ, EIoPriority::HIGH, 200, 100);
+            sScheduler.push(&sRequests[0], 0);
+            sScheduler.push(&sRequests[1], 0);
+            sScheduler.push(&sRequests[2], 0);
+
+            // The high priority write was submitted after the low priority write to
+            // the same range, it can not overtake it.
+            CHECK_EQUAL(&sRequests[2], sPop(sScheduler, 0, 0));
+            CHECK_EQUAL(&sRequests[0], sPop(sScheduler, 0, 0));
+            CHECK_EQUAL(&sRequests[1], sPop(sScheduler, 0, 0));
+            CHECK_TRUE(sScheduler.empty());
+        }
+
+        UNITTEST_TEST(deadline_promotion)
+        {
+            sSetupRequest(sRequests[0], &sFiles[0], EIoOp::READ, EIoPriority::LOW, 0, 16);
+            sScheduler.push(&sRequests[0], 0);
+            sSetupRequest(sRequests[1], &sFiles[0], EIoOp::READ, EIoPriority::HIGH, 64, 16);
+            sScheduler.push(&sRequests[1], 1000 * 1000);
+
+            // The low priority request has passed its deadline
+            CHECK_EQUAL(&sRequests[0], sPop(sScheduler, 1000 * 1000, 0));
+            CHECK_EQUAL(&sRequests[1], sPop(sScheduler, 1000 * 1000, 0));
+        }
+
+        UNITTEST_TEST(expire_cancelled_and_timed_out)
+        {
+            sSetupRequest(sRequests[0], &sFiles[0], EIoOp::READ, EIoPriority::NORMAL, 0, 16);
+            sSetupRequest(sRequests[1], &sFiles[0], EIoOp::READ, EIoPriority::NORMAL, 64, 16);
+            sSetupRequest(sRequests[2], &sFiles[0], EIoOp::READ, EIoPriority::NORMAL, 128, 16);
+            sRequests[1].m_timeout = 500;
+            sScheduler.push(&sRequests[0], 0);
+            sScheduler.push(&sRequests[1], 0);
+            sScheduler.push(&sRequests[2], 0);
+            sRequests[2].m_state = EIoState::CANCELLED;
+
+            CHECK_FALSE(sScheduler.has_expired(100));
+            CHECK_TRUE(sScheduler.has_expired(500));
+
+            iorequest_t* expired = sScheduler.expire(500);
+            CHECK_EQUAL(&sRequests[1], expired);
+            CHECK_EQUAL((s32)EIoState::TIMEDOUT, (s32)sRequests[1].m_state);
+            CHECK_EQUAL(&sRequests[2], expired->m_next);
+            CHECK_EQUAL((iorequest_t*)nullptr, expired->m_next->m_next);
+
+            CHECK_EQUAL(1, sScheduler.count());
+            CHECK_EQUAL(&sRequests[0], sPop(sScheduler, 500, 0));
+            CHECK_TRUE(sScheduler.empty());
+        }
+
+        UNITTEST_TEST(conflicts_are_tracked_per_file)
+        {
+            sSetupRequest(sRequests[0], &sFiles[0], EIoOp::WRITE, EIoPriority::NORMAL, 0, 100);
+            sSetupRequest(sRequests[1], &sFiles[1], EIoOp::WRITE, EIoPriority::NORMAL, 0, 100);
+            sSetupRequest(sRequests[2], &sFiles[0], EIoOp::READ, EIoPriority::NORMAL, 50, 100);
+            sSetupRequest(sRequests[3], &sFiles[1], EIoOp::READ, EIoPriority::NORMAL, 50, 100);
+            for (s32 i = 0; i < 4; ++i)
+                sScheduler.push(&sRequests[i], 0);
+            CHECK_EQUAL(&sRequests[0], sFiles[0].m_queued_head);
+            CHECK_EQUAL(&sRequests[2], sFiles[0].m_queued_tail);
+
+            // The write on one file holds up the read of that file only
+            iorequest_t* running = sScheduler.pop(0, 0);
+            CHECK_EQUAL(&sRequests[0], running);
+            CHECK_EQUAL(1, sFiles[0].m_running);
+            CHECK_EQUAL(&sRequests[2], sFiles[0].m_queued_head);
+            CHECK_EQUAL(&sRequests[1], sPop(sScheduler, 0, 0));
+            CHECK_EQUAL(&sRequests[3], sPop(sScheduler, 0, 0));
+            CHECK_EQUAL((iorequest_t*)nullptr, sScheduler.pop(0, 0));
+
+            sScheduler.retire(running->m_active);
+            CHECK_EQUAL(0, sFiles[0].m_running);
+            CHECK_EQUAL(&sRequests[2], sPop(sScheduler, 0, 0));
+            CHECK_TRUE(sScheduler.empty());
+            CHECK_EQUAL((iorequest_t*)nullptr, sFiles[0].m_queued_head);
+            CHECK_EQUAL((iorequest_t*)nullptr, sFiles[1].m_queued_tail);
+        }
+    }
+}
+UNITTEST_SUITE_END
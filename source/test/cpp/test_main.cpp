@@ -17,6 +17,22 @@ UNITTEST_SUITE_DECLARE(cUnitTest, filedevice_register);
 UNITTEST_SUITE_DECLARE(cUnitTest, dirpath);
 UNITTEST_SUITE_DECLARE(cUnitTest, filepath);
 UNITTEST_SUITE_DECLARE(cUnitTest, filestream);
+UNITTEST_SUITE_DECLARE(cUnitTest, ioscheduler);
+UNITTEST_SUITE_DECLARE(cUnitTest, ioqueue);
+UNITTEST_SUITE_DECLARE(cUnitTest, iobuffers);
+UNITTEST_SUITE_DECLARE(cUnitTest, crc32);
+UNITTEST_SUITE_DECLARE(cUnitTest, tinylfu);
+UNITTEST_SUITE_DECLARE(cUnitTest, chunker);
+UNITTEST_SUITE_DECLARE(cUnitTest, delta);
+UNITTEST_SUITE_DECLARE(cUnitTest, hash);
+UNITTEST_SUITE_DECLARE(cUnitTest, async);
+UNITTEST_SUITE_DECLARE(cUnitTest, filesystem);
+UNITTEST_SUITE_DECLARE(cUnitTest, appendlog);
+UNITTEST_SUITE_DECLARE(cUnitTest, recordlog);
+UNITTEST_SUITE_DECLARE(cUnitTest, mmapstream);
+UNITTEST_SUITE_DECLARE(cUnitTest, shmcache);
+UNITTEST_SUITE_DECLARE(cUnitTest, tiered);
+UNITTEST_SUITE_DECLARE(cUnitTest, cas);
 //UNITTEST_SUITE_DECLARE(cUnitTest, filesystem_common);
 
 namespace ncore
@@ -0,0 +1,206 @@
+#include "ccore/c_target.h"
+#include "cbase/c_allocator.h"
+
+#include "cunittest/cunittest.h"
+
+#include "cfilesystem/c_dirpath.h"
+#include "cfilesystem/c_filepath.h"
+#include "cfilesystem/c_filesystem.h"
+#include "cfilesystem/c_mmapstream.h"
+#include "cfilesystem/c_stream.h"
+#include "cfilesystem/c_threading.h"
+
+#include "cfilesystem/private/c_filedevice.h"
+#include "cfilesystem/private/c_filesystem.h"
+#include "cfilesystem/private/c_ioscheduler.h"
+
+#include "test_helpers.h"
+
+using namespace ncore;
+using namespace ncore::nfs;
+
+extern alloc_t* gTestAllocator;
+
+namespace ncore
+{
+    static const char* sMapDir  = "curdir:\\cfilesystem_test\\";
+    static const char* sMapFile = "curdir:\\cfilesystem_test\\mmapstream.bin";
+} // namespace ncore
+
+UNITTEST_SUITE_BEGIN(mmapstream)
+{
+    UNITTEST_FIXTURE(main)
+    {
+        enum
+        {
+            DATA_SIZE = 128 * 1024,
+            EXTENT    = 64 * 1024,
+        };
+
+        static u8* sData = nullptr;
+        static u8* sFile = nullptr;
+
+        UNITTEST_FIXTURE_SETUP()
+        {
+            nfs::context_t ctxt;
+            ctxt.m_allocator = gTestAllocator;
+            nfs::create(ctxt);
+
+            sData = (u8*)gTestAllocator->allocate(DATA_SIZE);
+            sFile = (u8*)gTestAllocator->allocate(DATA_SIZE);
+            sFill(sData, DATA_SIZE, 45);
+            sMakeDir(sMapDir);
+        }
+
+        UNITTEST_FIXTURE_TEARDOWN()
+        {
+            nfs::rm(nfs::filepath(sMapFile));
+            gTestAllocator->deallocate(sFile);
+            gTestAllocator->deallocate(sData);
+            nfs::destroy();
+        }
+
+        UNITTEST_TEST(write_grows_by_extents)
+        {
+            nfs::rm(nfs::filepath(sMapFile));
+
+            mmapoptions_t options;
+            options.m_extent            = EXTENT;
+            options.m_flush_interval_us = 0;
+
+            mmapstream_t stream;
+            if (!stream.open(nfs::filepath(sMapFile), options))
+                return; // The device cannot map files
+            CHECK_EQUAL(0, stream.vgetLength());
+
+            CHECK_EQUAL(1000, stream.vwrite(sData, 1000));
+            CHECK_EQUAL(1000, stream.vgetLength());
+            CHECK_EQUAL(EXTENT, nfs::size(nfs::filepath(sMapFile)));
+
+            // Beyond the end, the gap reads as zeros
+            stream.vsetPos(100000);
+            CHECK_EQUAL(5000, stream.vwrite(sData + 100000, 5000));
+            CHECK_EQUAL(105000, stream.vgetLength());
+            CHECK_EQUAL(2 * EXTENT, nfs::size(nfs::filepath(sMapFile)));
+            CHECK_TRUE(stream.sync());
+
+            u8 const* view = nullptr;
+            stream.vsetPos(500);
+            CHECK_EQUAL(1000, stream.vview(view, 1000));
+            CHECK_TRUE(sSame(view, sData + 500, 500));
+            CHECK_EQUAL(0, view[500]);
+            stream.vclose();
+            CHECK_FALSE(stream.isOpen());
+
+            // Cut back to the end of what was written
+            for (u32 i = 0; i < 105000; ++i)
+                sFile[i] = 0;
+            for (u32 i = 0; i < 1000; ++i)
+                sFile[i] = sData[i];
+            for (u32 i = 100000; i < 105000; ++i)
+                sFile[i] = sData[i];
+            CHECK_TRUE(sFileIs(sMapFile, sFile, 105000));
+        }
+
+        UNITTEST_TEST(read_only)
+        {
+            CHECK_TRUE(sWriteFile(sMapFile, sData, DATA_SIZE));
+
+            mmapoptions_t options;
+            options.m_writable = false;
+
+            mmapstream_t stream;
+            if (!stream.open(nfs::filepath(sMapFile), options))
+                return;
+            CHECK_FALSE(stream.vcanWrite());
+            CHECK_EQUAL(DATA_SIZE, stream.vgetLength());
+
+            u8 const* view = nullptr;
+            stream.vsetPos(4096);
+            CHECK_EQUAL(8192, stream.vview(view, 8192));
+            CHECK_TRUE(sSame(view, sData + 4096, 8192));
+            CHECK_EQUAL(4096 + 8192, stream.vgetPos());
+
+            // Reads stop at the end
+            stream.vsetPos(DATA_SIZE - 100);
+            CHECK_EQUAL(100, stream.vread(sFile, 1000));
+            CHECK_TRUE(sSame(sFile, sData + DATA_SIZE - 100, 100));
+            CHECK_EQUAL(0, stream.vread(sFile, 1000));
+
+            u8* span = nullptr;
+            stream.vsetPos(0);
+            CHECK_EQUAL(0, stream.vwrite(sData, 10));
+            CHECK_EQUAL(0, stream.view_writable(span, 10));
+            CHECK_FALSE(stream.sync());
+            stream.vclose();
+
+            CHECK_TRUE(sFileIs(sMapFile, sData, DATA_SIZE));
+        }
+
+        UNITTEST_TEST(view_writable_and_set_length)
+        {
+            CHECK_TRUE(sWriteFile(sMapFile, sData, 10000));
+
+            mmapoptions_t options;
+            options.m_extent            = EXTENT;
+            options.m_flush_interval_us = 0;
+
+            mmapstream_t stream;
+            if (!stream.open(nfs::filepath(sMapFile), options))
+                return;
+
+            // Filled in place
+            u8* span = nullptr;
+            stream.vsetPos(9000);
+            CHECK_EQUAL(2000, stream.view_writable(span, 2000));
+            for (u32 i = 0; i < 2000; ++i)
+                span[i] = sData[20000 + i];
+            CHECK_EQUAL(11000, stream.vgetLength());
+            CHECK_EQUAL(11000, stream.vgetPos());
+
+            stream.vsetLength(10500);
+            CHECK_EQUAL(10500, stream.vgetLength());
+            stream.vflush();
+            stream.vclose();
+
+            for (u32 i = 0; i < 9000; ++i)
+                sFile[i] = sData[i];
+            for (u32 i = 0; i < 1500; ++i)
+                sFile[9000 + i] = sData[20000 + i];
+            CHECK_TRUE(sFileIs(sMapFile, sFile, 10500));
+        }
+
+        UNITTEST_TEST(scheduled_flush_on_io_thread)
+        {
+            nfs::rm(nfs::filepath(sMapFile));
+
+            mmapoptions_t options;
+            options.m_extent            = EXTENT;
+            options.m_flush_interval_us = 1;
+
+            mmapstream_t stream;
+            if (!stream.open(nfs::filepath(sMapFile), options))
+                return;
+
+            parked_thread_t thread;
+            s32 const       worker = mImpl->register_ioworker(&thread);
+
+            // Once the interval has passed a write queues the flush, the mapping is
+            // kept until the IO thread has run it
+            u64 const start = io_clock_us();
+            while (io_clock_us() < start + 10)
+            {
+            }
+            CHECK_EQUAL(4096, stream.vwrite(sData, 4096));
+            doIO(&thread);
+            CHECK_EQUAL(4096, stream.vwrite(sData + 4096, 4096));
+            doIO(&thread);
+
+            mImpl->unregister_ioworker(worker);
+            CHECK_TRUE(stream.sync());
+            stream.vclose();
+            CHECK_TRUE(sFileIs(sMapFile, sData, 8192));
+        }
+    }
+}
+UNITTEST_SUITE_END
@@ -0,0 +1,293 @@
+#include "ccore/c_target.h"
+#include "cbase/c_allocator.h"
+
+#include "cunittest/cunittest.h"
+
+#include "cfilesystem/c_dirpath.h"
+#include "cfilesystem/c_filepath.h"
+#include "cfilesystem/c_filesystem.h"
+#include "cfilesystem/c_recordlog.h"
+#include "cfilesystem/c_stream.h"
+
+#include "cfilesystem/private/c_enumerations.h"
+#include "cfilesystem/private/c_filedevice.h"
+#include "cfilesystem/private/c_segment.h"
+
+#include "test_helpers.h"
+
+using namespace ncore;
+using namespace ncore::nfs;
+
+extern alloc_t* gTestAllocator;
+
+namespace ncore
+{
+    static const char* sRecTestDir = "curdir:\\cfilesystem_test\\";
+    static const char* sRecDir     = "curdir:\\cfilesystem_test\\recordlog\\";
+    static const char* sRecPath    = "curdir:\\cfilesystem_test\\recordlog\\orders";
+
+    // Record i is sRecordSize(i) bytes of the data at i * RECORD_STRIDE
+    enum
+    {
+        RECORD_STRIDE = 50,
+    };
+
+    static u32 sRecordSize(s64 i) { return 1 + (u32)((i * 37) % 300); }
+
+    static bool sRecordIs(s64 i, u8 const* data, u8 const* record, u32 size) { return size == sRecordSize(i) && sSame(record, data + i * RECORD_STRIDE, size); }
+
+    static bool sAppend(recordwriter_t& writer, u8 const* data, s64 from, s64 to)
+    {
+        for (s64 i = from; i < to; ++i)
+        {
+            if (writer.append(data + i * RECORD_STRIDE, sRecordSize(i)) != i)
+                return false;
+        }
+        return true;
+    }
+
+    // Overwrite bytes of a segment file at pos, or add them at its end when pos is (u64)-1
+    static bool sPatchSegment(s64 index, u64 pos, u8 const* bytes, u32 size)
+    {
+        char name[ESettings::MAX_PATH];
+        segment_name(sRecPath, index, "rec", name, ESettings::MAX_PATH);
+        stream_t stream;
+        nfs::open(nfs::filepath(name), EFileMode::Value_Open, EFileAccess::Value_ReadWrite, EFileOp::Value_Sync, stream);
+        if (!stream.isOpen())
+            return false;
+        stream.setPos(pos == (u64)-1 ? stream.getLength() : (s64)pos);
+        s64 const written = stream.write(bytes, size);
+        nfs::close(stream);
+        return written == (s64)size;
+    }
+
+    static bool sSegmentExists(s64 index)
+    {
+        char name[ESettings::MAX_PATH];
+        segment_name(sRecPath, index, "rec", name, ESettings::MAX_PATH);
+        return nfs::exists(nfs::filepath(name));
+    }
+} // namespace ncore
+
+UNITTEST_SUITE_BEGIN(recordlog)
+{
+    UNITTEST_FIXTURE(main)
+    {
+        enum
+        {
+            DATA_SIZE    = 64 * 1024,
+            SEGMENT_SIZE = 4096,
+            INTERVAL     = 4,
+        };
+
+        static u8* sData = nullptr;
+
+        static void sOptions(recordlogoptions_t& options)
+        {
+            options.m_path           = sRecPath;
+            options.m_segment_size   = SEGMENT_SIZE;
+            options.m_index_interval = INTERVAL;
+        }
+
+        // Removes the segments an earlier test left behind
+        static void sClearLog()
+        {
+            nfs::rm(nfs::dirpath(sRecDir));
+            sMakeDir(sRecDir);
+        }
+
+        UNITTEST_FIXTURE_SETUP()
+        {
+            nfs::context_t ctxt;
+            ctxt.m_allocator = gTestAllocator;
+            nfs::create(ctxt);
+
+            sData = (u8*)gTestAllocator->allocate(DATA_SIZE);
+            sFill(sData, DATA_SIZE, 44);
+            sMakeDir(sRecTestDir);
+            sMakeDir(sRecDir);
+        }
+
+        UNITTEST_FIXTURE_TEARDOWN()
+        {
+            nfs::rm(nfs::dirpath(sRecDir));
+            gTestAllocator->deallocate(sData);
+            nfs::destroy();
+        }
+
+        UNITTEST_TEST(write_and_read)
+        {
+            enum
+            {
+                RECORDS = 100,
+            };
+
+            sClearLog();
+
+            recordlogoptions_t options;
+            sOptions(options);
+            recordwriter_t writer;
+            CHECK_TRUE(writer.open(options));
+            CHECK_TRUE(sAppend(writer, sData, 0, RECORDS));
+            CHECK_EQUAL(RECORDS, writer.count());
+            CHECK_TRUE(writer.flush());
+            writer.close();
+            CHECK_TRUE(sSegmentExists(3)); // The records are spread over segments
+
+            recordreader_t reader;
+            CHECK_TRUE(reader.open(sRecPath));
+            u8 const* record = nullptr;
+            u32       size   = 0;
+            for (s64 i = 0; i < RECORDS; ++i)
+            {
+                CHECK_EQUAL(i, reader.position());
+                CHECK_EQUAL(ERecordLog::RECORD, reader.next(record, size));
+                CHECK_TRUE(sRecordIs(i, sData, record, size));
+            }
+            CHECK_EQUAL(ERecordLog::END, reader.next(record, size));
+            reader.close();
+
+            CHECK_FALSE(reader.open("curdir:\\cfilesystem_test\\recordlog\\missing"));
+        }
+
+        UNITTEST_TEST(tailing)
+        {
+            sClearLog();
+
+            recordlogoptions_t options;
+            sOptions(options);
+            recordwriter_t writer;
+            CHECK_TRUE(writer.open(options));
+            CHECK_TRUE(sAppend(writer, sData, 0, 3));
+
+            recordreader_t reader;
+            CHECK_TRUE(reader.open(sRecPath));
+            u8 const* record = nullptr;
+            u32       size   = 0;
+            for (s64 i = 0; i < 3; ++i)
+                CHECK_EQUAL(ERecordLog::RECORD, reader.next(record, size));
+            CHECK_EQUAL(ERecordLog::END, reader.next(record, size));
+
+            // Appended since, in this segment and in the ones after it
+            CHECK_TRUE(sAppend(writer, sData, 3, 60));
+            CHECK_TRUE(sSegmentExists(1));
+            for (s64 i = 3; i < 60; ++i)
+            {
+                CHECK_EQUAL(ERecordLog::RECORD, reader.next(record, size));
+                CHECK_TRUE(sRecordIs(i, sData, record, size));
+            }
+            CHECK_EQUAL(ERecordLog::END, reader.next(record, size));
+
+            // A record larger than a segment gets a segment of its own
+            CHECK_EQUAL(60, writer.append(sData, 2 * SEGMENT_SIZE));
+            CHECK_EQUAL(ERecordLog::RECORD, reader.next(record, size));
+            CHECK_EQUAL(2 * SEGMENT_SIZE, size);
+            CHECK_TRUE(sSame(record, sData, size));
+
+            reader.close();
+            writer.close();
+        }
+
+        UNITTEST_TEST(seek)
+        {
+            enum
+            {
+                RECORDS = 100,
+            };
+
+            sClearLog();
+
+            recordlogoptions_t options;
+            sOptions(options);
+            recordwriter_t writer;
+            CHECK_TRUE(writer.open(options));
+            CHECK_TRUE(sAppend(writer, sData, 0, RECORDS));
+            writer.close();
+
+            recordreader_t reader;
+            CHECK_TRUE(reader.open(sRecPath));
+            u8 const* record  = nullptr;
+            u32       size    = 0;
+            s64 const picks[] = {57, 3, 99, 0, 4, 58};
+            for (s32 p = 0; p < 6; ++p)
+            {
+                CHECK_TRUE(reader.seek(picks[p]));
+                CHECK_EQUAL(picks[p], reader.position());
+                CHECK_EQUAL(ERecordLog::RECORD, reader.next(record, size));
+                CHECK_TRUE(sRecordIs(picks[p], sData, record, size));
+            }
+            CHECK_FALSE(reader.seek(RECORDS + 1));
+            CHECK_FALSE(reader.seek(-1));
+            reader.close();
+        }
+
+        UNITTEST_TEST(recover_torn_record)
+        {
+            sClearLog();
+
+            recordlogoptions_t options;
+            sOptions(options);
+            recordwriter_t writer;
+            CHECK_TRUE(writer.open(options));
+            CHECK_TRUE(sAppend(writer, sData, 0, 10));
+            writer.close();
+
+            // A frame for 100 bytes of which only 5 made it to the file
+            u8 torn[8 + 5];
+            u32 const frame[2] = {100, 0};
+            for (u32 i = 0; i < 8; ++i)
+                torn[i] = ((u8 const*)frame)[i];
+            for (u32 i = 0; i < 5; ++i)
+                torn[8 + i] = sData[i];
+            CHECK_TRUE(sPatchSegment(0, (u64)-1, torn, sizeof(torn)));
+
+            CHECK_TRUE(writer.open(options));
+            CHECK_EQUAL(10, writer.count());
+            CHECK_TRUE(sAppend(writer, sData, 10, 12));
+            writer.close();
+
+            recordreader_t reader;
+            CHECK_TRUE(reader.open(sRecPath));
+            u8 const* record = nullptr;
+            u32       size   = 0;
+            for (s64 i = 0; i < 12; ++i)
+            {
+                CHECK_EQUAL(ERecordLog::RECORD, reader.next(record, size));
+                CHECK_TRUE(sRecordIs(i, sData, record, size));
+            }
+            CHECK_EQUAL(ERecordLog::END, reader.next(record, size));
+            reader.close();
+        }
+
+        UNITTEST_TEST(corrupt_record)
+        {
+            sClearLog();
+
+            recordlogoptions_t options;
+            sOptions(options);
+            recordwriter_t writer;
+            CHECK_TRUE(writer.open(options));
+            CHECK_TRUE(sAppend(writer, sData, 0, 40));
+            writer.close();
+            CHECK_TRUE(sSegmentExists(1));
+
+            // The data of record 0 follows the segment header and its frame
+            u8 const flipped = (u8)~sData[0];
+            CHECK_TRUE(sPatchSegment(0, 16 + 8, &flipped, 1));
+
+            recordreader_t reader;
+            CHECK_TRUE(reader.open(sRecPath));
+            u8 const* record = nullptr;
+            u32       size   = 0;
+            CHECK_EQUAL(ERecordLog::CORRUPT, reader.next(record, size));
+            CHECK_EQUAL(0, reader.position());
+
+            // The records after the next index entry can still be reached
+            CHECK_TRUE(reader.seek(INTERVAL));
+            CHECK_EQUAL(ERecordLog::RECORD, reader.next(record, size));
+            CHECK_TRUE(sRecordIs(INTERVAL, sData, record, size));
+            reader.close();
+        }
+    }
+}
+UNITTEST_SUITE_END
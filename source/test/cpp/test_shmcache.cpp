@@ -0,0 +1,180 @@
+#include "ccore/c_target.h"
+#include "cbase/c_allocator.h"
+
+#include "cunittest/cunittest.h"
+
+#include "cfilesystem/c_dirpath.h"
+#include "cfilesystem/c_filepath.h"
+#include "cfilesystem/c_filesystem.h"
+#include "cfilesystem/c_stream.h"
+
+#include "cfilesystem/private/c_filedevice.h"
+
+#include "test_helpers.h"
+
+using namespace ncore;
+using namespace ncore::nfs;
+
+extern alloc_t* gTestAllocator;
+
+namespace ncore
+{
+    static const char* sCacheDir   = "curdir:\\cfilesystem_test\\";
+    static const char* sCacheFile  = "curdir:\\cfilesystem_test\\shmcache.bin";
+    static const char* sCacheLarge = "curdir:\\cfilesystem_test\\shmcache_large.bin";
+    static const char* sCacheName  = "cfilesystem_test_shmcache";
+} // namespace ncore
+
+UNITTEST_SUITE_BEGIN(shmcache)
+{
+    UNITTEST_FIXTURE(main)
+    {
+        enum
+        {
+            DATA_SIZE  = 512 * 1024,
+            CACHE_SIZE = 1024 * 1024,
+        };
+
+        static u8*           sData   = nullptr;
+        static filedevice_t* sDevice = nullptr;
+
+        UNITTEST_FIXTURE_SETUP()
+        {
+            nfs::context_t ctxt;
+            ctxt.m_allocator = gTestAllocator;
+            nfs::create(ctxt);
+
+            sData = (u8*)gTestAllocator->allocate(DATA_SIZE);
+            sFill(sData, DATA_SIZE, 46);
+            sMakeDir(sCacheDir);
+            sDevice = nfs::filepath(sCacheFile).m_dirpath.m_device->m_fileDevice;
+        }
+
+        UNITTEST_FIXTURE_TEARDOWN()
+        {
+            nfs::rm(nfs::filepath(sCacheFile));
+            nfs::rm(nfs::filepath(sCacheLarge));
+            gTestAllocator->deallocate(sData);
+            nfs::destroy();
+        }
+
+        UNITTEST_TEST(load_is_shared)
+        {
+            CHECK_TRUE(sWriteFile(sCacheFile, sData, 10000));
+            filedevice_t* cache = nfs::create_cache_device(sDevice, sCacheName, CACHE_SIZE);
+            if (cache == nullptr)
+                return; // No shared memory
+            filepath_t const fp = nfs::filepath(sCacheFile);
+
+            u8 const* data    = nullptr;
+            u64       size    = 0;
+            void*     mapping = nullptr;
+            CHECK_TRUE(cache->loadFile(fp, gTestAllocator, 1, data, size, mapping));
+            CHECK_EQUAL(10000, size);
+            CHECK_TRUE(sSame(data, sData, 10000));
+
+            // The second load is a hit on the same shared bytes
+            u8 const* again         = nullptr;
+            void*     again_mapping = nullptr;
+            CHECK_TRUE(cache->loadFile(fp, gTestAllocator, 1, again, size, again_mapping));
+            CHECK_TRUE(again == data);
+
+            // Another attach to the same memory sees the file as well
+            filedevice_t* other = nfs::create_cache_device(sDevice, sCacheName, CACHE_SIZE);
+            CHECK_TRUE(other != nullptr);
+            u8 const* shared         = nullptr;
+            void*     shared_mapping = nullptr;
+            CHECK_TRUE(other->loadFile(fp, gTestAllocator, 1, shared, size, shared_mapping));
+            CHECK_EQUAL(10000, size);
+            CHECK_TRUE(sSame(shared, sData, 10000));
+            CHECK_TRUE(other->unmapFile(shared_mapping));
+            nfs::destroy_cache_device(other);
+
+            // The same name with another size is refused
+            CHECK_TRUE(nfs::create_cache_device(sDevice, sCacheName, 2 * CACHE_SIZE) == nullptr);
+
+            CHECK_TRUE(cache->unmapFile(again_mapping));
+            CHECK_TRUE(cache->unmapFile(mapping));
+            nfs::destroy_cache_device(cache);
+        }
+
+        UNITTEST_TEST(changed_file_is_loaded_again)
+        {
+            CHECK_TRUE(sWriteFile(sCacheFile, sData, 10000));
+            filedevice_t* cache = nfs::create_cache_device(sDevice, sCacheName, CACHE_SIZE);
+            if (cache == nullptr)
+                return;
+            filepath_t const fp = nfs::filepath(sCacheFile);
+
+            u8 const* data    = nullptr;
+            u64       size    = 0;
+            void*     mapping = nullptr;
+            CHECK_TRUE(cache->loadFile(fp, gTestAllocator, 1, data, size, mapping));
+            CHECK_TRUE(cache->unmapFile(mapping));
+
+            CHECK_TRUE(sWriteFile(sCacheFile, sData + 20000, 12000));
+            CHECK_TRUE(cache->loadFile(fp, gTestAllocator, 1, data, size, mapping));
+            CHECK_EQUAL(12000, size);
+            CHECK_TRUE(sSame(data, sData + 20000, 12000));
+            CHECK_TRUE(cache->unmapFile(mapping));
+
+            nfs::destroy_cache_device(cache);
+        }
+
+        UNITTEST_TEST(copied_out)
+        {
+            CHECK_TRUE(sWriteFile(sCacheFile, sData, 10000));
+            filedevice_t* cache = nfs::create_cache_device(sDevice, sCacheName, CACHE_SIZE);
+            if (cache == nullptr)
+                return;
+            filepath_t const fp = nfs::filepath(sCacheFile);
+
+            // Without mapping the caller owns a copy
+            u8 const* data    = nullptr;
+            u64       size    = 0;
+            void*     mapping = nullptr;
+            CHECK_TRUE(cache->loadFile(fp, gTestAllocator, 0, data, size, mapping));
+            CHECK_EQUAL(10000, size);
+            CHECK_TRUE(mapping == nullptr);
+            CHECK_TRUE(sSame(data, sData, 10000));
+            gTestAllocator->deallocate((void*)data);
+
+            // Into a buffer, only when it fits
+            u8* buffer = (u8*)gTestAllocator->allocate(10000);
+            CHECK_FALSE(cache->loadFile(fp, buffer, 9999, size));
+            CHECK_TRUE(cache->loadFile(fp, buffer, 10000, size));
+            CHECK_EQUAL(10000, size);
+            CHECK_TRUE(sSame(buffer, sData, 10000));
+            gTestAllocator->deallocate(buffer);
+
+            nfs::destroy_cache_device(cache);
+        }
+
+        UNITTEST_TEST(large_file_bypasses_the_cache)
+        {
+            filedevice_t* cache = nfs::create_cache_device(sDevice, sCacheName, CACHE_SIZE);
+            if (cache == nullptr)
+                return;
+
+            // More than a quarter of the cache is loaded from the device
+            CHECK_TRUE(sWriteFile(sCacheLarge, sData, DATA_SIZE));
+            u8 const* data    = nullptr;
+            u64       size    = 0;
+            void*     mapping = nullptr;
+            CHECK_TRUE(cache->loadFile(nfs::filepath(sCacheLarge), gTestAllocator, 1, data, size, mapping));
+            CHECK_EQUAL(DATA_SIZE, size);
+            CHECK_TRUE(sSame(data, sData, DATA_SIZE));
+            if (mapping != nullptr)
+            {
+                CHECK_TRUE(cache->unmapFile(mapping));
+            }
+            else
+            {
+                gTestAllocator->deallocate((void*)data);
+            }
+
+            nfs::destroy_cache_device(cache);
+        }
+    }
+}
+UNITTEST_SUITE_END
@@ -0,0 +1,229 @@
+#include "ccore/c_target.h"
+#include "cbase/c_allocator.h"
+
+#include "cunittest/cunittest.h"
+
+#include "cfilesystem/c_dirpath.h"
+#include "cfilesystem/c_filepath.h"
+#include "cfilesystem/c_filesystem.h"
+#include "cfilesystem/c_stream.h"
+
+#include "cfilesystem/private/c_filedevice.h"
+
+#include "test_helpers.h"
+
+using namespace ncore;
+using namespace ncore::nfs;
+
+extern alloc_t* gTestAllocator;
+
+namespace ncore
+{
+    static const char* sTierDir  = "curdir:\\cfilesystem_test\\";
+    static const char* sTierFile = "curdir:\\cfilesystem_test\\tiered.bin";
+
+    // True when the device gives exactly size bytes of data for the file
+    static bool sDeviceHas(filedevice_t* device, const char* path, u8 const* data, u64 size, u8* buffer, u64 capacity)
+    {
+        u64 n = 0;
+        return device->loadFile(nfs::filepath(path), buffer, capacity, n) && n == size && sSame(buffer, data, size);
+    }
+} // namespace ncore
+
+UNITTEST_SUITE_BEGIN(tiered)
+{
+    UNITTEST_FIXTURE(main)
+    {
+        enum
+        {
+            DATA_SIZE = 64 * 1024,
+            FILE_SIZE = 10000,
+        };
+
+        static u8*           sData   = nullptr;
+        static u8*           sFile   = nullptr;
+        static u8*           sRead   = nullptr;
+        static filedevice_t* sDevice = nullptr;
+
+        // The file is written again and used twice, that reaches the promote threshold
+        // and the next use finds the file in memory
+        static void sPromote(filedevice_t* tier)
+        {
+            sWriteFile(sTierFile, sData, FILE_SIZE);
+
+            // What the file is after a write of 1000 bytes at 100
+            for (u32 i = 0; i < FILE_SIZE; ++i)
+                sFile[i] = sData[i];
+            for (u32 i = 0; i < 1000; ++i)
+                sFile[100 + i] = sData[50000 + i];
+
+            for (s32 i = 0; i < 2; ++i)
+            {
+                u64 n = 0;
+                tier->loadFile(nfs::filepath(sTierFile), sRead, DATA_SIZE, n);
+            }
+        }
+
+        UNITTEST_FIXTURE_SETUP()
+        {
+            nfs::context_t ctxt;
+            ctxt.m_allocator = gTestAllocator;
+            nfs::create(ctxt);
+
+            sData = (u8*)gTestAllocator->allocate(DATA_SIZE);
+            sFile = (u8*)gTestAllocator->allocate(DATA_SIZE);
+            sRead = (u8*)gTestAllocator->allocate(DATA_SIZE);
+            sFill(sData, DATA_SIZE, 47);
+            sMakeDir(sTierDir);
+            sDevice = nfs::filepath(sTierFile).m_dirpath.m_device->m_fileDevice;
+        }
+
+        UNITTEST_FIXTURE_TEARDOWN()
+        {
+            nfs::rm(nfs::filepath(sTierFile));
+            gTestAllocator->deallocate(sRead);
+            gTestAllocator->deallocate(sFile);
+            gTestAllocator->deallocate(sData);
+            nfs::destroy();
+        }
+
+        UNITTEST_TEST(write_back_on_flush)
+        {
+            tieroptions_t options;
+            options.m_write             = ETierWrite::BACK;
+            options.m_promote_threshold = 2;
+            filedevice_t* tier          = nfs::create_tiered_device(sDevice, options);
+            sPromote(tier);
+
+            void* handle = nullptr;
+            CHECK_TRUE(tier->openFile(nfs::filepath(sTierFile), EFileMode::Value_Open, EFileAccess::Value_ReadWrite, EFileOp::Value_Sync, handle));
+            u64 n = 0;
+            CHECK_TRUE(tier->writeFile(handle, 100, sData + 50000, 1000, n));
+            CHECK_EQUAL(1000, n);
+
+            // Only the memory tier has the write
+            CHECK_TRUE(tier->readFile(handle, 0, sRead, DATA_SIZE, n));
+            CHECK_EQUAL(FILE_SIZE, n);
+            CHECK_TRUE(sSame(sRead, sFile, FILE_SIZE));
+            CHECK_TRUE(sDeviceHas(sDevice, sTierFile, sData, FILE_SIZE, sRead, DATA_SIZE));
+
+            CHECK_TRUE(tier->flushFile(handle));
+            CHECK_TRUE(sDeviceHas(sDevice, sTierFile, sFile, FILE_SIZE, sRead, DATA_SIZE));
+            CHECK_TRUE(tier->closeFile(handle));
+
+            nfs::destroy_tiered_device(tier);
+        }
+
+        UNITTEST_TEST(write_back_on_destroy)
+        {
+            tieroptions_t options;
+            options.m_write             = ETierWrite::BACK;
+            options.m_promote_threshold = 2;
+            filedevice_t* tier          = nfs::create_tiered_device(sDevice, options);
+            sPromote(tier);
+
+            void* handle = nullptr;
+            CHECK_TRUE(tier->openFile(nfs::filepath(sTierFile), EFileMode::Value_Open, EFileAccess::Value_ReadWrite, EFileOp::Value_Sync, handle));
+            u64 n = 0;
+            CHECK_TRUE(tier->writeFile(handle, 100, sData + 50000, 1000, n));
+            CHECK_TRUE(tier->closeFile(handle));
+
+            // Still dirty after the close, the load is served from memory
+            CHECK_TRUE(tier->loadFile(nfs::filepath(sTierFile), sRead, DATA_SIZE, n));
+            CHECK_TRUE(sSame(sRead, sFile, FILE_SIZE));
+            CHECK_TRUE(sDeviceHas(sDevice, sTierFile, sData, FILE_SIZE, sRead, DATA_SIZE));
+
+            nfs::destroy_tiered_device(tier);
+            CHECK_TRUE(sDeviceHas(sDevice, sTierFile, sFile, FILE_SIZE, sRead, DATA_SIZE));
+        }
+
+        UNITTEST_TEST(write_through)
+        {
+            tieroptions_t options;
+            options.m_write             = ETierWrite::THROUGH;
+            options.m_promote_threshold = 2;
+            filedevice_t* tier          = nfs::create_tiered_device(sDevice, options);
+            sPromote(tier);
+
+            void* handle = nullptr;
+            CHECK_TRUE(tier->openFile(nfs::filepath(sTierFile), EFileMode::Value_Open, EFileAccess::Value_ReadWrite, EFileOp::Value_Sync, handle));
+            u64 n = 0;
+            CHECK_TRUE(tier->writeFile(handle, 100, sData + 50000, 1000, n));
+            CHECK_TRUE(sDeviceHas(sDevice, sTierFile, sFile, FILE_SIZE, sRead, DATA_SIZE));
+            CHECK_TRUE(tier->readFile(handle, 0, sRead, DATA_SIZE, n));
+            CHECK_TRUE(sSame(sRead, sFile, FILE_SIZE));
+            CHECK_TRUE(tier->closeFile(handle));
+
+            CHECK_TRUE(sDeviceHas(tier, sTierFile, sFile, FILE_SIZE, sRead, DATA_SIZE));
+            nfs::destroy_tiered_device(tier);
+        }
+
+        UNITTEST_TEST(extending_write_detaches)
+        {
+            tieroptions_t options;
+            options.m_write             = ETierWrite::BACK;
+            options.m_promote_threshold = 2;
+            filedevice_t* tier          = nfs::create_tiered_device(sDevice, options);
+            sPromote(tier);
+
+            // Goes to the device right away even when writing back
+            void* handle = nullptr;
+            CHECK_TRUE(tier->openFile(nfs::filepath(sTierFile), EFileMode::Value_Open, EFileAccess::Value_ReadWrite, EFileOp::Value_Sync, handle));
+            u64 n = 0;
+            CHECK_TRUE(tier->writeFile(handle, FILE_SIZE - 500, sData + 50000, 1000, n));
+            u64 length = 0;
+            CHECK_TRUE(tier->getLengthOfFile(handle, length));
+            CHECK_EQUAL(FILE_SIZE + 500, length);
+            CHECK_TRUE(tier->closeFile(handle));
+
+            for (u32 i = 0; i < FILE_SIZE - 500; ++i)
+                sFile[i] = sData[i];
+            for (u32 i = 0; i < 1000; ++i)
+                sFile[FILE_SIZE - 500 + i] = sData[50000 + i];
+            CHECK_TRUE(sDeviceHas(sDevice, sTierFile, sFile, FILE_SIZE + 500, sRead, DATA_SIZE));
+            CHECK_TRUE(sDeviceHas(tier, sTierFile, sFile, FILE_SIZE + 500, sRead, DATA_SIZE));
+
+            nfs::destroy_tiered_device(tier);
+        }
+
+        UNITTEST_TEST(too_large_to_promote)
+        {
+            tieroptions_t options;
+            options.m_write             = ETierWrite::BACK;
+            options.m_promote_threshold = 2;
+            options.m_max_file_size     = FILE_SIZE - 1;
+            filedevice_t* tier          = nfs::create_tiered_device(sDevice, options);
+            sPromote(tier);
+
+            void* handle = nullptr;
+            CHECK_TRUE(tier->openFile(nfs::filepath(sTierFile), EFileMode::Value_Open, EFileAccess::Value_ReadWrite, EFileOp::Value_Sync, handle));
+            u64 n = 0;
+            CHECK_TRUE(tier->writeFile(handle, 100, sData + 50000, 1000, n));
+            CHECK_TRUE(sDeviceHas(sDevice, sTierFile, sFile, FILE_SIZE, sRead, DATA_SIZE));
+            CHECK_TRUE(tier->closeFile(handle));
+
+            nfs::destroy_tiered_device(tier);
+        }
+
+        UNITTEST_TEST(delete_forgets)
+        {
+            tieroptions_t options;
+            options.m_write             = ETierWrite::BACK;
+            options.m_promote_threshold = 2;
+            filedevice_t* tier          = nfs::create_tiered_device(sDevice, options);
+            sPromote(tier);
+
+            CHECK_TRUE(tier->deleteFile(nfs::filepath(sTierFile)));
+            CHECK_FALSE(tier->hasFile(nfs::filepath(sTierFile)));
+            u64 n = 0;
+            CHECK_FALSE(tier->loadFile(nfs::filepath(sTierFile), sRead, DATA_SIZE, n));
+
+            // A new file under the name is not confused with the old one
+            CHECK_TRUE(sWriteFile(sTierFile, sData + 30000, 2000));
+            CHECK_TRUE(sDeviceHas(tier, sTierFile, sData + 30000, 2000, sRead, DATA_SIZE));
+
+            nfs::destroy_tiered_device(tier);
+        }
+    }
+}
+UNITTEST_SUITE_END
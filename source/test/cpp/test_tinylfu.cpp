@@ -0,0 +1,55 @@
+#include "ccore/c_target.h"
+#include "cbase/c_allocator.h"
+
+#include "cunittest/cunittest.h"
+
+#include "cfilesystem/private/c_tinylfu.h"
+
+using namespace ncore;
+using namespace ncore::nfs;
+
+extern alloc_t* gTestAllocator;
+
+UNITTEST_SUITE_BEGIN(tinylfu)
+{
+    UNITTEST_FIXTURE(main)
+    {
+        static tinylfu_t sSketch;
+
+        UNITTEST_FIXTURE_SETUP() { sSketch.init(gTestAllocator, 1000); }
+        UNITTEST_FIXTURE_TEARDOWN() { sSketch.exit(); }
+
+        UNITTEST_TEST(width_is_power_of_2)
+        {
+            CHECK_EQUAL((u32)1024, sSketch.width());
+        }
+
+        UNITTEST_TEST(counts_and_saturates)
+        {
+            CHECK_EQUAL((u32)0, sSketch.estimate(42));
+            for (s32 i = 0; i < 3; ++i)
+                sSketch.increment(42);
+            CHECK_TRUE(sSketch.estimate(42) >= 3);
+            for (s32 i = 0; i < 100; ++i)
+                sSketch.increment(43);
+            CHECK_EQUAL((u32)tinylfu_t::MAX_COUNT, sSketch.estimate(43));
+        }
+
+        UNITTEST_TEST(admits_the_more_frequent)
+        {
+            for (s32 i = 0; i < 5; ++i)
+                sSketch.increment(1000);
+            sSketch.increment(2000);
+            CHECK_TRUE(sSketch.admit(1000, 2000));
+            CHECK_FALSE(sSketch.admit(2000, 1000));
+        }
+
+        UNITTEST_TEST(aging_halves)
+        {
+            u32 const before = sSketch.estimate(43);
+            sSketch.age();
+            CHECK_EQUAL(before / 2, sSketch.estimate(43));
+        }
+    }
+}
+UNITTEST_SUITE_END